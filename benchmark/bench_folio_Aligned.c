@@ -0,0 +1,171 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares vectorized loads from folio_Allocate() memory and from
+ * folio_AllocateAligned() memory, and the cost of the aligned allocation.
+ *
+ * usage: bench_folio_Aligned [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <Folio/folio.h>
+#include <Folio/folio_StdProvider.h>
+
+// 32 byte vectors, one AVX register
+typedef float Vector __attribute__((vector_size(32)));
+
+// The same vector, but the compiler may not assume the alignment
+typedef float UnalignedVector __attribute__((vector_size(32), aligned(4)));
+
+#define VectorFloats (sizeof(Vector) / sizeof(float))
+
+static const size_t _lengths[] = { 4096, 65536, 1048576 };
+static const size_t _lengthCount = sizeof(_lengths) / sizeof(size_t);
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+static float
+_sumAligned(const void *memory, size_t length)
+{
+	const Vector *v = memory;
+	Vector sum = { 0 };
+	for (size_t i = 0; i < length / sizeof(Vector); ++i) {
+		sum += v[i];
+	}
+
+	float total = 0;
+	for (size_t i = 0; i < VectorFloats; ++i) {
+		total += sum[i];
+	}
+	return total;
+}
+
+static float
+_sumUnaligned(const void *memory, size_t length)
+{
+	const UnalignedVector *v = memory;
+	UnalignedVector sum = { 0 };
+	for (size_t i = 0; i < length / sizeof(Vector); ++i) {
+		sum += v[i];
+	}
+
+	float total = 0;
+	for (size_t i = 0; i < VectorFloats; ++i) {
+		total += sum[i];
+	}
+	return total;
+}
+
+/*
+ * @return Bytes per second summed
+ */
+static double
+_sum(float (*sum)(const void *, size_t), const void *memory, size_t length, size_t iterations)
+{
+	volatile float sink = 0;
+	double start = _now();
+	for (size_t i = 0; i < iterations; ++i) {
+		sink += sum(memory, length);
+	}
+	(void) sink;
+	return (double) iterations * length / (_now() - start);
+}
+
+/*
+ * Allocate and immediately release, with the alignment or without if 0
+ */
+static double
+_pingPong(FolioMemoryProvider *provider, size_t length, size_t alignment, size_t iterations)
+{
+	double start = _now();
+	for (size_t i = 0; i < iterations; ++i) {
+		void *memory;
+		if (alignment) {
+			memory = folioMemoryProvider_AllocateAligned(provider, length, alignment, NULL);
+		} else {
+			memory = folioMemoryProvider_Allocate(provider, length, NULL);
+		}
+		*(volatile uint8_t *) memory = (uint8_t) i;
+		folioMemoryProvider_Release(provider, &memory);
+	}
+	return iterations / (_now() - start);
+}
+
+int
+main(int argc, char *argv[argc])
+{
+	size_t iterations = 1000000;
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+	}
+
+	FolioMemoryProvider *provider = folioStdProvider_Create(SIZE_MAX);
+
+	printf("%-10s %16s %16s %16s\n", "length", "unaligned MB/s", "aligned 32 MB/s", "aligned 64 MB/s");
+	for (size_t l = 0; l < _lengthCount; ++l) {
+		size_t length = _lengths[l];
+		size_t rounds = iterations * 64 / length + 1;
+
+		// An odd float offset, so the plain allocation is not 32 byte aligned by chance
+		float *plain = folioMemoryProvider_Allocate(provider, length + sizeof(float), NULL);
+		float *aligned32 = folioMemoryProvider_AllocateAligned(provider, length, 32, NULL);
+		float *aligned64 = folioMemoryProvider_AllocateAligned(provider, length, 64, NULL);
+		for (size_t i = 0; i < length / sizeof(float); ++i) {
+			plain[i + 1] = aligned32[i] = aligned64[i] = (float) i;
+		}
+
+		double unaligned = _sum(_sumUnaligned, plain + 1, length, rounds);
+		double rate32 = _sum(_sumAligned, aligned32, length, rounds);
+		double rate64 = _sum(_sumAligned, aligned64, length, rounds);
+		printf("%-10zu %16.0f %16.0f %16.0f\n", length, unaligned / 1E6, rate32 / 1E6, rate64 / 1E6);
+
+		folioMemoryProvider_Release(provider, (void **) &plain);
+		folioMemoryProvider_Release(provider, (void **) &aligned32);
+		folioMemoryProvider_Release(provider, (void **) &aligned64);
+	}
+
+	const size_t alignments[] = { 0, 32, 64, 4096 };
+	printf("\n%-10s %12s %16s\n", "length", "alignment", "pingpong ops/s");
+	for (size_t a = 0; a < sizeof(alignments) / sizeof(size_t); ++a) {
+		double rate = _pingPong(provider, 256, alignments[a], iterations);
+		printf("%-10d %12zu %16.0f\n", 256, alignments[a], rate);
+	}
+
+	folioMemoryProvider_ReleaseProvider(&provider);
+	return 0;
+}
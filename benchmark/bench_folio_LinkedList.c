@@ -0,0 +1,114 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Measures FolioLinkedList append/remove throughput on the default provider.
+ *
+ * usage: bench_folio_LinkedList [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <Folio/folio.h>
+#include <Folio/folio_LinkedList.h>
+
+// The number of items on the list in the batch workload
+#define BatchSize 1024
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+/*
+ * Append one item and remove it again, like a queue that is usually empty
+ */
+static double
+_pingPong(FolioLinkedList *list, void *item, size_t iterations)
+{
+	double start = _now();
+	for (size_t i = 0; i < iterations; ++i) {
+		folioLinkedList_Append(list, item);
+		void *removed = folioLinkedList_Remove(list);
+		folio_Release(&removed);
+	}
+	return iterations / (_now() - start);
+}
+
+/*
+ * Append BatchSize items, then remove them all
+ */
+static double
+_batch(FolioLinkedList *list, void *items[BatchSize], size_t iterations)
+{
+	size_t rounds = iterations / BatchSize;
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			folioLinkedList_Append(list, items[i]);
+		}
+		for (size_t i = 0; i < BatchSize; ++i) {
+			void *removed = folioLinkedList_Remove(list);
+			folio_Release(&removed);
+		}
+	}
+	return rounds * BatchSize / (_now() - start);
+}
+
+int
+main(int argc, char *argv[argc])
+{
+	size_t iterations = 1000000;
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+	}
+
+	void *items[BatchSize];
+	for (size_t i = 0; i < BatchSize; ++i) {
+		items[i] = folio_Allocate(64);
+	}
+
+	FolioLinkedList *list = folioLinkedList_Create();
+
+	double pingPong = _pingPong(list, items[0], iterations);
+	double batch = _batch(list, items, iterations);
+
+	printf("%-20s %16s %16s\n", "list", "pingpong ops/s", "batch ops/s");
+	printf("%-20s %16.0f %16.0f\n", "FolioLinkedList", pingPong, batch);
+
+	folioLinkedList_Release(&list);
+	for (size_t i = 0; i < BatchSize; ++i) {
+		folio_Release(&items[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,276 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares the allocate/release throughput of the memory providers.
+ *
+ * usage: bench_folio_Providers [iterations]
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <Folio/folio.h>
+#include <Folio/folio_StdProvider.h>
+#include <Folio/folio_SlabProvider.h>
+#include <Folio/folio_ArenaProvider.h>
+#include <Folio/folio_FastProvider.h>
+
+typedef struct provider_entry {
+	const char *name;
+	FolioMemoryProvider * (*create)(size_t poolSize);
+} ProviderEntry;
+
+static const ProviderEntry _providers[] = {
+	{ .name = "FolioStdProvider",  .create = folioStdProvider_Create },
+	{ .name = "FolioSlabProvider", .create = folioSlabProvider_Create },
+	{ .name = "FolioFastProvider", .create = folioFastProvider_Create },
+};
+
+static const size_t _providerCount = sizeof(_providers) / sizeof(ProviderEntry);
+
+static const size_t _lengths[] = { 16, 64, 256, 1024, 4096 };
+static const size_t _lengthCount = sizeof(_lengths) / sizeof(size_t);
+
+// The number of live allocations in the batch workload
+#define BatchSize 1024
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+/*
+ * Allocate and immediately release
+ */
+static double
+_pingPong(FolioMemoryProvider *provider, size_t length, size_t iterations)
+{
+	double start = _now();
+	for (size_t i = 0; i < iterations; ++i) {
+		void *memory = folioMemoryProvider_Allocate(provider, length, NULL);
+		*(volatile uint8_t *) memory = (uint8_t) i;
+		folioMemoryProvider_Release(provider, &memory);
+	}
+	return iterations / (_now() - start);
+}
+
+/*
+ * Allocate BatchSize blocks, then release them all
+ */
+static double
+_batch(FolioMemoryProvider *provider, size_t length, size_t iterations)
+{
+	void *memory[BatchSize];
+	size_t rounds = iterations / BatchSize;
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			memory[i] = folioMemoryProvider_Allocate(provider, length, NULL);
+		}
+		for (size_t i = 0; i < BatchSize; ++i) {
+			folioMemoryProvider_Release(provider, &memory[i]);
+		}
+	}
+	return rounds * BatchSize / (_now() - start);
+}
+
+/*
+ * The same workload as _batch(), through folioMemoryProvider_AllocateBatch() and
+ * folioMemoryProvider_ReleaseBatch()
+ */
+static double
+_batchApi(FolioMemoryProvider *provider, size_t length, size_t iterations)
+{
+	void *memory[BatchSize];
+	size_t rounds = iterations / BatchSize;
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		size_t allocated = folioMemoryProvider_AllocateBatch(provider, BatchSize, length, NULL, memory);
+		folioMemoryProvider_ReleaseBatch(provider, memory, allocated);
+	}
+	return rounds * BatchSize / (_now() - start);
+}
+
+/*
+ * Lock and unlock each of BatchSize live blocks
+ */
+static double
+_lockUnlock(FolioMemoryProvider *provider, size_t length, size_t iterations)
+{
+	void *memory[BatchSize];
+	size_t rounds = iterations / BatchSize;
+
+	for (size_t i = 0; i < BatchSize; ++i) {
+		memory[i] = folioMemoryProvider_Allocate(provider, length, NULL);
+	}
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			folioMemoryProvider_Lock(provider, memory[i]);
+			folioMemoryProvider_Unlock(provider, memory[i]);
+		}
+	}
+	double opsPerSecond = rounds * BatchSize / (_now() - start);
+
+	for (size_t i = 0; i < BatchSize; ++i) {
+		folioMemoryProvider_Release(provider, &memory[i]);
+	}
+	return opsPerSecond;
+}
+
+/*
+ * Acquire and release a reference on each of BatchSize live blocks.  Large
+ * blocks put the trailer on a different cache line than the header.
+ */
+static double
+_acquireRelease(FolioMemoryProvider *provider, size_t length, size_t iterations, bool unchecked)
+{
+	void *memory[BatchSize];
+	size_t rounds = iterations / BatchSize;
+
+	for (size_t i = 0; i < BatchSize; ++i) {
+		memory[i] = folioMemoryProvider_Allocate(provider, length, NULL);
+	}
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			void *copy;
+			if (unchecked) {
+				copy = folioMemoryProvider_AcquireUnchecked(provider, memory[i]);
+				folioMemoryProvider_ReleaseUnchecked(provider, &copy);
+			} else {
+				copy = folioMemoryProvider_Acquire(provider, memory[i]);
+				folioMemoryProvider_Release(provider, &copy);
+			}
+		}
+	}
+	double opsPerSecond = rounds * BatchSize / (_now() - start);
+
+	for (size_t i = 0; i < BatchSize; ++i) {
+		folioMemoryProvider_Release(provider, &memory[i]);
+	}
+	return opsPerSecond;
+}
+
+/*
+ * A request: allocate BatchSize blocks, then drop them all.  The arena drops
+ * them with one reset instead of releasing each one.
+ */
+static double
+_request(FolioMemoryProvider *provider, bool arena, size_t length, size_t iterations)
+{
+	void *memory[BatchSize];
+	size_t rounds = iterations / BatchSize;
+
+	double start = _now();
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			memory[i] = folioMemoryProvider_Allocate(provider, length, NULL);
+		}
+		if (arena) {
+			folioArenaProvider_Reset(provider);
+		} else {
+			for (size_t i = 0; i < BatchSize; ++i) {
+				folioMemoryProvider_Release(provider, &memory[i]);
+			}
+		}
+	}
+	return rounds * BatchSize / (_now() - start);
+}
+
+int
+main(int argc, char *argv[argc])
+{
+	size_t iterations = 1000000;
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+	}
+
+	printf("%-20s %8s %16s %16s %16s %16s\n", "provider", "length", "pingpong ops/s", "batch ops/s", "batch api ops/s", "lock ops/s");
+	for (size_t p = 0; p < _providerCount; ++p) {
+		FolioMemoryProvider *provider = _providers[p].create(SIZE_MAX);
+
+		for (size_t l = 0; l < _lengthCount; ++l) {
+			double pingPong = _pingPong(provider, _lengths[l], iterations);
+			double batch = _batch(provider, _lengths[l], iterations);
+			double batchApi = _batchApi(provider, _lengths[l], iterations);
+			double lock = _lockUnlock(provider, _lengths[l], iterations);
+			printf("%-20s %8zu %16.0f %16.0f %16.0f %16.0f\n", _providers[p].name, _lengths[l], pingPong, batch, batchApi, lock);
+		}
+
+		folioMemoryProvider_ReleaseProvider(&provider);
+	}
+
+	printf("\n%-20s %8s %16s\n", "provider", "length", "request ops/s");
+	for (size_t p = 0; p < _providerCount + 1; ++p) {
+		bool arena = (p == _providerCount);
+		const char *name = arena ? "FolioArenaProvider" : _providers[p].name;
+		FolioMemoryProvider *provider = arena ? folioArenaProvider_Create(SIZE_MAX) : _providers[p].create(SIZE_MAX);
+
+		for (size_t l = 0; l < _lengthCount; ++l) {
+			double request = _request(provider, arena, _lengths[l], iterations);
+			printf("%-20s %8zu %16.0f\n", name, _lengths[l], request);
+		}
+
+		if (arena) {
+			folioArenaProvider_Release(&provider);
+		} else {
+			folioMemoryProvider_ReleaseProvider(&provider);
+		}
+	}
+
+	const size_t validationLengths[] = { 64, 65536 };
+	printf("\n%-20s %8s %12s %12s %12s %12s %12s\n", "acquire/release", "length",
+			"full", "magic", "sampled/64", "final", "unchecked");
+	for (size_t l = 0; l < sizeof(validationLengths) / sizeof(size_t); ++l) {
+		FolioMemoryProvider *provider = folioStdProvider_Create(SIZE_MAX);
+		double rates[5];
+		for (FolioValidationLevel level = FolioValidationLevel_Full; level <= FolioValidationLevel_FinalRelease; ++level) {
+			folioMemoryProvider_SetValidationLevel(provider, level, 64);
+			rates[level] = _acquireRelease(provider, validationLengths[l], iterations, false);
+		}
+		folioMemoryProvider_SetValidationLevel(provider, FolioValidationLevel_Full, 0);
+		rates[4] = _acquireRelease(provider, validationLengths[l], iterations, true);
+
+		printf("%-20s %8zu %12.0f %12.0f %12.0f %12.0f %12.0f\n", "FolioStdProvider", validationLengths[l],
+				rates[0], rates[1], rates[2], rates[3], rates[4]);
+		folioMemoryProvider_ReleaseProvider(&provider);
+	}
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Multi-threaded allocate/release throughput on one shared provider, for
+ * 1, 2, 4, ... threads up to the number of online cores.
+ *
+ * usage: bench_folio_ThreadScaling [iterationsPerThread [maxThreads]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Folio/folio.h>
+#include <Folio/folio_StdProvider.h>
+#include <Folio/folio_SlabProvider.h>
+
+typedef struct provider_entry {
+	const char *name;
+	FolioMemoryProvider * (*create)(size_t poolSize);
+} ProviderEntry;
+
+static const ProviderEntry _providers[] = {
+	{ .name = "FolioStdProvider",  .create = folioStdProvider_Create },
+	{ .name = "FolioSlabProvider", .create = folioSlabProvider_Create },
+};
+
+static const size_t _providerCount = sizeof(_providers) / sizeof(ProviderEntry);
+
+// Each thread keeps this many allocations live, like a receive batch
+#define BatchSize 64
+#define AllocationLength 128
+
+typedef struct worker_arg {
+	FolioMemoryProvider *provider;
+	size_t iterations;
+	pthread_barrier_t *barrier;
+} WorkerArg;
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+static void *
+_worker(void *arg)
+{
+	WorkerArg *work = arg;
+	void *memory[BatchSize];
+
+	pthread_barrier_wait(work->barrier);
+
+	for (size_t r = 0; r < work->iterations / BatchSize; ++r) {
+		for (size_t i = 0; i < BatchSize; ++i) {
+			memory[i] = folioMemoryProvider_Allocate(work->provider, AllocationLength, NULL);
+		}
+		for (size_t i = 0; i < BatchSize; ++i) {
+			folioMemoryProvider_Release(work->provider, &memory[i]);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * @return aggregate allocate+release pairs per second
+ */
+static double
+_run(FolioMemoryProvider *provider, unsigned threadCount, size_t iterations)
+{
+	pthread_t threads[threadCount];
+	WorkerArg args[threadCount];
+	pthread_barrier_t barrier;
+
+	// +1 for this thread, so the clock starts when everyone is ready
+	pthread_barrier_init(&barrier, NULL, threadCount + 1);
+
+	for (unsigned t = 0; t < threadCount; ++t) {
+		args[t].provider = provider;
+		args[t].iterations = iterations;
+		args[t].barrier = &barrier;
+		pthread_create(&threads[t], NULL, _worker, &args[t]);
+	}
+
+	pthread_barrier_wait(&barrier);
+	double start = _now();
+
+	for (unsigned t = 0; t < threadCount; ++t) {
+		pthread_join(threads[t], NULL);
+	}
+
+	double elapsed = _now() - start;
+	pthread_barrier_destroy(&barrier);
+
+	return threadCount * (iterations / BatchSize) * BatchSize / elapsed;
+}
+
+int
+main(int argc, char *argv[argc])
+{
+	size_t iterations = 1000000;
+	unsigned maxThreads = (unsigned) sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		maxThreads = (unsigned) strtoul(argv[2], NULL, 10);
+	}
+
+	printf("%-20s %8s %16s %10s\n", "provider", "threads", "ops/s", "speedup");
+	for (size_t p = 0; p < _providerCount; ++p) {
+		FolioMemoryProvider *provider = _providers[p].create(SIZE_MAX);
+
+		double single = 0;
+		for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+			double rate = _run(provider, threads, iterations);
+			if (threads == 1) {
+				single = rate;
+			}
+			printf("%-20s %8u %16.0f %10.2f\n", _providers[p].name, threads, rate, rate / single);
+		}
+
+		folioMemoryProvider_ReleaseProvider(&provider);
+	}
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares folio_AllocateAndZero() to folio_Allocate() followed by a memset(),
+ * which is what folio_AllocateAndZero() used to do, from 4 KiB to 64 MiB.  Each
+ * block is touched once after allocation, as a caller filling a table would.
+ *
+ * usage: bench_folio_Zero [total MiB per length]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <Folio/folio.h>
+#include <Folio/folio_SlabProvider.h>
+#include <Folio/folio_StdProvider.h>
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+/*
+ * Writes one byte per page, so both variants pay for faulting in the pages
+ */
+static void
+_touch(uint8_t *memory, size_t length)
+{
+	for (size_t i = 0; i < length; i += 4096) {
+		memory[i] = 1;
+	}
+}
+
+/*
+ * @return Allocations per second
+ */
+static double
+_run(FolioMemoryProvider *provider, size_t length, size_t iterations, bool useMemset)
+{
+	double start = _now();
+	for (size_t i = 0; i < iterations; ++i) {
+		uint8_t *memory;
+		if (useMemset) {
+			memory = folioMemoryProvider_Allocate(provider, length, NULL);
+			memset(memory, 0, length);
+		} else {
+			memory = folioMemoryProvider_AllocateAndZero(provider, length, NULL);
+		}
+		_touch(memory, length);
+		folioMemoryProvider_Release(provider, (void **) &memory);
+	}
+	return iterations / (_now() - start);
+}
+
+int
+main(int argc, char *argv[argc])
+{
+	size_t totalMiB = 1024;
+	if (argc > 1) {
+		totalMiB = strtoul(argv[1], NULL, 10);
+	}
+
+	struct {
+		const char *name;
+		FolioMemoryProvider *provider;
+	} providers[] = {
+		{ "std", folioStdProvider_Create(SIZE_MAX) },
+		{ "slab", folioSlabProvider_Create(SIZE_MAX) },
+	};
+
+	printf("%-8s %-10s %16s %16s %10s\n", "provider", "length", "memset ops/s", "zero ops/s", "speedup");
+	for (size_t p = 0; p < sizeof(providers) / sizeof(providers[0]); ++p) {
+		for (size_t length = 4096; length <= 64 * 1024 * 1024; length *= 4) {
+			size_t iterations = totalMiB * 1024 * 1024 / length;
+			if (iterations < 4) {
+				iterations = 4;
+			}
+
+			double memsetRate = _run(providers[p].provider, length, iterations, true);
+			double zeroRate = _run(providers[p].provider, length, iterations, false);
+			printf("%-8s %-10zu %16.0f %16.0f %9.2fx\n", providers[p].name, length, memsetRate, zeroRate, zeroRate / memsetRate);
+		}
+		folioMemoryProvider_ReleaseProvider(&providers[p].provider);
+	}
+
+	return 0;
+}
@@ -32,10 +32,16 @@
 #include <stdbool.h>
 
 /**
- * Should be done once (and only once) at program startup.
+ * Sets the global provider.  Defaults to FolioStdProvider if not otherwise set.
  *
- * Defaults to FolioStdProvider if not otherwise set.  When set, the prior
- * provider is released.
+ * This may be called while other threads allocate, e.g. to go from FolioDebugProvider
+ * back to FolioStdProvider when a debug session ends.  Calls already using the prior
+ * provider finish with it, and the prior provider is released only after they have all
+ * returned.  Memory from the prior provider is still released to it by folio_Release().
+ *
+ * Because it waits for those calls, it must not be called from a finalizer, reclaimer,
+ * or soft limit callback, which run inside them.  A folio_AllocateWait() holds a
+ * reference to the provider instead while it sleeps, so it does not hold up the swap.
  */
 void folio_SetProvider(FolioMemoryProvider *provider);
 
@@ -45,10 +51,166 @@ void folio_SetProvider(FolioMemoryProvider *provider);
 void folio_SetAvailableMemory(size_t maximum);
 
 /**
- * Returns the active allocator.
+ * Sets a soft limit on the amount of memory allocated.  See folioMemoryProvider_SetSoftLimit().
+ */
+void folio_SetSoftLimit(size_t bytes, FolioSoftLimitCallback callback);
+
+/**
+ * Sets how much validation the allocator does.  See folioMemoryProvider_SetValidationLevel().
+ */
+void folio_SetValidationLevel(FolioValidationLevel level, unsigned sampleInterval);
+
+/**
+ * Sets the size at which allocations are mapped with mmap().  See folioMemoryProvider_SetLargeObjectThreshold().
+ */
+void folio_SetLargeObjectThreshold(size_t bytes);
+
+/**
+ * Sets aside memory for later allocations, typically at startup before latency
+ * sensitive work, so the first allocations do not pay for page faults or for the
+ * allocator growing its free lists.
+ *
+ * The bytes are split evenly between the size class hints, and each share is carved
+ * in to blocks that hold an allocation of that length.  An allocation that fits a
+ * hinted class takes a reserved block while there are any, otherwise it allocates as
+ * usual.  Reserved memory is not counted in the allocated bytes until it is allocated,
+ * and it stays with the provider until the provider is released.  folio_Report()
+ * shows the reserved bytes and how many of them are in use.
+ *
+ * FolioStdProvider and FolioDebugProvider reserve at most the pool size, once.  The
+ * slab provider reserves whole slabs for the hinted size classes and may be called more
+ * than once.  Providers with nothing to reserve return 0.
+ *
+ * @param bytes The bytes to reserve, including the per allocation overhead
+ * @param sizeClassHints A 0 terminated array of allocation lengths, or NULL for a default set
+ * @param flags FolioReserveFlags
+ * @return The number of bytes reserved, 0 if none
+ */
+size_t folio_Reserve(size_t bytes, const size_t *sizeClassHints, unsigned flags);
+
+/**
+ * Gives idle free memory held by the allocator back to the system, so the resident
+ * size falls again after a burst.  It is not a background thread: a long running
+ * program calls it from its own timer or idle loop.
+ *
+ * What is idle depends on the provider.  The slab provider unmaps slabs whose blocks
+ * are all free (not reserved slabs, and not blocks held in other threads' caches; the
+ * calling thread's cache is flushed first).  The arena provider frees the chunk it keeps
+ * across resets while the arena is empty.  Providers on malloc() ask it to return its
+ * free pages (malloc_trim() on glibc), which they cannot count.  Memory reserved with
+ * folio_Reserve() is kept.
+ *
+ * The provider keeps the idle bytes set by folio_SetScavengePolicy().  folio_Report()
+ * shows the bytes given back and the number of calls.
+ *
+ * @param budget The most bytes to give back, SIZE_MAX for no limit
+ * @return The bytes given back (may be 0 where the provider cannot count them)
+ */
+size_t folio_Scavenge(size_t budget);
+
+/**
+ * Creates a child of the allocator with its own limit, so a subsystem gets a budget
+ * that it cannot exceed and that also counts against the whole.  The child is a
+ * provider of the same kind: use it with the folioMemoryProvider functions and release
+ * it with folioMemoryProvider_ReleaseProvider().  A child may have children of its own
+ * with folioMemoryProvider_CreateChild(), and an allocation counts against every ancestor.
+ *
+ * The child charges its parent in whole chunks of limit / 8 bytes (at most
+ * FolioChildMaximumChunk), lock free, so most allocations do not touch the parent.
+ * The parent sees the child's memory rounded up to a chunk.  The charges count in the
+ * parent's FolioPriority_Normal class, and do not call the parent's soft limit callback
+ * or reclaimers.  A folioMemoryProvider_AllocateWait() on a child is woken by the child's
+ * releases.
+ *
+ * The child holds a reference to its parent until it is released.  folio_Report() shows
+ * the tree of children with the memory of each.
+ *
+ * Example
+ * <code>
+ * FolioMemoryProvider *sessions = folio_CreateChild(16 * 1024 * 1024);
+ * Session *session = folioMemoryProvider_Allocate(sessions, sizeof(Session), NULL);
+ * ...
+ * folioMemoryProvider_Release(sessions, (void **) &session);
+ * folioMemoryProvider_ReleaseProvider(&sessions);
+ * </code>
+ *
+ * @param limit The most bytes of user memory of the child
+ * @return The child provider
+ */
+FolioMemoryProvider * folio_CreateChild(size_t limit);
+
+/**
+ * Sets how much folio_Scavenge() keeps.  See folioMemoryProvider_SetScavengePolicy().
+ */
+void folio_SetScavengePolicy(size_t retainBytes, unsigned decayPercent);
+
+/**
+ * Registers a reclaimer on the allocator.  See folioMemoryProvider_RegisterReclaimer().
+ */
+bool folio_RegisterReclaimer(FolioReclaimer callback, void *context, unsigned priority);
+
+/**
+ * Removes a reclaimer.  See folioMemoryProvider_UnregisterReclaimer().
+ */
+bool folio_UnregisterReclaimer(FolioReclaimer callback, void *context);
+
+/**
+ * Sets the reserve and cap of a priority class.  See folioMemoryProvider_SetPriorityClass().
+ */
+void folio_SetPriorityClass(FolioPriority priority, size_t reserveBytes, size_t capBytes);
+
+/**
+ * Sets the priority class of the calling thread.  See folioMemoryProvider_SetThreadPriority().
+ */
+FolioPriority folio_SetThreadPriority(FolioPriority priority);
+
+/**
+ * Returns the active allocator of the calling thread: the last provider it pushed with
+ * folio_PushThreadProvider(), otherwise the one from folio_SetProvider().
+ * The result is not acquired, so a concurrent folio_SetProvider() may release it.
  */
 FolioMemoryProvider *folio_GetProvider(void);
 
+/**
+ * The most providers one thread may have pushed at once
+ */
+#define FolioMaximumThreadProviders 8
+
+/**
+ * Makes the calling thread allocate from `provider` until the matching folio_PopThreadProvider().
+ * Other threads are not affected.  Pushes nest, and the thread holds a reference to each
+ * pushed provider.
+ *
+ * Only the folio_Allocate*() calls use the pushed provider.  The per-pointer calls (folio_Release(),
+ * folio_Length(), ...) always go to the provider that allocated the memory, so memory may be
+ * released after the pop or on another thread.
+ *
+ * folio_Report(), folio_OustandingReferences(), folio_AllocatedBytes() and folio_TestRefCount()
+ * also use the pushed provider, so inside the scope they show what the scope allocated.
+ * The other calls that configure the allocator (folio_SetAvailableMemory(), ...) always
+ * use the global provider.
+ *
+ * A thread that exits with providers pushed pops them, releasing its references.
+ *
+ * Example
+ * <code>
+ * FolioMemoryProvider *arena = folioArenaProvider_Create(SIZE_MAX);
+ * folio_PushThreadProvider(arena);
+ * ... // batch job, folio_Allocate() uses the arena
+ * folio_PopThreadProvider();
+ * folioMemoryProvider_ReleaseProvider(&arena);
+ * </code>
+ *
+ * @param provider The provider to allocate from, acquired until popped
+ */
+void folio_PushThreadProvider(FolioMemoryProvider *provider);
+
+/**
+ * Undoes the last folio_PushThreadProvider() of the calling thread and releases its provider.
+ * Traps with UnexpectedState if the thread has none pushed.
+ */
+void folio_PopThreadProvider(void);
+
 /**
  * Basic memory allocation.  Memory contents may be undetermined state, not necessarily 0.
  */
@@ -107,8 +269,122 @@ void * folio_AllocateWithFinalizer(const size_t length, Finalizer fini);
  */
 void * folio_AllocateAndZero(const size_t length, Finalizer fini);
 
+/**
+ * Allocates memory aligned to `alignment` bytes, e.g. for SIMD loads or O_DIRECT buffers.
+ * The memory is used like any other folio memory: folio_Acquire(), folio_Release(),
+ * folio_Reallocate() (which keeps the alignment), etc.
+ *
+ * Example
+ * <code>
+ * float *vector = folio_AllocateAligned(1024 * sizeof(float), 64, NULL);
+ * ...
+ * folio_Release((void **) &vector);
+ * </code>
+ *
+ * @param length The amount of memory to allocate
+ * @param alignment A power of 2
+ * @param fini The finalizer to call on last reference release (may be NULL)
+ */
+void * folio_AllocateAligned(const size_t length, size_t alignment, Finalizer fini);
+
+/**
+ * Allocates count blocks of length bytes, e.g. for a whole receive batch.  The
+ * provider reserves the batch against its pool and counts the statistics once,
+ * instead of once per block.
+ *
+ * Example
+ * <code>
+ * void *packets[64];
+ * size_t received = folio_AllocateBatch(64, 1500, NULL, packets);
+ * ...
+ * folio_ReleaseBatch(packets, received);
+ * </code>
+ *
+ * @param count The number of blocks
+ * @param length The length of each block
+ * @param fini The finalizer of each block (may be NULL)
+ * @param out An array of count pointers to receive the memory
+ * @return The number of blocks allocated.  They are the first entries of out, the
+ *         rest are NULL.  It is 0 if the whole batch does not fit in the pool.
+ */
+size_t folio_AllocateBatch(size_t count, const size_t length, Finalizer fini, void **out);
+
+/**
+ * Like folio_AllocateWithFinalizer(), but if the pool is out of memory the caller sleeps
+ * until enough memory is released or the timeout passes, instead of getting NULL right
+ * away.  Waiters get memory in the order they started waiting.  This makes the pool
+ * limit back-pressure between the stages of a pipeline.
+ *
+ * folio_Report() shows the number of waiters and a histogram of the wait times.
+ *
+ * The wait holds a reference to the global provider, so a folio_SetProvider() meanwhile
+ * does not wait for it.  The memory comes from the provider the call started with.
+ *
+ * Example
+ * <code>
+ * // Blocks the reader while the downstream stages hold the whole pool
+ * Packet *packet = folio_AllocateWait(sizeof(Packet), NULL, FolioWaitForever);
+ * </code>
+ *
+ * @param length The amount of memory to allocate
+ * @param fini The finalizer to call on last reference release (may be NULL)
+ * @param timeoutMilliseconds How long to wait, 0 for not at all, or FolioWaitForever
+ * @return The memory, or NULL on timeout, or at once if length could never fit: it is
+ *         more than the whole pool, than the cap of the priority class, or than the
+ *         pool of an ancestor (see folioMemoryProvider_CreateChild())
+ */
+void * folio_AllocateWait(const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+
+/**
+ * Allocates in the given priority class, whatever the class of the calling thread.
+ *
+ * Example
+ * <code>
+ * folio_SetPriorityClass(FolioPriority_Critical, 1024 * 1024, SIZE_MAX);
+ * folio_SetPriorityClass(FolioPriority_Bulk, 0, 64 * 1024 * 1024);
+ * ...
+ * RouteUpdate *update = folio_AllocateWithPriority(sizeof(RouteUpdate), NULL, FolioPriority_Critical);
+ * </code>
+ *
+ * @param length The amount of memory to allocate
+ * @param fini The finalizer to call on last reference release (may be NULL)
+ * @param priority The class to count the memory in
+ */
+void * folio_AllocateWithPriority(const size_t length, Finalizer fini, FolioPriority priority);
+
+/**
+ * Changes the length of the memory, like realloc().  The contents up to the shorter
+ * of the old and new lengths are kept, any new bytes are undetermined.
+ *
+ * The memory stays in place when the provider can grow or shrink the block, otherwise
+ * it is copied to a new block.  Because it may move, the caller must hold the only
+ * reference.
+ *
+ * Example
+ * <code>
+ * uint8_t *buffer = folio_Allocate(64);
+ * ...
+ * if (folio_Reallocate((void **) &buffer, 128) == NULL) {
+ *    // buffer is still the old 64 bytes
+ * }
+ * </code>
+ *
+ * Like folio_Acquire() and folio_Release(), this goes to the provider that allocated
+ * the memory, whatever folio_SetProvider() says now.
+ *
+ * @param memoryPtr The memory, updated with the new memory on success
+ * @param newLength The new length in bytes
+ * @return The new memory, or NULL if out of memory or the reference count is more than 1
+ *         (the memory is then unchanged)
+ */
+void * folio_Reallocate(void **memoryPtr, size_t newLength);
+
 /**
  * Obtain a reference count to the memory.  Use folio_Release() to free it.
+ *
+ * The memory records the pool that allocated it, so this and the other per-pointer calls
+ * (folio_Release(), folio_Length(), folio_Lock(), ...) go directly to that provider, even
+ * after folio_SetProvider() has changed the current one.
  */
 void * folio_Acquire(const void *memory);
 
@@ -120,13 +396,77 @@ void * folio_Acquire(const void *memory);
  */
 void folio_Release(void **memoryPtr);
 
+/**
+ * Releases a reference to each of the count memory pointers, like calling folio_Release()
+ * on each one, but with the accounting and statistics updated once for the batch.
+ * Each pointer must be non-NULL and is set to NULL.
+ */
+void folio_ReleaseBatch(void **memoryArray, size_t count);
+
+/**
+ * Obtains n references to the memory at once, e.g. before handing one buffer to n
+ * consumers.  The memory is validated once and the reference count changes with one
+ * atomic add.  Each reference is released with folio_Release(), or several with
+ * folio_ReleaseN().
+ *
+ * Example
+ * <code>
+ * folio_AcquireN(packet, queueCount);
+ * for (unsigned i = 0; i < queueCount; i++) {
+ *    queue_Put(queues[i], packet);
+ * }
+ * </code>
+ *
+ * @param n The number of references, at least 1
+ * @return The memory
+ */
+void * folio_AcquireN(const void *memory, unsigned n);
+
+/**
+ * Releases n references to the memory at once.  The caller must hold at least n.  If
+ * they are the last references, the finalizer runs once and the memory is freed.
+ * The pointer is set to NULL.
+ *
+ * @param n The number of references, at least 1
+ */
+void folio_ReleaseN(void **memoryPtr, unsigned n);
+
+/**
+ * Moves the reference held in *slot to the caller and sets *slot to NULL.  The
+ * reference count does not change and nothing is validated, so moving a reference
+ * out of a container costs no atomic operations, unlike a folio_Acquire() of the
+ * contents followed by a folio_Release() of the slot.
+ *
+ * Example
+ * <code>
+ * void *data = folio_Steal(&entry->data);
+ * // the entry no longer holds a reference, data holds the one it had
+ * </code>
+ *
+ * @param slot Where the reference is stored
+ * @return The reference, which the caller must release (may be NULL if *slot was NULL)
+ */
+void * folio_Steal(void **slot);
+
+/**
+ * Like folio_Acquire(), but does not validate the memory.  Only use it on memory
+ * you know is good, such as in a hot path that already holds a reference.
+ */
+void * folio_AcquireUnchecked(const void *memory);
+
+/**
+ * Like folio_Release(), but does not validate the memory.  The final release still
+ * calls the finalizer and frees the memory.
+ */
+void folio_ReleaseUnchecked(void **memoryPtr);
+
 /**
  * The number of bytes in this allocation.
  */
 size_t folio_Length(const void *memory);
 
 /**
- * Report memory statistics
+ * Report memory statistics of the calling thread's active allocator (see folio_GetProvider())
  */
 void folio_Report(FILE *stream);
 
@@ -136,12 +476,13 @@ void folio_Report(FILE *stream);
 void folio_Validate(const void *memory);
 
 /**
- * The total number of outstanding references in the allocator
+ * The total number of outstanding references in the calling thread's active allocator
  */
 size_t folio_OustandingReferences(void);
 
 /**
- * The total number of outstanding bytes allocated to the user.
+ * The total number of outstanding bytes allocated to the user by the calling thread's
+ * active allocator.
  *
  * The actual number of bytes allocated will be a small constant above
  * this number due to overhead in the allocator (approximately 40 bytes per
@@ -0,0 +1,78 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FOLIO_ARENAPROVIDER_H
+#define FOLIO_ARENAPROVIDER_H
+
+#include "folio.h"
+
+/**
+ * Region memory allocator for request-scoped memory.  Allocations are bump
+ * allocated out of large chunks, with the same checks for underflow & overflow
+ * as the other providers.
+ *
+ * Allocations still have reference counts and finalizers, so they work with
+ * folio_Acquire() and folio_Release().  Releasing the last reference runs the
+ * finalizer, but the memory only goes back to the system on
+ * folioArenaProvider_Reset() or folioArenaProvider_Release().
+ *
+ * Example
+ * <code>
+ * FolioMemoryProvider *arena = folioArenaProvider_Create(SIZE_MAX);
+ * for (;;) {
+ *    Request *request = folioMemoryProvider_Allocate(arena, sizeof(Request), _requestFinalizer);
+ *    ...
+ *    folioArenaProvider_Reset(arena);
+ * }
+ * folioArenaProvider_Release(&arena);
+ * </code>
+ *
+ * @param poolSize The maximum number of user bytes available from the provider
+ */
+FolioMemoryProvider * folioArenaProvider_Create(size_t poolSize);
+
+/**
+ * Frees every allocation in the arena at once, no matter how many references
+ * are outstanding.  The finalizers of allocations not yet released run in
+ * reverse allocation order.  A finalizer may release other allocations of the
+ * arena, even ones that were already freed by the reset.
+ *
+ * Only the allocations with a finalizer are visited, the rest go back in one step,
+ * so a reset costs the same however many of them there are.
+ *
+ * Must not be called while other threads are using the arena.
+ */
+void folioArenaProvider_Reset(FolioMemoryProvider *provider);
+
+/**
+ * Resets the arena, then releases a reference to the provider.
+ *
+ * @return true If this was the last release and the provider was freed
+ * @return false If there are still outstanding acquires of the provider
+ */
+bool folioArenaProvider_Release(FolioMemoryProvider **providerPtr);
+
+#endif /* FOLIO_ARENAPROVIDER_H */
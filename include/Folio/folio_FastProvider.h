@@ -0,0 +1,52 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FOLIO_FASTPROVIDER_H
+#define FOLIO_FASTPROVIDER_H
+
+#include "folio.h"
+
+/**
+ * Memory allocator for release builds.  It has the same reference counts and
+ * finalizers as the other providers, but no header guard, trailer, or magic
+ * numbers, and it does not check the provider on every call.  Each allocation
+ * carries a 32 byte header, and the memory has malloc()'s alignment.
+ *
+ * Because nothing is checked, an overrun or a release of memory from another
+ * provider corrupts the heap instead of trapping.  Use it once the code is
+ * clean under FolioStdProvider.
+ *
+ * Allocations are limited to UINT32_MAX bytes.  folioMemoryProvider_Lock() works,
+ * but folioMemoryProvider_Unlock() does not check that the locking thread unlocks.
+ * The validation level has no effect.
+ *
+ * Release the reference with folioMemoryProvider_ReleaseProvider().
+ *
+ * @param poolSize The maximum number of user bytes available from the provider
+ */
+FolioMemoryProvider * folioFastProvider_Create(size_t poolSize);
+
+#endif /* FOLIO_FASTPROVIDER_H */
@@ -30,11 +30,89 @@
 #include <stdio.h> // for FILE *
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
 
 #include <Folio/folio_Finalizer.h>
 
 typedef struct folioMemoryProvider_memory_provider FolioMemoryProvider;
 
+/**
+ * Called when an allocation takes the provider's allocated bytes above its soft
+ * limit.  The allocation succeeded.  It is called on the allocating thread, so
+ * keep it short and do not allocate from the same provider.
+ *
+ * @param provider The provider that crossed its soft limit
+ * @param allocatedBytes The allocated bytes right after the crossing
+ * @param softLimit The soft limit that was crossed
+ */
+typedef void (*FolioSoftLimitCallback)(FolioMemoryProvider *provider, size_t allocatedBytes, size_t softLimit);
+
+/**
+ * Asked to give back memory of the provider (e.g. by dropping cache entries) when the
+ * provider is short.  It is called on an allocating thread, with no provider locks held,
+ * so it may release memory of the provider.  An allocation it makes from the same
+ * provider does not reclaim again.
+ *
+ * @param provider The provider that is short of memory
+ * @param targetBytes The user bytes the provider would like back
+ * @param context The context given to folioMemoryProvider_RegisterReclaimer()
+ * @return The bytes it believes it gave back
+ */
+typedef size_t (*FolioReclaimer)(FolioMemoryProvider *provider, size_t targetBytes, void *context);
+
+/**
+ * The timeout of folio_AllocateWait() that waits until the memory is available
+ */
+#define FolioWaitForever UINT_MAX
+
+/**
+ * How much checking a provider does on Acquire, Length, Release, Lock, and Unlock.
+ * folioMemoryProvider_Validate() always does the full checks.
+ */
+typedef enum {
+	// Header magic, header guard, trailer, and reference count on every operation (the default)
+	FolioValidationLevel_Full = 0,
+
+	// Header magic and reference count only.  Does not touch the far end of the block.
+	FolioValidationLevel_MagicOnly,
+
+	// Full checks on 1 in every N operations per thread, magic-only on the others
+	FolioValidationLevel_Sampled,
+
+	// No checks on ordinary operations.  The guards and trailer are checked once, on the final release.
+	FolioValidationLevel_FinalRelease
+} FolioValidationLevel;
+
+/**
+ * The priority class an allocation is counted in.  See folioMemoryProvider_SetPriorityClass().
+ */
+typedef enum {
+	// Control plane memory that must keep working under pressure
+	FolioPriority_Critical = 0,
+	FolioPriority_High,
+
+	// The class of a thread that has not chosen one
+	FolioPriority_Normal,
+
+	// Data that may be shed first, e.g. bulk payload buffers
+	FolioPriority_Bulk
+} FolioPriority;
+
+#define FolioPriorityClasses 4
+
+/**
+ * Options for folioMemoryProvider_Reserve().  Combine them with |.
+ */
+typedef enum {
+	FolioReserveFlags_None = 0,
+
+	// Fault in the reserved pages now (e.g. MAP_POPULATE), so first use takes no page faults
+	FolioReserveFlags_Populate = 1,
+
+	// Lock the reserved pages in RAM with mlock().  Subject to RLIMIT_MEMLOCK, failing to lock is not an error.
+	FolioReserveFlags_Lock = 2
+} FolioReserveFlags;
+
 struct folioMemoryProvider_memory_provider {
 	/**
 	 * Release the entire memory pool.  Will release even if there are outstanding allocations.
@@ -51,10 +129,49 @@ struct folioMemoryProvider_memory_provider {
 
 	void * (*allocate)(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
 	void * (*allocateAndZero)(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+
+	/**
+	 * Like allocate, but the memory is aligned to `alignment` bytes, a power of 2.  See folio_AllocateAligned().
+	 */
+	void * (*allocateAligned)(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+
+	/**
+	 * Allocates up to count blocks in to out.  See folio_AllocateBatch().
+	 */
+	size_t (*allocateBatch)(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+
+	/**
+	 * Like allocate, but waits for room in the pool.  See folio_AllocateWait().
+	 */
+	void * (*allocateWait)(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+
+	/**
+	 * Changes the length of memory held by a single reference.  See folio_Reallocate().
+	 */
+	void * (*reallocate)(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
 	void * (*acquire)(FolioMemoryProvider *provider, const void * memory);
 	size_t (*length)(const FolioMemoryProvider *provider, const void *memory);
 	void (*release)(FolioMemoryProvider *provider, void **memoryPtr);
 
+	/**
+	 * Acquires or releases n references at once.  See folio_AcquireN() and folio_ReleaseN().
+	 */
+	void * (*acquireN)(FolioMemoryProvider *provider, const void * memory, unsigned n);
+	void (*releaseN)(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+
+	/**
+	 * Releases a reference to each of count memory pointers.  See folio_ReleaseBatch().
+	 */
+	void (*releaseBatch)(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+
+	/**
+	 * Like acquire and release, but without any validation of the memory, whatever the
+	 * validation level.  For trusted hot paths.  A provider that is meant for debugging
+	 * may still check.
+	 */
+	void * (*acquireUnchecked)(FolioMemoryProvider *provider, const void * memory);
+	void (*releaseUnchecked)(FolioMemoryProvider *provider, void **memoryPtr);
+
 	/**
 	 * A spin-lock on the memory using atomic operations.  Contenting
 	 * threads will busy-wait on the lock.  No ordering of threads and
@@ -109,18 +226,44 @@ struct folioMemoryProvider_memory_provider {
 	 * on how the compiler aligns structures and if using a 64-bit machine).
 	 *
 	 * You may set this at any time, though if set after some allocations
-	 * have taken place it will not trap until the next allocation.
+	 * have taken place it will not trap until the next allocation.  It does
+	 * not take a lock.
 	 */
 	void (*setAvailableMemory)(FolioMemoryProvider *provider, size_t bytes);
 
+	/**
+	 * Pre-carves memory for the given allocation lengths.  See folio_Reserve().
+	 */
+	size_t (*reserve)(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+
+	/**
+	 * Gives idle free memory back to the system.  See folio_Scavenge().
+	 */
+	size_t (*scavenge)(FolioMemoryProvider *provider, size_t budget);
+
+	/**
+	 * Creates a provider of the same kind whose allocations also count against this
+	 * one.  See folio_CreateChild().
+	 */
+	FolioMemoryProvider * (*createChild)(FolioMemoryProvider *provider, size_t limit);
+
 	void *poolState;
 };
 
 #define folioMemoryProvider_SetAvailableMemory(provider, maximum) (provider)->setAvailableMemory(provider, maximum)
 #define folioMemoryProvider_Allocate(provider, length, fini) (provider)->allocate(provider, length, fini)
 #define folioMemoryProvider_AllocateAndZero(provider, length, fini) (provider)->allocateAndZero(provider, length, fini);
+#define folioMemoryProvider_AllocateAligned(provider, length, alignment, fini) (provider)->allocateAligned(provider, length, alignment, fini)
+#define folioMemoryProvider_AllocateBatch(provider, count, length, fini, out) (provider)->allocateBatch(provider, count, length, fini, out)
+#define folioMemoryProvider_AllocateWait(provider, length, fini, timeoutMilliseconds) (provider)->allocateWait(provider, length, fini, timeoutMilliseconds)
+#define folioMemoryProvider_Reallocate(provider, memoryPtr, newLength) (provider)->reallocate(provider, memoryPtr, newLength)
 #define folioMemoryProvider_Acquire(provider, memory) (provider)->acquire(provider, memory)
 #define folioMemoryProvider_Release(provider, memoryPtr) (provider)->release(provider, memoryPtr)
+#define folioMemoryProvider_AcquireN(provider, memory, n) (provider)->acquireN(provider, memory, n)
+#define folioMemoryProvider_ReleaseN(provider, memoryPtr, n) (provider)->releaseN(provider, memoryPtr, n)
+#define folioMemoryProvider_ReleaseBatch(provider, memoryArray, count) (provider)->releaseBatch(provider, memoryArray, count)
+#define folioMemoryProvider_AcquireUnchecked(provider, memory) (provider)->acquireUnchecked(provider, memory)
+#define folioMemoryProvider_ReleaseUnchecked(provider, memoryPtr) (provider)->releaseUnchecked(provider, memoryPtr)
 #define folioMemoryProvider_Length(provider, memory) (provider)->length(provider, memory)
 #define folioMemoryProvider_Report(provider, stream) (provider)->report(provider, stream)
 #define folioMemoryProvider_Display(provider, memory, stream) (provider)->display(provider, memory, stream)
@@ -130,11 +273,169 @@ struct folioMemoryProvider_memory_provider {
 #define folioMemoryProvider_AllocatedBytes(provider) (provider)->allocationSize(provider)
 #define folioMemoryProvider_Lock(provider, memory) (provider)->lock(provider, memory)
 #define folioMemoryProvider_Unlock(provider, memory) (provider)->unlock(provider, memory)
+#define folioMemoryProvider_Reserve(provider, bytes, sizeClassHints, flags) (provider)->reserve(provider, bytes, sizeClassHints, flags)
+#define folioMemoryProvider_Scavenge(provider, budget) (provider)->scavenge(provider, budget)
+#define folioMemoryProvider_CreateChild(parent, limit) (parent)->createChild(parent, limit)
 
 bool folioMemoryProvider_ReleaseProvider(FolioMemoryProvider **providerPtr);
 
 #define folioMemoryProvider_AcquireProvider(provider) (provider)->acquireProvider(provider)
 
+/**
+ * Sets a soft limit on the user memory of the provider.  Unlike the available memory
+ * (the hard limit), allocations beyond the soft limit succeed.  Each allocation that
+ * goes from at or below the limit to above it increments folioMemoryProvider_SoftLimitCount()
+ * and calls the callback.
+ *
+ * You may set this at any time.  It does not take a lock.
+ *
+ * @param bytes The soft limit, SIZE_MAX for none (the default)
+ * @param callback Called on crossing the soft limit (may be NULL)
+ */
+void folioMemoryProvider_SetSoftLimit(FolioMemoryProvider *provider, size_t bytes, FolioSoftLimitCallback callback);
+
+/**
+ * The number of times allocations crossed the soft limit
+ */
+size_t folioMemoryProvider_SoftLimitCount(const FolioMemoryProvider *provider);
+
+/**
+ * Sets how much validation the provider does on each operation.  You may change it
+ * at any time.  It does not take a lock.
+ *
+ * @param level The validation level
+ * @param sampleInterval For FolioValidationLevel_Sampled, do the full checks on 1 in this many operations
+ */
+void folioMemoryProvider_SetValidationLevel(FolioMemoryProvider *provider, FolioValidationLevel level, unsigned sampleInterval);
+
+/**
+ * The current validation level of the provider
+ */
+FolioValidationLevel folioMemoryProvider_GetValidationLevel(const FolioMemoryProvider *provider);
+
+/**
+ * The default large object threshold of a provider, see folioMemoryProvider_SetLargeObjectThreshold()
+ */
+#define FolioLargeObjectDefaultThreshold ((size_t) 1024 * 1024)
+
+/**
+ * Allocations of at least this many bytes (including the header and trailer) are
+ * mapped directly with mmap().  Growing them uses mremap(), which does not copy, blocks
+ * of 2 MiB or more are advised to use huge pages, and the final release unmaps them.
+ * The memory of a new large object is zero.
+ *
+ * It applies to providers that take their blocks from malloc() (e.g. FolioStdProvider and
+ * FolioDebugProvider).  Providers with their own block memory (e.g. slabs or arenas)
+ * ignore it.  You may change it at any time, it affects new allocations.
+ *
+ * @param bytes The threshold, 0 to never use mmap()
+ */
+void folioMemoryProvider_SetLargeObjectThreshold(FolioMemoryProvider *provider, size_t bytes);
+
+/**
+ * Sets how much folioMemoryProvider_Scavenge() gives back.  It keeps retainBytes of
+ * idle memory and gives back at most decayPercent of the idle memory above that per
+ * call, so calling it on a timer decays the idle memory towards retainBytes.
+ *
+ * The default is to keep nothing and give back everything (0, 100).  You may set this
+ * at any time.  It does not take a lock.
+ *
+ * @param retainBytes Idle bytes to keep for the next burst
+ * @param decayPercent 0 to 100, the share of the idle bytes above retainBytes to give back per call
+ */
+void folioMemoryProvider_SetScavengePolicy(FolioMemoryProvider *provider, size_t retainBytes, unsigned decayPercent);
+
+/**
+ * The largest chunk a child provider charges its parent at a time.  See folio_CreateChild().
+ */
+#define FolioChildMaximumChunk (64 * 1024)
+
+/**
+ * The most reclaimers a provider holds
+ */
+#define FolioMaximumReclaimers 8
+
+/**
+ * The default of folioMemoryProvider_SetReclaimInterval()
+ */
+#define FolioReclaimDefaultInterval 10
+
+/**
+ * Registers a reclaimer.  When an allocation finds the provider out of memory, the
+ * provider calls the reclaimers with the shortfall and then retries the allocation once.
+ * When an allocation crosses the soft limit, after the soft limit callback, it calls them
+ * with the bytes above the soft limit.
+ *
+ * Reclaimers are called in increasing priority, in registration order for the same
+ * priority, until they have given back the target.  Only one thread reclaims at a time
+ * (others do not wait), and at most once per reclaim interval.  folioMemoryProvider_Report()
+ * shows the number of reclaims, the bytes they gave back, and their latency.
+ *
+ * @param priority Lower priorities are called first
+ * @return true if registered, false if the provider already has FolioMaximumReclaimers
+ */
+bool folioMemoryProvider_RegisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context, unsigned priority);
+
+/**
+ * Removes a reclaimer registered with the same callback and context
+ *
+ * @return true if it was registered
+ */
+bool folioMemoryProvider_UnregisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context);
+
+/**
+ * Sets the least time between two reclaims.  A reclaim that would come sooner is skipped
+ * (and the allocation fails as it would without reclaimers).
+ *
+ * @param milliseconds The interval, 0 for none.  The default is FolioReclaimDefaultInterval.
+ */
+void folioMemoryProvider_SetReclaimInterval(FolioMemoryProvider *provider, unsigned milliseconds);
+
+/**
+ * Sets the guaranteed reserve and the cap of a priority class.  Every allocation is
+ * counted in the priority class of the allocating thread (see
+ * folioMemoryProvider_SetThreadPriority()), or the one given to
+ * folioMemoryProvider_AllocateWithPriority().
+ *
+ * A class may always use its reserve: the other classes together cannot take the pool
+ * above the available memory less the unused part of the reserves.  No class goes above
+ * its cap.  So giving FolioPriority_Critical a reserve and FolioPriority_Bulk a cap keeps
+ * control plane allocations working while bulk allocations are refused.
+ *
+ * Without any reserve or cap a class only counts its bytes.  With one, each allocation
+ * takes a pool-wide lock to check the classes together.  folioMemoryProvider_Report() shows
+ * the bytes of each class and the allocations it was denied.
+ *
+ * @param reserveBytes The bytes only this class may use, 0 for none
+ * @param capBytes The most bytes of this class, SIZE_MAX for no cap
+ */
+void folioMemoryProvider_SetPriorityClass(FolioMemoryProvider *provider, FolioPriority priority, size_t reserveBytes, size_t capBytes);
+
+/**
+ * Sets the priority class of the calling thread's allocations, for all providers.
+ * A thread starts in FolioPriority_Normal.
+ *
+ * @return The thread's prior class
+ */
+FolioPriority folioMemoryProvider_SetThreadPriority(FolioPriority priority);
+
+/**
+ * Allocates in the given priority class, whatever the class of the calling thread
+ */
+void *folioMemoryProvider_AllocateWithPriority(FolioMemoryProvider *provider, const size_t length, Finalizer fini, FolioPriority priority);
+
+/**
+ * The provider that allocated the memory.  Each block records its owning pool just before
+ * the user memory, so this is a direct lookup, not a search.
+ *
+ * Traps with UnexpectedState if the owner record is damaged (e.g. a memory underrun) or
+ * the memory is not from a Folio provider.
+ *
+ * @param memory Memory from any Folio provider
+ * @return The provider (not acquired)
+ */
+FolioMemoryProvider *folioMemoryProvider_GetOwner(const void *memory);
+
 /**
  * Tests if the current number of Acquires is equal to the expected reference count.
  * If it is not, the function will display the provided message and return false.
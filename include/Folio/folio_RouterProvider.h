@@ -0,0 +1,89 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FOLIO_ROUTERPROVIDER_H
+#define FOLIO_ROUTERPROVIDER_H
+
+#include "folio.h"
+
+/**
+ * The most routes of a router, including the default route
+ */
+#define FolioRouterMaximumRoutes 8
+
+/**
+ * A provider that hands each allocation to one of several other providers by its
+ * length, e.g. small objects to a slab provider and everything else to a provider on
+ * malloc() and mmap().  Each route has an optional fallback that takes the allocations
+ * its provider has no memory for.
+ *
+ * The router writes a small prefix before the memory that records the provider that
+ * owns it, so acquire, release, length, and lock go straight to that provider.  Memory
+ * from the router must be used with the router.
+ *
+ * The router has its own pool, so the memory of all routes together is limited by its
+ * pool size and counted in folioMemoryProvider_AllocatedBytes(), and it works with soft
+ * limits, reclaimers, priority classes, and folioMemoryProvider_AllocateWait() like the
+ * other providers.  The providers of the routes also count the memory (plus the prefix)
+ * against their own limits.
+ *
+ * Example
+ * <code>
+ * FolioMemoryProvider *slab = folioSlabProvider_Create(SIZE_MAX);
+ * FolioMemoryProvider *large = folioStdProvider_Create(SIZE_MAX);
+ * FolioMemoryProvider *router = folioRouterProvider_Create(SIZE_MAX, large, NULL);
+ * folioRouterProvider_AddRoute(router, 1024, slab, large);
+ * folioMemoryProvider_ReleaseProvider(&slab);
+ * folioMemoryProvider_ReleaseProvider(&large);
+ *
+ * Packet *packet = folioMemoryProvider_Allocate(router, sizeof(Packet), NULL);
+ * ...
+ * folioMemoryProvider_Release(router, (void **) &packet);
+ * folioMemoryProvider_ReleaseProvider(&router);
+ * </code>
+ *
+ * @param poolSize The maximum number of user bytes available from the router
+ * @param provider The provider of the default route, for lengths above every other route
+ * @param fallback Takes the default route's allocations that provider cannot (may be NULL)
+ */
+FolioMemoryProvider * folioRouterProvider_Create(size_t poolSize, FolioMemoryProvider *provider, FolioMemoryProvider *fallback);
+
+/**
+ * Sends allocations of at most maximumLength bytes (and longer than the next shorter
+ * route) to provider, or to fallback if provider returns NULL.  The router holds a
+ * reference to both until it is released.
+ *
+ * Add the routes before the first allocation.  It does not take a lock.  Aligned
+ * allocations are routed by their length alone.
+ *
+ * @param maximumLength The longest allocation of the route, less than SIZE_MAX
+ * @param provider The provider of the route
+ * @param fallback Takes the allocations that provider cannot (may be NULL)
+ */
+void folioRouterProvider_AddRoute(FolioMemoryProvider *router, size_t maximumLength, FolioMemoryProvider *provider,
+		FolioMemoryProvider *fallback);
+
+#endif /* FOLIO_ROUTERPROVIDER_H */
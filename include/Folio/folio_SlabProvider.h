@@ -0,0 +1,48 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FOLIO_SLABPROVIDER_H
+#define FOLIO_SLABPROVIDER_H
+
+#include "folio.h"
+
+/**
+ * Memory allocator with checks for underflow & overflow that carves
+ * allocations out of large slabs in fixed size classes instead of
+ * calling malloc() and free() for every allocation.
+ *
+ * Freed blocks go on an intrusive free list for their size class and are
+ * reused by the next allocation of that class.  Slab memory is returned to
+ * the system when the provider is released.  Allocations larger than the
+ * biggest size class use malloc() and free().
+ *
+ * Release the reference with folioMemoryProvider_ReleaseProvider().
+ *
+ * @param poolSize The maximum number of user bytes available from the provider
+ */
+FolioMemoryProvider * folioSlabProvider_Create(size_t poolSize);
+
+#endif /* FOLIO_SLABPROVIDER_H */
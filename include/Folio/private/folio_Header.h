@@ -32,6 +32,7 @@
 #include <Folio/private/folio_Pool.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 /**
  * The header of every memory allocation.
@@ -60,7 +61,8 @@ typedef struct folio_header {
 
 	Finalizer xfini;
 
-	FolioLock *xlock;
+	// The thread holding xspinLock (see folioHeader_Lock)
+	pthread_t xlockingThreadId;
 
 	uint8_t xheaderGuardLength;
 	uint8_t xtrailerGuardLength;
@@ -71,7 +73,21 @@ typedef struct folio_header {
 	// if this flag is set.
 	bool xinFinalizer;
 
-	uint8_t pad[7];
+	// The per-allocation spin lock lives in the header, so locking an object
+	// does not need another heap allocation or pointer chase.
+	atomic_flag xspinLock;
+
+	// Non-zero for memory from folioInternalProvider_AllocateAligned(), the
+	// log2 of the alignment.  Such a block has padding before the header.
+	uint8_t xalignmentShift;
+
+	// The block is mapped with mmap() (see the pool's largeObjectThreshold)
+	bool xlargeObject;
+
+	// The FolioPriority class the block is counted in
+	uint8_t xpriority;
+
+	uint8_t pad[3];
 
 	uint32_t xmagic2;
 } FolioHeader;
@@ -85,34 +101,28 @@ FolioHeader *folioHeader_GetMemoryHeader(const void *memory, const FolioPool *po
 /**
  * Initialize a header.  The header must exist in allocated memory.
  *
- * You must call folioHeader_Finalize() when done with the header (to free
- * the reference to the lock).
+ * The header's spin lock starts unlocked.
  *
  * Example
  * <code>
  * void foo() {
  *    FolioHeader header;
- *    FolioLock *lock = folioLock_Create();
- *    folioHeader_Initialize(&header, 123, 500, lock, 1, NULL, 0);
- *    folioLock_Release(&lock);
+ *    folioHeader_Initialize(&header, 123, 500, 1, 0, NULL, 0, 0);
  * }
  * </code>
  *
  * @param header The header structure to initialize
  * @param magic The value to use in the two magic fields that protect the front and rear of the header
  * @param requestedLength The amount of memory requested by the user
- * @param lock The FolioLock to use (stores a reference to the lock, must not be NULL)
  * @param refCount The value to set the refcount to (usually 1)
  * @param providerDataLength the additional bytes for a provider's storage
  * @param fini The finalizer for the memory (may be NULL)
  * @param guardLength The number of guard bytes past magic2 (may be 0)
  */
 void folioHeader_Initialize(FolioHeader *header, uint32_t magic, size_t requestedLength,
-		const FolioLock *lock, int refCount, size_t providerHeaderLength, Finalizer fini,
+		int refCount, size_t providerHeaderLength, Finalizer fini,
 		size_t headerGuardLength, size_t trailerGuardLength);
 
-void folioHeader_Finalize(FolioHeader *header);
-
 /**
  * Increments the reference count stored in the header.  This is an atomic operation.
  *
@@ -127,6 +137,27 @@ int folioHeader_IncrementReferenceCount(FolioHeader *header);
  */
 int folioHeader_DecrementReferenceCount(FolioHeader *header);
 
+/**
+ * Adds n to the reference count stored in the header.  This is an atomic operation.
+ *
+ * @return The prior reference count
+ */
+int folioHeader_AddReferenceCount(FolioHeader *header, int n);
+
+/**
+ * Subtracts n from the reference count stored in the header.  This is an atomic operation.
+ *
+ * @return The prior reference count
+ */
+int folioHeader_SubtractReferenceCount(FolioHeader *header, int n);
+
+/**
+ * Sets the reference count to zero.  This is an atomic operation.
+ *
+ * @return The prior reference count
+ */
+int folioHeader_ClearReferenceCount(FolioHeader *header);
+
 /**
  * Determine if we are currently executing the user's finalier for this memory block.
  *
@@ -140,6 +171,37 @@ bool folioHeader_InFinalizer(const FolioHeader *header);
  */
 size_t folioHeader_GetRequestedLength(const FolioHeader *header);
 
+/**
+ * The log2 of the alignment the memory was allocated with, or 0 if it was
+ * allocated without an alignment.
+ */
+unsigned folioHeader_GetAlignmentShift(const FolioHeader *header);
+
+/**
+ * Marks the block as allocated with an alignment of 2^alignmentShift
+ */
+void folioHeader_SetAlignmentShift(FolioHeader *header, unsigned alignmentShift);
+
+/**
+ * True if the block is mapped with mmap() rather than from malloc() or a block allocator
+ */
+bool folioHeader_IsLargeObject(const FolioHeader *header);
+
+void folioHeader_SetLargeObject(FolioHeader *header, bool largeObject);
+
+/**
+ * The priority class the block's bytes are counted in
+ */
+unsigned folioHeader_GetPriority(const FolioHeader *header);
+
+void folioHeader_SetPriority(FolioHeader *header, unsigned priority);
+
+/**
+ * Changes the requested length and the trailer guard length of a block being
+ * reallocated.  The caller must then write the trailer at its new position.
+ */
+void folioHeader_SetRequestedLength(FolioHeader *header, size_t requestedLength, size_t trailerGuardLength);
+
 /**
  * If the finalizer is non-null, execute it with the provided memory pointer
  */
@@ -155,6 +217,7 @@ void folioHeader_Lock(FolioHeader *header);
 
 /**
  * Unlocks the memory allocation.  Must be called by the lock holder (same thread id).
+ * Will trap with LongBowTrapCannotObtainLockEvent if the thread id is not the same.
  */
 void folioHeader_Unlock(FolioHeader *header);
 
@@ -81,13 +81,30 @@ FolioMemoryProvider *folioInternalProvider_AcquireProvider(const FolioMemoryProv
 /**
  * Release a reference to the provider.
  *
- * Returns true if this was the final release and the memory was freed.
+ * Returns true if this was the final release.  The pool is freed then, or if blocks are
+ * still live, when folioInternalProvider_Unhold() drops the hold of the last one.
  *
  * TODO: Need to handle statically allocated providers, right now it will try to
  * call free() on the provider.
  */
 bool folioInternalProvider_ReleaseProvider(FolioMemoryProvider **providerPtr);
 
+/**
+ * Takes a hold on the pool for each of count live blocks.  The pool (and the provider state) is
+ * not freed while it has holds, even after the final release of the provider, so
+ * memory released through folio_Release() after the provider was swapped out and
+ * released still finds it.  The internal allocation functions take the hold of
+ * each block themselves, a provider with its own block layout calls this.  Does not
+ * check the pool magic.
+ */
+void folioInternalProvider_Hold(FolioMemoryProvider *provider, size_t count);
+
+/**
+ * Drops count holds taken for blocks.  The last hold, if the provider has no references
+ * left, frees the pool, so the caller must not touch the provider after this.
+ */
+void folioInternalProvider_Unhold(FolioMemoryProvider *provider, size_t count);
+
 /**
  * Returns a pointer to to the provider storage in the pool.  It will be of
  * length providerStateLength from the Create function.
@@ -116,23 +133,289 @@ void *folioInternalProvider_GetProviderHeader(FolioMemoryProvider const *provide
 size_t folioInternalProvider_GetProviderHeaderLength(const FolioMemoryProvider *provider);
 
 
+/**
+ * Use blockAllocator for the memory of each allocation instead of malloc() and free().
+ *
+ * Must be set before the first allocation.  The blockAllocator must remain valid
+ * for the life of the provider.
+ *
+ * @param provider The provider created by folioInternalProvider_Create()
+ * @param blockAllocator The source of block memory (NULL restores malloc() and free())
+ */
+void folioInternalProvider_SetBlockAllocator(FolioMemoryProvider *provider, const FolioBlockAllocator *blockAllocator);
+
+/**
+ * Reserves length bytes of user memory against the pool's limits, calling the soft
+ * limit callback if this crosses the soft limit.  Unlike the other functions, it does
+ * not check the pool magic, so a provider with its own block layout may use it
+ * on every allocation.
+ *
+ * @param priority The FolioPriority class to count the bytes in.  The provider keeps it
+ *                 to give them back.
+ * @return true if the bytes were reserved
+ * @return false if that would exceed the available memory or the class limits
+ */
+bool folioInternalProvider_Reserve(FolioMemoryProvider *provider, unsigned priority, size_t length);
+
+/**
+ * Like folioInternalProvider_Reserve(), but waits in line for the bytes as in
+ * folioInternalProvider_AllocateWait().
+ */
+bool folioInternalProvider_ReserveWait(FolioMemoryProvider *provider, unsigned priority, size_t length, unsigned timeoutMilliseconds);
+
+/**
+ * Gives back bytes reserved with folioInternalProvider_Reserve().  Does not check the pool magic.
+ */
+void folioInternalProvider_Unreserve(FolioMemoryProvider *provider, unsigned priority, size_t length);
+
+/**
+ * The priority class of the calling thread's allocations
+ */
+FolioPriority folioInternalProvider_GetThreadPriority(void);
+
+/**
+ * See folioMemoryProvider_SetThreadPriority()
+ */
+FolioPriority folioInternalProvider_SetThreadPriority(FolioPriority priority);
+
+/**
+ * The total block length (header, user memory, and trailer) the pool uses for an
+ * allocation of length bytes.  For providers that reserve their own block memory.
+ */
+size_t folioInternalProvider_BlockLength(const FolioMemoryProvider *provider, size_t length);
+
+/**
+ * Faults in length bytes of mapped memory as FolioReserveFlags asks, and locks them
+ * with mlock() for FolioReserveFlags_Lock.
+ *
+ * @return true if the memory is locked
+ */
+bool folioInternalProvider_Prefault(void *memory, size_t length, unsigned flags);
+
+/**
+ * Reserves blocks for a pool without a block allocator.  See folio_Reserve().
+ * A pool reserves once, later calls return 0.
+ *
+ * @return The bytes mapped for the reserve, 0 if none
+ */
+size_t folioInternalProvider_ReserveBlocks(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+
 void * folioInternalProvider_Allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+
+/**
+ * Like folioInternalProvider_Allocate(), but if the pool is out of memory, waits up to
+ * timeoutMilliseconds for releases to make room.  See folio_AllocateWait().
+ */
+void * folioInternalProvider_AllocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+
+/**
+ * Like folioInternalProvider_Allocate(), but the user memory is zero.  Only memory that
+ * is not already zero (i.e. a reused block from a block allocator) is cleared, with
+ * folioZero_Clear().
+ */
 void * folioInternalProvider_AllocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+
+/**
+ * Allocates count blocks of length bytes with a single reservation against the pool.
+ * The first return value entries of out are the memory, the rest are NULL.
+ *
+ * @return The number of blocks allocated, 0 if the whole batch does not fit in the pool
+ */
+size_t folioInternalProvider_AllocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+
+/**
+ * Like folioInternalProvider_Allocate(), but the user memory is aligned to alignment bytes.
+ * The padding goes before the header, so folioHeader_GetMemoryHeader() still works.
+ *
+ * @param alignment A power of 2
+ */
+void * folioInternalProvider_AllocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+
+/**
+ * Changes the length of the memory, keeping its contents up to the shorter of the
+ * two lengths.  It stays in place if the new length fits in the trailer guard slack
+ * or the block allocator can resize the block, otherwise it moves to a new block.
+ *
+ * @return The memory, also stored in *memoryPtr, or NULL if out of memory or the
+ *         reference count is not 1, in which case the memory is untouched.
+ */
+void * folioInternalProvider_Reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
+
 void * folioInternalProvider_Acquire(FolioMemoryProvider *provider, const void *memory);
+
+/**
+ * Like folioInternalProvider_Acquire(), but does no validation of the memory at all.
+ */
+void * folioInternalProvider_AcquireUnchecked(FolioMemoryProvider *provider, const void *memory);
+
+/**
+ * Like folioInternalProvider_Acquire(), but adds n references with one validation and
+ * one atomic add.
+ *
+ * @param n The number of references, at least 1
+ */
+void * folioInternalProvider_AcquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
 size_t folioInternalProvider_Length(const FolioMemoryProvider *provider, const void *memory);
 
 /**
  * Release a reference to the memory.  If it is the final release, it will call the
  * finalizer, if set, then release the memory.  The provider header state is invalid at this point.
  *
+ * The final release leaves the block's hold on the pool (see folioInternalProvider_Hold()),
+ * so the provider state stays valid.  The caller drops it with folioInternalProvider_Unhold()
+ * when done with the state.  The same goes for the other release functions and
+ * folioInternalProvider_DiscardMemory().
+ *
  * @return true if this was the final release
  * @return false if there are still outstanding references
  */
 bool folioInternalProvider_ReleaseMemory(FolioMemoryProvider *provider, void **memoryPtr);
 
+/**
+ * Like folioInternalProvider_ReleaseMemory(), but does no validation of the memory at all.
+ * The final release still runs the finalizer and frees the block.
+ */
+bool folioInternalProvider_ReleaseMemoryUnchecked(FolioMemoryProvider *provider, void **memoryPtr);
+
+/**
+ * Like folioInternalProvider_ReleaseMemory(), but releases n references with one validation
+ * and one atomic subtract.  The caller must hold at least n references.
+ *
+ * @param n The number of references, at least 1
+ * @return true if this released the last references
+ */
+bool folioInternalProvider_ReleaseMemoryN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+
+/**
+ * Releases a reference to each of the count memory pointers and sets them to NULL.  The
+ * memory freed by final releases is given back to the pool in one update.
+ *
+ * @param finalRelease If not NULL, an array of count entries set true for each final release
+ * @return The number of final releases
+ */
+size_t folioInternalProvider_ReleaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count, bool *finalRelease);
+
+/**
+ * Tests if the memory is a live allocation of the provider (it has the pool's magic
+ * and a positive reference count).  Unlike the other functions, it does not trap on a
+ * released allocation.  The block memory must still be readable, so this is only
+ * useful with a block allocator that does not give memory back on free (e.g. an arena).
+ *
+ * @return true The memory is live
+ * @return false The memory was released or discarded
+ */
+bool folioInternalProvider_IsLive(const FolioMemoryProvider *provider, const void *memory);
+
+/**
+ * Ends the life of an allocation no matter how many references are outstanding.
+ * Runs the finalizer and invalidates the header, checking only the magic.  It does
+ * not give the block back to the block allocator, nor the bytes to the pool, nor drop
+ * the block's hold.  The caller does those for all the blocks it discards at once,
+ * with folioInternalProvider_Unreserve() and folioInternalProvider_Unhold().
+ *
+ * If the memory was already released or discarded, does nothing (the same caveat as
+ * folioInternalProvider_IsLive() applies).
+ *
+ * @return The number of references that were outstanding (0 if already released)
+ */
+int folioInternalProvider_DiscardMemory(FolioMemoryProvider *provider, void *memory);
+
 void folioInternalProvider_Validate(const FolioMemoryProvider *provider, const void *memory);
 size_t folioInternalProvider_AllocationSize(const FolioMemoryProvider *provider);
+
+/**
+ * The user bytes held by the allocations of one FolioPriority class
+ */
+size_t folioInternalProvider_ClassAllocationSize(const FolioMemoryProvider *provider, unsigned priority);
 void folioInternalProvider_SetAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+
+/**
+ * A child pool charges its parent in chunks of its limit divided by this, at most
+ * FolioChildMaximumChunk.
+ */
+#define FolioChildChunkDivisor 8
+
+/**
+ * Makes the provider a child of parent: its allocations also count against the parent
+ * and the parent's ancestors.  It takes a reference to parent, which it releases on its
+ * final release.  Call it right after folioInternalProvider_Create().
+ *
+ * @param provider The new child, with no allocations
+ * @param parent Any provider built on the internal provider
+ */
+void folioInternalProvider_SetParent(FolioMemoryProvider *provider, FolioMemoryProvider *parent);
+
+/**
+ * Sets the soft limit and its callback (may be NULL).  Does not take a lock.  Use SIZE_MAX
+ * to remove the soft limit.
+ */
+void folioInternalProvider_SetSoftLimit(FolioMemoryProvider *provider, size_t softLimit, FolioSoftLimitCallback callback);
+
+/**
+ * Sets the pool's large object threshold.  See folioMemoryProvider_SetLargeObjectThreshold().
+ */
+void folioInternalProvider_SetLargeObjectThreshold(FolioMemoryProvider *provider, size_t bytes);
+
+/**
+ * Sets a priority class of the pool.  See folioMemoryProvider_SetPriorityClass().
+ */
+void folioInternalProvider_SetPriorityClass(FolioMemoryProvider *provider, FolioPriority priority, size_t reserveBytes, size_t capBytes);
+
+/**
+ * Adds a reclaimer to the pool.  See folioMemoryProvider_RegisterReclaimer().
+ */
+bool folioInternalProvider_RegisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context, unsigned priority);
+
+/**
+ * Removes a reclaimer from the pool.  See folioMemoryProvider_UnregisterReclaimer().
+ */
+bool folioInternalProvider_UnregisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context);
+
+/**
+ * Sets the least time between reclaims.  See folioMemoryProvider_SetReclaimInterval().
+ */
+void folioInternalProvider_SetReclaimInterval(FolioMemoryProvider *provider, unsigned milliseconds);
+
+/**
+ * Sets the pool's scavenge policy.  See folioMemoryProvider_SetScavengePolicy().
+ */
+void folioInternalProvider_SetScavengePolicy(FolioMemoryProvider *provider, size_t retainBytes, unsigned decayPercent);
+
+/**
+ * The most bytes a scavenge may give back, given the provider's idle bytes, the pool's
+ * scavenge policy, and the caller's budget.  It is at least 1 if anything may go.  A
+ * provider that gives back whole chunks only gives back a chunk that fits in the limit.
+ */
+size_t folioInternalProvider_ScavengeLimit(const FolioMemoryProvider *provider, size_t idleBytes, size_t budget);
+
+/**
+ * Counts a scavenge that gave back the bytes in the pool statistics
+ */
+void folioInternalProvider_RecordScavenge(FolioMemoryProvider *provider, size_t bytes);
+
+/**
+ * Scavenge for providers on malloc().  Gives back the whole pages of idle blocks in the
+ * reserve (see folioInternalProvider_ReserveBlocks()) within the scavenge policy and the
+ * budget, then asks malloc to return its free pages, keeping the retained bytes.
+ *
+ * @return The reserve bytes given back.  What malloc gives back cannot be counted.
+ */
+size_t folioInternalProvider_Scavenge(FolioMemoryProvider *provider, size_t budget);
+
+/**
+ * Sets how much validation Acquire, Length, Release, Lock, and Unlock do.
+ * folioInternalProvider_Validate() always does a full validation.
+ *
+ * @param sampleInterval For FolioValidationLevel_Sampled, do a full validation on 1 in this many operations
+ */
+void folioInternalProvider_SetValidationLevel(FolioMemoryProvider *provider, FolioValidationLevel level, unsigned sampleInterval);
+FolioValidationLevel folioInternalProvider_GetValidationLevel(const FolioMemoryProvider *provider);
+
+/**
+ * The number of allocations that took the pool above its soft limit
+ */
+size_t folioInternalProvider_SoftLimitCount(const FolioMemoryProvider *provider);
+
 void folioInternalProvider_Lock(FolioMemoryProvider *provider, void *memory);
 void folioInternalProvider_Unlock(FolioMemoryProvider *provider, void *memory);
 
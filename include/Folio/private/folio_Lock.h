@@ -28,45 +28,30 @@
 #define SRC_PRIVATE_FOLIO_LOCK_H_
 
 #include <stdatomic.h>
-
-typedef struct folio_lock FolioLock;
-
-void folioLock_FlagLock(atomic_flag *flag);
-void folioLock_FlagUnlock(atomic_flag *flag);
+#include <stdint.h>
 
 /**
- * Creates a spin lock that uses atomic operations.
+ * Spins until it obtains the lock on the flag.  No ordering of contenders.
  */
-FolioLock *folioLock_Create(void);
-
-/**
- * Obtains a reference count to the lock.
- */
-FolioLock *folioLock_Acquire(const FolioLock *lock);
+void folioLock_FlagLock(atomic_flag *flag);
 
 /**
- * Releases a reference to the lock.  It is allowed to
- * release the last reference to the lock even if the
- * lock is still in the locked state.
+ * Releases the lock on the flag.
  */
-void folioLock_Release(FolioLock **lockPtr);
+void folioLock_FlagUnlock(atomic_flag *flag);
 
 /**
- * Obtains the lock.  Will busy-wait blocking.  No ordering
- * of contenders.  Will record the thread id of the locker.
+ * Sleeps while the word is expected, for at most timeoutNanos.  It may return early
+ * (a wake up, a signal, or a spurious wake up), so the caller checks again.
+ *
+ * Uses a futex on Linux.  Elsewhere it sleeps for a short time.
  */
-void folioLock_Lock(FolioLock *lock);
+void folioLock_FutexWait(atomic_uint *word, unsigned expected, uint64_t timeoutNanos);
 
 /**
- * Releases the lock.  Must be called by the same thread id
- * as the locker.  Will trap with LongBowTrapCannotObtainLockEvent
- * if the thread id is not the same.
- *
- * The thread that initially creates the lock may be able to
- * call folio_Unlock without first calling folio_Lock.  Likewise,
- * the locking thread may be able to call folio_Unlock multiple times
- * without re-obtaining the lock, assuming no one else has locked it.
+ * Wakes up to count threads in folioLock_FutexWait() on the word.  The caller changes
+ * the word first.
  */
-void folioLock_Unlock(FolioLock *lock);
+void folioLock_FutexWake(atomic_uint *word, unsigned count);
 
 #endif /* SRC_PRIVATE_FOLIO_LOCK_H_ */
@@ -30,7 +30,8 @@
 #include <stdatomic.h>
 #include <stdint.h>
 #include <stddef.h>
-#include <Folio/private/folio_Lock.h>
+#include <stdbool.h>
+#include <Folio/folio_MemoryProvider.h>
 
 #define _alignment_width sizeof(void *)
 
@@ -39,6 +40,137 @@
  */
 #define _internalMagic 0xa16588fb703b6f06ULL
 
+/**
+ * A provider built on the internal provider may supply its own source of block
+ * memory (e.g. slabs or arenas) in place of malloc() and free().  A block is the
+ * entire allocation: header, user memory, and trailer.
+ */
+typedef struct folio_block_allocator {
+	/**
+	 * Returns at least totalLength bytes aligned to _alignment_width, or NULL if
+	 * no memory is available.  If zero is true, the bytes must be zero, which the
+	 * allocator can skip clearing for memory it knows is fresh.
+	 */
+	void * (*allocate)(FolioMemoryProvider *provider, size_t totalLength, bool zero);
+
+	/**
+	 * Returns a block obtained from allocate().  totalLength is the same value
+	 * that was passed to allocate().
+	 */
+	void (*free)(FolioMemoryProvider *provider, void *block, size_t totalLength);
+
+	/**
+	 * Optional.  Resizes a block from allocate() to newTotalLength bytes, in place or
+	 * by moving it like realloc().  After this, free() must accept the block with
+	 * newTotalLength.
+	 *
+	 * @return The resized block, or NULL (and the block is untouched) if the allocator
+	 *         cannot do it, in which case the caller allocates a new block and copies.
+	 */
+	void * (*reallocate)(FolioMemoryProvider *provider, void *block, size_t totalLength, size_t newTotalLength);
+
+	/**
+	 * Optional.  Called once when the provider is freed, while its provider state is
+	 * still valid, to return the allocator's own memory.
+	 */
+	void (*destroy)(FolioMemoryProvider *provider);
+} FolioBlockAllocator;
+
+/**
+ * The most size classes folioInternalProvider_ReserveBlocks() keeps
+ */
+#define FolioReserveMaximumClasses 8
+
+/**
+ * Reserved blocks of one length, carved from [start, end) of the reserved mapping
+ */
+typedef struct folio_reserve_class {
+	atomic_flag lock;
+
+	// The total block length (header + user memory + trailer) of the class
+	size_t blockLength;
+
+	uint8_t *start;
+	uint8_t *end;
+
+	// Intrusive list, the first word of a free block points to the next free block
+	void *freeList;
+
+	// Free blocks whose pages after the first word were given back by a scavenge
+	void *scavengedList;
+
+	size_t blocks;
+	size_t blocksInUse;
+} FolioReserveClass;
+
+/**
+ * Memory set aside by folioInternalProvider_ReserveBlocks() for pools without a block
+ * allocator.  Classes are in increasing blockLength.
+ */
+typedef struct folio_reserve {
+	void *mapping;
+	size_t mappingLength;
+	bool locked;
+
+	unsigned classCount;
+	FolioReserveClass classes[FolioReserveMaximumClasses];
+} FolioReserve;
+
+/**
+ * The last word of every block header, immediately before the user memory, names the
+ * pool that owns the memory.  folioPool_GetOwner() finds the provider from it, so
+ * memory can be acquired and released without knowing its provider.
+ */
+typedef struct folio_owner {
+	// The pool's slot in the registry of pools
+	uint32_t poolId;
+
+	// The pool's headerMagic
+	uint32_t magic;
+} FolioOwner;
+
+/**
+ * The most pools with allocations at once
+ */
+#define FolioMaximumPools 65536
+
+/**
+ * Wait times are counted in buckets of 4x: bucket 0 is under 1 usec, bucket i is from
+ * 4^(i-1) to 4^i usec, and the last bucket is everything longer.
+ */
+#define FolioWaitHistogramBuckets 12
+
+/**
+ * A thread in folioInternalProvider_AllocateWait().  It lives on the waiting thread's stack.
+ */
+typedef struct folio_waiter {
+	struct folio_waiter *next;
+
+	// Set to 1 and woken when the waiter should try again
+	atomic_uint wakeup;
+} FolioWaiter;
+
+/**
+ * The accounting of one FolioPriority class
+ */
+typedef struct folio_priority_class {
+	// User bytes held by the class's allocations
+	atomic_uint_least64_t current;
+
+	// See folioMemoryProvider_SetPriorityClass().  cap is UINT64_MAX for none.
+	atomic_uint_least64_t reserve;
+	atomic_uint_least64_t cap;
+
+	// Reservations the class was refused
+	atomic_uint_least64_t denials;
+} FolioPriorityClass;
+
+typedef struct folio_reclaimer_entry {
+	FolioReclaimer callback;
+	void *context;
+	unsigned priority;
+} FolioReclaimerEntry;
+
 /**
  * +-----------------------+
  * | FolioMemoryProvider   |
@@ -73,21 +205,136 @@ typedef struct folio_pool {
 	// The size of the trailer including the guard length.
 	uint32_t trailerAlignedLength;
 
-	atomic_uint currentAllocation;
+	// The pool's slot in the registry of pools (see FolioOwner), 0 until the first allocation
+	atomic_uint poolId;
+
+	// Bytes of user memory held by outstanding allocations.  It is 64-bit
+	// and only changes by compare-and-swap, never under a lock.
+	atomic_uint_least64_t currentAllocation;
 
 	atomic_int referenceCount;
 
-	atomic_flag allocationLock;
+	// One hold for the references as a whole plus one for each live block.  The
+	// pool is unregistered and freed when the last hold goes, so blocks still
+	// out after the final release of the provider keep it alive.
+	atomic_uint_least64_t holds;
+
+	// amount of memory in the pool (the hard limit).  An allocation that would
+	// take currentAllocation above it fails.
+	atomic_uint_least64_t poolSize;
+
+	// An allocation that takes currentAllocation from at or below softLimit to
+	// above it counts in softLimitCount and calls softLimitCallback (if not NULL).
+	// UINT64_MAX means no soft limit.
+	atomic_uint_least64_t softLimit;
+	atomic_uint_least64_t softLimitCount;
+	_Atomic(FolioSoftLimitCallback) softLimitCallback;
+
+	// A FolioValidationLevel.  sampleInterval is the N of FolioValidationLevel_Sampled.
+	atomic_uint validationLevel;
+	atomic_uint sampleInterval;
+
+	// Without a block allocator, blocks of at least largeObjectThreshold bytes (0 for
+	// none) are mapped with mmap() instead of malloc().  The counts are the live mapped
+	// blocks and their mapped bytes, and the number of blocks ever mapped.
+	atomic_size_t largeObjectThreshold;
+	atomic_uint_least64_t largeObjectCount;
+	atomic_uint_least64_t largeObjectBytes;
+	atomic_uint_least64_t largeObjectTotal;
+
+	// Blocks reserved with folioInternalProvider_ReserveBlocks(), NULL if none.  Set once.
+	_Atomic(FolioReserve *) reserve;
 
-	// amount of memory in the pool
-	size_t poolSize;
+	// A scavenge keeps scavengeRetain idle bytes and gives back at most scavengeDecayPercent
+	// of the rest.  The counts are the bytes given back and the number of scavenges.
+	atomic_size_t scavengeRetain;
+	atomic_uint scavengeDecayPercent;
+	atomic_uint_least64_t scavengedBytes;
+	atomic_uint_least64_t scavengeCount;
+
+	// Reclaimers in the order to call them, protected by reclaimLock
+	atomic_flag reclaimLock;
+	atomic_uint reclaimerCount;
+	FolioReclaimerEntry reclaimers[FolioMaximumReclaimers];
+
+	// Held by the one thread reclaiming.  A reclaim starts at least reclaimInterval
+	// nanoseconds after the last one ended (lastReclaim).  The counts are reclaims, the
+	// bytes the reclaimers gave back, their total and longest time, and skipped reclaims.
+	atomic_flag reclaimRunning;
+	atomic_uint_least64_t reclaimInterval;
+	atomic_uint_least64_t lastReclaim;
+	atomic_uint_least64_t reclaimCount;
+	atomic_uint_least64_t reclaimedBytes;
+	atomic_uint_least64_t reclaimNanos;
+	atomic_uint_least64_t reclaimMaxNanos;
+	atomic_uint_least64_t reclaimSkipped;
+
+	// The classes' accounting.  Once any class has a reserve or a cap, priorityLimited is
+	// true and every reservation checks the classes together under priorityLock.
+	atomic_flag priorityLock;
+	atomic_bool priorityLimited;
+	FolioPriorityClass priorityClasses[FolioPriorityClasses];
+
+	// Threads waiting for memory, in FIFO order, protected by waitLock.  Only the
+	// first waiter tries to allocate.  waiters is the length of the list.
+	atomic_flag waitLock;
+	FolioWaiter *waitHead;
+	FolioWaiter *waitTail;
+	atomic_uint waiters;
+
+	// The most waiters at once, the number of waits, their total time, the ones that
+	// timed out, and a histogram of their times.
+	atomic_uint maxWaiters;
+	atomic_uint_least64_t waitCount;
+	atomic_uint_least64_t waitNanos;
+	atomic_uint_least64_t waitTimeouts;
+	atomic_uint_least64_t waitHistogram[FolioWaitHistogramBuckets];
+
+	// A child pool (see folioMemoryProvider_CreateChild()) charges its parent for its
+	// currentAllocation rounded up to whole chunks of parentChunk bytes, so most
+	// reservations do not touch the parent.  NULL for a pool without a parent.
+	struct folio_pool *parent;
+	uint64_t parentChunk;
+
+	// The provider of the parent, to which the child holds a reference
+	FolioMemoryProvider *parentProvider;
+
+	// The child pools, linked by nextSibling, protected by childLock
+	atomic_flag childLock;
+	struct folio_pool *firstChild;
+	struct folio_pool *nextSibling;
+
+	// The waiters in all descendant pools.  A descendant's waiter may have been refused
+	// by this pool, so a release here wakes them too.
+	atomic_uint descendantWaiters;
 
 	// Used to start a guard byte array pattern.  Varries for each pool.
 	uint8_t guardPattern;
 
+	// The source of block memory.  If NULL, uses malloc() and free().
+	const FolioBlockAllocator *blockAllocator;
+
 	// Bit pattern to make sure we are really working with this data structure.
 	uint64_t internalMagic2;
-} FolioPool __attribute__((aligned));
+} __attribute__((aligned(64))) FolioPool;
+
+/**
+ * The owner word for the pool's blocks.  Registers the pool on its first call.
+ *
+ * @param provider The provider of the pool, to which folioPool_GetOwner() dispatches
+ */
+FolioOwner folioPool_Owner(FolioPool *pool, FolioMemoryProvider *provider);
+
+/**
+ * Removes the pool from the registry of pools.  For the final release of the pool.
+ */
+void folioPool_Unregister(FolioPool *pool);
+
+/**
+ * The provider that owns the memory, from the owner word in front of it.  Traps with
+ * an unexpected state if the owner word does not name a live pool (e.g. a memory underrun).
+ */
+FolioMemoryProvider *folioPool_GetOwner(const void *memory);
 
 /**
  * Creates a string report of the pool.
@@ -96,4 +343,59 @@ typedef struct folio_pool {
  */
 char *folioPool_ToString(const FolioPool *pool);
 
+/**
+ * Reserves length bytes of the pool for an allocation in the priority class.  Lock
+ * free, unless a class has a reserve or a cap.
+ *
+ * @param crossedSoftLimit Set to true if this reservation took the pool above its soft limit
+ *
+ * @return true if reserved
+ * @return false if the reservation would exceed the hard limit, the class cap, or
+ *         another class's reserve (nothing is reserved)
+ */
+bool folioPool_Reserve(FolioPool *pool, unsigned priority, size_t length, bool *crossedSoftLimit);
+
+/**
+ * Tests if a reservation of length bytes in the priority class could succeed once
+ * enough memory is released, that is if length is within the hard limit and class
+ * cap of the pool and within the hard limit and Normal class cap of each ancestor,
+ * counting the whole chunks a child charges its parent.
+ */
+bool folioPool_CanEverReserve(const FolioPool *pool, unsigned priority, size_t length);
+
+/**
+ * Returns length bytes reserved by folioPool_Reserve() in the priority class and wakes
+ * the first waiter, if any, of the pool and of each descendant.  Lock free, unless
+ * there are waiters.
+ */
+void folioPool_Unreserve(FolioPool *pool, unsigned priority, size_t length);
+
+/**
+ * Tells the waiter to try again.  The caller holds the pool's waitLock.
+ */
+void folioPool_WakeWaiter(FolioWaiter *waiter);
+
+/**
+ * Counts a waiter that entered (delta 1) or left (delta -1) the pool's line in the
+ * descendantWaiters of each ancestor, so their releases wake it.
+ */
+void folioPool_CountDescendantWaiter(FolioPool *pool, int delta);
+
+/**
+ * Makes the pool a child of parent, charged in chunks of chunk bytes.  The pool must not
+ * have any memory reserved, and the parent must outlive it.
+ */
+void folioPool_Attach(FolioPool *pool, FolioPool *parent, uint64_t chunk);
+
+/**
+ * Removes a child pool from its parent and gives back what it charged the parent.
+ * For the final release of the pool.
+ */
+void folioPool_Detach(FolioPool *pool);
+
+/**
+ * Sets the reserve and cap of a priority class.  See folioMemoryProvider_SetPriorityClass().
+ */
+void folioPool_SetPriorityClass(FolioPool *pool, unsigned priority, uint64_t reserveBytes, uint64_t capBytes);
+
 #endif /* INCLUDE_FOLIO_PRIVATE_FOLIO_POOL_H_ */
@@ -0,0 +1,157 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_FOLIO_PRIVATE_FOLIO_STATS_H_
+#define INCLUDE_FOLIO_PRIVATE_FOLIO_STATS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The number of shards.  Each thread updates one shard, picked round robin
+ * the first time the thread uses any FolioStats.  With more threads than
+ * shards, threads share shards.
+ */
+#define FolioStatsShardCount 64
+
+/**
+ * The counters of one shard, in its own cache line so threads do not share lines.
+ *
+ * The outstanding counts are signed because memory allocated on one thread is
+ * often released on another, so a single shard may go negative.  Only the sum
+ * over all shards is meaningful.
+ */
+typedef struct folio_stats_shard {
+	// (uintptr_t) pthread_self() of the first thread to use the shard, 0 if unused
+	atomic_uintptr_t owner;
+
+	// Set when a second thread uses the shard
+	atomic_bool shared;
+
+	atomic_int_least64_t outstandingAllocs;
+	atomic_int_least64_t outstandingAcquires;
+
+	// Totals for the per-thread breakdown
+	atomic_uint_least64_t allocations;
+	atomic_uint_least64_t acquires;
+	atomic_uint_least64_t releases;
+
+	// number of allocations attempted but no memory available
+	atomic_uint_least64_t outOfMemoryCount;
+} __attribute__((aligned(64))) FolioStatsShard;
+
+/**
+ * Provider statistics that threads update without a shared lock.  They are
+ * only summed when read (e.g. for a report or an acquire count).
+ *
+ * All zero is the initial state, so a FolioStats in static storage needs no
+ * initializer.
+ */
+typedef struct folio_stats {
+	FolioStatsShard shards[FolioStatsShardCount];
+} FolioStats;
+
+/**
+ * The sum of all shards
+ */
+typedef struct folio_stats_snapshot {
+	size_t outstandingAllocs;
+	size_t outstandingAcquires;
+	size_t allocations;
+	size_t acquires;
+	size_t releases;
+	size_t outOfMemoryCount;
+} FolioStatsSnapshot;
+
+/**
+ * Sets all counters to zero.
+ */
+void folioStats_Initialize(FolioStats *stats);
+
+/**
+ * Counts an allocation, or an out of memory if the allocation failed.
+ */
+void folioStats_Allocate(FolioStats *stats, bool success);
+
+/**
+ * Counts a batch of allocations with one update.
+ *
+ * @param allocated The number of successful allocations
+ * @param failed The number of allocations that were out of memory
+ */
+void folioStats_AllocateBatch(FolioStats *stats, size_t allocated, size_t failed);
+
+/**
+ * Counts an acquire of existing memory
+ */
+void folioStats_Acquire(FolioStats *stats);
+
+/**
+ * Counts n acquires of existing memory with one update
+ */
+void folioStats_AcquireN(FolioStats *stats, size_t n);
+
+/**
+ * Counts a release.  If finalRelease, the allocation is also no longer outstanding.
+ */
+void folioStats_Release(FolioStats *stats, bool finalRelease);
+
+/**
+ * Counts a batch of releases with one update.
+ *
+ * @param releases The number of releases
+ * @param finalReleases How many of them were the final release of their memory
+ */
+void folioStats_ReleaseBatch(FolioStats *stats, size_t releases, size_t finalReleases);
+
+/**
+ * Counts allocations that ended without going through release (e.g. an arena reset).
+ *
+ * @param allocs The number of allocations that ended
+ * @param acquires The number of references they had outstanding
+ */
+void folioStats_Discard(FolioStats *stats, size_t allocs, size_t acquires);
+
+/**
+ * Sums the shards.  The result is not an atomic snapshot if other threads are
+ * updating the counters.
+ */
+void folioStats_Sum(const FolioStats *stats, FolioStatsSnapshot *sum);
+
+/**
+ * The sum of the outstanding acquires over all shards
+ */
+size_t folioStats_OutstandingAcquires(const FolioStats *stats);
+
+/**
+ * Writes one line per shard in use showing the thread that owns it (or that it is
+ * shared) and its totals.
+ */
+void folioStats_ReportThreads(const FolioStats *stats, FILE *stream);
+
+#endif /* INCLUDE_FOLIO_PRIVATE_FOLIO_STATS_H_ */
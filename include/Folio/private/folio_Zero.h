@@ -0,0 +1,53 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SRC_PRIVATE_FOLIO_ZERO_H_
+#define SRC_PRIVATE_FOLIO_ZERO_H_
+
+#include <stddef.h>
+
+/**
+ * Used as the non-temporal threshold when the platform does not report its
+ * last level cache size.
+ */
+#define FolioZeroDefaultNonTemporalThreshold ((size_t) 8 * 1024 * 1024)
+
+/**
+ * At or above this length, folioZero_Clear() uses non-temporal stores.  It is
+ * 3/4 of the last level cache (as glibc does for memset), so a block that the
+ * caller will use while it is still cached is cleared with memset().
+ */
+size_t folioZero_NonTemporalThreshold(void);
+
+/**
+ * Sets length bytes at memory to zero.
+ *
+ * Lengths at or above folioZero_NonTemporalThreshold() bypass the cache with
+ * non-temporal stores where the platform has them (SSE2), otherwise this is memset().
+ */
+void folioZero_Clear(void *memory, size_t length);
+
+#endif /* SRC_PRIVATE_FOLIO_ZERO_H_ */
@@ -28,96 +28,476 @@
 #include <LongBow/runtime.h>
 #include "Folio/folio.h"
 #include "Folio/folio_StdProvider.h"
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 
 
 // Because it is a static allocation, we cannot get a reference count.
 // In any case, it is statically allocated and we cannot release it.
 static FolioMemoryProvider *_defaultProvider = &FolioStdProvider;
-static FolioMemoryProvider *_provider = &FolioStdProvider;
+static _Atomic(FolioMemoryProvider *) _provider = ATOMIC_VAR_INIT(&FolioStdProvider);
 
-void
-folio_SetProvider(FolioMemoryProvider *provider)
+/*
+ * Replacing _provider works like RCU.  A reader counts itself in its shard under the
+ * parity of _epoch, loads _provider, and uncounts when done.  A writer stores the new
+ * provider, flips _epoch, and waits for the old parity to drain in every shard before
+ * it releases the old provider.  Readers take no lock; writers are serialized.
+ */
+#define FolioReaderShardCount 64
+
+typedef struct folio_reader_shard {
+	atomic_uint count[2];
+} __attribute__((aligned(64))) FolioReaderShard;
+
+static FolioReaderShard _readerShards[FolioReaderShardCount];
+static atomic_uint _nextReaderShard = ATOMIC_VAR_INIT(0);
+static atomic_uint _epoch = ATOMIC_VAR_INIT(0);
+static pthread_mutex_t _writerLock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread FolioReaderShard *_threadReaderShard;
+
+typedef struct folio_reader {
+	FolioMemoryProvider *provider;
+
+	// The count to decrement when done, or NULL if the provider is not from _provider
+	atomic_uint *count;
+} FolioReader;
+
+// The pushed providers of this thread.  _threadProvider is the top, or NULL
+// when none is pushed so the allocators only test one thread-local.
+static __thread FolioMemoryProvider *_threadProviders[FolioMaximumThreadProviders];
+static __thread unsigned _threadProviderCount;
+static __thread FolioMemoryProvider *_threadProvider;
+
+// Pops what a thread left pushed when it exits
+static pthread_once_t _threadProviderOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t _threadProviderKey;
+
+/*
+ * Starts using the global provider.  It stays valid until _leave().
+ */
+static inline FolioReader
+_enter(void)
+{
+	FolioReaderShard *shard = _threadReaderShard;
+	if (shard == NULL) {
+		shard = &_readerShards[atomic_fetch_add_explicit(&_nextReaderShard, 1, memory_order_relaxed) % FolioReaderShardCount];
+		_threadReaderShard = shard;
+	}
+
+	for (;;) {
+		unsigned parity = atomic_load(&_epoch) & 1;
+		atomic_fetch_add(&shard->count[parity], 1);
+
+		// If a writer flipped the epoch in between, it may not wait for this count
+		if ((atomic_load(&_epoch) & 1) == parity) {
+			return (FolioReader) { .provider = atomic_load(&_provider), .count = &shard->count[parity] };
+		}
+		atomic_fetch_sub(&shard->count[parity], 1);
+	}
+}
+
+/*
+ * Like _enter(), but for new memory: this thread's pushed provider if it has one.
+ * The thread holds a reference to a pushed provider, so it is used without counting.
+ */
+static inline FolioReader
+_enterAllocator(void)
 {
-	if (_provider != _defaultProvider) {
-		folioMemoryProvider_ReleaseProvider(&_provider);
+	FolioMemoryProvider *provider = _threadProvider;
+	if (provider != NULL) {
+		return (FolioReader) { .provider = provider, .count = NULL };
+	}
+	return _enter();
+}
+
+static inline void
+_leave(FolioReader reader)
+{
+	if (reader.count != NULL) {
+		atomic_fetch_sub_explicit(reader.count, 1, memory_order_release);
+	}
+}
+
+/*
+ * Waits until no reader can still be using a provider loaded before the last store to _provider
+ */
+static void
+_synchronize(void)
+{
+	unsigned parity = atomic_fetch_add(&_epoch, 1) & 1;
+	for (unsigned i = 0; i < FolioReaderShardCount; i++) {
+		while (atomic_load_explicit(&_readerShards[i].count[parity], memory_order_acquire) != 0) {
+			sched_yield();
+		}
 	}
+}
 
+/*
+ * Installs `provider` (already acquired) and releases the prior one once no reader uses it
+ */
+static void
+_replaceProvider(FolioMemoryProvider *provider)
+{
+	pthread_mutex_lock(&_writerLock);
+	FolioMemoryProvider *prior = atomic_exchange(&_provider, provider);
+	_synchronize();
+	pthread_mutex_unlock(&_writerLock);
+
+	// The default provider is statically allocated and cannot be released.
+	if (prior != NULL && prior != _defaultProvider) {
+		folioMemoryProvider_ReleaseProvider(&prior);
+	}
+}
+
+void
+folio_SetProvider(FolioMemoryProvider *provider)
+{
 	if (provider != NULL) {
-		_provider = folioMemoryProvider_AcquireProvider(provider);
-	} else {
-		_provider = NULL;
+		provider = folioMemoryProvider_AcquireProvider(provider);
 	}
+	_replaceProvider(provider);
 }
 
 void
 folio_ReleaseProvider(void)
 {
-	if (_provider != _defaultProvider) {
-		folioMemoryProvider_ReleaseProvider(&_provider);
-	} else {
-		// If trying to release the default provider, don't do it!  Just null it.
-		// The default provider is statically allocated and cannot be released.
-		_provider = NULL;
-	}
+	_replaceProvider(NULL);
 }
 
 void
-folio_SetAvailableMemory(size_t maximum) {
-	folioMemoryProvider_SetAvailableMemory(_provider, maximum);
+folio_SetAvailableMemory(size_t maximum)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetAvailableMemory(reader.provider, maximum);
+	_leave(reader);
+}
+
+void
+folio_SetSoftLimit(size_t bytes, FolioSoftLimitCallback callback)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetSoftLimit(reader.provider, bytes, callback);
+	_leave(reader);
+}
+
+void
+folio_SetValidationLevel(FolioValidationLevel level, unsigned sampleInterval)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetValidationLevel(reader.provider, level, sampleInterval);
+	_leave(reader);
+}
+
+void
+folio_SetPriorityClass(FolioPriority priority, size_t reserveBytes, size_t capBytes)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetPriorityClass(reader.provider, priority, reserveBytes, capBytes);
+	_leave(reader);
+}
+
+FolioPriority
+folio_SetThreadPriority(FolioPriority priority)
+{
+	return folioMemoryProvider_SetThreadPriority(priority);
 }
 
 FolioMemoryProvider *
 folio_GetProvider(void)
 {
-	return _provider;
+	FolioMemoryProvider *provider = _threadProvider;
+	return provider != NULL ? provider : atomic_load(&_provider);
+}
+
+/*
+ * Thread exit with providers still pushed
+ */
+static void
+_popThreadProviders(void *unused __attribute__((unused)))
+{
+	while (_threadProviderCount > 0) {
+		folio_PopThreadProvider();
+	}
+}
+
+static void
+_createThreadProviderKey(void)
+{
+	int failure = pthread_key_create(&_threadProviderKey, _popThreadProviders);
+	trapUnexpectedStateIf(failure, "Could not create thread provider key: %d", failure);
+}
+
+void
+folio_PushThreadProvider(FolioMemoryProvider *provider)
+{
+	assertNotNull(provider, "provider must be non-null");
+	trapUnexpectedStateIf(_threadProviderCount == FolioMaximumThreadProviders,
+			"Thread already has %u providers pushed", _threadProviderCount);
+
+	if (_threadProviderCount == 0) {
+		// Any non-NULL value makes the thread call _popThreadProviders() on exit
+		pthread_once(&_threadProviderOnce, _createThreadProviderKey);
+		pthread_setspecific(_threadProviderKey, _threadProviders);
+	}
+
+	_threadProvider = folioMemoryProvider_AcquireProvider(provider);
+	_threadProviders[_threadProviderCount++] = _threadProvider;
+}
+
+void
+folio_PopThreadProvider(void)
+{
+	trapUnexpectedStateIf(_threadProviderCount == 0, "Thread has no provider pushed");
+
+	FolioMemoryProvider *provider = _threadProviders[--_threadProviderCount];
+	_threadProviders[_threadProviderCount] = NULL;
+	_threadProvider = _threadProviderCount > 0 ? _threadProviders[_threadProviderCount - 1] : NULL;
+	if (_threadProviderCount == 0) {
+		pthread_setspecific(_threadProviderKey, NULL);
+	}
+
+	folioMemoryProvider_ReleaseProvider(&provider);
+}
+
+void
+folio_SetLargeObjectThreshold(size_t bytes)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetLargeObjectThreshold(reader.provider, bytes);
+	_leave(reader);
+}
+
+size_t
+folio_Reserve(size_t bytes, const size_t *sizeClassHints, unsigned flags)
+{
+	FolioReader reader = _enter();
+	size_t result = folioMemoryProvider_Reserve(reader.provider, bytes, sizeClassHints, flags);
+	_leave(reader);
+	return result;
+}
+
+size_t
+folio_Scavenge(size_t budget)
+{
+	FolioReader reader = _enter();
+	size_t result = folioMemoryProvider_Scavenge(reader.provider, budget);
+	_leave(reader);
+	return result;
+}
+
+FolioMemoryProvider *
+folio_CreateChild(size_t limit)
+{
+	FolioReader reader = _enter();
+	FolioMemoryProvider * result = folioMemoryProvider_CreateChild(reader.provider, limit);
+	_leave(reader);
+	return result;
+}
+
+void
+folio_SetScavengePolicy(size_t retainBytes, unsigned decayPercent)
+{
+	FolioReader reader = _enter();
+	folioMemoryProvider_SetScavengePolicy(reader.provider, retainBytes, decayPercent);
+	_leave(reader);
+}
+
+bool
+folio_RegisterReclaimer(FolioReclaimer callback, void *context, unsigned priority)
+{
+	FolioReader reader = _enter();
+	bool result = folioMemoryProvider_RegisterReclaimer(reader.provider, callback, context, priority);
+	_leave(reader);
+	return result;
+}
+
+bool
+folio_UnregisterReclaimer(FolioReclaimer callback, void *context)
+{
+	FolioReader reader = _enter();
+	bool result = folioMemoryProvider_UnregisterReclaimer(reader.provider, callback, context);
+	_leave(reader);
+	return result;
 }
 
 void *
 folio_Allocate(size_t length)
 {
-	return folioMemoryProvider_Allocate(_provider, length, NULL);
+	FolioReader reader = _enterAllocator();
+	void * result = folioMemoryProvider_Allocate(reader.provider, length, NULL);
+	_leave(reader);
+	return result;
 }
 
 void *
 folio_AllocateAndZero(size_t length, Finalizer fini)
 {
-	return folioMemoryProvider_AllocateAndZero(_provider, length, fini);
+	FolioReader reader = _enterAllocator();
+	void * result = folioMemoryProvider_AllocateAndZero(reader.provider, length, fini);
+	_leave(reader);
+	return result;
+}
+
+void *
+folio_AllocateAligned(size_t length, size_t alignment, Finalizer fini)
+{
+	FolioReader reader = _enterAllocator();
+	void * result = folioMemoryProvider_AllocateAligned(reader.provider, length, alignment, fini);
+	_leave(reader);
+	return result;
+}
+
+size_t
+folio_AllocateBatch(size_t count, size_t length, Finalizer fini, void **out)
+{
+	FolioReader reader = _enterAllocator();
+	size_t result = folioMemoryProvider_AllocateBatch(reader.provider, count, length, fini, out);
+	_leave(reader);
+	return result;
+}
+
+void *
+folio_AllocateWait(const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	FolioReader reader = _enterAllocator();
+	FolioMemoryProvider *provider = reader.provider;
+
+	// A wait may be long, so hold the global provider by a reference rather than the
+	// reader count that folio_SetProvider() waits for
+	if (reader.count != NULL) {
+		provider = folioMemoryProvider_AcquireProvider(provider);
+		_leave(reader);
+	}
+
+	void * result = folioMemoryProvider_AllocateWait(provider, length, fini, timeoutMilliseconds);
+
+	if (reader.count != NULL) {
+		folioMemoryProvider_ReleaseProvider(&provider);
+	}
+	return result;
+}
+
+void *
+folio_AllocateWithPriority(const size_t length, Finalizer fini, FolioPriority priority)
+{
+	FolioReader reader = _enterAllocator();
+	void * result = folioMemoryProvider_AllocateWithPriority(reader.provider, length, fini, priority);
+	_leave(reader);
+	return result;
+}
+
+/*
+ * The provider that allocated the memory, which may not be the current provider
+ */
+static FolioMemoryProvider *
+_ownerOf(void **memoryPtr)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+	return folioPool_GetOwner(*memoryPtr);
+}
+
+void *
+folio_Reallocate(void **memoryPtr, size_t newLength)
+{
+	return folioMemoryProvider_Reallocate(_ownerOf(memoryPtr), memoryPtr, newLength);
 }
 
 void *
 folio_Acquire(const void *memory)
 {
-	return folioMemoryProvider_Acquire(_provider, memory);
+	return folioMemoryProvider_Acquire(folioPool_GetOwner(memory), memory);
 }
 
 void
 folio_Release(void **memoryPtr)
 {
-	folioMemoryProvider_Release(_provider, memoryPtr);
+	folioMemoryProvider_Release(_ownerOf(memoryPtr), memoryPtr);
+}
+
+void *
+folio_Steal(void **slot)
+{
+	assertNotNull(slot, "slot must be non-null");
+
+	void *memory = *slot;
+	*slot = NULL;
+	return memory;
+}
+
+void *
+folio_AcquireN(const void *memory, unsigned n)
+{
+	return folioMemoryProvider_AcquireN(folioPool_GetOwner(memory), memory, n);
+}
+
+void
+folio_ReleaseN(void **memoryPtr, unsigned n)
+{
+	folioMemoryProvider_ReleaseN(_ownerOf(memoryPtr), memoryPtr, n);
+}
+
+void
+folio_ReleaseBatch(void **memoryArray, size_t count)
+{
+	assertNotNull(memoryArray, "memoryArray must be non-null");
+
+	// One call per run of memory from the same provider
+	size_t start = 0;
+	while (start < count) {
+		FolioMemoryProvider *owner = folioPool_GetOwner(memoryArray[start]);
+		size_t end = start + 1;
+		while (end < count && folioPool_GetOwner(memoryArray[end]) == owner) {
+			end++;
+		}
+		folioMemoryProvider_ReleaseBatch(owner, memoryArray + start, end - start);
+		start = end;
+	}
+}
+
+void *
+folio_AcquireUnchecked(const void *memory)
+{
+	return folioMemoryProvider_AcquireUnchecked(folioPool_GetOwner(memory), memory);
+}
+
+void
+folio_ReleaseUnchecked(void **memoryPtr)
+{
+	folioMemoryProvider_ReleaseUnchecked(_ownerOf(memoryPtr), memoryPtr);
 }
 
 size_t
 folio_Length(const void *memory) {
-	return folioMemoryProvider_Length(_provider, memory);
+	return folioMemoryProvider_Length(folioPool_GetOwner(memory), memory);
 }
 
 void
 folio_Report(FILE *stream)
 {
-	folioMemoryProvider_Report(_provider, stream);
+	FolioReader reader = _enterAllocator();
+	folioMemoryProvider_Report(reader.provider, stream);
+	_leave(reader);
 }
 
 size_t
 folio_OustandingReferences(void)
 {
-	return folioMemoryProvider_OustandingReferences(_provider);
+	FolioReader reader = _enterAllocator();
+	size_t result = folioMemoryProvider_OustandingReferences(reader.provider);
+	_leave(reader);
+	return result;
 }
 
 size_t
 folio_AllocatedBytes(void)
 {
-	return folioMemoryProvider_AllocatedBytes(_provider);
+	FolioReader reader = _enterAllocator();
+	size_t result = folioMemoryProvider_AllocatedBytes(reader.provider);
+	_leave(reader);
+	return result;
 }
 
 
@@ -139,18 +519,18 @@ folio_TestRefCount(size_t expectedRefCount, FILE *stream, const char *format, ..
 void
 folio_Validate(const void *memory)
 {
-	folioMemoryProvider_Validate(_provider, memory);
+	folioMemoryProvider_Validate(folioPool_GetOwner(memory), memory);
 }
 
 void
 folio_Lock(void *memory)
 {
-	folioMemoryProvider_Lock(_provider, memory);
+	folioMemoryProvider_Lock(folioPool_GetOwner(memory), memory);
 }
 
 void
 folio_Unlock(void *memory)
 {
-	folioMemoryProvider_Unlock(_provider, memory);
+	folioMemoryProvider_Unlock(folioPool_GetOwner(memory), memory);
 }
 
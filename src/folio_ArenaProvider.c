@@ -0,0 +1,771 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LongBow/runtime.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <Folio/folio_ArenaProvider.h>
+#include <Folio/private/folio_Lock.h>
+#include <Folio/private/folio_InternalProvider.h>
+#include <Folio/private/folio_Pool.h>
+#include <Folio/private/folio_Header.h>
+#include <Folio/private/folio_Stats.h>
+#include <Folio/private/folio_Zero.h>
+
+static FolioMemoryProvider *_acquireProvider(const FolioMemoryProvider *provider);
+static bool _releaseProvider(FolioMemoryProvider **providerPtr);
+
+static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
+static void * _acquire(FolioMemoryProvider *provider, const void *memory);
+static size_t _length(const FolioMemoryProvider *provider, const void *memory);
+static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+static void * _acquireUnchecked(FolioMemoryProvider *provider, const void *memory);
+static void _releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr);
+static void _report(const FolioMemoryProvider *provider, FILE *stream);
+static void _display(const FolioMemoryProvider *provider, const void *memory, FILE *stream);
+static void _validate(const FolioMemoryProvider *provider, const void *memory);
+static size_t _acquireCount(const FolioMemoryProvider *provider);
+static size_t _allocationSize(const FolioMemoryProvider *provider);
+static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
+
+static void _lock(FolioMemoryProvider *provider, void *memory);
+static void _unlock(FolioMemoryProvider *provider, void *memory);
+
+static void * _arenaAllocate(FolioMemoryProvider *provider, size_t totalLength, bool zero);
+static void _arenaFree(FolioMemoryProvider *provider, void *block, size_t totalLength);
+static void * _arenaReallocate(FolioMemoryProvider *provider, void *block, size_t totalLength, size_t newTotalLength);
+static void _arenaDestroy(FolioMemoryProvider *provider);
+
+const FolioMemoryProvider FolioArenaProviderTemplate = {
+	.acquireProvider = _acquireProvider,
+	.releaseProvider = _releaseProvider,
+	.allocate = _allocate,
+	.allocateAndZero = _allocateAndZero,
+	.allocateAligned = _allocateAligned,
+	.allocateBatch = _allocateBatch,
+	.allocateWait = _allocateWait,
+	.reallocate = _reallocate,
+	.acquire = _acquire,
+	.length = _length,
+	.release = _release,
+	.releaseBatch = _releaseBatch,
+	.acquireN = _acquireN,
+	.releaseN = _releaseN,
+	.acquireUnchecked = _acquireUnchecked,
+	.releaseUnchecked = _releaseUnchecked,
+	.report = _report,
+	.display = _display,
+	.validate = _validate,
+	.acquireCount = _acquireCount,
+	.allocationSize = _allocationSize,
+	.setAvailableMemory = _setAvailableMemory,
+	.reserve = _reserve,
+	.scavenge = _scavenge,
+	.createChild = _createChild,
+	.lock = _lock,
+	.unlock = _unlock
+};
+
+static const FolioBlockAllocator _arenaBlockAllocator = {
+	.allocate = _arenaAllocate,
+	.free = _arenaFree,
+	.reallocate = _arenaReallocate,
+	.destroy = _arenaDestroy
+};
+
+/*
+ * Blocks are bump allocated from chunks of ChunkLength bytes (or larger, for a
+ * block that would not fit).  Allocations with a finalizer are also recorded in an
+ * allocation log so a reset can run the finalizers newest to oldest.  The log pages
+ * are bump allocated from the chunks too, so they go away with the chunks.  The
+ * reset gives back the bytes of each priority class and the blocks' holds in one go,
+ * so the blocks without a finalizer cost it nothing.
+ *
+ * A reset keeps one ChunkLength chunk so a request-per-reset loop does not
+ * go back to malloc() every time.
+ */
+#define ChunkLength ((size_t) 64 * 1024)
+#define ChunkHeaderLength ((size_t) 16)
+#define BumpAlignment ((size_t) 16)
+#define LogEntries 510
+
+typedef struct arena_chunk {
+	struct arena_chunk *next;
+	size_t length;
+} ArenaChunk;
+
+typedef struct allocation_log {
+	struct allocation_log *previous;
+	size_t count;
+	void *memory[LogEntries];
+} AllocationLog;
+
+typedef struct arena_state {
+	FolioStats stats;
+
+	// protects everything below
+	atomic_flag arenaLock;
+
+	// newest chunk first
+	ArenaChunk *chunks;
+	size_t chunkCount;
+	size_t chunkBytes;
+
+	// The unused part of the newest chunk
+	uint8_t *next;
+	uint8_t *end;
+
+	// newest page first
+	AllocationLog *log;
+	size_t allocationsSinceReset;
+	size_t resetCount;
+
+	// true while folioArenaProvider_Reset() is running finalizers
+	atomic_bool resetting;
+} ArenaState;
+
+/* ********************************************************** */
+
+FolioMemoryProvider *
+folioArenaProvider_Create(size_t poolSize)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&FolioArenaProviderTemplate, poolSize,
+									sizeof(ArenaState), 0);
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	memset(state, 0, sizeof(ArenaState));
+
+	atomic_flag_clear(&state->arenaLock);
+	atomic_init(&state->resetting, false);
+
+	folioInternalProvider_SetBlockAllocator(provider, &_arenaBlockAllocator);
+
+	return provider;
+}
+
+/*
+ * Bump allocate from the newest chunk, adding a chunk if it does not fit.
+ *
+ * precondition: you hold the arena lock
+ *
+ * @return NULL if the system is out of memory
+ */
+static void *
+_bump(ArenaState *state, size_t length)
+{
+	size_t alignedLength = (length + BumpAlignment - 1) & ~(BumpAlignment - 1);
+
+	if (state->next == NULL || alignedLength > (size_t) (state->end - state->next)) {
+		size_t chunkLength = ChunkLength;
+		if (alignedLength + ChunkHeaderLength > chunkLength) {
+			chunkLength = alignedLength + ChunkHeaderLength;
+		}
+
+		ArenaChunk *chunk = malloc(chunkLength);
+		if (chunk != NULL) {
+			chunk->length = chunkLength;
+			chunk->next = state->chunks;
+			state->chunks = chunk;
+			state->chunkCount++;
+			state->chunkBytes += chunkLength;
+
+			state->next = (uint8_t *) chunk + ChunkHeaderLength;
+			state->end = (uint8_t *) chunk + chunkLength;
+		}
+	}
+
+	void *memory = NULL;
+	if (state->next != NULL && alignedLength <= (size_t) (state->end - state->next)) {
+		memory = state->next;
+		state->next += alignedLength;
+	}
+	return memory;
+}
+
+/*
+ * Record an allocation in the log.
+ *
+ * precondition: you hold the arena lock
+ *
+ * @return false if out of memory
+ */
+static bool
+_logAllocation(ArenaState *state, void *memory)
+{
+	if (state->log == NULL || state->log->count == LogEntries) {
+		AllocationLog *page = _bump(state, sizeof(AllocationLog));
+		if (page != NULL) {
+			page->previous = state->log;
+			page->count = 0;
+			state->log = page;
+		}
+	}
+
+	bool logged = false;
+	if (state->log != NULL && state->log->count < LogEntries) {
+		state->log->memory[state->log->count++] = memory;
+		logged = true;
+	}
+	return logged;
+}
+
+static void *
+_arenaAllocate(FolioMemoryProvider *provider, size_t totalLength, bool zero)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	folioLock_FlagLock(&state->arenaLock);
+	void *block = _bump(state, totalLength);
+	if (block != NULL) {
+		state->allocationsSinceReset++;
+	}
+	folioLock_FlagUnlock(&state->arenaLock);
+
+	// The chunks come from malloc() and are reused after a reset
+	if (zero && block != NULL) {
+		folioZero_Clear(block, totalLength);
+	}
+
+	return block;
+}
+
+static void
+_arenaFree(FolioMemoryProvider *provider __attribute__((unused)), void *block __attribute__((unused)),
+		size_t totalLength __attribute__((unused)))
+{
+	// The memory goes back to the system on reset
+}
+
+/*
+ * Shrinking is always in place, as the memory only comes back on reset.  Growing
+ * is in place if the block is the last one bumped and its chunk has room.
+ */
+static void *
+_arenaReallocate(FolioMemoryProvider *provider, void *block, size_t totalLength, size_t newTotalLength)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	size_t alignedLength = (totalLength + BumpAlignment - 1) & ~(BumpAlignment - 1);
+	size_t newAlignedLength = (newTotalLength + BumpAlignment - 1) & ~(BumpAlignment - 1);
+
+	void *newBlock = NULL;
+
+	folioLock_FlagLock(&state->arenaLock);
+	bool atTop = (uint8_t *) block + alignedLength == state->next;
+	if (newAlignedLength <= alignedLength) {
+		if (atTop) {
+			state->next = (uint8_t *) block + newAlignedLength;
+		}
+		newBlock = block;
+	} else if (atTop && newAlignedLength - alignedLength <= (size_t) (state->end - state->next)) {
+		state->next = (uint8_t *) block + newAlignedLength;
+		newBlock = block;
+	}
+	folioLock_FlagUnlock(&state->arenaLock);
+
+	return newBlock;
+}
+
+/*
+ * Frees all chunks except the one kept for reuse.
+ *
+ * precondition: you hold the arena lock
+ */
+static void
+_freeChunks(ArenaState *state, bool keepOne)
+{
+	ArenaChunk *keep = NULL;
+	ArenaChunk *chunk = state->chunks;
+	while (chunk != NULL) {
+		ArenaChunk *next = chunk->next;
+		if (keepOne && keep == NULL && chunk->length == ChunkLength) {
+			keep = chunk;
+		} else {
+			free(chunk);
+		}
+		chunk = next;
+	}
+
+	state->chunks = keep;
+	state->log = NULL;
+	if (keep != NULL) {
+		keep->next = NULL;
+		state->chunkCount = 1;
+		state->chunkBytes = keep->length;
+		state->next = (uint8_t *) keep + ChunkHeaderLength;
+		state->end = (uint8_t *) keep + keep->length;
+	} else {
+		state->chunkCount = 0;
+		state->chunkBytes = 0;
+		state->next = NULL;
+		state->end = NULL;
+	}
+}
+
+void
+folioArenaProvider_Reset(FolioMemoryProvider *provider)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	atomic_store(&state->resetting, true);
+
+	// Newest to oldest.  A finalizer may release other allocations of the arena,
+	// which _release() tolerates while resetting.
+	for (AllocationLog *log = state->log; log != NULL; log = log->previous) {
+		for (size_t i = log->count; i > 0; --i) {
+			folioInternalProvider_DiscardMemory(provider, log->memory[i - 1]);
+		}
+	}
+
+	// What the finalizers did not release is discarded as a whole
+	FolioStatsSnapshot outstanding;
+	folioStats_Sum(&state->stats, &outstanding);
+	size_t discardedAllocs = outstanding.outstandingAllocs;
+	folioStats_Discard(&state->stats, discardedAllocs, outstanding.outstandingAcquires);
+
+	for (unsigned priority = 0; priority < FolioPriorityClasses; ++priority) {
+		size_t bytes = folioInternalProvider_ClassAllocationSize(provider, priority);
+		if (bytes > 0) {
+			folioInternalProvider_Unreserve(provider, priority, bytes);
+		}
+	}
+
+	folioLock_FlagLock(&state->arenaLock);
+	_freeChunks(state, true);
+	state->allocationsSinceReset = 0;
+	state->resetCount++;
+	folioLock_FlagUnlock(&state->arenaLock);
+
+	atomic_store(&state->resetting, false);
+
+	if (discardedAllocs > 0) {
+		folioInternalProvider_Unhold(provider, discardedAllocs);
+	}
+}
+
+bool
+folioArenaProvider_Release(FolioMemoryProvider **providerPtr)
+{
+	trapIllegalValueIf(providerPtr == NULL, "providerPtr must be non-null");
+
+	folioArenaProvider_Reset(*providerPtr);
+	return _releaseProvider(providerPtr);
+}
+
+static FolioMemoryProvider *
+_acquireProvider(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AcquireProvider(provider);
+}
+
+static bool
+_releaseProvider(FolioMemoryProvider **providerPtr)
+{
+	return folioInternalProvider_ReleaseProvider(providerPtr);
+}
+
+/*
+ * Frees the chunks when the pool goes, which is not before the last block is released
+ */
+static void
+_arenaDestroy(FolioMemoryProvider *provider)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	_freeChunks(state, false);
+}
+
+/*
+ * Logs new memory with a finalizer so the reset can run it.
+ *
+ * @return The memory, or NULL if it could not be logged and was released
+ */
+static void *
+_logNewMemory(FolioMemoryProvider *provider, ArenaState *state, void *memory, Finalizer fini)
+{
+	if (memory != NULL && fini != NULL) {
+		folioLock_FlagLock(&state->arenaLock);
+		bool logged = _logAllocation(state, memory);
+		folioLock_FlagUnlock(&state->arenaLock);
+
+		if (!logged) {
+			// Without a log entry the reset could not finalize it
+			folioInternalProvider_ReleaseMemory(provider, &memory);
+			folioInternalProvider_Unhold(provider, 1);
+		}
+	}
+	return memory;
+}
+
+static void *
+_allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot allocate from an arena during its reset");
+
+	void *memory = folioInternalProvider_Allocate(provider, length, fini);
+	memory = _logNewMemory(provider, state, memory, fini);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot allocate from an arena during its reset");
+
+	void *memory = folioInternalProvider_AllocateAligned(provider, length, alignment, fini);
+	memory = _logNewMemory(provider, state, memory, fini);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot allocate from an arena during its reset");
+
+	void *memory = folioInternalProvider_AllocateAndZero(provider, length, fini);
+	memory = _logNewMemory(provider, state, memory, fini);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+/*
+ * One reservation for the batch, then a log entry for each block if they have a finalizer
+ */
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot allocate from an arena during its reset");
+
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, count, length, fini, out);
+	if (fini != NULL) {
+		size_t logged = 0;
+		for (size_t i = 0; i < allocated; ++i) {
+			void *memory = _logNewMemory(provider, state, out[i], fini);
+			if (memory != NULL) {
+				out[logged++] = memory;
+			}
+		}
+		for (size_t i = logged; i < allocated; ++i) {
+			out[i] = NULL;
+		}
+		allocated = logged;
+	}
+
+	folioStats_AllocateBatch(&state->stats, allocated, count - allocated);
+	return allocated;
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot allocate from an arena during its reset");
+
+	void *memory = folioInternalProvider_AllocateWait(provider, length, fini, timeoutMilliseconds);
+	memory = _logNewMemory(provider, state, memory, fini);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+	trapUnexpectedStateIf(atomic_load(&state->resetting), "Cannot reallocate in an arena during its reset");
+
+	void *oldMemory = *memoryPtr;
+	void *memory = folioInternalProvider_Reallocate(provider, memoryPtr, newLength);
+
+	if (memory != NULL && memory != oldMemory) {
+		// The old copy is invalid, so the reset skips its log entry.  The new one is
+		// logged whether or not it has a finalizer, a discard without one is harmless.
+		folioLock_FlagLock(&state->arenaLock);
+		bool logged = _logAllocation(state, memory);
+		folioLock_FlagUnlock(&state->arenaLock);
+
+		trapOutOfMemoryIf(!logged, "Could not log the reallocated memory %p", memory);
+	}
+
+	return memory;
+}
+
+static void
+_validate(const FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_Validate(provider, memory);
+}
+
+static void *
+_acquire(FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_Acquire(provider, memory);
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	folioInternalProvider_AcquireN(provider, memory, n);
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_AcquireN(&state->stats, n);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireUnchecked(FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_AcquireUnchecked(provider, memory);
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static size_t
+_length(const FolioMemoryProvider *provider, const void *memory)
+{
+	return folioInternalProvider_Length(provider, memory);
+}
+
+static void
+_release(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	if (atomic_load(&state->resetting) && !folioInternalProvider_IsLive(provider, *memoryPtr)) {
+		// A finalizer releasing memory the reset already discarded (and counted)
+		*memoryPtr = NULL;
+	} else {
+		bool finalRelease = folioInternalProvider_ReleaseMemory(provider, memoryPtr);
+
+		folioStats_Release(&state->stats, finalRelease);
+		if (finalRelease) {
+			folioInternalProvider_Unhold(provider, 1);
+		}
+	}
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	if (atomic_load(&state->resetting) && !folioInternalProvider_IsLive(provider, *memoryPtr)) {
+		// A finalizer releasing memory the reset already discarded (and counted)
+		*memoryPtr = NULL;
+	} else {
+		bool finalRelease = folioInternalProvider_ReleaseMemoryN(provider, memoryPtr, n);
+
+		folioStats_ReleaseBatch(&state->stats, n, finalRelease ? 1 : 0);
+		if (finalRelease) {
+			folioInternalProvider_Unhold(provider, 1);
+		}
+	}
+}
+
+/*
+ * A loop over _release(), which handles memory that a reset already discarded
+ */
+static void
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		_release(provider, &memoryArray[i]);
+	}
+}
+
+static void
+_releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	if (atomic_load(&state->resetting) && !folioInternalProvider_IsLive(provider, *memoryPtr)) {
+		*memoryPtr = NULL;
+	} else {
+		bool finalRelease = folioInternalProvider_ReleaseMemoryUnchecked(provider, memoryPtr);
+
+		folioStats_Release(&state->stats, finalRelease);
+		if (finalRelease) {
+			folioInternalProvider_Unhold(provider, 1);
+		}
+	}
+}
+
+static void
+_report(const FolioMemoryProvider *provider, FILE *stream)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(&state->stats, &copy);
+
+	folioLock_FlagLock(&state->arenaLock);
+	size_t chunkCount = state->chunkCount;
+	size_t chunkBytes = state->chunkBytes;
+	size_t allocations = state->allocationsSinceReset;
+	size_t resets = state->resetCount;
+	folioLock_FlagUnlock(&state->arenaLock);
+
+	fprintf(stream, "\nFolioArenaProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu, "
+			"chunks %zu (%zu bytes), allocations since reset %zu, resets %zu\n",
+			copy.outstandingAllocs,
+			copy.outstandingAcquires,
+			folioInternalProvider_AllocationSize(provider),
+			chunkCount,
+			chunkBytes,
+			allocations,
+			resets);
+	folioStats_ReportThreads(&state->stats, stream);
+	fprintf(stream, "\n");
+
+	folioInternalProvider_Report(provider, stream);
+}
+
+static void
+_display(const FolioMemoryProvider *provider, const void *memory, FILE *stream)
+{
+	folioInternalProvider_Display(provider, memory, stream);
+}
+
+static void
+_setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
+{
+	folioInternalProvider_SetAvailableMemory(provider, availableMemory);
+}
+
+/*
+ * A reset gives back all but one chunk, so a reserve would not last.  Nothing to reserve.
+ */
+static size_t
+_reserve(FolioMemoryProvider *provider __attribute__((unused)), size_t bytes __attribute__((unused)),
+		const size_t *sizeClassHints __attribute__((unused)), unsigned flags __attribute__((unused)))
+{
+	return 0;
+}
+
+/*
+ * An empty arena gives back the chunk it keeps across resets
+ */
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	size_t scavenged = 0;
+
+	folioLock_FlagLock(&state->arenaLock);
+	if (state->allocationsSinceReset == 0 && state->chunks != NULL) {
+		size_t idle = state->chunkBytes;
+		if (folioInternalProvider_ScavengeLimit(provider, idle, budget) >= idle) {
+			_freeChunks(state, false);
+			scavenged = idle;
+		}
+	}
+	folioLock_FlagUnlock(&state->arenaLock);
+
+	folioInternalProvider_RecordScavenge(provider, scavenged);
+	return scavenged;
+}
+
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	FolioMemoryProvider *child = folioArenaProvider_Create(limit);
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
+static size_t
+_acquireCount(const FolioMemoryProvider *provider)
+{
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(provider);
+
+	return folioStats_OutstandingAcquires(&state->stats);
+}
+
+static size_t
+_allocationSize(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AllocationSize(provider);
+}
+
+static void
+_lock(FolioMemoryProvider *provider, void *memory)
+{
+	folioInternalProvider_Lock(provider, memory);
+}
+
+static void
+_unlock(FolioMemoryProvider *provider, void *memory)
+{
+	folioInternalProvider_Unlock(provider, memory);
+}
@@ -30,7 +30,7 @@
 #include <Folio/folio_DebugProvider.h>
 #include <Folio/private/folio_InternalList.h>
 #include <Folio/private/folio_InternalProvider.h>
-#include <Folio/private/folio_Lock.h>
+#include <Folio/private/folio_Stats.h>
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -42,19 +42,32 @@
 static uint32_t _backtrace_depth = 16;
 static uint32_t _backtrace_offset = 2;
 
+// _releaseBatch() works on this many pointers at a time
+#define ReleaseBatchChunk 64
+
 static FolioMemoryProvider *_acquireProvider(const FolioMemoryProvider *provider);
 static bool _releaseProvider(FolioMemoryProvider **providerPtr);
 
 static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
 static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
 static void * _acquire(FolioMemoryProvider *provider, const void *memory);
 static size_t _length(const FolioMemoryProvider *provider, const void *memory);
 static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
 static void _report(const FolioMemoryProvider *provider, FILE *stream);
 static void _validate(const FolioMemoryProvider *provider, const void *memory);
 static size_t _acquireCount(const FolioMemoryProvider *provider);
 static size_t _allocationSize(const FolioMemoryProvider *provider);
 static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
 
 static void _lock(FolioMemoryProvider *provider, void *memory);
 static void _unlock(FolioMemoryProvider *provider, void *memory);
@@ -64,33 +77,33 @@ const FolioMemoryProvider FolioDebugProviderTemplate = {
 	.releaseProvider = _releaseProvider,
 	.allocate = _allocate,
 	.allocateAndZero = _allocateAndZero,
+	.allocateAligned = _allocateAligned,
+	.allocateBatch = _allocateBatch,
+	.allocateWait = _allocateWait,
+	.reallocate = _reallocate,
 	.acquire = _acquire,
 	.length = _length,
 	.release = _release,
+	.releaseBatch = _releaseBatch,
+	.acquireN = _acquireN,
+	.releaseN = _releaseN,
+	// The debug provider always validates
+	.acquireUnchecked = _acquire,
+	.releaseUnchecked = _release,
 	.report = _report,
 	.validate = _validate,
 	.acquireCount = _acquireCount,
 	.allocationSize = _allocationSize,
 	.setAvailableMemory = _setAvailableMemory,
+	.reserve = _reserve,
+	.scavenge = _scavenge,
+	.createChild = _createChild,
 	.lock = _lock,
 	.unlock = _unlock
 };
 
-typedef struct stats {
-	atomic_flag lock;
-
-	// The bytes allocated - bytes freed
-	size_t currentAllocation;
-
-	size_t outstandingAllocs;
-	size_t outstandingAcquires;
-
-	// number of allocations attempted but no memory available
-	size_t outOfMemoryCount;
-} Stats;
-
 typedef struct debug_state {
-	Stats stats;
+	FolioStats stats;
 	FolioInternalList *allocationList;
 } DebugState;
 
@@ -129,7 +142,7 @@ folioDebugProvider_Create(size_t poolSize)
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
 	state->allocationList = folioInternalList_Create();
 
-	memset(&state->stats, 0, sizeof(Stats));
+	folioStats_Initialize(&state->stats);
 
 	return provider;
 }
@@ -146,40 +159,112 @@ _releaseProvider(FolioMemoryProvider **providerPtr)
 	return folioInternalProvider_ReleaseProvider(providerPtr);
 }
 
+/*
+ * Records the backtrace and puts new memory on the allocation list
+ */
+static void
+_trackNewMemory(FolioMemoryProvider *provider, DebugState *state, void *memory)
+{
+	if (memory != NULL) {
+		DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(provider, memory);
+		debug->backtrace = longBowBacktrace_Create(_backtrace_depth, _backtrace_offset);
+
+		folioInternalList_Lock(state->allocationList);
+		debug->allocListHandle = folioInternalList_Append(state->allocationList, memory);
+		folioInternalList_Unlock(state->allocationList);
+	}
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+}
+
 static void *
 _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 {
 	void *memory = folioInternalProvider_Allocate(provider, length, fini);
 
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+	_trackNewMemory(provider, state, memory);
 
-	folioLock_FlagLock(&state->stats.lock);
-	if (memory != NULL) {
+	return memory;
+}
 
-		DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(provider, memory);
-		debug->backtrace = longBowBacktrace_Create(_backtrace_depth, _backtrace_offset);
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	void *memory = folioInternalProvider_AllocateAligned(provider, length, alignment, fini);
 
-		folioInternalList_Lock(state->allocationList);
-		debug->allocListHandle = folioInternalList_Append(state->allocationList, memory);
-		folioInternalList_Unlock(state->allocationList);
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+	_trackNewMemory(provider, state, memory);
+
+	return memory;
+}
 
-		state->stats.outstandingAcquires++;
-		state->stats.outstandingAllocs++;
-	} else {
-		state->stats.outOfMemoryCount++;
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, count, length, fini, out);
+
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+
+	for (size_t i = 0; i < allocated; ++i) {
+		DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(provider, out[i]);
+		debug->backtrace = longBowBacktrace_Create(_backtrace_depth, _backtrace_offset);
 	}
-	folioLock_FlagUnlock(&state->stats.lock);
 
-	return memory;
+	folioInternalList_Lock(state->allocationList);
+	for (size_t i = 0; i < allocated; ++i) {
+		DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(provider, out[i]);
+		debug->allocListHandle = folioInternalList_Append(state->allocationList, out[i]);
+	}
+	folioInternalList_Unlock(state->allocationList);
+
+	folioStats_AllocateBatch(&state->stats, allocated, count - allocated);
+
+	return allocated;
 }
 
 static void *
 _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 {
-	void * memory = _allocate(provider, length, fini);
-	if (memory) {
-		memset(memory, 0, length);
+	void *memory = folioInternalProvider_AllocateAndZero(provider, length, fini);
+
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+	_trackNewMemory(provider, state, memory);
+
+	return memory;
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	void *memory = folioInternalProvider_AllocateWait(provider, length, fini, timeoutMilliseconds);
+
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+	_trackNewMemory(provider, state, memory);
+
+	return memory;
+}
+
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	void *oldMemory = *memoryPtr;
+	void *memory = folioInternalProvider_Reallocate(provider, memoryPtr, newLength);
+
+	if (memory != NULL && memory != oldMemory) {
+		// The debug header moved with the block, but the allocation list still has the old pointer
+		DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+		DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(provider, memory);
+
+		folioInternalList_Lock(state->allocationList);
+		folioInternalList_RemoveAt(state->allocationList, debug->allocListHandle);
+		debug->allocListHandle = folioInternalList_Append(state->allocationList, memory);
+		folioInternalList_Unlock(state->allocationList);
 	}
+
 	return memory;
 }
 
@@ -196,9 +281,19 @@ _acquire(FolioMemoryProvider *provider, const void *memory)
 
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
 
-	folioLock_FlagLock(&state->stats.lock);
-	state->stats.outstandingAcquires++;
-	folioLock_FlagUnlock(&state->stats.lock);
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	folioInternalProvider_AcquireN(provider, memory, n);
+
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_AcquireN(&state->stats, n);
 
 	return (void *) memory;
 }
@@ -209,6 +304,21 @@ _length(const FolioMemoryProvider *provider, const void *memory)
 	return folioInternalProvider_Length(provider, memory);
 }
 
+/*
+ * Takes freed memory off the allocation list, using a copy of its debug header
+ */
+static void
+_untrackMemory(DebugState *state, DebugHeader *debugCopy)
+{
+	if (debugCopy->allocListHandle != NULL) {
+		folioInternalList_Lock(state->allocationList);
+		folioInternalList_RemoveAt(state->allocationList, debugCopy->allocListHandle);
+		folioInternalList_Unlock(state->allocationList);
+	}
+
+	longBowBacktrace_Destroy(&debugCopy->backtrace);
+}
+
 static void
 _release(FolioMemoryProvider *provider, void **memoryPtr)
 {
@@ -225,24 +335,74 @@ _release(FolioMemoryProvider *provider, void **memoryPtr)
 
 	bool finalRelease = folioInternalProvider_ReleaseMemory(provider, memoryPtr);
 	if (finalRelease) {
+		_untrackMemory(state, &debugCopy);
+	}
+
+	folioStats_Release(&state->stats, finalRelease);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+
+	// must extract the header before release otherwise it might go away and copy it to local
+	DebugHeader debugCopy = *(DebugHeader *) folioInternalProvider_GetProviderHeader(provider, *memoryPtr);
+
+	bool finalRelease = folioInternalProvider_ReleaseMemoryN(provider, memoryPtr, n);
+	if (finalRelease) {
+		_untrackMemory(state, &debugCopy);
+	}
 
-		if (debugCopy.allocListHandle != NULL) {
-			folioInternalList_Lock(state->allocationList);
-			folioInternalList_RemoveAt(state->allocationList, debugCopy.allocListHandle);
-			folioInternalList_Unlock(state->allocationList);
+	folioStats_ReleaseBatch(&state->stats, n, finalRelease ? 1 : 0);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
+{
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
+
+	size_t finalReleases = 0;
+	for (size_t start = 0; start < count; start += ReleaseBatchChunk) {
+		size_t chunk = count - start < ReleaseBatchChunk ? count - start : ReleaseBatchChunk;
+
+		// must copy the headers before the release, as it may free them
+		DebugHeader debugCopy[ReleaseBatchChunk];
+		bool finalRelease[ReleaseBatchChunk];
+		for (size_t i = 0; i < chunk; ++i) {
+			assertNotNull(memoryArray[start + i], "memoryArray[%zu] must be non-null", start + i);
+			debugCopy[i] = *(DebugHeader *) folioInternalProvider_GetProviderHeader(provider, memoryArray[start + i]);
 		}
 
-		longBowBacktrace_Destroy(&debugCopy.backtrace);
+		finalReleases += folioInternalProvider_ReleaseBatch(provider, &memoryArray[start], chunk, finalRelease);
+
+		folioInternalList_Lock(state->allocationList);
+		for (size_t i = 0; i < chunk; ++i) {
+			if (finalRelease[i] && debugCopy[i].allocListHandle != NULL) {
+				folioInternalList_RemoveAt(state->allocationList, debugCopy[i].allocListHandle);
+			}
+		}
+		folioInternalList_Unlock(state->allocationList);
 
-		folioLock_FlagLock(&state->stats.lock);
-		state->stats.outstandingAcquires--;
-		state->stats.outstandingAllocs--;
-		folioLock_FlagUnlock(&state->stats.lock);
+		for (size_t i = 0; i < chunk; ++i) {
+			if (finalRelease[i]) {
+				longBowBacktrace_Destroy(&debugCopy[i].backtrace);
+			}
+		}
+	}
 
-	} else {
-		folioLock_FlagLock(&state->stats.lock);
-		state->stats.outstandingAcquires--;
-		folioLock_FlagUnlock(&state->stats.lock);
+	folioStats_ReleaseBatch(&state->stats, count, finalReleases);
+	if (finalReleases > 0) {
+		folioInternalProvider_Unhold(provider, finalReleases);
 	}
 }
 
@@ -251,16 +411,16 @@ _report(const FolioMemoryProvider *provider, FILE *stream)
 {
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
 
-	Stats copy;
-
-	folioLock_FlagLock(&state->stats.lock);
-	memcpy(&copy, &state->stats, sizeof(Stats));
-	folioLock_FlagUnlock(&state->stats.lock);
+	FolioStatsSnapshot copy;
+	folioStats_Sum(&state->stats, &copy);
 
-	fprintf(stream, "\nMemoryDebugAlloc: outstanding allocs %zu acquires %zu, currentAllocation %zu\n\n",
+	fprintf(stream, "\nMemoryDebugAlloc: outstanding allocs %zu acquires %zu, currentAllocation %zu, outOfMemory %zu\n",
 			copy.outstandingAllocs,
 			copy.outstandingAcquires,
-			folioInternalProvider_AllocationSize(provider));
+			folioInternalProvider_AllocationSize(provider),
+			copy.outOfMemoryCount);
+	folioStats_ReportThreads(&state->stats, stream);
+	fprintf(stream, "\n");
 }
 
 static void
@@ -269,15 +429,32 @@ _setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
 	folioInternalProvider_SetAvailableMemory(provider, availableMemory);
 }
 
+static size_t
+_reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags)
+{
+	return folioInternalProvider_ReserveBlocks(provider, bytes, sizeClassHints, flags);
+}
+
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	return folioInternalProvider_Scavenge(provider, budget);
+}
+
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	FolioMemoryProvider *child = folioDebugProvider_Create(limit);
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
 static size_t
 _acquireCount(const FolioMemoryProvider *provider)
 {
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(provider);
 
-	folioLock_FlagLock(&state->stats.lock);
-	size_t count = state->stats.outstandingAcquires;
-	folioLock_FlagUnlock(&state->stats.lock);
-	return count;
+	return folioStats_OutstandingAcquires(&state->stats);
 }
 
 static size_t
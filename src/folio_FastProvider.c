@@ -0,0 +1,604 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LongBow/runtime.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <Folio/folio_FastProvider.h>
+#include <Folio/private/folio_Stats.h>
+#include <Folio/private/folio_InternalProvider.h>
+#include <Folio/private/folio_Pool.h>
+
+static FolioMemoryProvider *_acquireProvider(const FolioMemoryProvider *provider);
+static bool _releaseProvider(FolioMemoryProvider **providerPtr);
+
+static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
+static void * _acquire(FolioMemoryProvider *provider, const void *memory);
+static size_t _length(const FolioMemoryProvider *provider, const void *memory);
+static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+static void _report(const FolioMemoryProvider *provider, FILE *stream);
+static void _display(const FolioMemoryProvider *provider, const void *memory, FILE *stream);
+static void _validate(const FolioMemoryProvider *provider, const void *memory);
+static size_t _acquireCount(const FolioMemoryProvider *provider);
+static size_t _allocationSize(const FolioMemoryProvider *provider);
+static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
+
+static void _lock(FolioMemoryProvider *provider, void *memory);
+static void _unlock(FolioMemoryProvider *provider, void *memory);
+
+/*
+ * The FolioFastProvider uses the FolioPool of the internal provider for the
+ * memory limits and accounting, but not its block layout.  Each block is a
+ * FastHeader immediately followed by the user memory:
+ *
+ * +------------------+
+ * | FastHeader       |  32 bytes
+ * +------------------+
+ * | user memory      |  <-- returned pointer
+ * +------------------+
+ *
+ * Aligned memory comes from posix_memalign() with `alignment` bytes in front of
+ * the user memory.  The size_t before the FastHeader is the offset back to the
+ * start of the block.
+ */
+typedef struct fast_header {
+	// The low 28 bits are the reference count.  The high bit is the lock
+	// bit of folioMemoryProvider_Lock(), so it does not need its own word.
+	// The next bit marks aligned memory, and the two below it hold the
+	// FolioPriority class the length is counted in.
+	atomic_uint_least32_t state;
+
+	// The requested allocation length
+	uint32_t length;
+
+	Finalizer fini;
+
+	// Pads the header to a multiple of 16 bytes, so the user memory keeps malloc()'s alignment
+	uint64_t spare;
+
+	// Last, right before the user memory, like the header of the other providers
+	FolioOwner owner;
+} FastHeader;
+
+// The alignment of malloc() memory
+#define MallocAlignment (2 * sizeof(void *))
+
+#define LockBit 0x80000000UL
+#define AlignedBit 0x40000000UL
+#define PriorityShift 28
+#define PriorityMask (3UL << PriorityShift)
+#define ReferenceMask ((1UL << PriorityShift) - 1)
+
+const FolioMemoryProvider FolioFastProviderTemplate = {
+	.acquireProvider = _acquireProvider,
+	.releaseProvider = _releaseProvider,
+	.allocate = _allocate,
+	.allocateAndZero = _allocateAndZero,
+	.allocateAligned = _allocateAligned,
+	.allocateBatch = _allocateBatch,
+	.allocateWait = _allocateWait,
+	.reallocate = _reallocate,
+	.acquire = _acquire,
+	.length = _length,
+	.release = _release,
+	.releaseBatch = _releaseBatch,
+	.acquireN = _acquireN,
+	.releaseN = _releaseN,
+	// Nothing is checked anyway
+	.acquireUnchecked = _acquire,
+	.releaseUnchecked = _release,
+	.report = _report,
+	.display = _display,
+	.validate = _validate,
+	.acquireCount = _acquireCount,
+	.allocationSize = _allocationSize,
+	.setAvailableMemory = _setAvailableMemory,
+	.reserve = _reserve,
+	.scavenge = _scavenge,
+	.createChild = _createChild,
+	.lock = _lock,
+	.unlock = _unlock,
+	.poolState = NULL,
+};
+
+/* ********************************************************** */
+
+/*
+ * Same as folioInternalProvider_GetProviderState(), but without checking the pool
+ */
+static inline FolioStats *
+_getStats(const FolioMemoryProvider *provider)
+{
+	return (FolioStats *) ((uint8_t *) provider->poolState + sizeof(FolioPool));
+}
+
+static inline FastHeader *
+_getHeader(const void *memory)
+{
+	return (FastHeader *) memory - 1;
+}
+
+/*
+ * The start of the block that was returned by malloc() or posix_memalign()
+ */
+static inline void *
+_getBlock(FastHeader *header)
+{
+	if (atomic_load_explicit(&header->state, memory_order_relaxed) & AlignedBit) {
+		return (uint8_t *) header - ((size_t *) header)[-1];
+	}
+	return header;
+}
+
+static inline unsigned
+_getPriority(FastHeader *header)
+{
+	return (unsigned) ((atomic_load_explicit(&header->state, memory_order_relaxed) & PriorityMask) >> PriorityShift);
+}
+
+/*
+ * @return The user memory in a new aligned block, or NULL if out of memory
+ */
+static void *
+_allocateAlignedBlock(size_t length, size_t alignment, unsigned priority, FolioOwner owner)
+{
+	void *user = NULL;
+	void *block;
+	if (posix_memalign(&block, alignment, alignment + length) == 0) {
+		user = (uint8_t *) block + alignment;
+		FastHeader *header = _getHeader(user);
+		((size_t *) header)[-1] = (uint8_t *) header - (uint8_t *) block;
+		atomic_init(&header->state, 1 | AlignedBit | (priority << PriorityShift));
+		header->owner = owner;
+	}
+	return user;
+}
+
+FolioMemoryProvider *
+folioFastProvider_Create(size_t poolSize)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&FolioFastProviderTemplate, poolSize, sizeof(FolioStats), 0);
+	return provider;
+}
+
+static FolioMemoryProvider *
+_acquireProvider(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AcquireProvider(provider);
+}
+
+static bool
+_releaseProvider(FolioMemoryProvider **providerPtr)
+{
+	return folioInternalProvider_ReleaseProvider(providerPtr);
+}
+
+/*
+ * Fills in the header of a new block with one reference
+ */
+static void *
+_initializeHeader(FolioMemoryProvider *provider, FastHeader *header, size_t length, Finalizer fini, unsigned priority)
+{
+	atomic_init(&header->state, 1 | (priority << PriorityShift));
+	header->length = (uint32_t) length;
+	header->fini = fini;
+	header->owner = folioPool_Owner((FolioPool *) provider->poolState, provider);
+	return header + 1;
+}
+
+/*
+ * @param zero If true, use calloc(), which skips clearing chunks that come fresh from the kernel
+ * @param timeoutMilliseconds If not 0, how long to wait for room in the pool
+ */
+static void *
+_allocateMemory(FolioMemoryProvider *provider, const size_t length, Finalizer fini, bool zero, unsigned timeoutMilliseconds)
+{
+	void *user = NULL;
+	unsigned priority = folioInternalProvider_GetThreadPriority();
+
+	bool reserved = false;
+	if (length <= UINT32_MAX) {
+		if (timeoutMilliseconds == 0) {
+			reserved = folioInternalProvider_Reserve(provider, priority, length);
+		} else {
+			reserved = folioInternalProvider_ReserveWait(provider, priority, length, timeoutMilliseconds);
+		}
+	}
+
+	if (reserved) {
+		FastHeader *header = zero ? calloc(1, sizeof(FastHeader) + length) : malloc(sizeof(FastHeader) + length);
+		if (header != NULL) {
+			user = _initializeHeader(provider, header, length, fini, priority);
+			folioInternalProvider_Hold(provider, 1);
+		} else {
+			folioInternalProvider_Unreserve(provider, priority, length);
+		}
+	}
+
+	folioStats_Allocate(_getStats(provider), user != NULL);
+	return user;
+}
+
+static void *
+_allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	return _allocateMemory(provider, length, fini, false, 0);
+}
+
+static void *
+_allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	return _allocateMemory(provider, length, fini, true, 0);
+}
+
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	trapIllegalValueIf(alignment == 0 || (alignment & (alignment - 1)) != 0, "alignment %zu must be a power of 2", alignment);
+
+	// malloc() memory is already aligned, and the header keeps it
+	if (alignment <= MallocAlignment) {
+		return _allocate(provider, length, fini);
+	}
+
+	void *user = NULL;
+	unsigned priority = folioInternalProvider_GetThreadPriority();
+
+	// The block offset needs its own room in front of the header
+	while (alignment < sizeof(FastHeader) + sizeof(size_t)) {
+		alignment *= 2;
+	}
+
+	if (length <= UINT32_MAX && folioInternalProvider_Reserve(provider, priority, length)) {
+		user = _allocateAlignedBlock(length, alignment, priority, folioPool_Owner((FolioPool *) provider->poolState, provider));
+		if (user != NULL) {
+			FastHeader *header = _getHeader(user);
+			header->length = (uint32_t) length;
+			header->fini = fini;
+			folioInternalProvider_Hold(provider, 1);
+		} else {
+			folioInternalProvider_Unreserve(provider, priority, length);
+		}
+	}
+
+	folioStats_Allocate(_getStats(provider), user != NULL);
+	return user;
+}
+
+/*
+ * One reservation for the whole batch, as in folioInternalProvider_AllocateBatch()
+ */
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	assertNotNull(out, "out must be non-null");
+
+	size_t allocated = 0;
+	unsigned priority = folioInternalProvider_GetThreadPriority();
+
+	if (length <= UINT32_MAX && (count == 0 || length <= SIZE_MAX / count)
+			&& folioInternalProvider_Reserve(provider, priority, count * length)) {
+		while (allocated < count) {
+			FastHeader *header = malloc(sizeof(FastHeader) + length);
+			if (header == NULL) {
+				break;
+			}
+			out[allocated++] = _initializeHeader(provider, header, length, fini, priority);
+		}
+
+		if (allocated < count) {
+			// malloc() ran out of memory, so give back the rest of the reservation
+			folioInternalProvider_Unreserve(provider, priority, (count - allocated) * length);
+		}
+		if (allocated > 0) {
+			folioInternalProvider_Hold(provider, allocated);
+		}
+	}
+
+	for (size_t i = allocated; i < count; ++i) {
+		out[i] = NULL;
+	}
+
+	folioStats_AllocateBatch(_getStats(provider), allocated, count - allocated);
+	return allocated;
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	return _allocateMemory(provider, length, fini, false, timeoutMilliseconds);
+}
+
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	FastHeader *header = _getHeader(*memoryPtr);
+	void *user = NULL;
+
+	if ((atomic_load(&header->state) & ReferenceMask) == 1 && newLength <= UINT32_MAX) {
+		size_t length = header->length;
+		unsigned priority = _getPriority(header);
+
+		bool memoryIsAvailable = true;
+		if (newLength > length) {
+			memoryIsAvailable = folioInternalProvider_Reserve(provider, priority, newLength - length);
+		}
+
+		if (memoryIsAvailable) {
+			FastHeader *newHeader;
+			if (atomic_load(&header->state) & AlignedBit) {
+				// realloc() does not keep the alignment, so it is always a copy
+				size_t alignment = (uint8_t *) (header + 1) - (uint8_t *) _getBlock(header);
+				newHeader = NULL;
+				void *newUser = _allocateAlignedBlock(newLength, alignment, priority, header->owner);
+				if (newUser != NULL) {
+					newHeader = _getHeader(newUser);
+					newHeader->fini = header->fini;
+					memcpy(newUser, header + 1, length < newLength ? length : newLength);
+					free(_getBlock(header));
+				}
+			} else {
+				newHeader = realloc(header, sizeof(FastHeader) + newLength);
+			}
+
+			if (newHeader != NULL) {
+				if (newLength < length) {
+					folioInternalProvider_Unreserve(provider, priority, length - newLength);
+				}
+				newHeader->length = (uint32_t) newLength;
+				user = newHeader + 1;
+				*memoryPtr = user;
+			} else if (newLength > length) {
+				folioInternalProvider_Unreserve(provider, priority, newLength - length);
+			}
+		}
+	}
+
+	return user;
+}
+
+static void
+_validate(const FolioMemoryProvider *provider, const void *memory)
+{
+	// The owner and the reference count are the only things we have to check
+	const FastHeader *header = _getHeader(memory);
+	trapUnexpectedStateIf(header->owner.magic != ((FolioPool *) provider->poolState)->headerMagic,
+			"Memory: invalid owner (memory underrun)");
+
+	uint32_t refcount = atomic_load(&((FastHeader *) header)->state) & ReferenceMask;
+	trapUnexpectedStateIf(refcount == 0, "Memory: refcount is zero");
+}
+
+static void *
+_acquire(FolioMemoryProvider *provider, const void *memory)
+{
+	FastHeader *header = _getHeader(memory);
+	atomic_fetch_add_explicit(&header->state, 1, memory_order_relaxed);
+
+	folioStats_Acquire(_getStats(provider));
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	trapIllegalValueIf(n < 1 || n > ReferenceMask, "Invalid number of references %u", n);
+
+	FastHeader *header = _getHeader(memory);
+	atomic_fetch_add_explicit(&header->state, n, memory_order_relaxed);
+
+	folioStats_AcquireN(_getStats(provider), n);
+	return (void *) memory;
+}
+
+static size_t
+_length(const FolioMemoryProvider *provider __attribute__((unused)), const void *memory)
+{
+	return _getHeader(memory)->length;
+}
+
+/*
+ * Finalizes and frees memory with no references left.  The caller drops the block's
+ * hold on the pool when done with the stats.
+ */
+static void
+_destroy(FolioMemoryProvider *provider, FastHeader *header, void *memory)
+{
+	if (header->fini) {
+		header->fini(memory);
+	}
+	folioInternalProvider_Unreserve(provider, _getPriority(header), header->length);
+	free(_getBlock(header));
+}
+
+static void
+_release(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	void *memory = *memoryPtr;
+	FastHeader *header = _getHeader(memory);
+
+	uint32_t prior = atomic_fetch_sub_explicit(&header->state, 1, memory_order_acq_rel);
+	bool finalRelease = (prior & ReferenceMask) == 1;
+	if (finalRelease) {
+		_destroy(provider, header, memory);
+	}
+
+	folioStats_Release(_getStats(provider), finalRelease);
+	*memoryPtr = NULL;
+
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+	trapIllegalValueIf(n < 1 || n > ReferenceMask, "Invalid number of references %u", n);
+
+	void *memory = *memoryPtr;
+	FastHeader *header = _getHeader(memory);
+
+	uint32_t prior = atomic_fetch_sub_explicit(&header->state, n, memory_order_acq_rel);
+	bool finalRelease = (prior & ReferenceMask) == n;
+	if (finalRelease) {
+		_destroy(provider, header, memory);
+	}
+
+	folioStats_ReleaseBatch(_getStats(provider), n, finalRelease ? 1 : 0);
+	*memoryPtr = NULL;
+
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		_release(provider, &memoryArray[i]);
+	}
+}
+
+static void
+_report(const FolioMemoryProvider *provider, FILE *stream)
+{
+	FolioStats *stats = _getStats(provider);
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(stats, &copy);
+
+	fprintf(stream, "\nFolioFastProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu, outOfMemory %zu, header %zu bytes\n",
+			copy.outstandingAllocs,
+			copy.outstandingAcquires,
+			_allocationSize(provider),
+			copy.outOfMemoryCount,
+			sizeof(FastHeader));
+	folioStats_ReportThreads(stats, stream);
+	fprintf(stream, "\n");
+
+	folioInternalProvider_Report(provider, stream);
+}
+
+static void
+_display(const FolioMemoryProvider *provider __attribute__((unused)), const void *memory, FILE *stream)
+{
+	FastHeader *header = _getHeader(memory);
+	uint32_t state = atomic_load(&header->state);
+	fprintf(stream, "FastHeader %p: refcount %u locked %d aligned %d length %u fini %p\n",
+			(void *) header,
+			(unsigned) (state & ReferenceMask),
+			(state & LockBit) != 0,
+			(state & AlignedBit) != 0,
+			header->length,
+			(void *) header->fini);
+}
+
+static void
+_setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
+{
+	folioInternalProvider_SetAvailableMemory(provider, availableMemory);
+}
+
+/*
+ * Blocks come straight from malloc(), there is nothing to reserve
+ */
+static size_t
+_reserve(FolioMemoryProvider *provider __attribute__((unused)), size_t bytes __attribute__((unused)),
+		const size_t *sizeClassHints __attribute__((unused)), unsigned flags __attribute__((unused)))
+{
+	return 0;
+}
+
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	return folioInternalProvider_Scavenge(provider, budget);
+}
+
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	FolioMemoryProvider *child = folioFastProvider_Create(limit);
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
+static size_t
+_acquireCount(const FolioMemoryProvider *provider)
+{
+	return folioStats_OutstandingAcquires(_getStats(provider));
+}
+
+static size_t
+_allocationSize(const FolioMemoryProvider *provider)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	return (size_t) atomic_load(&pool->currentAllocation);
+}
+
+static void
+_lock(FolioMemoryProvider *provider __attribute__((unused)), void *memory)
+{
+	FastHeader *header = _getHeader(memory);
+
+	// spin until the prior value did not have the lock bit
+	uint32_t prior;
+	do {
+		prior = atomic_fetch_or_explicit(&header->state, LockBit, memory_order_acquire);
+	} while (prior & LockBit);
+}
+
+static void
+_unlock(FolioMemoryProvider *provider __attribute__((unused)), void *memory)
+{
+	FastHeader *header = _getHeader(memory);
+	atomic_fetch_and_explicit(&header->state, ~LockBit, memory_order_release);
+}
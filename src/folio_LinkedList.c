@@ -47,7 +47,11 @@ static void
 _entryFinalize(void *memory)
 {
 	Entry *entry = memory;
-	folio_Release(&entry->data);
+
+	// NULL if the data was moved out by folioLinkedList_Remove()
+	if (entry->data != NULL) {
+		folio_Release(&entry->data);
+	}
 }
 
 Entry *
@@ -140,7 +144,8 @@ folioLinkedList_Remove(FolioLinkedList *list)
 			list->tail = NULL;
 		}
 
-		data = folio_Acquire(entry_GetData(entry));
+		// Move the entry's reference to the caller rather than acquire a new one
+		data = folio_Steal(&entry->data);
 		entry_Release(&entry);
 	}
 	folio_Unlock(list);
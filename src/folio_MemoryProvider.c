@@ -26,6 +26,8 @@
 
 #include <LongBow/runtime.h>
 #include <Folio/folio_MemoryProvider.h>
+#include <Folio/private/folio_InternalProvider.h>
+#include <Folio/private/folio_Pool.h>
 #include <stdarg.h>
 
 
@@ -38,6 +40,101 @@ folioMemoryProvider_ReleaseProvider(FolioMemoryProvider **providerPtr)
 	return (*providerPtr)->releaseProvider(providerPtr);
 }
 
+void
+folioMemoryProvider_SetSoftLimit(FolioMemoryProvider *provider, size_t bytes, FolioSoftLimitCallback callback)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetSoftLimit(provider, bytes, callback);
+}
+
+size_t
+folioMemoryProvider_SoftLimitCount(const FolioMemoryProvider *provider)
+{
+	assertNotNull(provider, "provider must be non-null");
+	return folioInternalProvider_SoftLimitCount(provider);
+}
+
+void
+folioMemoryProvider_SetValidationLevel(FolioMemoryProvider *provider, FolioValidationLevel level, unsigned sampleInterval)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetValidationLevel(provider, level, sampleInterval);
+}
+
+FolioValidationLevel
+folioMemoryProvider_GetValidationLevel(const FolioMemoryProvider *provider)
+{
+	assertNotNull(provider, "provider must be non-null");
+	return folioInternalProvider_GetValidationLevel(provider);
+}
+
+void
+folioMemoryProvider_SetLargeObjectThreshold(FolioMemoryProvider *provider, size_t bytes)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetLargeObjectThreshold(provider, bytes);
+}
+
+void
+folioMemoryProvider_SetScavengePolicy(FolioMemoryProvider *provider, size_t retainBytes, unsigned decayPercent)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetScavengePolicy(provider, retainBytes, decayPercent);
+}
+
+bool
+folioMemoryProvider_RegisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context, unsigned priority)
+{
+	assertNotNull(provider, "provider must be non-null");
+	assertNotNull(callback, "callback must be non-null");
+	return folioInternalProvider_RegisterReclaimer(provider, callback, context, priority);
+}
+
+bool
+folioMemoryProvider_UnregisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context)
+{
+	assertNotNull(provider, "provider must be non-null");
+	return folioInternalProvider_UnregisterReclaimer(provider, callback, context);
+}
+
+void
+folioMemoryProvider_SetReclaimInterval(FolioMemoryProvider *provider, unsigned milliseconds)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetReclaimInterval(provider, milliseconds);
+}
+
+void
+folioMemoryProvider_SetPriorityClass(FolioMemoryProvider *provider, FolioPriority priority, size_t reserveBytes, size_t capBytes)
+{
+	assertNotNull(provider, "provider must be non-null");
+	folioInternalProvider_SetPriorityClass(provider, priority, reserveBytes, capBytes);
+}
+
+FolioPriority
+folioMemoryProvider_SetThreadPriority(FolioPriority priority)
+{
+	return folioInternalProvider_SetThreadPriority(priority);
+}
+
+void *
+folioMemoryProvider_AllocateWithPriority(FolioMemoryProvider *provider, const size_t length, Finalizer fini, FolioPriority priority)
+{
+	assertNotNull(provider, "provider must be non-null");
+
+	FolioPriority prior = folioInternalProvider_SetThreadPriority(priority);
+	void *memory = folioMemoryProvider_Allocate(provider, length, fini);
+	folioInternalProvider_SetThreadPriority(prior);
+
+	return memory;
+}
+
+FolioMemoryProvider *
+folioMemoryProvider_GetOwner(const void *memory)
+{
+	return folioPool_GetOwner(memory);
+}
+
 bool
 folioMemoryProvider_TestRefCount(FolioMemoryProvider const *provider, size_t expectedRefCount, FILE *stream, const char *format, ...)
 {
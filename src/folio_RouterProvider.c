@@ -0,0 +1,810 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LongBow/runtime.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <Folio/folio_RouterProvider.h>
+#include <Folio/private/folio_InternalProvider.h>
+#include <Folio/private/folio_Pool.h>
+#include <Folio/private/folio_Stats.h>
+
+static FolioMemoryProvider *_acquireProvider(const FolioMemoryProvider *provider);
+static bool _releaseProvider(FolioMemoryProvider **providerPtr);
+
+static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
+static void * _acquire(FolioMemoryProvider *provider, const void *memory);
+static size_t _length(const FolioMemoryProvider *provider, const void *memory);
+static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+static void * _acquireUnchecked(FolioMemoryProvider *provider, const void *memory);
+static void _releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr);
+static void _report(const FolioMemoryProvider *provider, FILE *stream);
+static void _display(const FolioMemoryProvider *provider, const void *memory, FILE *stream);
+static void _validate(const FolioMemoryProvider *provider, const void *memory);
+static size_t _acquireCount(const FolioMemoryProvider *provider);
+static size_t _allocationSize(const FolioMemoryProvider *provider);
+static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
+
+static void _lock(FolioMemoryProvider *provider, void *memory);
+static void _unlock(FolioMemoryProvider *provider, void *memory);
+
+const FolioMemoryProvider FolioRouterProviderTemplate = {
+	.acquireProvider = _acquireProvider,
+	.releaseProvider = _releaseProvider,
+	.allocate = _allocate,
+	.allocateAndZero = _allocateAndZero,
+	.allocateAligned = _allocateAligned,
+	.allocateBatch = _allocateBatch,
+	.allocateWait = _allocateWait,
+	.reallocate = _reallocate,
+	.acquire = _acquire,
+	.length = _length,
+	.release = _release,
+	.releaseBatch = _releaseBatch,
+	.acquireN = _acquireN,
+	.releaseN = _releaseN,
+	.acquireUnchecked = _acquireUnchecked,
+	.releaseUnchecked = _releaseUnchecked,
+	.report = _report,
+	.display = _display,
+	.validate = _validate,
+	.acquireCount = _acquireCount,
+	.allocationSize = _allocationSize,
+	.setAvailableMemory = _setAvailableMemory,
+	.reserve = _reserve,
+	.scavenge = _scavenge,
+	.createChild = _createChild,
+	.lock = _lock,
+	.unlock = _unlock
+};
+
+/*
+ * Each allocation is a block from the provider of its route:
+ *
+ * +-------------+--------------+------------------+
+ * | (alignment) | RouterPrefix | user memory      |
+ * +-------------+--------------+------------------+
+ * ^ block                      ^ user = block + offset
+ *
+ * The first word of the block is always the offset: it is the prefix's own offset
+ * field, unless an aligned allocation put padding in front of the prefix.  So the
+ * prefix is found from the user memory for a release, and from the block for the
+ * finalizer, which the route's provider calls with the block.  The prefix ends with
+ * the router's owner word, so folio_Release() finds the router.
+ */
+typedef struct router_prefix {
+	uint64_t offset;
+
+	// The provider that owns the block
+	FolioMemoryProvider *provider;
+
+	// The user's finalizer, may be NULL
+	Finalizer fini;
+
+	// The user length, reserved in the router's pool in the priority class
+	uint64_t length;
+	uint32_t priority;
+	uint32_t pad;
+
+	FolioOwner owner;
+} RouterPrefix;
+
+#define PrefixLength sizeof(RouterPrefix)
+
+typedef struct router_route {
+	size_t maximumLength;
+	FolioMemoryProvider *provider;
+	FolioMemoryProvider *fallback;
+
+	// Allocations of the route, and how many of them the fallback took
+	atomic_uint_least64_t allocations;
+	atomic_uint_least64_t fallbacks;
+} RouterRoute;
+
+typedef struct router_state {
+	FolioStats stats;
+
+	// In increasing maximumLength, the last (the default route) is SIZE_MAX
+	unsigned routeCount;
+	RouterRoute routes[FolioRouterMaximumRoutes];
+} RouterState;
+
+/* ********************************************************** */
+
+static FolioMemoryProvider *
+_createRouter(size_t poolSize)
+{
+	FolioMemoryProvider *router = folioInternalProvider_Create(&FolioRouterProviderTemplate, poolSize, sizeof(RouterState), 0);
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(router);
+	memset(state, 0, sizeof(RouterState));
+
+	return router;
+}
+
+static void
+_setRoute(RouterRoute *route, size_t maximumLength, FolioMemoryProvider *provider, FolioMemoryProvider *fallback)
+{
+	route->maximumLength = maximumLength;
+	route->provider = folioMemoryProvider_AcquireProvider(provider);
+	route->fallback = fallback == NULL ? NULL : folioMemoryProvider_AcquireProvider(fallback);
+	atomic_init(&route->allocations, 0);
+	atomic_init(&route->fallbacks, 0);
+}
+
+FolioMemoryProvider *
+folioRouterProvider_Create(size_t poolSize, FolioMemoryProvider *provider, FolioMemoryProvider *fallback)
+{
+	assertNotNull(provider, "provider must be non-null");
+
+	FolioMemoryProvider *router = _createRouter(poolSize);
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(router);
+	_setRoute(&state->routes[0], SIZE_MAX, provider, fallback);
+	state->routeCount = 1;
+
+	return router;
+}
+
+void
+folioRouterProvider_AddRoute(FolioMemoryProvider *router, size_t maximumLength, FolioMemoryProvider *provider,
+		FolioMemoryProvider *fallback)
+{
+	assertNotNull(router, "router must be non-null");
+	assertNotNull(provider, "provider must be non-null");
+	trapIllegalValueIf(maximumLength == SIZE_MAX, "maximumLength SIZE_MAX is the default route");
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(router);
+	trapIllegalValueIf(state->routeCount == FolioRouterMaximumRoutes, "router has the most routes, %d", FolioRouterMaximumRoutes);
+
+	unsigned index = 0;
+	while (state->routes[index].maximumLength < maximumLength) {
+		index++;
+	}
+	trapIllegalValueIf(state->routes[index].maximumLength == maximumLength, "router already has a route of %zu", maximumLength);
+
+	memmove(&state->routes[index + 1], &state->routes[index], (state->routeCount - index) * sizeof(RouterRoute));
+	_setRoute(&state->routes[index], maximumLength, provider, fallback);
+	state->routeCount++;
+}
+
+static RouterRoute *
+_findRoute(RouterState *state, size_t length)
+{
+	unsigned index = 0;
+	while (state->routes[index].maximumLength < length) {
+		index++;
+	}
+	return &state->routes[index];
+}
+
+/*
+ * Calls f on each provider of the routes once, even if it is on several routes
+ */
+static void
+_forEachProvider(RouterState *state, void (*f)(FolioMemoryProvider *provider, void *context), void *context)
+{
+	FolioMemoryProvider *seen[2 * FolioRouterMaximumRoutes];
+	unsigned seenCount = 0;
+
+	for (unsigned i = 0; i < state->routeCount; ++i) {
+		FolioMemoryProvider *providers[2] = { state->routes[i].provider, state->routes[i].fallback };
+		for (unsigned j = 0; j < 2; ++j) {
+			bool found = providers[j] == NULL;
+			for (unsigned k = 0; k < seenCount && !found; ++k) {
+				found = seen[k] == providers[j];
+			}
+			if (!found) {
+				seen[seenCount++] = providers[j];
+				f(providers[j], context);
+			}
+		}
+	}
+}
+
+/* ********************************************************** */
+
+static RouterPrefix *
+_getPrefix(const FolioMemoryProvider *router, const void *memory)
+{
+	trapIllegalValueIf(memory == NULL, "memory must be non-null");
+
+	RouterPrefix *prefix = (RouterPrefix *) ((uint8_t *) memory - PrefixLength);
+	FolioPool *pool = router->poolState;
+	trapUnexpectedStateIf(prefix->owner.magic != pool->headerMagic || prefix->owner.poolId != atomic_load(&pool->poolId),
+			"memory %p is not from router %p (memory underrun)", memory, (void *) router);
+	return prefix;
+}
+
+static void *
+_getBlock(RouterPrefix *prefix)
+{
+	return (uint8_t *) prefix + PrefixLength - prefix->offset;
+}
+
+static void *
+_getUser(RouterPrefix *prefix)
+{
+	return (uint8_t *) prefix + PrefixLength;
+}
+
+/*
+ * The finalizer of every block.  On the final release of the memory, calls the user's
+ * finalizer and gives the memory back to the router's pool, dropping the block's hold on it.
+ */
+static void
+_finalize(void *block)
+{
+	RouterPrefix *prefix = (RouterPrefix *) ((uint8_t *) block + *(uint64_t *) block - PrefixLength);
+
+	if (prefix->fini != NULL) {
+		prefix->fini(_getUser(prefix));
+	}
+
+	FolioMemoryProvider *router = folioPool_GetOwner(_getUser(prefix));
+
+	// _release() counted the release, this counts the end of the allocation
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(router);
+	folioStats_Discard(&state->stats, 1, 0);
+
+	folioInternalProvider_Unreserve(router, prefix->priority, prefix->length);
+	folioInternalProvider_Unhold(router, 1);
+}
+
+static void *
+_allocateBlock(FolioMemoryProvider *provider, size_t totalLength, size_t alignment, bool zero, unsigned timeoutMilliseconds)
+{
+	if (alignment > 0) {
+		return folioMemoryProvider_AllocateAligned(provider, totalLength, alignment, _finalize);
+	}
+	if (zero) {
+		return folioMemoryProvider_AllocateAndZero(provider, totalLength, _finalize);
+	}
+	if (timeoutMilliseconds > 0) {
+		return folioMemoryProvider_AllocateWait(provider, totalLength, _finalize, timeoutMilliseconds);
+	}
+	return folioMemoryProvider_Allocate(provider, totalLength, _finalize);
+}
+
+/*
+ * Fills in the prefix of a block from the owner provider
+ *
+ * @return The user memory
+ */
+static void *
+_initializePrefix(FolioMemoryProvider *router, uint8_t *block, size_t offset, FolioMemoryProvider *owner, Finalizer fini,
+		size_t length, unsigned priority)
+{
+	RouterPrefix *prefix = (RouterPrefix *) (block + offset - PrefixLength);
+	*(uint64_t *) block = offset;
+	prefix->offset = offset;
+	prefix->provider = owner;
+	prefix->fini = fini;
+	prefix->length = length;
+	prefix->priority = priority;
+	prefix->owner = folioPool_Owner(router->poolState, router);
+	return block + offset;
+}
+
+/*
+ * Reserves the length in the router's pool, then allocates it from the route's provider
+ * or, if that has no memory, its fallback.  A wait is only on the router's pool and on
+ * the last provider tried.
+ *
+ * @param alignment The alignment of an aligned allocation, 0 for none
+ */
+static void *
+_allocateRouted(FolioMemoryProvider *router, size_t length, size_t alignment, bool zero, unsigned timeoutMilliseconds, Finalizer fini)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(router);
+
+	size_t offset = PrefixLength;
+	if (alignment > PrefixLength) {
+		offset = alignment;
+	} else if (alignment > 0) {
+		offset = (PrefixLength + alignment - 1) & ~(alignment - 1);
+	}
+
+	unsigned priority = folioInternalProvider_GetThreadPriority();
+	bool reserved = false;
+	if (length <= SIZE_MAX - offset) {
+		if (timeoutMilliseconds > 0) {
+			reserved = folioInternalProvider_ReserveWait(router, priority, length, timeoutMilliseconds);
+		} else {
+			reserved = folioInternalProvider_Reserve(router, priority, length);
+		}
+	}
+
+	uint8_t *block = NULL;
+	if (reserved) {
+		RouterRoute *route = _findRoute(state, length);
+		atomic_fetch_add_explicit(&route->allocations, 1, memory_order_relaxed);
+
+		FolioMemoryProvider *owner = route->provider;
+		block = _allocateBlock(owner, length + offset, alignment, zero, route->fallback == NULL ? timeoutMilliseconds : 0);
+		if (block == NULL && route->fallback != NULL) {
+			atomic_fetch_add_explicit(&route->fallbacks, 1, memory_order_relaxed);
+			owner = route->fallback;
+			block = _allocateBlock(owner, length + offset, alignment, zero, timeoutMilliseconds);
+		}
+
+		if (block != NULL) {
+			_initializePrefix(router, block, offset, owner, fini, length, priority);
+			folioInternalProvider_Hold(router, 1);
+		} else {
+			folioInternalProvider_Unreserve(router, priority, length);
+		}
+	}
+
+	folioStats_Allocate(&state->stats, block != NULL);
+
+	return block == NULL ? NULL : block + offset;
+}
+
+static void *
+_allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	return _allocateRouted(provider, length, 0, false, 0, fini);
+}
+
+static void *
+_allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	return _allocateRouted(provider, length, 0, true, 0, fini);
+}
+
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	trapIllegalValueIf(alignment == 0 || (alignment & (alignment - 1)) != 0, "alignment %zu must be a power of 2", alignment);
+	return _allocateRouted(provider, length, alignment, false, 0, fini);
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	return _allocateRouted(provider, length, 0, false, timeoutMilliseconds, fini);
+}
+
+/*
+ * One reservation in the router's pool for the whole batch, then a batch from the
+ * route's provider and, for what that could not allocate, one from its fallback
+ */
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	assertNotNull(out, "out must be non-null");
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+
+	size_t allocated = 0;
+	unsigned priority = folioInternalProvider_GetThreadPriority();
+
+	if (length <= SIZE_MAX - PrefixLength && (count == 0 || length <= SIZE_MAX / count)
+			&& folioInternalProvider_Reserve(provider, priority, count * length)) {
+		RouterRoute *route = _findRoute(state, length);
+		atomic_fetch_add_explicit(&route->allocations, count, memory_order_relaxed);
+
+		size_t primary = folioMemoryProvider_AllocateBatch(route->provider, count, length + PrefixLength, _finalize, out);
+		allocated = primary;
+		if (allocated < count && route->fallback != NULL) {
+			atomic_fetch_add_explicit(&route->fallbacks, count - allocated, memory_order_relaxed);
+			allocated += folioMemoryProvider_AllocateBatch(route->fallback, count - allocated, length + PrefixLength, _finalize,
+					out + allocated);
+		}
+
+		for (size_t i = 0; i < allocated; ++i) {
+			FolioMemoryProvider *owner = i < primary ? route->provider : route->fallback;
+			out[i] = _initializePrefix(provider, out[i], PrefixLength, owner, fini, length, priority);
+		}
+
+		if (allocated < count) {
+			folioInternalProvider_Unreserve(provider, priority, (count - allocated) * length);
+		}
+		if (allocated > 0) {
+			folioInternalProvider_Hold(provider, allocated);
+		}
+	}
+
+	for (size_t i = allocated; i < count; ++i) {
+		out[i] = NULL;
+	}
+
+	folioStats_AllocateBatch(&state->stats, allocated, count - allocated);
+	return allocated;
+}
+
+/*
+ * The memory stays with the provider that owns it, whatever route the new length
+ * would take.
+ */
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+
+	RouterPrefix *prefix = _getPrefix(provider, *memoryPtr);
+	uint64_t length = prefix->length;
+	uint64_t offset = prefix->offset;
+	unsigned priority = prefix->priority;
+
+	if (newLength > SIZE_MAX - offset) {
+		return NULL;
+	}
+	if (newLength > length && !folioInternalProvider_Reserve(provider, priority, newLength - length)) {
+		return NULL;
+	}
+
+	void *block = _getBlock(prefix);
+	uint8_t *resized = folioMemoryProvider_Reallocate(prefix->provider, &block, newLength + offset);
+	if (resized == NULL) {
+		if (newLength > length) {
+			folioInternalProvider_Unreserve(provider, priority, newLength - length);
+		}
+		return NULL;
+	}
+
+	if (newLength < length) {
+		folioInternalProvider_Unreserve(provider, priority, length - newLength);
+	}
+
+	prefix = (RouterPrefix *) (resized + offset - PrefixLength);
+	prefix->length = newLength;
+
+	*memoryPtr = resized + offset;
+	return *memoryPtr;
+}
+
+static void *
+_acquire(FolioMemoryProvider *provider, const void *memory)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	folioMemoryProvider_Acquire(prefix->provider, _getBlock(prefix));
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	folioMemoryProvider_AcquireN(prefix->provider, _getBlock(prefix), n);
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_AcquireN(&state->stats, n);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireUnchecked(FolioMemoryProvider *provider, const void *memory)
+{
+	RouterPrefix *prefix = (RouterPrefix *) ((uint8_t *) memory - PrefixLength);
+	folioMemoryProvider_AcquireUnchecked(prefix->provider, _getBlock(prefix));
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static size_t
+_length(const FolioMemoryProvider *provider, const void *memory)
+{
+	return _getPrefix(provider, memory)->length;
+}
+
+static void
+_release(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Release(&state->stats, false);
+
+	RouterPrefix *prefix = _getPrefix(provider, *memoryPtr);
+	void *block = _getBlock(prefix);
+	folioMemoryProvider_Release(prefix->provider, &block);
+	*memoryPtr = NULL;
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_ReleaseBatch(&state->stats, n, 0);
+
+	RouterPrefix *prefix = _getPrefix(provider, *memoryPtr);
+	void *block = _getBlock(prefix);
+	folioMemoryProvider_ReleaseN(prefix->provider, &block, n);
+	*memoryPtr = NULL;
+}
+
+static void
+_releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Release(&state->stats, false);
+
+	RouterPrefix *prefix = (RouterPrefix *) ((uint8_t *) *memoryPtr - PrefixLength);
+	void *block = _getBlock(prefix);
+	folioMemoryProvider_ReleaseUnchecked(prefix->provider, &block);
+	*memoryPtr = NULL;
+}
+
+/*
+ * Replaces each memory pointer with its block, and releases each run of blocks with
+ * the same provider as one batch of that provider.
+ */
+static void
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
+{
+	assertNotNull(memoryArray, "memoryArray must be non-null");
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	folioStats_ReleaseBatch(&state->stats, count, 0);
+
+	FolioMemoryProvider *owner = NULL;
+	size_t start = 0;
+	for (size_t i = 0; i < count; ++i) {
+		RouterPrefix *prefix = _getPrefix(provider, memoryArray[i]);
+		if (prefix->provider != owner && i > start) {
+			folioMemoryProvider_ReleaseBatch(owner, &memoryArray[start], i - start);
+			start = i;
+		}
+		owner = prefix->provider;
+		memoryArray[i] = _getBlock(prefix);
+	}
+
+	if (count > start) {
+		folioMemoryProvider_ReleaseBatch(owner, &memoryArray[start], count - start);
+	}
+}
+
+static void
+_lock(FolioMemoryProvider *provider, void *memory)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	folioMemoryProvider_Lock(prefix->provider, _getBlock(prefix));
+}
+
+static void
+_unlock(FolioMemoryProvider *provider, void *memory)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	folioMemoryProvider_Unlock(prefix->provider, _getBlock(prefix));
+}
+
+static void
+_validate(const FolioMemoryProvider *provider, const void *memory)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	trapIllegalValueIf(*(uint64_t *) _getBlock(prefix) != prefix->offset, "memory %p has a corrupt router prefix", memory);
+	folioMemoryProvider_Validate(prefix->provider, _getBlock(prefix));
+}
+
+static void
+_display(const FolioMemoryProvider *provider, const void *memory, FILE *stream)
+{
+	RouterPrefix *prefix = _getPrefix(provider, memory);
+	fprintf(stream, "Router memory %p length %" PRIu64 " priority %u from provider %p block %p (offset %" PRIu64 ")\n",
+			memory, prefix->length, prefix->priority, (void *) prefix->provider, _getBlock(prefix), prefix->offset);
+	folioMemoryProvider_Display(prefix->provider, _getBlock(prefix), stream);
+}
+
+/* ********************************************************** */
+
+static FolioMemoryProvider *
+_acquireProvider(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AcquireProvider(provider);
+}
+
+static bool
+_releaseProvider(FolioMemoryProvider **providerPtr)
+{
+	trapIllegalValueIf(providerPtr == NULL, "providerPtr must be non-null");
+
+	// The routes live in the provider state, so take them before the provider goes away
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(*providerPtr);
+	unsigned routeCount = state->routeCount;
+	RouterRoute routes[FolioRouterMaximumRoutes];
+	memcpy(routes, state->routes, routeCount * sizeof(RouterRoute));
+
+	bool finalRelease = folioInternalProvider_ReleaseProvider(providerPtr);
+	if (finalRelease) {
+		for (unsigned i = 0; i < routeCount; ++i) {
+			folioMemoryProvider_ReleaseProvider(&routes[i].provider);
+			if (routes[i].fallback != NULL) {
+				folioMemoryProvider_ReleaseProvider(&routes[i].fallback);
+			}
+		}
+	}
+
+	return finalRelease;
+}
+
+/*
+ * A child router has the same routes, and its pool is a child of the router's pool
+ */
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+
+	FolioMemoryProvider *child = _createRouter(limit);
+	RouterState *childState = (RouterState *) folioInternalProvider_GetProviderState(child);
+	for (unsigned i = 0; i < state->routeCount; ++i) {
+		_setRoute(&childState->routes[i], state->routes[i].maximumLength, state->routes[i].provider, state->routes[i].fallback);
+	}
+	childState->routeCount = state->routeCount;
+
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
+static void
+_setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
+{
+	folioInternalProvider_SetAvailableMemory(provider, availableMemory);
+}
+
+/*
+ * Each provider that serves one of the hints reserves up to bytes for the hints it serves
+ * (with no hints, only the default route reserves).  The hints are the user lengths, so
+ * the prefix is added for the providers.
+ */
+static size_t
+_reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+
+	if (sizeClassHints == NULL) {
+		RouterRoute *route = &state->routes[state->routeCount - 1];
+		return folioMemoryProvider_Reserve(route->provider, bytes, NULL, flags);
+	}
+
+	size_t hintCount = 0;
+	while (sizeClassHints[hintCount] != 0) {
+		hintCount++;
+	}
+
+	size_t reserved = 0;
+	size_t hints[hintCount + 1];
+	for (unsigned i = 0; i < state->routeCount; ++i) {
+		size_t routeHints = 0;
+		for (size_t j = 0; j < hintCount; ++j) {
+			if (_findRoute(state, sizeClassHints[j]) == &state->routes[i] && sizeClassHints[j] <= SIZE_MAX - PrefixLength) {
+				hints[routeHints++] = sizeClassHints[j] + PrefixLength;
+			}
+		}
+		hints[routeHints] = 0;
+
+		if (routeHints > 0) {
+			reserved += folioMemoryProvider_Reserve(state->routes[i].provider, bytes, hints, flags);
+		}
+	}
+	return reserved;
+}
+
+typedef struct scavenge_context {
+	size_t budget;
+	size_t scavenged;
+} ScavengeContext;
+
+static void
+_scavengeProvider(FolioMemoryProvider *provider, void *context)
+{
+	ScavengeContext *scavenge = context;
+	if (scavenge->scavenged < scavenge->budget) {
+		scavenge->scavenged += folioMemoryProvider_Scavenge(provider, scavenge->budget - scavenge->scavenged);
+	}
+}
+
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+
+	ScavengeContext context = { .budget = budget, .scavenged = 0 };
+	_forEachProvider(state, _scavengeProvider, &context);
+
+	folioInternalProvider_RecordScavenge(provider, context.scavenged);
+	return context.scavenged;
+}
+
+static size_t
+_acquireCount(const FolioMemoryProvider *provider)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+	return folioStats_OutstandingAcquires(&state->stats);
+}
+
+static size_t
+_allocationSize(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AllocationSize(provider);
+}
+
+static void
+_reportProvider(FolioMemoryProvider *provider, void *context)
+{
+	folioMemoryProvider_Report(provider, (FILE *) context);
+}
+
+static void
+_report(const FolioMemoryProvider *provider, FILE *stream)
+{
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(provider);
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(&state->stats, &copy);
+
+	fprintf(stream, "\nFolioRouterProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu, outOfMemory %zu\n",
+			copy.outstandingAllocs,
+			copy.outstandingAcquires,
+			folioInternalProvider_AllocationSize(provider),
+			copy.outOfMemoryCount);
+	for (unsigned i = 0; i < state->routeCount; ++i) {
+		RouterRoute *route = &state->routes[i];
+		if (route->maximumLength == SIZE_MAX) {
+			fprintf(stream, "    default route: provider %p fallback %p", (void *) route->provider, (void *) route->fallback);
+		} else {
+			fprintf(stream, "    route to %zu bytes: provider %p fallback %p", route->maximumLength, (void *) route->provider, (void *) route->fallback);
+		}
+		fprintf(stream, " allocs %" PRIu64 " (%" PRIu64 " to fallback)\n",
+				(uint64_t) atomic_load(&route->allocations), (uint64_t) atomic_load(&route->fallbacks));
+	}
+	folioStats_ReportThreads(&state->stats, stream);
+	fprintf(stream, "\n");
+
+	folioInternalProvider_Report(provider, stream);
+
+	_forEachProvider(state, _reportProvider, stream);
+}
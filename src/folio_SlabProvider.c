@@ -0,0 +1,1128 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LongBow/runtime.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <Folio/folio_SlabProvider.h>
+#include <Folio/private/folio_Lock.h>
+#include <Folio/private/folio_InternalProvider.h>
+#include <Folio/private/folio_Pool.h>
+#include <Folio/private/folio_Header.h>
+#include <Folio/private/folio_Stats.h>
+#include <Folio/private/folio_Zero.h>
+
+static FolioMemoryProvider *_acquireProvider(const FolioMemoryProvider *provider);
+static bool _releaseProvider(FolioMemoryProvider **providerPtr);
+
+static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
+static void * _acquire(FolioMemoryProvider *provider, const void *memory);
+static size_t _length(const FolioMemoryProvider *provider, const void *memory);
+static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+static void * _acquireUnchecked(FolioMemoryProvider *provider, const void *memory);
+static void _releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr);
+static void _report(const FolioMemoryProvider *provider, FILE *stream);
+static void _display(const FolioMemoryProvider *provider, const void *memory, FILE *stream);
+static void _validate(const FolioMemoryProvider *provider, const void *memory);
+static size_t _acquireCount(const FolioMemoryProvider *provider);
+static size_t _allocationSize(const FolioMemoryProvider *provider);
+static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
+
+static void _lock(FolioMemoryProvider *provider, void *memory);
+static void _unlock(FolioMemoryProvider *provider, void *memory);
+
+static void * _slabAllocate(FolioMemoryProvider *provider, size_t totalLength, bool zero);
+static void _slabFree(FolioMemoryProvider *provider, void *block, size_t totalLength);
+static void * _slabReallocate(FolioMemoryProvider *provider, void *block, size_t totalLength, size_t newTotalLength);
+static void _slabDestroy(FolioMemoryProvider *provider);
+static void _destroyThreadCaches(void *unused);
+
+const FolioMemoryProvider FolioSlabProviderTemplate = {
+	.acquireProvider = _acquireProvider,
+	.releaseProvider = _releaseProvider,
+	.allocate = _allocate,
+	.allocateAndZero = _allocateAndZero,
+	.allocateAligned = _allocateAligned,
+	.allocateBatch = _allocateBatch,
+	.allocateWait = _allocateWait,
+	.reallocate = _reallocate,
+	.acquire = _acquire,
+	.length = _length,
+	.release = _release,
+	.releaseBatch = _releaseBatch,
+	.acquireN = _acquireN,
+	.releaseN = _releaseN,
+	.acquireUnchecked = _acquireUnchecked,
+	.releaseUnchecked = _releaseUnchecked,
+	.report = _report,
+	.display = _display,
+	.validate = _validate,
+	.acquireCount = _acquireCount,
+	.allocationSize = _allocationSize,
+	.setAvailableMemory = _setAvailableMemory,
+	.reserve = _reserve,
+	.scavenge = _scavenge,
+	.createChild = _createChild,
+	.lock = _lock,
+	.unlock = _unlock
+};
+
+static const FolioBlockAllocator _slabBlockAllocator = {
+	.allocate = _slabAllocate,
+	.free = _slabFree,
+	.reallocate = _slabReallocate,
+	.destroy = _slabDestroy
+};
+
+/*
+ * Each slab is SlabLength bytes aligned to SlabLength, so the slab of any
+ * block is found by masking the block address.  The first SlabHeaderLength
+ * bytes hold the SlabHeader and blocks are carved from the rest.
+ *
+ * Size classes are the total block length (header + user memory + trailer).
+ * They are multiples of 16 up to 128 bytes, then four classes per power of two
+ * up to MaximumClassLength.
+ *
+ * Each thread keeps a cache of free blocks per size class in front of the
+ * shared class free lists.  A thread only takes a class lock to move a batch of
+ * blocks between its cache and the class, so most allocations and releases
+ * touch no shared cache lines in the slab provider.  A cache holds at most
+ * CacheBytes per class (bounded by CacheMinimumBlocks and CacheMaximumBlocks).
+ */
+#define SlabLength ((size_t) 256 * 1024)
+#define SlabHeaderLength ((size_t) 64)
+#define SmallClassWidth 16
+#define SmallClassCount 8
+#define SmallClassMaximum (SmallClassWidth * SmallClassCount)
+#define MaximumClassLength ((size_t) 32 * 1024)
+#define SizeClassCount (SmallClassCount + 4 * 8)
+#define CacheBytes ((size_t) 64 * 1024)
+#define CacheMinimumBlocks 4
+#define CacheMaximumBlocks 128
+
+typedef struct slab_header {
+	struct slab_header *next;
+	unsigned sizeClass;
+
+	// Carved by _reserve(), so a scavenge keeps it
+	bool reserved;
+
+	// Only used by a scavenge, under the class lock
+	size_t freeBlocks;
+} SlabHeader;
+
+typedef struct slab_class {
+	atomic_flag lock;
+
+	// Intrusive list, the first word of a free block points to the next free block
+	void *freeList;
+
+	// The part of the newest slab not yet handed out
+	uint8_t *carveNext;
+	uint8_t *carveEnd;
+
+	// Blocks not on freeList (in use by the user or held in a thread cache)
+	size_t blocksInUse;
+} SlabClass;
+
+/*
+ * The free blocks a thread holds for one size class.  Uses the same intrusive
+ * list as SlabClass.
+ */
+typedef struct thread_magazine {
+	void *head;
+	unsigned count;
+
+	// The first `fresh` blocks were carved from a new slab, so only their link word is not zero
+	unsigned fresh;
+} ThreadMagazine;
+
+typedef struct thread_cache {
+	// NULL once the provider is destroyed, then the thread frees the cache
+	_Atomic(struct slab_state *) state;
+
+	// All the caches of a provider, so the provider can detach them
+	struct thread_cache *next;
+	struct thread_cache *prev;
+
+	// All the caches of the thread, only used by the thread
+	struct thread_cache *threadNext;
+
+	ThreadMagazine magazines[SizeClassCount];
+} ThreadCache;
+
+typedef struct slab_state {
+	FolioStats stats;
+
+	atomic_flag slabLock;
+	SlabHeader *slabs;
+	size_t slabCount;
+
+	// allocations too large for a size class
+	atomic_size_t largeAllocs;
+
+	// slab bytes carved by _reserve(), and how many of them mlock() locked
+	atomic_size_t reservedBytes;
+	atomic_size_t lockedBytes;
+
+	// slabs unmapped by _scavenge()
+	atomic_size_t scavengedSlabs;
+
+	// protects caches
+	atomic_flag cacheLock;
+	ThreadCache *caches;
+
+	SlabClass classes[SizeClassCount];
+} SlabState;
+
+// One key for all slab providers, so their number is not limited by PTHREAD_KEYS_MAX.
+// Any non-NULL value makes the thread call _destroyThreadCaches() on exit.
+static pthread_once_t _cacheKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t _cacheKey;
+
+// The caches of the calling thread, one per slab provider it used, most recent first
+static __thread ThreadCache *_threadCaches;
+
+/* ********************************************************** */
+
+FolioMemoryProvider *
+folioSlabProvider_Create(size_t poolSize)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&FolioSlabProviderTemplate, poolSize,
+									sizeof(SlabState), 0);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+	memset(state, 0, sizeof(SlabState));
+
+	atomic_flag_clear(&state->slabLock);
+	atomic_flag_clear(&state->cacheLock);
+	for (unsigned i = 0; i < SizeClassCount; ++i) {
+		atomic_flag_clear(&state->classes[i].lock);
+	}
+
+	folioInternalProvider_SetBlockAllocator(provider, &_slabBlockAllocator);
+
+	return provider;
+}
+
+/*
+ * The index of the smallest size class that holds totalLength bytes.
+ *
+ * precondition: 0 < totalLength <= MaximumClassLength
+ */
+static unsigned
+_sizeClassIndex(size_t totalLength)
+{
+	unsigned index;
+	if (totalLength <= SmallClassMaximum) {
+		index = (unsigned) ((totalLength + SmallClassWidth - 1) / SmallClassWidth) - 1;
+	} else {
+		// power is the position of the highest bit of (totalLength - 1), the
+		// four classes above 2^power are spaced 2^(power - 2) apart.
+		size_t n = totalLength - 1;
+		unsigned power = (unsigned) (sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(n));
+		index = SmallClassCount + (power - 7) * 4 + (unsigned) (n >> (power - 2)) - 4;
+	}
+	return index;
+}
+
+/*
+ * The block length of a size class
+ */
+static size_t
+_sizeClassLength(unsigned index)
+{
+	size_t length;
+	if (index < SmallClassCount) {
+		length = (index + 1) * SmallClassWidth;
+	} else {
+		unsigned power = 7 + (index - SmallClassCount) / 4;
+		unsigned step = (index - SmallClassCount) % 4;
+		length = ((size_t) 1 << power) + (step + 1) * ((size_t) 1 << (power - 2));
+	}
+	return length;
+}
+
+/*
+ * Maps a new SlabLength aligned slab and links it in to the provider's slab list.
+ *
+ * @return NULL if the system is out of memory
+ */
+static SlabHeader *
+_createSlab(SlabState *state, unsigned sizeClass)
+{
+	SlabHeader *slab = NULL;
+
+	// Map twice the length so we can trim it to an aligned slab
+	size_t mapLength = 2 * SlabLength;
+	uint8_t *map = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map != MAP_FAILED) {
+		uint8_t *aligned = (uint8_t *) (((uintptr_t) map + SlabLength - 1) & ~(uintptr_t) (SlabLength - 1));
+
+		size_t headTrim = aligned - map;
+		size_t tailTrim = mapLength - headTrim - SlabLength;
+		if (headTrim > 0) {
+			munmap(map, headTrim);
+		}
+		if (tailTrim > 0) {
+			munmap(aligned + SlabLength, tailTrim);
+		}
+
+		slab = (SlabHeader *) aligned;
+		slab->sizeClass = sizeClass;
+
+		folioLock_FlagLock(&state->slabLock);
+		slab->next = state->slabs;
+		state->slabs = slab;
+		state->slabCount++;
+		folioLock_FlagUnlock(&state->slabLock);
+	}
+
+	return slab;
+}
+
+/*
+ * Carves a whole new slab on to the size class free list.  The first block ends up
+ * at the head of the list.
+ */
+static void
+_carveSlab(SlabState *state, unsigned index, SlabHeader *slab)
+{
+	size_t blockLength = _sizeClassLength(index);
+	size_t blockCount = (SlabLength - SlabHeaderLength) / blockLength;
+	SlabClass *class = &state->classes[index];
+
+	uint8_t *first = (uint8_t *) slab + SlabHeaderLength;
+
+	folioLock_FlagLock(&class->lock);
+	for (size_t i = blockCount; i > 0; --i) {
+		void *block = first + (i - 1) * blockLength;
+		*(void **) block = class->freeList;
+		class->freeList = block;
+	}
+	folioLock_FlagUnlock(&class->lock);
+}
+
+#define _slabOf(block) ((SlabHeader *) ((uintptr_t) (block) & ~(uintptr_t) (SlabLength - 1)))
+
+/*
+ * Finds the slabs of a size class with every block on the class free list.  Reserved
+ * slabs and the slab being carved do not count.  If release is true, unlinks at most
+ * limit bytes of them from the free list and the slab list, and unmaps them.
+ *
+ * @return The bytes of such slabs found (release false) or unmapped (release true)
+ */
+static size_t
+_scavengeClass(SlabState *state, unsigned index, size_t limit, bool release)
+{
+	size_t blocksPerSlab = (SlabLength - SlabHeaderLength) / _sizeClassLength(index);
+	SlabClass *class = &state->classes[index];
+
+	folioLock_FlagLock(&class->lock);
+	if (class->freeList == NULL) {
+		folioLock_FlagUnlock(&class->lock);
+		return 0;
+	}
+
+	SlabHeader *carving = class->carveNext != NULL ? (SlabHeader *) (class->carveEnd - SlabLength) : NULL;
+
+	folioLock_FlagLock(&state->slabLock);
+	for (SlabHeader *slab = state->slabs; slab != NULL; slab = slab->next) {
+		if (slab->sizeClass == index) {
+			slab->freeBlocks = 0;
+		}
+	}
+	folioLock_FlagUnlock(&state->slabLock);
+
+	for (void *block = class->freeList; block != NULL; block = *(void **) block) {
+		_slabOf(block)->freeBlocks++;
+	}
+
+	// Pick the idle slabs, marked by freeBlocks of SIZE_MAX
+	size_t bytes = 0;
+	SlabHeader *released = NULL;
+
+	folioLock_FlagLock(&state->slabLock);
+	SlabHeader **previous = &state->slabs;
+	while (*previous != NULL && (!release || bytes + SlabLength <= limit)) {
+		SlabHeader *slab = *previous;
+		if (slab->sizeClass == index && slab->freeBlocks == blocksPerSlab && !slab->reserved && slab != carving) {
+			bytes += SlabLength;
+			if (release) {
+				*previous = slab->next;
+				state->slabCount--;
+				slab->freeBlocks = SIZE_MAX;
+				slab->next = released;
+				released = slab;
+				continue;
+			}
+		}
+		previous = &slab->next;
+	}
+	folioLock_FlagUnlock(&state->slabLock);
+
+	if (released != NULL) {
+		void **link = &class->freeList;
+		while (*link != NULL) {
+			if (_slabOf(*link)->freeBlocks == SIZE_MAX) {
+				*link = *(void **) *link;
+			} else {
+				link = (void **) *link;
+			}
+		}
+	}
+	folioLock_FlagUnlock(&class->lock);
+
+	while (released != NULL) {
+		SlabHeader *next = released->next;
+		munmap(released, SlabLength);
+		atomic_fetch_add(&state->scavengedSlabs, 1);
+		released = next;
+	}
+
+	return bytes;
+}
+
+/*
+ * The number of free blocks a thread may cache for a size class
+ */
+static unsigned
+_cacheLimit(unsigned index)
+{
+	size_t limit = CacheBytes / _sizeClassLength(index);
+	if (limit < CacheMinimumBlocks) {
+		limit = CacheMinimumBlocks;
+	} else if (limit > CacheMaximumBlocks) {
+		limit = CacheMaximumBlocks;
+	}
+	return (unsigned) limit;
+}
+
+/*
+ * Moves up to count blocks from the size class to the magazine.  Takes blocks
+ * from the class free list first, then carves new ones from the slab.
+ *
+ * @return The number of blocks moved, 0 if the system is out of memory
+ */
+static unsigned
+_refillMagazine(SlabState *state, unsigned index, ThreadMagazine *magazine, unsigned count)
+{
+	size_t blockLength = _sizeClassLength(index);
+	SlabClass *class = &state->classes[index];
+	unsigned moved = 0;
+	unsigned carved = 0;
+
+	folioLock_FlagLock(&class->lock);
+	while (moved < count) {
+		void *block = NULL;
+		if (class->freeList != NULL) {
+			block = class->freeList;
+			class->freeList = *(void **) block;
+		} else {
+			if (class->carveNext == NULL || class->carveNext + blockLength > class->carveEnd) {
+				SlabHeader *slab = _createSlab(state, index);
+				if (slab == NULL) {
+					break;
+				}
+				class->carveNext = (uint8_t *) slab + SlabHeaderLength;
+				class->carveEnd = (uint8_t *) slab + SlabLength;
+			}
+
+			block = class->carveNext;
+			class->carveNext += blockLength;
+			carved++;
+		}
+
+		*(void **) block = magazine->head;
+		magazine->head = block;
+		magazine->count++;
+		moved++;
+	}
+	class->blocksInUse += moved;
+	folioLock_FlagUnlock(&class->lock);
+
+	// The carved blocks come after the free list blocks, so they are on top
+	magazine->fresh = magazine->count == moved ? carved : 0;
+
+	return moved;
+}
+
+/*
+ * Moves up to count blocks from the magazine back to the size class free list.
+ */
+static void
+_flushMagazine(SlabState *state, unsigned index, ThreadMagazine *magazine, unsigned count)
+{
+	if (count > magazine->count) {
+		count = magazine->count;
+	}
+
+	if (count > 0) {
+		// Unlink the first count blocks outside the lock
+		void *first = magazine->head;
+		void *last = first;
+		for (unsigned i = 1; i < count; ++i) {
+			last = *(void **) last;
+		}
+		magazine->head = *(void **) last;
+		magazine->count -= count;
+		magazine->fresh = magazine->fresh > count ? magazine->fresh - count : 0;
+
+		SlabClass *class = &state->classes[index];
+
+		folioLock_FlagLock(&class->lock);
+		*(void **) last = class->freeList;
+		class->freeList = first;
+		class->blocksInUse -= count;
+		folioLock_FlagUnlock(&class->lock);
+	}
+}
+
+static void
+_createCacheKey(void)
+{
+	int failure = pthread_key_create(&_cacheKey, _destroyThreadCaches);
+	trapUnexpectedStateIf(failure, "Could not create thread cache key: %d", failure);
+}
+
+/*
+ * Returns the calling thread's cache for the provider and moves it to the front of the
+ * thread's list.  Frees the caches of destroyed providers on the way.
+ *
+ * @return NULL if the thread has no cache for the provider
+ */
+static ThreadCache *
+_findThreadCache(SlabState *state)
+{
+	ThreadCache *cache = _threadCaches;
+	if (cache != NULL && atomic_load_explicit(&cache->state, memory_order_relaxed) == state) {
+		return cache;
+	}
+
+	ThreadCache **link = &_threadCaches;
+	while ((cache = *link) != NULL) {
+		SlabState *owner = atomic_load_explicit(&cache->state, memory_order_acquire);
+		if (owner == NULL) {
+			*link = cache->threadNext;
+			free(cache);
+		} else if (owner == state) {
+			*link = cache->threadNext;
+			cache->threadNext = _threadCaches;
+			_threadCaches = cache;
+			return cache;
+		} else {
+			link = &cache->threadNext;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the calling thread's cache for the provider, creating it on first use.
+ *
+ * @return NULL if out of memory
+ */
+static ThreadCache *
+_getThreadCache(SlabState *state)
+{
+	ThreadCache *cache = _findThreadCache(state);
+	if (cache == NULL) {
+		cache = calloc(1, sizeof(ThreadCache));
+		if (cache != NULL) {
+			atomic_init(&cache->state, state);
+
+			folioLock_FlagLock(&state->cacheLock);
+			cache->next = state->caches;
+			if (state->caches != NULL) {
+				state->caches->prev = cache;
+			}
+			state->caches = cache;
+			folioLock_FlagUnlock(&state->cacheLock);
+
+			if (_threadCaches == NULL) {
+				pthread_once(&_cacheKeyOnce, _createCacheKey);
+				pthread_setspecific(_cacheKey, &_threadCaches);
+			}
+			cache->threadNext = _threadCaches;
+			_threadCaches = cache;
+		}
+	}
+	return cache;
+}
+
+/*
+ * The final release of the provider, before its state is freed
+ */
+static void
+_slabDestroy(FolioMemoryProvider *provider)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	// The cached blocks are in the slabs, so it is enough to detach the caches.  Each
+	// thread frees its own when it next looks for a cache or exits.
+	folioLock_FlagLock(&state->cacheLock);
+	for (ThreadCache *cache = state->caches; cache != NULL; cache = cache->next) {
+		atomic_store_explicit(&cache->state, NULL, memory_order_release);
+	}
+	state->caches = NULL;
+	folioLock_FlagUnlock(&state->cacheLock);
+
+	folioLock_FlagLock(&state->slabLock);
+	SlabHeader *slab = state->slabs;
+	state->slabs = NULL;
+	folioLock_FlagUnlock(&state->slabLock);
+
+	while (slab != NULL) {
+		SlabHeader *next = slab->next;
+		munmap(slab, SlabLength);
+		slab = next;
+	}
+}
+
+/*
+ * Thread exit: return every cached block to its size class, for each provider the
+ * thread used that still exists
+ */
+static void
+_destroyThreadCaches(void *unused __attribute__((unused)))
+{
+	ThreadCache *cache = _threadCaches;
+	_threadCaches = NULL;
+
+	while (cache != NULL) {
+		ThreadCache *next = cache->threadNext;
+
+		SlabState *state = atomic_load_explicit(&cache->state, memory_order_acquire);
+		if (state != NULL) {
+			for (unsigned i = 0; i < SizeClassCount; ++i) {
+				_flushMagazine(state, i, &cache->magazines[i], cache->magazines[i].count);
+			}
+
+			folioLock_FlagLock(&state->cacheLock);
+			if (cache->prev != NULL) {
+				cache->prev->next = cache->next;
+			} else {
+				state->caches = cache->next;
+			}
+			if (cache->next != NULL) {
+				cache->next->prev = cache->prev;
+			}
+			folioLock_FlagUnlock(&state->cacheLock);
+		}
+
+		free(cache);
+		cache = next;
+	}
+}
+
+static void *
+_slabAllocate(FolioMemoryProvider *provider, size_t totalLength, bool zero)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	void *block = NULL;
+
+	if (totalLength <= MaximumClassLength) {
+		unsigned index = _sizeClassIndex(totalLength);
+		ThreadCache *cache = _getThreadCache(state);
+		if (cache != NULL) {
+			ThreadMagazine *magazine = &cache->magazines[index];
+			if (magazine->count == 0) {
+				_refillMagazine(state, index, magazine, _cacheLimit(index) / 2);
+			}
+
+			if (magazine->count > 0) {
+				block = magazine->head;
+				magazine->head = *(void **) block;
+				magazine->count--;
+
+				if (magazine->fresh > 0) {
+					magazine->fresh--;
+					*(void **) block = NULL;
+				} else if (zero) {
+					folioZero_Clear(block, totalLength);
+				}
+			}
+		}
+	} else {
+		block = zero ? calloc(1, totalLength) : malloc(totalLength);
+		if (block != NULL) {
+			atomic_fetch_add_explicit(&state->largeAllocs, 1, memory_order_relaxed);
+		}
+	}
+
+	return block;
+}
+
+static void
+_slabFree(FolioMemoryProvider *provider, void *block, size_t totalLength)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	if (totalLength <= MaximumClassLength) {
+		unsigned index = _sizeClassIndex(totalLength);
+		ThreadCache *cache = _getThreadCache(state);
+		if (cache != NULL) {
+			ThreadMagazine *magazine = &cache->magazines[index];
+			*(void **) block = magazine->head;
+			magazine->head = block;
+			magazine->count++;
+			magazine->fresh = 0;
+
+			unsigned limit = _cacheLimit(index);
+			if (magazine->count > limit) {
+				_flushMagazine(state, index, magazine, limit / 2);
+			}
+		} else {
+			// No cache, so put it straight back in the size class
+			ThreadMagazine single = { .head = block, .count = 1 };
+			*(void **) block = NULL;
+			_flushMagazine(state, index, &single, 1);
+		}
+	} else {
+		atomic_fetch_sub_explicit(&state->largeAllocs, 1, memory_order_relaxed);
+		free(block);
+	}
+}
+
+/*
+ * A block stays in place if the new length is in the same size class, as then
+ * _slabFree() puts it back on the right free list.  Large blocks use realloc().
+ * Anything else moves between a size class and malloc(), which the caller does.
+ */
+static void *
+_slabReallocate(FolioMemoryProvider *provider __attribute__((unused)), void *block, size_t totalLength, size_t newTotalLength)
+{
+	void *newBlock = NULL;
+
+	if (totalLength <= MaximumClassLength) {
+		if (newTotalLength <= MaximumClassLength && _sizeClassIndex(newTotalLength) == _sizeClassIndex(totalLength)) {
+			newBlock = block;
+		}
+	} else if (newTotalLength > MaximumClassLength) {
+		newBlock = realloc(block, newTotalLength);
+	}
+
+	return newBlock;
+}
+
+static FolioMemoryProvider *
+_acquireProvider(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AcquireProvider(provider);
+}
+
+static bool
+_releaseProvider(FolioMemoryProvider **providerPtr)
+{
+	trapIllegalValueIf(providerPtr == NULL, "providerPtr must be non-null");
+
+	// The final release calls _slabDestroy() before the provider state is freed
+	return folioInternalProvider_ReleaseProvider(providerPtr);
+}
+
+static void *
+_allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	void *memory = folioInternalProvider_Allocate(provider, length, fini);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	void *memory = folioInternalProvider_AllocateAndZero(provider, length, fini);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	void *memory = folioInternalProvider_AllocateAligned(provider, length, alignment, fini);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, count, length, fini, out);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_AllocateBatch(&state->stats, allocated, count - allocated);
+
+	return allocated;
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	void *memory = folioInternalProvider_AllocateWait(provider, length, fini, timeoutMilliseconds);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Allocate(&state->stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	return folioInternalProvider_Reallocate(provider, memoryPtr, newLength);
+}
+
+static void
+_validate(const FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_Validate(provider, memory);
+}
+
+static void *
+_acquire(FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_Acquire(provider, memory);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	folioInternalProvider_AcquireN(provider, memory, n);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_AcquireN(&state->stats, n);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireUnchecked(FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_AcquireUnchecked(provider, memory);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Acquire(&state->stats);
+
+	return (void *) memory;
+}
+
+static size_t
+_length(const FolioMemoryProvider *provider, const void *memory)
+{
+	return folioInternalProvider_Length(provider, memory);
+}
+
+static void
+_release(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	bool finalRelease = folioInternalProvider_ReleaseMemory(provider, memoryPtr);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Release(&state->stats, finalRelease);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	bool finalRelease = folioInternalProvider_ReleaseMemoryN(provider, memoryPtr, n);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_ReleaseBatch(&state->stats, n, finalRelease ? 1 : 0);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
+{
+	size_t finalReleases = folioInternalProvider_ReleaseBatch(provider, memoryArray, count, NULL);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_ReleaseBatch(&state->stats, count, finalReleases);
+	if (finalReleases > 0) {
+		folioInternalProvider_Unhold(provider, finalReleases);
+	}
+}
+
+static void
+_releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	bool finalRelease = folioInternalProvider_ReleaseMemoryUnchecked(provider, memoryPtr);
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	folioStats_Release(&state->stats, finalRelease);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_report(const FolioMemoryProvider *provider, FILE *stream)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(&state->stats, &copy);
+
+	folioLock_FlagLock(&state->slabLock);
+	size_t slabCount = state->slabCount;
+	folioLock_FlagUnlock(&state->slabLock);
+
+	size_t cached[SizeClassCount] = { 0 };
+	size_t cacheCount = 0;
+
+	folioLock_FlagLock(&state->cacheLock);
+	for (ThreadCache *cache = state->caches; cache != NULL; cache = cache->next) {
+		cacheCount++;
+		for (unsigned i = 0; i < SizeClassCount; ++i) {
+			cached[i] += cache->magazines[i].count;
+		}
+	}
+	folioLock_FlagUnlock(&state->cacheLock);
+
+	fprintf(stream, "\nFolioSlabProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu, "
+			"slabs %zu (%zu bytes, %zu reserved, %zu locked, %zu scavenged), large allocs %zu, thread caches %zu\n",
+			copy.outstandingAllocs,
+			copy.outstandingAcquires,
+			folioInternalProvider_AllocationSize(provider),
+			slabCount,
+			slabCount * SlabLength,
+			atomic_load(&state->reservedBytes),
+			atomic_load(&state->lockedBytes),
+			atomic_load(&state->scavengedSlabs),
+			atomic_load(&state->largeAllocs),
+			cacheCount);
+	folioStats_ReportThreads(&state->stats, stream);
+
+	for (unsigned i = 0; i < SizeClassCount; ++i) {
+		SlabClass *class = &state->classes[i];
+
+		folioLock_FlagLock(&class->lock);
+		size_t inUse = class->blocksInUse;
+		folioLock_FlagUnlock(&class->lock);
+
+		if (inUse > 0) {
+			fprintf(stream, "    class %2u (%5zu bytes) : %zu blocks in use, %zu in thread caches\n",
+					i, _sizeClassLength(i), inUse > cached[i] ? inUse - cached[i] : 0, cached[i]);
+		}
+	}
+	fprintf(stream, "\n");
+
+	folioInternalProvider_Report(provider, stream);
+}
+
+static void
+_display(const FolioMemoryProvider *provider, const void *memory, FILE *stream)
+{
+	folioInternalProvider_Display(provider, memory, stream);
+}
+
+static void
+_setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
+{
+	folioInternalProvider_SetAvailableMemory(provider, availableMemory);
+}
+
+/*
+ * Splits the bytes between the hinted size classes and carves whole slabs for each on
+ * to the class free lists.  Hints too large for a size class are ignored.
+ */
+static size_t
+_reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags)
+{
+	static const size_t defaultHints[] = { 64, 256, 1024, 4096, 0 };
+	if (sizeClassHints == NULL) {
+		sizeClassHints = defaultHints;
+	}
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	size_t poolSize = (size_t) atomic_load(&folioPool_GetFromProvider(provider)->poolSize);
+	if (bytes > poolSize) {
+		bytes = poolSize;
+	}
+
+	unsigned indexes[SizeClassCount];
+	unsigned indexCount = 0;
+	for (const size_t *hint = sizeClassHints; *hint != 0 && indexCount < SizeClassCount; ++hint) {
+		size_t totalLength = folioInternalProvider_BlockLength(provider, *hint);
+		if (totalLength <= MaximumClassLength) {
+			indexes[indexCount++] = _sizeClassIndex(totalLength);
+		}
+	}
+
+	size_t reserved = 0;
+	size_t locked = 0;
+	if (indexCount > 0) {
+		size_t slabsPerClass = (bytes / indexCount) / SlabLength;
+		for (unsigned i = 0; i < indexCount; ++i) {
+			for (size_t n = 0; n < slabsPerClass; ++n) {
+				SlabHeader *slab = _createSlab(state, indexes[i]);
+				if (slab == NULL) {
+					break;
+				}
+
+				slab->reserved = true;
+				if (folioInternalProvider_Prefault(slab, SlabLength, flags)) {
+					locked += SlabLength;
+				}
+				_carveSlab(state, indexes[i], slab);
+				reserved += SlabLength;
+			}
+		}
+	}
+
+	atomic_fetch_add(&state->reservedBytes, reserved);
+	atomic_fetch_add(&state->lockedBytes, locked);
+	return reserved;
+}
+
+/*
+ * Unmaps slabs whose blocks are all free.  The calling thread's cache goes back to the
+ * size classes first, other threads' caches stay.
+ */
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	ThreadCache *cache = _findThreadCache(state);
+	if (cache != NULL) {
+		for (unsigned i = 0; i < SizeClassCount; ++i) {
+			_flushMagazine(state, i, &cache->magazines[i], cache->magazines[i].count);
+		}
+	}
+
+	size_t idle = 0;
+	for (unsigned i = 0; i < SizeClassCount; ++i) {
+		idle += _scavengeClass(state, i, 0, false);
+	}
+
+	size_t limit = folioInternalProvider_ScavengeLimit(provider, idle, budget);
+
+	// Slabs go back whole, so a policy share of less than a slab rounds up if the budget allows
+	if (limit > 0 && limit < SlabLength && budget >= SlabLength) {
+		limit = SlabLength;
+	}
+
+	size_t scavenged = 0;
+	for (unsigned i = 0; i < SizeClassCount && scavenged < limit; ++i) {
+		scavenged += _scavengeClass(state, i, limit - scavenged, true);
+	}
+
+	folioInternalProvider_RecordScavenge(provider, scavenged);
+	return scavenged;
+}
+
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	FolioMemoryProvider *child = folioSlabProvider_Create(limit);
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
+static size_t
+_acquireCount(const FolioMemoryProvider *provider)
+{
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(provider);
+
+	return folioStats_OutstandingAcquires(&state->stats);
+}
+
+static size_t
+_allocationSize(const FolioMemoryProvider *provider)
+{
+	return folioInternalProvider_AllocationSize(provider);
+}
+
+static void
+_lock(FolioMemoryProvider *provider, void *memory)
+{
+	folioInternalProvider_Lock(provider, memory);
+}
+
+static void
+_unlock(FolioMemoryProvider *provider, void *memory)
+{
+	folioInternalProvider_Unlock(provider, memory);
+}
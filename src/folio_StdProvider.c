@@ -31,7 +31,7 @@
 #include <stdatomic.h>
 
 #include <Folio/folio_StdProvider.h>
-#include <Folio/private/folio_Lock.h>
+#include <Folio/private/folio_Stats.h>
 #include <Folio/private/folio_InternalProvider.h>
 #include <Folio/private/folio_Pool.h>
 #include <Folio/private/folio_Header.h>
@@ -41,36 +41,40 @@ static bool _releaseProvider(FolioMemoryProvider **providerPtr);
 
 static void * _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
 static void * _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini);
+static void * _allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini);
+static size_t _allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out);
+static void * _allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds);
+static void * _reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength);
 static void * _acquire(FolioMemoryProvider *provider, const void *memory);
 static size_t _length(const FolioMemoryProvider *provider, const void *memory);
 static void _release(FolioMemoryProvider *provider, void **memoryPtr);
+static void _releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count);
+static void * _acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n);
+static void _releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n);
+static void * _acquireUnchecked(FolioMemoryProvider *provider, const void *memory);
+static void _releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr);
 static void _report(const FolioMemoryProvider *provider, FILE *stream);
 static void _display(const FolioMemoryProvider *provider, const void *memory, FILE *stream);
 static void _validate(const FolioMemoryProvider *provider, const void *memory);
 static size_t _acquireCount(const FolioMemoryProvider *provider);
 static size_t _allocationSize(const FolioMemoryProvider *provider);
 static void _setAvailableMemory(FolioMemoryProvider *provider, size_t maximum);
+static size_t _reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags);
+static size_t _scavenge(FolioMemoryProvider *provider, size_t budget);
+static FolioMemoryProvider * _createChild(FolioMemoryProvider *provider, size_t limit);
 
 static void _lock(FolioMemoryProvider *provider, void *memory);
 static void _unlock(FolioMemoryProvider *provider, void *memory);
 
-typedef struct stats {
-	atomic_flag lock;
-
-	size_t outstandingAllocs;
-	size_t outstandingAcquires;
-
-	// number of allocations attempted but no memory available
-	size_t outOfMemoryCount;
-} _Stats;
-
 
 /*
  * Our local storage for the static provider
  */
 typedef struct static_storage {
 	FolioPool pool;
-	_Stats stats;
+
+	// zero initialized
+	FolioStats stats;
 } StaticStorage;
 
 // Struct only used to compute its size
@@ -81,11 +85,16 @@ struct complete_provider {
 
 struct aligned_header {
 	FolioHeader dummy1;
+	FolioOwner dummy2;
 } __attribute__((aligned));
 
 #define StdHeaderMagic 0x69493bf8UL
 #define GuardPattern 0xE0
-#define GuardLength (sizeof(struct aligned_header) - sizeof(FolioHeader))
+#define GuardLength (sizeof(struct aligned_header) - sizeof(FolioHeader) - sizeof(FolioOwner))
+
+// A priority class with no reserve and no cap
+#define _unlimitedPriorityClass { .current = ATOMIC_VAR_INIT(0), .reserve = ATOMIC_VAR_INIT(0), \
+		.cap = ATOMIC_VAR_INIT(UINT64_MAX), .denials = ATOMIC_VAR_INIT(0) }
 
 #ifndef FOLIO_UNITTEST
 
@@ -94,23 +103,62 @@ static StaticStorage _storage = {
 		.pool = {
 				.internalMagic1 = _internalMagic,
 				.headerMagic = StdHeaderMagic,
-				.providerStateLength = sizeof(_Stats),
+				.providerStateLength = sizeof(FolioStats),
 				.providerHeaderLength = 0,
 				.headerGuardLength = GuardLength,
 				.headerAlignedLength = sizeof(struct aligned_header),
 				.trailerAlignedLength = sizeof(FolioTrailer),
+				.poolId = ATOMIC_VAR_INIT(0),
 				.guardPattern = GuardPattern,
-				.allocationLock = ATOMIC_FLAG_INIT,
-				.poolSize = SIZE_MAX,
+				.poolSize = ATOMIC_VAR_INIT(SIZE_MAX),
+				.softLimit = ATOMIC_VAR_INIT(UINT64_MAX),
+				.softLimitCount = ATOMIC_VAR_INIT(0),
+				.softLimitCallback = ATOMIC_VAR_INIT(NULL),
+				.validationLevel = ATOMIC_VAR_INIT(FolioValidationLevel_Full),
+				.sampleInterval = ATOMIC_VAR_INIT(0),
+				.largeObjectThreshold = ATOMIC_VAR_INIT(FolioLargeObjectDefaultThreshold),
+				.largeObjectCount = ATOMIC_VAR_INIT(0),
+				.largeObjectBytes = ATOMIC_VAR_INIT(0),
+				.largeObjectTotal = ATOMIC_VAR_INIT(0),
+				.reserve = ATOMIC_VAR_INIT(NULL),
+				.scavengeRetain = ATOMIC_VAR_INIT(0),
+				.scavengeDecayPercent = ATOMIC_VAR_INIT(100),
+				.scavengedBytes = ATOMIC_VAR_INIT(0),
+				.scavengeCount = ATOMIC_VAR_INIT(0),
+				.reclaimLock = ATOMIC_FLAG_INIT,
+				.reclaimerCount = ATOMIC_VAR_INIT(0),
+				.reclaimRunning = ATOMIC_FLAG_INIT,
+				.reclaimInterval = ATOMIC_VAR_INIT((uint64_t) FolioReclaimDefaultInterval * 1000000),
+				.lastReclaim = ATOMIC_VAR_INIT(0),
+				.reclaimCount = ATOMIC_VAR_INIT(0),
+				.reclaimedBytes = ATOMIC_VAR_INIT(0),
+				.reclaimNanos = ATOMIC_VAR_INIT(0),
+				.reclaimMaxNanos = ATOMIC_VAR_INIT(0),
+				.reclaimSkipped = ATOMIC_VAR_INIT(0),
+				.priorityLock = ATOMIC_FLAG_INIT,
+				.priorityLimited = ATOMIC_VAR_INIT(false),
+				.priorityClasses = {
+						_unlimitedPriorityClass, _unlimitedPriorityClass, _unlimitedPriorityClass, _unlimitedPriorityClass
+				},
+				.waitLock = ATOMIC_FLAG_INIT,
+				.waitHead = NULL,
+				.waitTail = NULL,
+				.waiters = ATOMIC_VAR_INIT(0),
+				.maxWaiters = ATOMIC_VAR_INIT(0),
+				.waitCount = ATOMIC_VAR_INIT(0),
+				.waitNanos = ATOMIC_VAR_INIT(0),
+				.waitTimeouts = ATOMIC_VAR_INIT(0),
+				.parent = NULL,
+				.parentChunk = 0,
+				.parentProvider = NULL,
+				.childLock = ATOMIC_FLAG_INIT,
+				.firstChild = NULL,
+				.nextSibling = NULL,
+				.descendantWaiters = ATOMIC_VAR_INIT(0),
 				.currentAllocation = ATOMIC_VAR_INIT(0),
 				.referenceCount = ATOMIC_VAR_INIT(1),
+				.holds = ATOMIC_VAR_INIT(1),
 				.internalMagic2 = _internalMagic
-		},
-		.stats = {
-				.lock = ATOMIC_FLAG_INIT,
-				.outstandingAllocs = 0,
-				.outstandingAcquires = 0,
-				.outOfMemoryCount = 0
 		}
 };
 
@@ -119,15 +167,27 @@ FolioMemoryProvider FolioStdProvider = {
 		.releaseProvider = _releaseProvider,
 		.allocate = _allocate,
 		.allocateAndZero = _allocateAndZero,
+		.allocateAligned = _allocateAligned,
+		.allocateBatch = _allocateBatch,
+		.allocateWait = _allocateWait,
+		.reallocate = _reallocate,
 		.acquire = _acquire,
 		.length = _length,
 		.release = _release,
+		.releaseBatch = _releaseBatch,
+		.acquireN = _acquireN,
+		.releaseN = _releaseN,
+		.acquireUnchecked = _acquireUnchecked,
+		.releaseUnchecked = _releaseUnchecked,
 		.report = _report,
 		.display = _display,
 		.validate = _validate,
 		.acquireCount = _acquireCount,
 		.allocationSize = _allocationSize,
 		.setAvailableMemory = _setAvailableMemory,
+		.reserve = _reserve,
+		.scavenge = _scavenge,
+		.createChild = _createChild,
 		.lock = _lock,
 		.unlock = _unlock,
 		.poolState = &_storage,
@@ -140,23 +200,62 @@ static StaticStorage _TEST_storage = {
 		.pool = {
 				.internalMagic1 = _internalMagic,
 				.headerMagic = StdHeaderMagic,
-				.providerStateLength = sizeof(_Stats),
+				.providerStateLength = sizeof(FolioStats),
 				.providerHeaderLength = 0,
 				.headerGuardLength = GuardLength,
 				.headerAlignedLength = sizeof(struct aligned_header),
 				.trailerAlignedLength = sizeof(FolioTrailer),
+				.poolId = ATOMIC_VAR_INIT(0),
 				.guardPattern = GuardPattern,
-				.allocationLock = ATOMIC_FLAG_INIT,
-				.poolSize = SIZE_MAX,
+				.poolSize = ATOMIC_VAR_INIT(SIZE_MAX),
+				.softLimit = ATOMIC_VAR_INIT(UINT64_MAX),
+				.softLimitCount = ATOMIC_VAR_INIT(0),
+				.softLimitCallback = ATOMIC_VAR_INIT(NULL),
+				.validationLevel = ATOMIC_VAR_INIT(FolioValidationLevel_Full),
+				.sampleInterval = ATOMIC_VAR_INIT(0),
+				.largeObjectThreshold = ATOMIC_VAR_INIT(FolioLargeObjectDefaultThreshold),
+				.largeObjectCount = ATOMIC_VAR_INIT(0),
+				.largeObjectBytes = ATOMIC_VAR_INIT(0),
+				.largeObjectTotal = ATOMIC_VAR_INIT(0),
+				.reserve = ATOMIC_VAR_INIT(NULL),
+				.scavengeRetain = ATOMIC_VAR_INIT(0),
+				.scavengeDecayPercent = ATOMIC_VAR_INIT(100),
+				.scavengedBytes = ATOMIC_VAR_INIT(0),
+				.scavengeCount = ATOMIC_VAR_INIT(0),
+				.reclaimLock = ATOMIC_FLAG_INIT,
+				.reclaimerCount = ATOMIC_VAR_INIT(0),
+				.reclaimRunning = ATOMIC_FLAG_INIT,
+				.reclaimInterval = ATOMIC_VAR_INIT((uint64_t) FolioReclaimDefaultInterval * 1000000),
+				.lastReclaim = ATOMIC_VAR_INIT(0),
+				.reclaimCount = ATOMIC_VAR_INIT(0),
+				.reclaimedBytes = ATOMIC_VAR_INIT(0),
+				.reclaimNanos = ATOMIC_VAR_INIT(0),
+				.reclaimMaxNanos = ATOMIC_VAR_INIT(0),
+				.reclaimSkipped = ATOMIC_VAR_INIT(0),
+				.priorityLock = ATOMIC_FLAG_INIT,
+				.priorityLimited = ATOMIC_VAR_INIT(false),
+				.priorityClasses = {
+						_unlimitedPriorityClass, _unlimitedPriorityClass, _unlimitedPriorityClass, _unlimitedPriorityClass
+				},
+				.waitLock = ATOMIC_FLAG_INIT,
+				.waitHead = NULL,
+				.waitTail = NULL,
+				.waiters = ATOMIC_VAR_INIT(0),
+				.maxWaiters = ATOMIC_VAR_INIT(0),
+				.waitCount = ATOMIC_VAR_INIT(0),
+				.waitNanos = ATOMIC_VAR_INIT(0),
+				.waitTimeouts = ATOMIC_VAR_INIT(0),
+				.parent = NULL,
+				.parentChunk = 0,
+				.parentProvider = NULL,
+				.childLock = ATOMIC_FLAG_INIT,
+				.firstChild = NULL,
+				.nextSibling = NULL,
+				.descendantWaiters = ATOMIC_VAR_INIT(0),
 				.currentAllocation = ATOMIC_VAR_INIT(0),
 				.referenceCount = ATOMIC_VAR_INIT(1),
+				.holds = ATOMIC_VAR_INIT(1),
 				.internalMagic2 = _internalMagic
-		},
-		.stats = {
-				.lock = ATOMIC_FLAG_INIT,
-				.outstandingAllocs = 0,
-				.outstandingAcquires = 0,
-				.outOfMemoryCount = 0
 		}
 };
 
@@ -165,15 +264,27 @@ FolioMemoryProvider _TEST_FolioStdProvider = {
 		.releaseProvider = _releaseProvider,
 		.allocate = _allocate,
 		.allocateAndZero = _allocateAndZero,
+		.allocateAligned = _allocateAligned,
+		.allocateBatch = _allocateBatch,
+		.allocateWait = _allocateWait,
+		.reallocate = _reallocate,
 		.acquire = _acquire,
 		.length = _length,
 		.release = _release,
+		.releaseBatch = _releaseBatch,
+		.acquireN = _acquireN,
+		.releaseN = _releaseN,
+		.acquireUnchecked = _acquireUnchecked,
+		.releaseUnchecked = _releaseUnchecked,
 		.report = _report,
 		.display = _display,
 		.validate = _validate,
 		.acquireCount = _acquireCount,
 		.allocationSize = _allocationSize,
 		.setAvailableMemory = _setAvailableMemory,
+		.reserve = _reserve,
+		.scavenge = _scavenge,
+		.createChild = _createChild,
 		.lock = _lock,
 		.unlock = _unlock,
 		.poolState = &_TEST_storage,
@@ -186,7 +297,7 @@ FolioMemoryProvider _TEST_FolioStdProvider = {
 FolioMemoryProvider *
 folioStdProvider_Create(size_t poolSize)
 {
-	FolioMemoryProvider *pool = folioInternalProvider_Create(&FolioStdProvider, poolSize, sizeof(_Stats), 0);
+	FolioMemoryProvider *pool = folioInternalProvider_Create(&FolioStdProvider, poolSize, sizeof(FolioStats), 0);
 	return pool;
 }
 
@@ -207,16 +318,8 @@ _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 {
 	void *memory = folioInternalProvider_Allocate(provider, length, fini);
 
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(provider);
-
-	folioLock_FlagLock(&stats->lock);
-	if (memory != NULL) {
-		stats->outstandingAcquires++;
-		stats->outstandingAllocs++;
-	} else {
-		stats->outOfMemoryCount++;
-	}
-	folioLock_FlagUnlock(&stats->lock);
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Allocate(stats, memory != NULL);
 
 	return memory;
 }
@@ -224,13 +327,56 @@ _allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 static void *
 _allocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 {
-	void * memory = _allocate(provider, length, fini);
-	if (memory) {
-		memset(memory, 0, length);
-	}
+	void *memory = folioInternalProvider_AllocateAndZero(provider, length, fini);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Allocate(stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_allocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	void *memory = folioInternalProvider_AllocateAligned(provider, length, alignment, fini);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Allocate(stats, memory != NULL);
+
 	return memory;
 }
 
+static size_t
+_allocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
+{
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, count, length, fini, out);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_AllocateBatch(stats, allocated, count - allocated);
+
+	return allocated;
+}
+
+static void *
+_allocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	void *memory = folioInternalProvider_AllocateWait(provider, length, fini, timeoutMilliseconds);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Allocate(stats, memory != NULL);
+
+	return memory;
+}
+
+static void *
+_reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	return folioInternalProvider_Reallocate(provider, memoryPtr, newLength);
+}
+
 static void
 _validate(const FolioMemoryProvider *provider, const void *memory)
 {
@@ -242,11 +388,30 @@ _acquire(FolioMemoryProvider *provider, const void *memory)
 {
 	folioInternalProvider_Acquire(provider, memory);
 
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(provider);
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Acquire(stats);
+
+	return (void *) memory;
+}
+
+static void *
+_acquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	folioInternalProvider_AcquireN(provider, memory, n);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_AcquireN(stats, n);
+
+	return (void *) memory;
+}
 
-	folioLock_FlagLock(&stats->lock);
-	stats->outstandingAcquires++;
-	folioLock_FlagUnlock(&stats->lock);
+static void *
+_acquireUnchecked(FolioMemoryProvider *provider, const void *memory)
+{
+	folioInternalProvider_AcquireUnchecked(provider, memory);
+
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Acquire(stats);
 
 	return (void *) memory;
 }
@@ -265,35 +430,67 @@ _release(FolioMemoryProvider *provider, void **memoryPtr)
 
 	bool finalRelease = folioInternalProvider_ReleaseMemory(provider, memoryPtr);
 
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(provider);
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Release(stats, finalRelease);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_releaseN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	assertNotNull(memoryPtr, "memoryPtr must be non-null");
+	assertNotNull(*memoryPtr, "memoryPtr must dereference to non-null");
+
+	bool finalRelease = folioInternalProvider_ReleaseMemoryN(provider, memoryPtr, n);
 
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_ReleaseBatch(stats, n, finalRelease ? 1 : 0);
 	if (finalRelease) {
-		folioLock_FlagLock(&stats->lock);
-		stats->outstandingAcquires--;
-		stats->outstandingAllocs--;
-		folioLock_FlagUnlock(&stats->lock);
-	} else {
-		folioLock_FlagLock(&stats->lock);
-		stats->outstandingAcquires--;
-		folioLock_FlagUnlock(&stats->lock);
+		folioInternalProvider_Unhold(provider, 1);
 	}
 }
 
 static void
-_report(const FolioMemoryProvider *provider, FILE *stream)
+_releaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count)
 {
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(provider);
+	size_t finalReleases = folioInternalProvider_ReleaseBatch(provider, memoryArray, count, NULL);
 
-	_Stats copy;
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_ReleaseBatch(stats, count, finalReleases);
+	if (finalReleases > 0) {
+		folioInternalProvider_Unhold(provider, finalReleases);
+	}
+}
 
-	folioLock_FlagLock(&stats->lock);
-	memcpy(&copy, stats, sizeof(_Stats));
-	folioLock_FlagUnlock(&stats->lock);
+static void
+_releaseUnchecked(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	bool finalRelease = folioInternalProvider_ReleaseMemoryUnchecked(provider, memoryPtr);
 
-	fprintf(stream, "\nFolioStdProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu\n\n",
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	folioStats_Release(stats, finalRelease);
+	if (finalRelease) {
+		folioInternalProvider_Unhold(provider, 1);
+	}
+}
+
+static void
+_report(const FolioMemoryProvider *provider, FILE *stream)
+{
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(stats, &copy);
+
+	fprintf(stream, "\nFolioStdProvider: outstanding allocs %zu acquires %zu, currentAllocation %zu, outOfMemory %zu\n",
 			copy.outstandingAllocs,
 			copy.outstandingAcquires,
-			folioInternalProvider_AllocationSize(provider));
+			folioInternalProvider_AllocationSize(provider),
+			copy.outOfMemoryCount);
+	folioStats_ReportThreads(stats, stream);
+	fprintf(stream, "\n");
 
 	folioInternalProvider_Report(provider, stream);
 }
@@ -311,14 +508,30 @@ _setAvailableMemory(FolioMemoryProvider *provider, size_t availableMemory)
 }
 
 static size_t
-_acquireCount(const FolioMemoryProvider *provider)
+_reserve(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags)
 {
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(provider);
+	return folioInternalProvider_ReserveBlocks(provider, bytes, sizeClassHints, flags);
+}
 
-	folioLock_FlagLock(&stats->lock);
-	size_t count = stats->outstandingAcquires;
-	folioLock_FlagUnlock(&stats->lock);
-	return count;
+static size_t
+_scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	return folioInternalProvider_Scavenge(provider, budget);
+}
+
+static FolioMemoryProvider *
+_createChild(FolioMemoryProvider *provider, size_t limit)
+{
+	FolioMemoryProvider *child = folioStdProvider_Create(limit);
+	folioInternalProvider_SetParent(child, provider);
+	return child;
+}
+
+static size_t
+_acquireCount(const FolioMemoryProvider *provider)
+{
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(provider);
+	return folioStats_OutstandingAcquires(stats);
 }
 
 static size_t
@@ -41,31 +41,83 @@ folioHeader_GetMemoryHeader(const void *memory, const FolioPool *pool)
 
 
 void
-folioHeader_Initialize(FolioHeader *header, uint32_t magic, size_t requestedLength, const FolioLock *lock,
+folioHeader_Initialize(FolioHeader *header, uint32_t magic, size_t requestedLength,
 		int refCount, size_t providerDataLength, Finalizer fini, size_t headerGuardLength, size_t trailerGuardLength)
 {
 	header->xmagic1 = magic;
 	header->xrequestedLength = requestedLength;
-	header->xlock = folioLock_Acquire(lock);
+	atomic_flag_clear(&header->xspinLock);
+
+	// note that this thread does not really hold the lock, but
+	// we need to initialize it with something and as it is an
+	// opaque value this is all we have.
+	header->xlockingThreadId = pthread_self();
 	header->xreferenceCount = ATOMIC_VAR_INIT(refCount);
 	header->xfini = fini;
 	header->xproviderDataLength = providerDataLength;
 	header->xheaderGuardLength = headerGuardLength;
 	header->xtrailerGuardLength = trailerGuardLength;
+	header->xalignmentShift = 0;
+	header->xlargeObject = false;
+	header->xpriority = 0;
 	header->xmagic2 = magic;
 }
 
+size_t
+folioHeader_GetRequestedLength(const FolioHeader *header)
+{
+	assertNotNull(header, "header must be non-null");
+	return header->xrequestedLength;
+}
+
+unsigned
+folioHeader_GetAlignmentShift(const FolioHeader *header)
+{
+	assertNotNull(header, "header must be non-null");
+	return header->xalignmentShift;
+}
+
 void
-folioHeader_Finalize(FolioHeader *header)
+folioHeader_SetAlignmentShift(FolioHeader *header, unsigned alignmentShift)
 {
-	folioLock_Release(&header->xlock);
+	assertNotNull(header, "header must be non-null");
+	header->xalignmentShift = (uint8_t) alignmentShift;
 }
 
-size_t
-folioHeader_GetRequestedLength(const FolioHeader *header)
+bool
+folioHeader_IsLargeObject(const FolioHeader *header)
 {
 	assertNotNull(header, "header must be non-null");
-	return header->xrequestedLength;
+	return header->xlargeObject;
+}
+
+void
+folioHeader_SetLargeObject(FolioHeader *header, bool largeObject)
+{
+	assertNotNull(header, "header must be non-null");
+	header->xlargeObject = largeObject;
+}
+
+unsigned
+folioHeader_GetPriority(const FolioHeader *header)
+{
+	assertNotNull(header, "header must be non-null");
+	return header->xpriority;
+}
+
+void
+folioHeader_SetPriority(FolioHeader *header, unsigned priority)
+{
+	assertNotNull(header, "header must be non-null");
+	header->xpriority = (uint8_t) priority;
+}
+
+void
+folioHeader_SetRequestedLength(FolioHeader *header, size_t requestedLength, size_t trailerGuardLength)
+{
+	assertNotNull(header, "header must be non-null");
+	header->xrequestedLength = requestedLength;
+	header->xtrailerGuardLength = trailerGuardLength;
 }
 
 Finalizer
@@ -86,14 +138,19 @@ void
 folioHeader_Lock(FolioHeader *header)
 {
 	assertNotNull(header, "header must be non-null");
-	folioLock_Lock(header->xlock);
+	folioLock_FlagLock(&header->xspinLock);
+	header->xlockingThreadId = pthread_self();
 }
 
 void
 folioHeader_Unlock(FolioHeader *header)
 {
 	assertNotNull(header, "header must be non-null");
-	folioLock_Unlock(header->xlock);
+	if (pthread_equal(pthread_self(), header->xlockingThreadId)) {
+		folioLock_FlagUnlock(&header->xspinLock);
+	} else {
+		trapCannotObtainLock("Caller thread id not equal to locker thread id");
+	}
 }
 
 int
@@ -131,6 +188,27 @@ folioHeader_DecrementReferenceCount(FolioHeader *header)
 	return atomic_fetch_sub_explicit(&header->xreferenceCount, 1, memory_order_relaxed);
 }
 
+int
+folioHeader_AddReferenceCount(FolioHeader *header, int n)
+{
+	assertNotNull(header, "header must be non-null");
+	return atomic_fetch_add_explicit(&header->xreferenceCount, n, memory_order_relaxed);
+}
+
+int
+folioHeader_SubtractReferenceCount(FolioHeader *header, int n)
+{
+	assertNotNull(header, "header must be non-null");
+	return atomic_fetch_sub_explicit(&header->xreferenceCount, n, memory_order_relaxed);
+}
+
+int
+folioHeader_ClearReferenceCount(FolioHeader *header)
+{
+	assertNotNull(header, "header must be non-null");
+	return atomic_exchange_explicit(&header->xreferenceCount, 0, memory_order_relaxed);
+}
+
 void
 folioHeader_ExecuteFinalizer(FolioHeader *header, void *memory)
 {
@@ -176,13 +254,13 @@ folioHeader_ToString(const FolioHeader *header)
 	}
 
 	char *str;
-	asprintf(&str, "{Header (%p) : mgk1 0x%08x, len %zu, fini %p, lock %p, refCount %d, inFini %d, "
+	asprintf(&str, "{Header (%p) : mgk1 0x%08x, len %zu, fini %p, locker %#lx, refCount %d, inFini %d, "
 			"pvdrLen %u, hdrgrdlen %u, trlgrdlen %u, mgk2 0x%08x, grd (%p) [0x%s]}",
 			(void *) header,
 			header->xmagic1,
 			header->xrequestedLength,
 			header->xfini,
-			(void *) header->xlock,
+			(unsigned long) header->xlockingThreadId,
 			atomic_load(&((FolioHeader *)header)->xreferenceCount),
 			header->xinFinalizer,
 			header->xproviderDataLength,
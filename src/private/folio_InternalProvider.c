@@ -24,13 +24,23 @@
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <LongBow/runtime.h>
 #include <Folio/private/folio_InternalProvider.h>
 #include <Folio/private/folio_Lock.h>
+#include <Folio/private/folio_Zero.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include <Folio/private/folio_Header.h>
 #include <Folio/private/folio_Pool.h>
@@ -118,23 +128,34 @@ _getRandomMagic(void)
  * +-----------------------+
  * | FolioMemoryProvider   |
  * +-----------------------+
+ * | padding               |
+ * +-----------------------+
  * | FolioPool             | <-- folioPool_GetFromProvider(provider)  = pool->poolState pointer
  * +-----------------------+
  * | ProviderState         | <-- folioInternalProvider_GetProviderState(provider) = pool + sizeof(FolioPool)
  * +-----------------------+
  *
+ * The pool and the provider state start on a cache line, so a state such as FolioStats
+ * gets the alignment its type asks for.
  */
 FolioMemoryProvider *
 folioInternalProvider_Create(const FolioMemoryProvider *template, size_t memorySize,
 		size_t providerStateLength, size_t providerHeaderLength)
 {
-	size_t length = sizeof(FolioMemoryProvider) + sizeof(FolioPool) + providerStateLength;
+	const size_t poolAlignment = _Alignof(FolioPool);
+	size_t poolOffset = (sizeof(FolioMemoryProvider) + poolAlignment - 1) & ~(poolAlignment - 1);
+	size_t length = poolOffset + sizeof(FolioPool) + providerStateLength;
 	size_t alignedLength = _calculateAlignedLength(length);
 
-	FolioMemoryProvider *provider = calloc(1, alignedLength);
+	void *memory = NULL;
+	int failure = posix_memalign(&memory, poolAlignment, alignedLength);
+	trapOutOfMemoryIf(failure != 0, "Could not allocate %zu bytes for the provider", alignedLength);
+	memset(memory, 0, alignedLength);
+
+	FolioMemoryProvider *provider = memory;
 	memcpy(provider, template, sizeof(FolioMemoryProvider));
 
-	provider->poolState = (uint8_t *) provider + sizeof(FolioMemoryProvider);
+	provider->poolState = (uint8_t *) provider + poolOffset;
 
 	FolioPool *pool = folioPool_GetFromProvider(provider);
 
@@ -143,7 +164,8 @@ folioInternalProvider_Create(const FolioMemoryProvider *template, size_t memoryS
 	pool->providerStateLength = providerStateLength;
 	pool->providerHeaderLength = providerHeaderLength;
 
-	size_t headerLengthNoGuard = sizeof(FolioHeader) + providerHeaderLength;
+	// The owner word is last, right before the user memory
+	size_t headerLengthNoGuard = sizeof(FolioHeader) + providerHeaderLength + sizeof(FolioOwner);
 
 	printf("sizeof(FolioHeader) = %zu\n", sizeof(FolioHeader));
 
@@ -160,16 +182,67 @@ folioInternalProvider_Create(const FolioMemoryProvider *template, size_t memoryS
 	// headerGuardLength may be zero
 	pool->headerGuardLength = pool->headerAlignedLength - headerLengthNoGuard;
 	pool->trailerAlignedLength = sizeof(FolioTrailer);
+	atomic_init(&pool->poolId, 0);
 
 	pool->guardPattern = (uint8_t)pool->headerMagic + 1;
 	if (pool->guardPattern == 0) {
 		pool->guardPattern++;
 	}
 
-	atomic_flag_clear(&pool->allocationLock);
-	pool->poolSize = memorySize;
-	pool->currentAllocation = ATOMIC_VAR_INIT(0);
+	atomic_init(&pool->poolSize, memorySize);
+	atomic_init(&pool->softLimit, UINT64_MAX);
+	atomic_init(&pool->softLimitCount, 0);
+	atomic_init(&pool->softLimitCallback, NULL);
+	atomic_init(&pool->currentAllocation, 0);
+	atomic_init(&pool->validationLevel, FolioValidationLevel_Full);
+	atomic_init(&pool->sampleInterval, 0);
+	atomic_init(&pool->largeObjectThreshold, FolioLargeObjectDefaultThreshold);
+	atomic_init(&pool->largeObjectCount, 0);
+	atomic_init(&pool->largeObjectBytes, 0);
+	atomic_init(&pool->largeObjectTotal, 0);
+	atomic_init(&pool->reserve, NULL);
+	atomic_init(&pool->scavengeRetain, 0);
+	atomic_init(&pool->scavengeDecayPercent, 100);
+	atomic_init(&pool->scavengedBytes, 0);
+	atomic_init(&pool->scavengeCount, 0);
+	atomic_flag_clear(&pool->reclaimLock);
+	atomic_init(&pool->reclaimerCount, 0);
+	atomic_flag_clear(&pool->reclaimRunning);
+	atomic_init(&pool->reclaimInterval, (uint64_t) FolioReclaimDefaultInterval * 1000000);
+	atomic_init(&pool->lastReclaim, 0);
+	atomic_init(&pool->reclaimCount, 0);
+	atomic_init(&pool->reclaimedBytes, 0);
+	atomic_init(&pool->reclaimNanos, 0);
+	atomic_init(&pool->reclaimMaxNanos, 0);
+	atomic_init(&pool->reclaimSkipped, 0);
+	atomic_flag_clear(&pool->priorityLock);
+	atomic_init(&pool->priorityLimited, false);
+	for (unsigned i = 0; i < FolioPriorityClasses; ++i) {
+		atomic_init(&pool->priorityClasses[i].current, 0);
+		atomic_init(&pool->priorityClasses[i].reserve, 0);
+		atomic_init(&pool->priorityClasses[i].cap, UINT64_MAX);
+		atomic_init(&pool->priorityClasses[i].denials, 0);
+	}
+	atomic_flag_clear(&pool->waitLock);
+	pool->waitHead = NULL;
+	pool->waitTail = NULL;
+	atomic_init(&pool->waiters, 0);
+	atomic_init(&pool->maxWaiters, 0);
+	atomic_init(&pool->waitCount, 0);
+	atomic_init(&pool->waitNanos, 0);
+	atomic_init(&pool->waitTimeouts, 0);
+	for (unsigned i = 0; i < FolioWaitHistogramBuckets; ++i) {
+		atomic_init(&pool->waitHistogram[i], 0);
+	}
+	pool->parent = NULL;
+	pool->parentChunk = 0;
+	pool->parentProvider = NULL;
+	atomic_flag_clear(&pool->childLock);
+	pool->firstChild = NULL;
+	pool->nextSibling = NULL;
+	atomic_init(&pool->descendantWaiters, 0);
 	pool->referenceCount = ATOMIC_VAR_INIT(1);
+	atomic_init(&pool->holds, 1);
 
 	pool->internalMagic2 = _internalMagic;
 
@@ -198,8 +271,10 @@ _verifyHeader(FolioPool const *pool, const FolioHeader *header)
 	bool result = false;
 	if (folioHeader_CompareMagic(header, pool->headerMagic)) {
 		const uint8_t *guard = folioHeader_GetHeaderGuardAddress(header);
+		const FolioOwner *owner = (const FolioOwner *) ((const uint8_t *) header + pool->headerAlignedLength) - 1;
 
-		if (_verifyGuard(pool->guardPattern, pool->headerGuardLength, guard) ) {
+		if (_verifyGuard(pool->guardPattern, pool->headerGuardLength, guard) && owner->magic == pool->headerMagic
+				&& owner->poolId == atomic_load_explicit(&((FolioPool *) pool)->poolId, memory_order_relaxed)) {
 			result = true;
 		}
 	}
@@ -262,49 +337,534 @@ folioInternalProvider_GetProviderHeaderLength(const FolioMemoryProvider *provide
  *
  */
 
+// The FolioPriority class of the thread's allocations
+static __thread unsigned _threadPriority = FolioPriority_Normal;
+
+static uint64_t
+_nowNanos(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * Calls the reclaimers in order until they give back targetBytes.  Does nothing if
+ * another thread (or this one, from inside a reclaimer) is reclaiming, or if the last
+ * reclaim ended less than the reclaim interval ago.
+ *
+ * @return true if the reclaimers ran
+ */
+static bool
+_reclaim(FolioMemoryProvider *provider, FolioPool *pool, size_t targetBytes)
+{
+	if (atomic_load_explicit(&pool->reclaimerCount, memory_order_relaxed) == 0) {
+		return false;
+	}
+
+	if (atomic_flag_test_and_set(&pool->reclaimRunning)) {
+		atomic_fetch_add_explicit(&pool->reclaimSkipped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	uint64_t start = _nowNanos();
+	uint64_t last = atomic_load(&pool->lastReclaim);
+	if (last != 0 && start - last < atomic_load(&pool->reclaimInterval)) {
+		atomic_fetch_add_explicit(&pool->reclaimSkipped, 1, memory_order_relaxed);
+		atomic_flag_clear(&pool->reclaimRunning);
+		return false;
+	}
+
+	// Call them outside the lock, so a reclaimer may unregister itself
+	FolioReclaimerEntry reclaimers[FolioMaximumReclaimers];
+	folioLock_FlagLock(&pool->reclaimLock);
+	unsigned count = atomic_load(&pool->reclaimerCount);
+	memcpy(reclaimers, pool->reclaimers, count * sizeof(FolioReclaimerEntry));
+	folioLock_FlagUnlock(&pool->reclaimLock);
+
+	size_t reclaimed = 0;
+	for (unsigned i = 0; i < count && reclaimed < targetBytes; ++i) {
+		reclaimed += reclaimers[i].callback(provider, targetBytes - reclaimed, reclaimers[i].context);
+	}
+
+	uint64_t end = _nowNanos();
+	uint64_t elapsed = end - start;
+
+	atomic_fetch_add_explicit(&pool->reclaimCount, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->reclaimedBytes, reclaimed, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->reclaimNanos, elapsed, memory_order_relaxed);
+	if (elapsed > atomic_load_explicit(&pool->reclaimMaxNanos, memory_order_relaxed)) {
+		// Only the reclaiming thread writes it
+		atomic_store_explicit(&pool->reclaimMaxNanos, elapsed, memory_order_relaxed);
+	}
+
+	atomic_store(&pool->lastReclaim, end);
+	atomic_flag_clear(&pool->reclaimRunning);
+	return true;
+}
+
 /*
- * Tests for available memory and if so subtracts the allocation length.
+ * Tests for available memory and if so reserves the allocation length.  Calls the soft
+ * limit callback if this allocation crossed the soft limit.
+ *
+ * If the pool is out of memory or the allocation crossed the soft limit, runs the
+ * reclaimers.  After an out of memory reclaim it tries once more.
  *
  * @return true if allocation of length bytes is ok
  * @return false if out of memory
  */
 static bool
-_increaseCurrentAllocation(FolioPool *pool, const size_t length)
+_increaseCurrentAllocation(FolioMemoryProvider *provider, FolioPool *pool, unsigned priority, const size_t length)
 {
-	bool memoryIsAvailable = false;
+	bool crossedSoftLimit;
+	bool memoryIsAvailable = folioPool_Reserve(pool, priority, length, &crossedSoftLimit);
 
-	folioLock_FlagLock(&pool->allocationLock);
+	if (!memoryIsAvailable) {
+		uint64_t current = atomic_load(&pool->currentAllocation);
+		uint64_t poolSize = atomic_load(&pool->poolSize);
+		size_t available = current < poolSize ? (size_t) (poolSize - current) : 0;
 
-	if (pool->poolSize >= pool->currentAllocation) {
-		size_t remainingMemory = pool->poolSize - pool->currentAllocation;
-
-		if (length <= remainingMemory) {
-			memoryIsAvailable = true;
-			pool->currentAllocation += length;
+		if (_reclaim(provider, pool, length - (available < length ? available : 0))) {
+			memoryIsAvailable = folioPool_Reserve(pool, priority, length, &crossedSoftLimit);
 		}
 	}
 
-	folioLock_FlagUnlock(&pool->allocationLock);
+	if (crossedSoftLimit) {
+		FolioSoftLimitCallback callback = atomic_load(&pool->softLimitCallback);
+		if (callback) {
+			callback(provider, (size_t) atomic_load(&pool->currentAllocation), (size_t) atomic_load(&pool->softLimit));
+		}
+
+		uint64_t current = atomic_load(&pool->currentAllocation);
+		uint64_t softLimit = atomic_load(&pool->softLimit);
+		if (current > softLimit) {
+			_reclaim(provider, pool, (size_t) (current - softLimit));
+		}
+	}
 
 	return memoryIsAvailable;
 }
 
+static void
+_decreaseCurrentAllocation(FolioPool *pool, unsigned priority, const size_t length)
+{
+	// Also wakes the first waiter, and those of the parent if the pool is a child
+	folioPool_Unreserve(pool, priority, length);
+}
+
+static bool
+_isFirstWaiter(FolioPool *pool, FolioWaiter *waiter)
+{
+	folioLock_FlagLock(&pool->waitLock);
+	bool first = pool->waitHead == waiter;
+	folioLock_FlagUnlock(&pool->waitLock);
+	return first;
+}
+
+static unsigned
+_waitBucket(uint64_t nanos)
+{
+	uint64_t usec = nanos / 1000;
+	unsigned bucket = 0;
+	while (usec > 0 && bucket < FolioWaitHistogramBuckets - 1) {
+		usec >>= 2;
+		bucket++;
+	}
+	return bucket;
+}
+
+/*
+ * Like _increaseCurrentAllocation(), but if the pool is out of memory, waits in line
+ * until a release makes room or the timeout passes.  Only the first waiter tries to
+ * reserve, so waiters are served in order.  A plain allocation does not wait in line.
+ *
+ * @return true if allocation of length bytes is ok
+ * @return false on timeout, or at once if length could never fit: it is more than the
+ *         class cap, or more than the whole pool or that of an ancestor
+ */
+static bool
+_waitForAllocation(FolioMemoryProvider *provider, FolioPool *pool, unsigned priority, const size_t length, unsigned timeoutMilliseconds)
+{
+	// With nobody in line, taking the memory now does not pass anyone
+	if (atomic_load(&pool->waiters) == 0 && _increaseCurrentAllocation(provider, pool, priority, length)) {
+		return true;
+	}
+
+	if (timeoutMilliseconds == 0 || !folioPool_CanEverReserve(pool, priority, length)) {
+		return false;
+	}
+
+	uint64_t start = _nowNanos();
+	uint64_t deadline = UINT64_MAX;
+	if (timeoutMilliseconds != FolioWaitForever) {
+		deadline = start + (uint64_t) timeoutMilliseconds * 1000000;
+	}
+
+	FolioWaiter self = { .next = NULL };
+	atomic_init(&self.wakeup, 0);
+
+	folioLock_FlagLock(&pool->waitLock);
+	if (pool->waitTail != NULL) {
+		pool->waitTail->next = &self;
+	} else {
+		pool->waitHead = &self;
+	}
+	pool->waitTail = &self;
+	unsigned waiters = atomic_fetch_add(&pool->waiters, 1) + 1;
+	if (waiters > atomic_load(&pool->maxWaiters)) {
+		atomic_store(&pool->maxWaiters, waiters);
+	}
+	folioLock_FlagUnlock(&pool->waitLock);
+	folioPool_CountDescendantWaiter(pool, 1);
+
+	// Clear the wake up before trying, so a release after the try is not missed.  The
+	// fence pairs with folioPool_Unreserve(): either the try sees the released memory,
+	// or the release, here or in an ancestor, sees this waiter.
+	bool reserved = false;
+	uint64_t now = start;
+	while (!reserved && now < deadline) {
+		atomic_store(&self.wakeup, 0);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (_isFirstWaiter(pool, &self)) {
+			reserved = _increaseCurrentAllocation(provider, pool, priority, length);
+		}
+
+		if (!reserved) {
+			folioLock_FutexWait(&self.wakeup, 0, deadline - now);
+			now = _nowNanos();
+		}
+	}
+
+	folioLock_FlagLock(&pool->waitLock);
+	FolioWaiter *prior = NULL;
+	FolioWaiter **link = &pool->waitHead;
+	while (*link != &self) {
+		prior = *link;
+		link = &prior->next;
+	}
+	*link = self.next;
+	if (pool->waitTail == &self) {
+		pool->waitTail = prior;
+	}
+	atomic_fetch_sub(&pool->waiters, 1);
+
+	// The next in line may fit in what is left
+	if (prior == NULL && pool->waitHead != NULL) {
+		folioPool_WakeWaiter(pool->waitHead);
+	}
+	folioLock_FlagUnlock(&pool->waitLock);
+
+	folioPool_CountDescendantWaiter(pool, -1);
+
+	uint64_t elapsed = _nowNanos() - start;
+	atomic_fetch_add_explicit(&pool->waitCount, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->waitNanos, elapsed, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->waitHistogram[_waitBucket(elapsed)], 1, memory_order_relaxed);
+	if (!reserved) {
+		atomic_fetch_add_explicit(&pool->waitTimeouts, 1, memory_order_relaxed);
+	}
+
+	return reserved;
+}
+
+bool
+folioInternalProvider_Reserve(FolioMemoryProvider *provider, unsigned priority, size_t length)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	return _increaseCurrentAllocation(provider, pool, priority, length);
+}
+
+bool
+folioInternalProvider_ReserveWait(FolioMemoryProvider *provider, unsigned priority, size_t length, unsigned timeoutMilliseconds)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	return _waitForAllocation(provider, pool, priority, length, timeoutMilliseconds);
+}
+
+void
+folioInternalProvider_Unreserve(FolioMemoryProvider *provider, unsigned priority, size_t length)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	_decreaseCurrentAllocation(pool, priority, length);
+}
+
+FolioPriority
+folioInternalProvider_GetThreadPriority(void)
+{
+	return (FolioPriority) _threadPriority;
+}
+
+FolioPriority
+folioInternalProvider_SetThreadPriority(FolioPriority priority)
+{
+	trapIllegalValueIf((unsigned) priority >= FolioPriorityClasses, "priority %d must be less than %d", priority, FolioPriorityClasses);
+
+	FolioPriority prior = (FolioPriority) _threadPriority;
+	_threadPriority = priority;
+	return prior;
+}
+
+/*
+ * Mapped blocks of at least this length are advised to use transparent huge pages
+ */
+#define _hugePageLength ((size_t) 2 * 1024 * 1024)
+
+/*
+ * The number of bytes mapped for a large object block of totalLength bytes
+ */
+static size_t
+_mappedLength(size_t totalLength)
+{
+	static size_t pageSize = 0;
+	if (pageSize == 0) {
+		pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	}
+	return (totalLength + pageSize - 1) & ~(pageSize - 1);
+}
+
+static bool
+_isLargeObject(FolioPool *pool, size_t totalLength)
+{
+	size_t threshold = atomic_load_explicit(&pool->largeObjectThreshold, memory_order_relaxed);
+	return pool->blockAllocator == NULL && threshold > 0 && totalLength >= threshold;
+}
+
+static void
+_adviseHugePages(void *block, size_t mappedLength)
+{
+#ifdef MADV_HUGEPAGE
+	if (mappedLength >= _hugePageLength) {
+		// Only advice, so a kernel without transparent huge pages is not an error
+		madvise(block, mappedLength, MADV_HUGEPAGE);
+	}
+#endif
+}
+
+/*
+ * @return A new mapped block or NULL if out of memory
+ */
+static void *
+_mapBlock(FolioPool *pool, size_t totalLength)
+{
+	size_t mappedLength = _mappedLength(totalLength);
+	void *block = mmap(NULL, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (block == MAP_FAILED) {
+		return NULL;
+	}
+
+	_adviseHugePages(block, mappedLength);
+
+	atomic_fetch_add_explicit(&pool->largeObjectCount, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->largeObjectBytes, mappedLength, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->largeObjectTotal, 1, memory_order_relaxed);
+	return block;
+}
+
+static void
+_unmapBlock(FolioPool *pool, void *block, size_t totalLength)
+{
+	size_t mappedLength = _mappedLength(totalLength);
+	int failure = munmap(block, mappedLength);
+	trapUnexpectedStateIf(failure, "munmap of block %p failed", block);
+
+	atomic_fetch_sub_explicit(&pool->largeObjectCount, 1, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&pool->largeObjectBytes, mappedLength, memory_order_relaxed);
+}
+
+/*
+ * Grows or shrinks a mapped block with mremap(), which moves pages rather than copying
+ *
+ * @return The block, which may have moved, or NULL if out of memory (the block is untouched)
+ */
+static void *
+_remapBlock(FolioPool *pool, void *block, size_t totalLength, size_t newTotalLength)
+{
+	size_t mappedLength = _mappedLength(totalLength);
+	size_t newMappedLength = _mappedLength(newTotalLength);
+
+	void *newBlock = block;
+	if (newMappedLength != mappedLength) {
+#ifdef MREMAP_MAYMOVE
+		newBlock = mremap(block, mappedLength, newMappedLength, MREMAP_MAYMOVE);
+#else
+		// No mremap() on this platform, so map and copy
+		newBlock = mmap(NULL, newMappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (newBlock != MAP_FAILED) {
+			memcpy(newBlock, block, totalLength < newTotalLength ? totalLength : newTotalLength);
+			munmap(block, mappedLength);
+		}
+#endif
+		if (newBlock == MAP_FAILED) {
+			return NULL;
+		}
+
+		_adviseHugePages(newBlock, newMappedLength);
+
+		if (newMappedLength > mappedLength) {
+			atomic_fetch_add_explicit(&pool->largeObjectBytes, newMappedLength - mappedLength, memory_order_relaxed);
+		} else {
+			atomic_fetch_sub_explicit(&pool->largeObjectBytes, mappedLength - newMappedLength, memory_order_relaxed);
+		}
+	}
+	return newBlock;
+}
+
+/*
+ * @return The reserve class whose blocks hold totalLength bytes without wasting half of
+ *         the block, or NULL
+ */
+static FolioReserveClass *
+_reserveClassForLength(FolioReserve *reserve, size_t totalLength)
+{
+	for (unsigned i = 0; i < reserve->classCount; ++i) {
+		FolioReserveClass *class = &reserve->classes[i];
+		if (totalLength <= class->blockLength) {
+			return totalLength > class->blockLength / 2 ? class : NULL;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * @return The reserve class the block was carved from, or NULL if it is not a reserved block
+ */
+static FolioReserveClass *
+_reserveClassForBlock(FolioReserve *reserve, const void *block)
+{
+	if (reserve != NULL && (const uint8_t *) block >= (const uint8_t *) reserve->mapping
+			&& (const uint8_t *) block < (const uint8_t *) reserve->mapping + reserve->mappingLength) {
+		for (unsigned i = 0; i < reserve->classCount; ++i) {
+			FolioReserveClass *class = &reserve->classes[i];
+			if ((const uint8_t *) block >= class->start && (const uint8_t *) block < class->end) {
+				return class;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * @return A free reserved block of at least totalLength bytes, or NULL
+ */
+static void *
+_takeReservedBlock(FolioPool *pool, size_t totalLength)
+{
+	void *block = NULL;
+	FolioReserve *reserve = atomic_load_explicit(&pool->reserve, memory_order_acquire);
+	if (reserve != NULL) {
+		FolioReserveClass *class = _reserveClassForLength(reserve, totalLength);
+		if (class != NULL) {
+			folioLock_FlagLock(&class->lock);
+			void **list = class->freeList != NULL ? &class->freeList : &class->scavengedList;
+			block = *list;
+			if (block != NULL) {
+				*list = *(void **) block;
+				class->blocksInUse++;
+			}
+			folioLock_FlagUnlock(&class->lock);
+		}
+	}
+	return block;
+}
+
+static void
+_returnReservedBlock(FolioReserveClass *class, void *block)
+{
+	folioLock_FlagLock(&class->lock);
+	*(void **) block = class->freeList;
+	class->freeList = block;
+	class->blocksInUse--;
+	folioLock_FlagUnlock(&class->lock);
+}
+
+/*
+ * @param zero If true, the block is all zero.  calloc() and the block allocator skip
+ *        clearing memory that comes fresh from the kernel
+ * @param largeObject Set to true if the block is mapped, which the caller records in the header
+ */
+static void *
+_allocateBlock(FolioMemoryProvider *provider, FolioPool *pool, size_t totalLength, bool zero, bool *largeObject)
+{
+	void *block;
+	*largeObject = false;
+	if (pool->blockAllocator) {
+		block = pool->blockAllocator->allocate(provider, totalLength, zero);
+	} else if (_isLargeObject(pool, totalLength)) {
+		block = _mapBlock(pool, totalLength);
+		*largeObject = true;
+	} else if ((block = _takeReservedBlock(pool, totalLength)) != NULL) {
+		if (zero) {
+			folioZero_Clear(block, totalLength);
+		}
+	} else if (zero) {
+		block = calloc(1, totalLength);
+	} else {
+		block = malloc(totalLength);
+	}
+	return block;
+}
+
+/*
+ * A block from folioInternalProvider_AllocateAligned() has padding in front of the
+ * header so the user memory is aligned.  The size_t right before the header is the
+ * distance from the start of the block to the header.
+ *
+ * +-----------------------+
+ * | padding               |
+ * | block offset          |
+ * +-----------------------+
+ * | FolioHeader           |
+ * | ...                   |
+ *
+ * The block is totalLength + alignment bytes.
+ *
+ * @param largeObject Set to true if the block is mapped, which the caller records in the header
+ * @return The header position inside the new block, or NULL if out of memory
+ */
+static void *
+_allocateAlignedBlock(FolioMemoryProvider *provider, FolioPool *pool, size_t totalLength, size_t alignment, bool *largeObject)
+{
+	void *header = NULL;
+
+	uint8_t *block = _allocateBlock(provider, pool, totalLength + alignment, false, largeObject);
+	if (block != NULL) {
+		// The block is aligned to _alignment_width, so this is at most alignment bytes past the block
+		uintptr_t user = ((uintptr_t) block + sizeof(size_t) + pool->headerAlignedLength + alignment - 1) & ~(uintptr_t) (alignment - 1);
+		header = (uint8_t *) user - pool->headerAlignedLength;
+		((size_t *) header)[-1] = (uint8_t *) header - block;
+	}
+
+	return header;
+}
+
 /*
- * precondition: you hold the stats lock
+ * Frees the block of a header with totalLength bytes from _computeTotalLength()
  */
 static void
-_decreaseCurrentAllocation(FolioPool *pool, const size_t length)
+_freeBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, size_t totalLength)
 {
-	folioLock_FlagLock(&pool->allocationLock);
+	void *block = header;
 
-	trapIllegalValueIf(pool->currentAllocation < length, "current allocation less than length");
-	pool->currentAllocation -= length;
+	unsigned alignmentShift = folioHeader_GetAlignmentShift(header);
+	if (alignmentShift > 0) {
+		block = (uint8_t *) header - ((size_t *) header)[-1];
+		totalLength += (size_t) 1 << alignmentShift;
+	}
 
-	folioLock_FlagUnlock(&pool->allocationLock);
+	FolioReserveClass *reserveClass;
+	if (folioHeader_IsLargeObject(header)) {
+		_unmapBlock(pool, block, totalLength);
+	} else if (pool->blockAllocator) {
+		pool->blockAllocator->free(provider, block, totalLength);
+	} else if ((reserveClass = _reserveClassForBlock(atomic_load_explicit(&pool->reserve, memory_order_acquire), block)) != NULL) {
+		_returnReservedBlock(reserveClass, block);
+	} else {
+		free(block);
+	}
 }
 
 static size_t
-_computeTotalLength(FolioPool *pool, size_t requestLength, size_t trailerGuardLength)
+_computeTotalLength(const FolioPool *pool, size_t requestLength, size_t trailerGuardLength)
 {
 	size_t totalLength = pool->headerAlignedLength + requestLength +
 							trailerGuardLength + pool->trailerAlignedLength;
@@ -340,15 +900,69 @@ _computeTotalLength(FolioPool *pool, size_t requestLength, size_t trailerGuardLe
  *
  */
 
-void *
-folioInternalProvider_Allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+/*
+ * Lays out the header, guards, and trailer in a block of memory of at least
+ * _computeTotalLength() bytes.
+ *
+ * @return The user memory pointer inside the block
+ */
+static void *
+_initializeBlock(FolioMemoryProvider *provider, FolioPool *pool, void *memory, const size_t length, const size_t trailerGuardLength,
+		Finalizer fini, unsigned priority)
+{
+	FolioHeader *header = memory;
+
+	folioHeader_Initialize(header, pool->headerMagic, length, 1, pool->providerHeaderLength,
+							fini, pool->headerGuardLength, trailerGuardLength);
+	folioHeader_SetPriority(header, priority);
+	atomic_fetch_add_explicit(&pool->holds, 1, memory_order_relaxed);
+
+	void *user = (uint8_t *) memory + pool->headerAlignedLength;
+
+	uint8_t *headerGuard = (uint8_t *) folioHeader_GetHeaderGuardAddress(header);
+	_fillGuard(pool->guardPattern, pool->headerGuardLength, headerGuard);
+	*((FolioOwner *) user - 1) = folioPool_Owner(pool, provider);
+
+	FolioTrailer *trailer = folioHeader_GetTrailer(header, pool);
+	trailer->magic3 = pool->headerMagic;
+
+	uint8_t *trailerGuard = (uint8_t *) folioHeader_GetTrailerGuardAddress(header, pool);
+	_fillGuard(pool->guardPattern, trailerGuardLength, trailerGuard);
+
+#if DEBUG
+	fprintf(stderr, "Header %p Guard %p User %p Trailer %p Guard %p TotalLength %zu\n",
+			(void *) header,
+			(void *) headerGuard,
+			(void *) user,
+			(void *) trailer,
+			(void *) trailerGuard,
+			_computeTotalLength(pool, length, trailerGuardLength));
+
+	longBowDebug_MemoryDump((const char *) header, _computeTotalLength(pool, length, trailerGuardLength));
+#endif
+
+	return user;
+}
+
+/*
+ * @param zero If true, the user memory is all zeros
+ * @param timeoutMilliseconds If not 0, how long to wait for memory
+ */
+static void *
+_allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini, bool zero, unsigned timeoutMilliseconds)
 {
 	FolioPool *pool = folioPool_GetFromProvider(provider);
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
 	void *user = NULL;
+	unsigned priority = _threadPriority;
 
-	bool memoryIsAvailable = _increaseCurrentAllocation(pool, length);
+	bool memoryIsAvailable;
+	if (timeoutMilliseconds == 0) {
+		memoryIsAvailable = _increaseCurrentAllocation(provider, pool, priority, length);
+	} else {
+		memoryIsAvailable = _waitForAllocation(provider, pool, priority, length, timeoutMilliseconds);
+	}
 
 	if (memoryIsAvailable) {
 		size_t alignedLength = _calculateAlignedLength(length);
@@ -356,42 +970,70 @@ folioInternalProvider_Allocate(FolioMemoryProvider *provider, const size_t lengt
 
 		size_t totalLength = _computeTotalLength(pool, length, trailerGuardLength);
 
-		void *memory = malloc(totalLength);
-		FolioHeader *header = memory;
+		bool largeObject;
+		void *memory = _allocateBlock(provider, pool, totalLength, zero, &largeObject);
+		if (memory != NULL) {
+			user = _initializeBlock(provider, pool, memory, length, trailerGuardLength, fini, priority);
+			folioHeader_SetLargeObject(memory, largeObject);
+
+#if DEBUG
+			folioInternalProvider_Report(provider, stderr);
+			folioInternalProvider_Display(provider, user, stderr);
+			folioInternalProvider_Validate(provider, user);
+#endif
+		} else {
+			// The block allocator is out of memory, so give back the accounting
+			_decreaseCurrentAllocation(pool, priority, length);
+		}
+	}
+
+	return user;
+}
 
-		FolioLock *lock = folioLock_Create();
-		folioHeader_Initialize(header, pool->headerMagic, length, lock, 1, pool->providerHeaderLength,
-								fini, pool->headerGuardLength, trailerGuardLength);
-		folioLock_Release(&lock);
+void *
+folioInternalProvider_Allocate(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
+{
+	return _allocate(provider, length, fini, false, 0);
+}
 
-		user = memory + pool->headerAlignedLength;
+void *
+folioInternalProvider_AllocateWait(FolioMemoryProvider *provider, const size_t length, Finalizer fini, unsigned timeoutMilliseconds)
+{
+	return _allocate(provider, length, fini, false, timeoutMilliseconds);
+}
 
-		uint8_t *headerGuard = (uint8_t *) folioHeader_GetHeaderGuardAddress(header);
-		_fillGuard(pool->guardPattern, pool->headerGuardLength, headerGuard);
+void *
+folioInternalProvider_AllocateAligned(FolioMemoryProvider *provider, const size_t length, size_t alignment, Finalizer fini)
+{
+	trapIllegalValueIf(alignment == 0 || (alignment & (alignment - 1)) != 0, "alignment %zu must be a power of 2", alignment);
 
-		FolioTrailer *trailer = folioHeader_GetTrailer(header, pool);
-		trailer->magic3 = pool->headerMagic;
+	if (alignment <= _alignment_width) {
+		return folioInternalProvider_Allocate(provider, length, fini);
+	}
 
-		uint8_t *trailerGuard = (uint8_t *) folioHeader_GetTrailerGuardAddress(header, pool);
-		_fillGuard(pool->guardPattern, trailerGuardLength, trailerGuard);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
-#if DEBUG
-		fprintf(stderr, "Header %p Guard %p User %p Trailer %p Guard %p TotalLength %zu\n",
-				(void *) header,
-				(void *) headerGuard,
-				(void *) user,
-				(void *) trailer,
-				(void *) trailerGuard,
-				totalLength);
-
-		folioInternalProvider_Report(provider, stderr);
-		folioInternalProvider_Display(provider, user, stderr);
-
-		longBowDebug_MemoryDump((const char *) header, totalLength);
-#endif
+	void *user = NULL;
+	unsigned priority = _threadPriority;
+
+	bool memoryIsAvailable = _increaseCurrentAllocation(provider, pool, priority, length);
+
+	if (memoryIsAvailable) {
+		size_t alignedLength = _calculateAlignedLength(length);
+		size_t trailerGuardLength = alignedLength - length;
 
-		folioInternalProvider_Validate(provider, user);
+		size_t totalLength = _computeTotalLength(pool, length, trailerGuardLength);
 
+		bool largeObject;
+		void *header = _allocateAlignedBlock(provider, pool, totalLength, alignment, &largeObject);
+		if (header != NULL) {
+			user = _initializeBlock(provider, pool, header, length, trailerGuardLength, fini, priority);
+			folioHeader_SetAlignmentShift(header, (unsigned) __builtin_ctzll(alignment));
+			folioHeader_SetLargeObject(header, largeObject);
+		} else {
+			_decreaseCurrentAllocation(pool, priority, length);
+		}
 	}
 
 	return user;
@@ -400,27 +1042,85 @@ folioInternalProvider_Allocate(FolioMemoryProvider *provider, const size_t lengt
 void *
 folioInternalProvider_AllocateAndZero(FolioMemoryProvider *provider, const size_t length, Finalizer fini)
 {
-	void * memory = folioInternalProvider_Allocate(provider, length, fini);
-	if (memory) {
-		memset(memory, 0, length);
-	}
-	return memory;
+	return _allocate(provider, length, fini, true, 0);
 }
 
-static void
-_validateInternal(FolioPool *pool, const FolioHeader *header)
+size_t
+folioInternalProvider_AllocateBatch(FolioMemoryProvider *provider, size_t count, const size_t length, Finalizer fini, void **out)
 {
-	if (_verifyHeader(pool, header)) {
-		int refcount = folioHeader_ReferenceCount(header);
-		if (refcount == 0 && !folioHeader_InFinalizer(header)) {
-			char *headerString = folioHeader_ToString(header);
-			printf("\n\nHeader: %s\n", headerString);
-			free(headerString);
+	assertNotNull(out, "out must be non-null");
 
-			longBowDebug_MemoryDump((const char *) header, pool->headerAlignedLength + pool->headerGuardLength);
-			trapUnexpectedState("Memory: refcount is zero");
-		}
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
+	size_t allocated = 0;
+	unsigned priority = _threadPriority;
+
+	// One reservation for the whole batch
+	bool memoryIsAvailable = (count == 0 || length <= SIZE_MAX / count)
+							&& _increaseCurrentAllocation(provider, pool, priority, count * length);
+
+	if (memoryIsAvailable) {
+		size_t alignedLength = _calculateAlignedLength(length);
+		size_t trailerGuardLength = alignedLength - length;
+
+		size_t totalLength = _computeTotalLength(pool, length, trailerGuardLength);
+
+		while (allocated < count) {
+			bool largeObject;
+			void *memory = _allocateBlock(provider, pool, totalLength, false, &largeObject);
+			if (memory == NULL) {
+				break;
+			}
+			out[allocated++] = _initializeBlock(provider, pool, memory, length, trailerGuardLength, fini, priority);
+			folioHeader_SetLargeObject(memory, largeObject);
+		}
+
+		if (allocated < count) {
+			// The block allocator ran out of memory, so give back the rest of the accounting
+			_decreaseCurrentAllocation(pool, priority, (count - allocated) * length);
+		}
+	}
+
+	for (size_t i = allocated; i < count; ++i) {
+		out[i] = NULL;
+	}
+
+	return allocated;
+}
+
+static bool _releaseBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, void *memory, int prior);
+static size_t _destroyBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, void *memory);
+
+static void
+_trapInvalidHeader(FolioPool *pool, const FolioHeader *header)
+{
+	printf("\n\nHeader:\n");
+	longBowDebug_MemoryDump((const char *) header, pool->headerAlignedLength + pool->headerGuardLength);
+	trapUnexpectedState("Memory: invalid header (memory underrun)");
+}
+
+static void
+_validateReferenceCount(FolioPool *pool, const FolioHeader *header)
+{
+	int refcount = folioHeader_ReferenceCount(header);
+	if (refcount == 0 && !folioHeader_InFinalizer(header)) {
+		char *headerString = folioHeader_ToString(header);
+		printf("\n\nHeader: %s\n", headerString);
+		free(headerString);
+
+		longBowDebug_MemoryDump((const char *) header, pool->headerAlignedLength + pool->headerGuardLength);
+		trapUnexpectedState("Memory: refcount is zero");
+	}
+}
+
+/*
+ * Checks the header guard and the trailer, but not the reference count
+ */
+static void
+_validateGuards(FolioPool *pool, const FolioHeader *header)
+{
+	if (_verifyHeader(pool, header)) {
 		const FolioTrailer *trailer = folioHeader_GetTrailer(header, pool);
 		if (!_verifyTrailer(pool, trailer, folioHeader_GetTrailerGuardLength(header))) {
 			char *trailerString = folioTrailer_ToString(trailer, folioHeader_GetTrailerGuardLength(header));
@@ -432,9 +1132,61 @@ _validateInternal(FolioPool *pool, const FolioHeader *header)
 			trapUnexpectedState("Memory: invalid trailer (memory overrun)");
 		}
 	} else {
-		printf("\n\nHeader:\n");
-		longBowDebug_MemoryDump((const char *) header, pool->headerAlignedLength + pool->headerGuardLength);
-		trapUnexpectedState("Memory: invalid header (memory underrun)");
+		_trapInvalidHeader(pool, header);
+	}
+}
+
+static void
+_validateInternal(FolioPool *pool, const FolioHeader *header)
+{
+	_validateGuards(pool, header);
+	_validateReferenceCount(pool, header);
+}
+
+/*
+ * Only the two header magics and the reference count.  Does not touch the
+ * header guard or the trailer at the far end of the user memory.
+ */
+static void
+_validateMagic(FolioPool *pool, const FolioHeader *header)
+{
+	if (!folioHeader_CompareMagic(header, pool->headerMagic)) {
+		_trapInvalidHeader(pool, header);
+	}
+	_validateReferenceCount(pool, header);
+}
+
+// Counts operations of the current thread for FolioValidationLevel_Sampled
+static __thread unsigned _sampleCounter;
+
+/*
+ * Validation on an operation that is not the final release, per the pool's validation level
+ */
+static void
+_validateForLevel(FolioPool *pool, const FolioHeader *header)
+{
+	switch (atomic_load_explicit(&pool->validationLevel, memory_order_relaxed)) {
+		case FolioValidationLevel_Full:
+			_validateInternal(pool, header);
+			break;
+
+		case FolioValidationLevel_MagicOnly:
+			_validateMagic(pool, header);
+			break;
+
+		case FolioValidationLevel_Sampled: {
+			unsigned interval = atomic_load_explicit(&pool->sampleInterval, memory_order_relaxed);
+			if (interval < 2 || ++_sampleCounter % interval == 0) {
+				_validateInternal(pool, header);
+			} else {
+				_validateMagic(pool, header);
+			}
+			break;
+		}
+
+		case FolioValidationLevel_FinalRelease:
+		default:
+			break;
 	}
 }
 
@@ -464,8 +1216,64 @@ folioInternalProvider_AcquireProvider(const FolioMemoryProvider *provider)
 	return (FolioMemoryProvider *) provider;
 }
 
+/*
+ * Frees the pool once nothing holds it, neither a reference nor a live block.
+ */
+static void
+_freeProvider(FolioMemoryProvider *provider, FolioPool *pool)
+{
+	FolioReserve *reserve = atomic_load(&pool->reserve);
+	if (reserve != NULL) {
+		munmap(reserve->mapping, reserve->mappingLength);
+		free(reserve);
+	}
+
+	folioPool_Unregister(pool);
+
+	if (pool->parent != NULL) {
+		folioPool_Detach(pool);
+		folioMemoryProvider_ReleaseProvider(&pool->parentProvider);
+	}
+
+	if (pool->blockAllocator != NULL && pool->blockAllocator->destroy != NULL) {
+		pool->blockAllocator->destroy(provider);
+	}
+
+	// Write over magic1 so it invalidates the block
+	pool->internalMagic1 = 0;
+	free(provider);
+}
+
+/*
+ * Drops count holds on the pool, freeing it with the last one.
+ */
+static void
+_dropHolds(FolioMemoryProvider *provider, FolioPool *pool, uint64_t count)
+{
+	uint64_t prior = atomic_fetch_sub_explicit(&pool->holds, count, memory_order_acq_rel);
+	trapUnexpectedStateIf(prior < count, "Pool holds were %" PRIu64 " < %" PRIu64 " when trying to drop them", prior, count);
+
+	if (prior == count) {
+		_freeProvider(provider, pool);
+	}
+}
+
+void
+folioInternalProvider_Hold(FolioMemoryProvider *provider, size_t count)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	atomic_fetch_add_explicit(&pool->holds, count, memory_order_relaxed);
+}
+
+void
+folioInternalProvider_Unhold(FolioMemoryProvider *provider, size_t count)
+{
+	_dropHolds(provider, folioPool_GetFromProvider(provider), count);
+}
+
 /**
- * Release a reference to the provider.
+ * Release a reference to the provider.  The last one drops the references' hold on
+ * the pool, so the pool goes when its last block does.
  */
 bool
 folioInternalProvider_ReleaseProvider(FolioMemoryProvider **providerPtr)
@@ -480,20 +1288,158 @@ folioInternalProvider_ReleaseProvider(FolioMemoryProvider **providerPtr)
 	int prior = atomic_fetch_sub(&pool->referenceCount, 1);
 	trapIllegalValueIf(prior < 1, "Reference count was %d < 1 when trying to release", prior);
 
+	*providerPtr = NULL;
+
 	bool finalRelease = false;
 	if (prior == 1) {
 		finalRelease = true;
-
-		// Write over magic1 so it invalidates the block
-		pool->internalMagic1 = 0;
-		free(provider);
+		_dropHolds(provider, pool, 1);
 	}
 
-	*providerPtr = NULL;
 	return finalRelease;
+}
+
+
+/*
+ * Resizes a block from totalLength to newTotalLength bytes, keeping its contents up to
+ * the shorter of the two.  It may move the block.
+ *
+ * A large object grows or shrinks in place with mremap().  A block that crosses the
+ * large object threshold moves between malloc() and a mapping.  A reserved block stays
+ * in place while the new length fits, otherwise it moves to malloc().
+ *
+ * @param largeObject Set to true if the resized block is mapped
+ * @return The resized block or NULL if out of memory, in which case the block is untouched
+ */
+static void *
+_reallocateBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *block, size_t totalLength, size_t newTotalLength, bool *largeObject)
+{
+	void *newBlock = NULL;
+	FolioReserveClass *reserveClass;
+	bool wasLargeObject = folioHeader_IsLargeObject(block);
+	*largeObject = _isLargeObject(pool, newTotalLength);
+
+	if (wasLargeObject && *largeObject) {
+		newBlock = _remapBlock(pool, block, totalLength, newTotalLength);
+	} else if (wasLargeObject || *largeObject) {
+		newBlock = *largeObject ? _mapBlock(pool, newTotalLength) : malloc(newTotalLength);
+		if (newBlock != NULL) {
+			memcpy(newBlock, block, totalLength < newTotalLength ? totalLength : newTotalLength);
+			_freeBlock(provider, pool, block, totalLength);
+		}
+	} else if ((reserveClass = _reserveClassForBlock(atomic_load_explicit(&pool->reserve, memory_order_acquire), block)) != NULL) {
+		if (newTotalLength <= reserveClass->blockLength) {
+			newBlock = block;
+		} else {
+			newBlock = malloc(newTotalLength);
+			if (newBlock != NULL) {
+				memcpy(newBlock, block, totalLength);
+				_returnReservedBlock(reserveClass, block);
+			}
+		}
+	} else if (pool->blockAllocator) {
+		if (pool->blockAllocator->reallocate) {
+			newBlock = pool->blockAllocator->reallocate(provider, block, totalLength, newTotalLength);
+		}
+
+		if (newBlock == NULL) {
+			newBlock = pool->blockAllocator->allocate(provider, newTotalLength, false);
+			if (newBlock != NULL) {
+				memcpy(newBlock, block, totalLength < newTotalLength ? totalLength : newTotalLength);
 
+				// So nothing (e.g. an arena reset) mistakes the old copy for a live block
+				folioHeader_Invalidate(block);
+				pool->blockAllocator->free(provider, block, totalLength);
+			}
+		}
+	} else {
+		newBlock = realloc(block, newTotalLength);
+	}
+	return newBlock;
 }
 
+/*
+ * An aligned block always moves to a new aligned block, as the block allocator does
+ * not know about the padding.
+ *
+ * @return The header in the new block or NULL if out of memory
+ */
+static void *
+_reallocateAlignedBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, size_t totalLength, size_t newTotalLength, bool *largeObject)
+{
+	size_t alignment = (size_t) 1 << folioHeader_GetAlignmentShift(header);
+
+	void *newHeader = _allocateAlignedBlock(provider, pool, newTotalLength, alignment, largeObject);
+	if (newHeader != NULL) {
+		memcpy(newHeader, header, totalLength < newTotalLength ? totalLength : newTotalLength);
+		folioHeader_Invalidate(header);
+		_freeBlock(provider, pool, header, totalLength);
+	}
+	return newHeader;
+}
+
+void *
+folioInternalProvider_Reallocate(FolioMemoryProvider *provider, void **memoryPtr, size_t newLength)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(*memoryPtr, pool);
+	_validateInternal(pool, header);
+
+	void *user = NULL;
+
+	// Someone else holding a reference would be left with a dangling or resized pointer
+	if (folioHeader_ReferenceCount(header) == 1) {
+		size_t length = folioHeader_GetRequestedLength(header);
+		size_t totalLength = _computeTotalLength(pool, length, folioHeader_GetTrailerGuardLength(header));
+		unsigned priority = folioHeader_GetPriority(header);
+
+		size_t newTrailerGuardLength = _calculateAlignedLength(newLength) - newLength;
+		size_t newTotalLength = _computeTotalLength(pool, newLength, newTrailerGuardLength);
+
+		bool memoryIsAvailable = true;
+		if (newLength > length) {
+			memoryIsAvailable = _increaseCurrentAllocation(provider, pool, priority, newLength - length);
+		}
+
+		if (memoryIsAvailable) {
+			// If the new length fits in the trailer guard slack, the block does not change
+			void *block = header;
+			bool largeObject = folioHeader_IsLargeObject(header);
+			if (newTotalLength != totalLength) {
+				if (folioHeader_GetAlignmentShift(header) > 0) {
+					block = _reallocateAlignedBlock(provider, pool, header, totalLength, newTotalLength, &largeObject);
+				} else {
+					block = _reallocateBlock(provider, pool, header, totalLength, newTotalLength, &largeObject);
+				}
+			}
+
+			if (block != NULL) {
+				if (newLength < length) {
+					_decreaseCurrentAllocation(pool, priority, length - newLength);
+				}
+
+				header = block;
+				folioHeader_SetRequestedLength(header, newLength, newTrailerGuardLength);
+
+				// The copied header carries the old block's flag
+				folioHeader_SetLargeObject(header, largeObject);
+
+				FolioTrailer *trailer = folioHeader_GetTrailer(header, pool);
+				trailer->magic3 = pool->headerMagic;
+				_fillGuard(pool->guardPattern, newTrailerGuardLength, (uint8_t *) folioHeader_GetTrailerGuardAddress(header, pool));
+
+				user = (uint8_t *) block + pool->headerAlignedLength;
+				*memoryPtr = user;
+			} else if (newLength > length) {
+				_decreaseCurrentAllocation(pool, priority, newLength - length);
+			}
+		}
+	}
+
+	return user;
+}
 
 void *
 folioInternalProvider_Acquire(FolioMemoryProvider *provider, const void *memory)
@@ -503,7 +1449,7 @@ folioInternalProvider_Acquire(FolioMemoryProvider *provider, const void *memory)
 
 	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
 
-	_validateInternal(pool, header);
+	_validateForLevel(pool, header);
 
 	// prior value must be greater than 0.  If it is not positive it means someone
 	// freed the memory during the time between _validateInternal and now.
@@ -515,6 +1461,35 @@ folioInternalProvider_Acquire(FolioMemoryProvider *provider, const void *memory)
 	return (void *) memory;
 }
 
+void *
+folioInternalProvider_AcquireUnchecked(FolioMemoryProvider *provider, const void *memory)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+	folioHeader_IncrementReferenceCount(header);
+	return (void *) memory;
+}
+
+void *
+folioInternalProvider_AcquireN(FolioMemoryProvider *provider, const void *memory, unsigned n)
+{
+	trapIllegalValueIf(n < 1 || n > INT_MAX, "Invalid number of references %u", n);
+
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+
+	_validateForLevel(pool, header);
+
+	int prior = folioHeader_AddReferenceCount(header, (int) n);
+	if (prior < 1) {
+		trapUnrecoverableState("The memory %p was freed during acquire", (void *) memory);
+	}
+
+	return (void *) memory;
+}
+
 size_t
 folioInternalProvider_Length(const FolioMemoryProvider *provider, const void *memory)
 {
@@ -522,7 +1497,7 @@ folioInternalProvider_Length(const FolioMemoryProvider *provider, const void *me
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
 	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
-	_validateInternal(pool, header);
+	_validateForLevel(pool, header);
 
 	return folioHeader_GetRequestedLength(header);
 }
@@ -538,27 +1513,209 @@ folioInternalProvider_ReleaseMemory(FolioMemoryProvider *provider, void **memory
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
 	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
-	_validateInternal(pool, header);
+	FolioValidationLevel level = atomic_load_explicit(&pool->validationLevel, memory_order_relaxed);
+	_validateForLevel(pool, header);
 
 	int prior = folioHeader_DecrementReferenceCount(header);
 	trapIllegalValueIf(prior < 1, "Reference count was %d < 1 when trying to release", prior);
 
+	if (prior == 1 && level == FolioValidationLevel_FinalRelease) {
+		// The reference count is now 0, so only check the guards
+		_validateGuards(pool, header);
+	}
+
+	bool finalRelease = _releaseBlock(provider, pool, header, memory, prior);
+
+	*memoryPtr = NULL;
+	return finalRelease;
+}
+
+bool
+folioInternalProvider_ReleaseMemoryUnchecked(FolioMemoryProvider *provider, void **memoryPtr)
+{
+	void *memory = *memoryPtr;
+
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+
+	int prior = folioHeader_DecrementReferenceCount(header);
+	bool finalRelease = _releaseBlock(provider, pool, header, memory, prior);
+
+	*memoryPtr = NULL;
+	return finalRelease;
+}
+
+bool
+folioInternalProvider_ReleaseMemoryN(FolioMemoryProvider *provider, void **memoryPtr, unsigned n)
+{
+	trapIllegalValueIf(memoryPtr == NULL, "Null memory pointer");
+	trapIllegalValueIf(n < 1 || n > INT_MAX, "Invalid number of references %u", n);
+
+	void *memory = *memoryPtr;
+
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+	FolioValidationLevel level = atomic_load_explicit(&pool->validationLevel, memory_order_relaxed);
+	_validateForLevel(pool, header);
+
+	int prior = folioHeader_SubtractReferenceCount(header, (int) n);
+	trapIllegalValueIf(prior < (int) n, "Reference count was %d < %u when trying to release", prior, n);
+
+	if (prior == (int) n && level == FolioValidationLevel_FinalRelease) {
+		_validateGuards(pool, header);
+	}
+
+	// As if this were the last of n single releases
+	bool finalRelease = _releaseBlock(provider, pool, header, memory, prior - (int) n + 1);
+
+	*memoryPtr = NULL;
+	return finalRelease;
+}
+
+size_t
+folioInternalProvider_ReleaseBatch(FolioMemoryProvider *provider, void **memoryArray, size_t count, bool *finalRelease)
+{
+	assertNotNull(memoryArray, "memoryArray must be non-null");
+
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioValidationLevel level = atomic_load_explicit(&pool->validationLevel, memory_order_relaxed);
+
+	size_t finalReleases = 0;
+	size_t freedLength[FolioPriorityClasses] = { 0 };
+
+	for (size_t i = 0; i < count; ++i) {
+		void *memory = memoryArray[i];
+		trapIllegalValueIf(memory == NULL, "Null memory pointer at index %zu", i);
+
+		FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+		_validateForLevel(pool, header);
+
+		int prior = folioHeader_DecrementReferenceCount(header);
+		trapIllegalValueIf(prior < 1, "Reference count was %d < 1 when trying to release", prior);
+
+		if (prior == 1) {
+			if (level == FolioValidationLevel_FinalRelease) {
+				_validateGuards(pool, header);
+			}
+			unsigned priority = folioHeader_GetPriority(header);
+			freedLength[priority] += _destroyBlock(provider, pool, header, memory);
+			finalReleases++;
+		}
+
+		if (finalRelease) {
+			finalRelease[i] = (prior == 1);
+		}
+		memoryArray[i] = NULL;
+	}
+
+	for (unsigned priority = 0; priority < FolioPriorityClasses; ++priority) {
+		if (freedLength[priority] > 0) {
+			_decreaseCurrentAllocation(pool, priority, freedLength[priority]);
+		}
+	}
+
+	return finalReleases;
+}
+
+/*
+ * Finalizes and frees the block of memory that has no references left.  Does not
+ * change the pool accounting.
+ *
+ * @return The requested length of the memory
+ */
+static size_t
+_destroyBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, void *memory)
+{
+	folioHeader_ExecuteFinalizer(header, memory);
+
+	size_t length = folioHeader_GetRequestedLength(header);
+	size_t totalLength = _computeTotalLength(pool, length, folioHeader_GetTrailerGuardLength(header));
+
+	// Write over magic1 so it invalidates the block
+	folioHeader_Invalidate(header);
+	_freeBlock(provider, pool, header, totalLength);
+
+	return length;
+}
+
+/*
+ * After the reference count was decremented from prior, finalizes and frees
+ * the block if that was the last reference.
+ *
+ * @return true if it was the final release
+ */
+static bool
+_releaseBlock(FolioMemoryProvider *provider, FolioPool *pool, FolioHeader *header, void *memory, int prior)
+{
 	bool finalRelease = false;
 	if (prior == 1) {
 		finalRelease = true;
-		folioHeader_ExecuteFinalizer(header, memory);
+		unsigned priority = folioHeader_GetPriority(header);
+		_decreaseCurrentAllocation(pool, priority, _destroyBlock(provider, pool, header, memory));
+	}
+
+	return finalRelease;
+}
 
-		_decreaseCurrentAllocation(pool, folioHeader_GetRequestedLength(header));
+bool
+folioInternalProvider_IsLive(const FolioMemoryProvider *provider, const void *memory)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+	return folioHeader_CompareMagic(header, pool->headerMagic) && folioHeader_ReferenceCount(header) > 0;
+}
+
+int
+folioInternalProvider_DiscardMemory(FolioMemoryProvider *provider, void *memory)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
-		folioHeader_Finalize(header);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
 
-		// Write over magic1 so it invalidates the block
+	int references = 0;
+	if (folioHeader_CompareMagic(header, pool->headerMagic) && folioHeader_ReferenceCount(header) > 0) {
+		references = folioHeader_ClearReferenceCount(header);
+		folioHeader_ExecuteFinalizer(header, memory);
 		folioHeader_Invalidate(header);
-		free(header);
 	}
 
-	*memoryPtr = NULL;
-	return finalRelease;
+	return references;
+}
+
+void
+folioInternalProvider_SetBlockAllocator(FolioMemoryProvider *provider, const FolioBlockAllocator *blockAllocator)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	pool->blockAllocator = blockAllocator;
+}
+
+void
+folioInternalProvider_SetParent(FolioMemoryProvider *provider, FolioMemoryProvider *parent)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	FolioPool *parentPool = folioPool_GetFromProvider(parent);
+	trapUnexpectedStateIf( !_verifyInternalProvider(parentPool), "parent pointer is not a FolioPool");
+
+	uint64_t chunk = atomic_load(&pool->poolSize) / FolioChildChunkDivisor;
+	if (chunk > FolioChildMaximumChunk) {
+		chunk = FolioChildMaximumChunk;
+	} else if (chunk == 0) {
+		chunk = 1;
+	}
+
+	pool->parentProvider = folioMemoryProvider_AcquireProvider(parent);
+	folioPool_Attach(pool, parentPool, chunk);
 }
 
 void
@@ -567,7 +1724,411 @@ folioInternalProvider_SetAvailableMemory(FolioMemoryProvider *provider, size_t a
 	FolioPool *pool = folioPool_GetFromProvider(provider);
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
-	pool->poolSize = availableMemory;
+	atomic_store(&pool->poolSize, availableMemory);
+}
+
+void
+folioInternalProvider_SetSoftLimit(FolioMemoryProvider *provider, size_t softLimit, FolioSoftLimitCallback callback)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	atomic_store(&pool->softLimitCallback, callback);
+	atomic_store(&pool->softLimit, softLimit);
+}
+
+void
+folioInternalProvider_SetLargeObjectThreshold(FolioMemoryProvider *provider, size_t bytes)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	atomic_store(&pool->largeObjectThreshold, bytes);
+}
+
+bool
+folioInternalProvider_RegisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context, unsigned priority)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	bool registered = false;
+
+	folioLock_FlagLock(&pool->reclaimLock);
+	unsigned count = atomic_load(&pool->reclaimerCount);
+	if (count < FolioMaximumReclaimers) {
+		// After every reclaimer of the same or lower priority
+		unsigned i = count;
+		while (i > 0 && pool->reclaimers[i - 1].priority > priority) {
+			pool->reclaimers[i] = pool->reclaimers[i - 1];
+			i--;
+		}
+		pool->reclaimers[i] = (FolioReclaimerEntry) { .callback = callback, .context = context, .priority = priority };
+		atomic_store(&pool->reclaimerCount, count + 1);
+		registered = true;
+	}
+	folioLock_FlagUnlock(&pool->reclaimLock);
+
+	return registered;
+}
+
+bool
+folioInternalProvider_UnregisterReclaimer(FolioMemoryProvider *provider, FolioReclaimer callback, void *context)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	bool found = false;
+
+	folioLock_FlagLock(&pool->reclaimLock);
+	unsigned count = atomic_load(&pool->reclaimerCount);
+	for (unsigned i = 0; i < count; ++i) {
+		if (found) {
+			pool->reclaimers[i - 1] = pool->reclaimers[i];
+		} else if (pool->reclaimers[i].callback == callback && pool->reclaimers[i].context == context) {
+			found = true;
+		}
+	}
+	if (found) {
+		atomic_store(&pool->reclaimerCount, count - 1);
+	}
+	folioLock_FlagUnlock(&pool->reclaimLock);
+
+	return found;
+}
+
+void
+folioInternalProvider_SetPriorityClass(FolioMemoryProvider *provider, FolioPriority priority, size_t reserveBytes, size_t capBytes)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	folioPool_SetPriorityClass(pool, priority, reserveBytes, capBytes == SIZE_MAX ? UINT64_MAX : capBytes);
+}
+
+void
+folioInternalProvider_SetReclaimInterval(FolioMemoryProvider *provider, unsigned milliseconds)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	atomic_store(&pool->reclaimInterval, (uint64_t) milliseconds * 1000000);
+}
+
+void
+folioInternalProvider_SetScavengePolicy(FolioMemoryProvider *provider, size_t retainBytes, unsigned decayPercent)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+	trapIllegalValueIf(decayPercent > 100, "decayPercent %u must be at most 100", decayPercent);
+
+	atomic_store(&pool->scavengeRetain, retainBytes);
+	atomic_store(&pool->scavengeDecayPercent, decayPercent);
+}
+
+size_t
+folioInternalProvider_ScavengeLimit(const FolioMemoryProvider *provider, size_t idleBytes, size_t budget)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	size_t retain = atomic_load_explicit(&pool->scavengeRetain, memory_order_relaxed);
+	unsigned decayPercent = atomic_load_explicit(&pool->scavengeDecayPercent, memory_order_relaxed);
+
+	size_t limit = 0;
+	if (idleBytes > retain && decayPercent > 0) {
+		size_t excess = idleBytes - retain;
+
+		// Divide first so a large excess does not overflow
+		limit = excess / 100 * decayPercent + (excess % 100) * decayPercent / 100;
+		if (limit == 0) {
+			limit = 1;
+		}
+	}
+	return limit < budget ? limit : budget;
+}
+
+void
+folioInternalProvider_RecordScavenge(FolioMemoryProvider *provider, size_t bytes)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	atomic_fetch_add_explicit(&pool->scavengedBytes, bytes, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool->scavengeCount, 1, memory_order_relaxed);
+}
+
+/*
+ * The whole pages of a free reserved block after its link word.  These can be given
+ * back with madvise() and the block stays on a free list.
+ *
+ * @param start Set to the first page
+ * @return The length of the pages, may be 0
+ */
+static size_t
+_reserveBlockPages(const FolioReserveClass *class, void *block, uint8_t **start)
+{
+	uintptr_t pageMask = _mappedLength(1) - 1;
+	uintptr_t first = ((uintptr_t) block + sizeof(void *) + pageMask) & ~pageMask;
+	uintptr_t last = ((uintptr_t) block + class->blockLength) & ~pageMask;
+
+	*start = (uint8_t *) first;
+	return last > first ? last - first : 0;
+}
+
+/*
+ * Gives back the pages of idle reserved blocks, within the scavenge policy and budget.
+ * A locked reserve is left alone.
+ *
+ * @return The bytes given back
+ */
+static size_t
+_scavengeReserve(FolioMemoryProvider *provider, FolioPool *pool, size_t budget)
+{
+	FolioReserve *reserve = atomic_load_explicit(&pool->reserve, memory_order_acquire);
+	if (reserve == NULL || reserve->locked) {
+		return 0;
+	}
+
+	uint8_t *start;
+	size_t idleBytes = 0;
+	for (unsigned i = 0; i < reserve->classCount; ++i) {
+		FolioReserveClass *class = &reserve->classes[i];
+		folioLock_FlagLock(&class->lock);
+		for (void *block = class->freeList; block != NULL; block = *(void **) block) {
+			idleBytes += _reserveBlockPages(class, block, &start);
+		}
+		folioLock_FlagUnlock(&class->lock);
+	}
+
+	size_t limit = folioInternalProvider_ScavengeLimit(provider, idleBytes, budget);
+
+	size_t released = 0;
+	for (unsigned i = 0; i < reserve->classCount && released < limit; ++i) {
+		FolioReserveClass *class = &reserve->classes[i];
+
+		// The pages are given back under the lock, so no one can take the block first
+		folioLock_FlagLock(&class->lock);
+		void **previous = &class->freeList;
+		while (*previous != NULL) {
+			void *block = *previous;
+			size_t length = _reserveBlockPages(class, block, &start);
+			if (length > 0 && released + length <= limit && madvise(start, length, MADV_DONTNEED) == 0) {
+				*previous = *(void **) block;
+				*(void **) block = class->scavengedList;
+				class->scavengedList = block;
+				released += length;
+			} else {
+				previous = (void **) block;
+			}
+		}
+		folioLock_FlagUnlock(&class->lock);
+	}
+
+	return released;
+}
+
+size_t
+folioInternalProvider_Scavenge(FolioMemoryProvider *provider, size_t budget)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	size_t released = _scavengeReserve(provider, pool, budget);
+
+#ifdef __GLIBC__
+	// malloc_trim() gives back every free page it can, the budget does not apply.  The
+	// retained bytes stay at the top of the heap.
+	if (budget > 0 && atomic_load(&pool->scavengeDecayPercent) > 0) {
+		malloc_trim(atomic_load(&pool->scavengeRetain));
+	}
+#endif
+
+	folioInternalProvider_RecordScavenge(provider, released);
+	return released;
+}
+
+size_t
+folioInternalProvider_BlockLength(const FolioMemoryProvider *provider, size_t length)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	size_t trailerGuardLength = _calculateAlignedLength(length) - length;
+	return _computeTotalLength(pool, length, trailerGuardLength);
+}
+
+bool
+folioInternalProvider_Prefault(void *memory, size_t length, unsigned flags)
+{
+	if (flags & FolioReserveFlags_Populate) {
+		bool populated = false;
+#ifdef MADV_POPULATE_WRITE
+		populated = madvise(memory, length, MADV_POPULATE_WRITE) == 0;
+#endif
+		if (!populated) {
+			// One write per page faults it in
+			size_t pageSize = _mappedLength(1);
+			for (size_t offset = 0; offset < length; offset += pageSize) {
+				((volatile uint8_t *) memory)[offset] = 0;
+			}
+		}
+	}
+
+	bool locked = false;
+	if (flags & FolioReserveFlags_Lock) {
+		locked = mlock(memory, length) == 0;
+	}
+	return locked;
+}
+
+/*
+ * Sorts the hints by block length, drops duplicates and hints too large for a reserve
+ * class, and keeps at most FolioReserveMaximumClasses.
+ *
+ * @return The number of block lengths
+ */
+static unsigned
+_reserveBlockLengths(const FolioMemoryProvider *provider, FolioPool *pool, const size_t *sizeClassHints,
+		size_t blockLengths[FolioReserveMaximumClasses])
+{
+	static const size_t defaultHints[] = { 64, 256, 1024, 4096, 0 };
+	if (sizeClassHints == NULL) {
+		sizeClassHints = defaultHints;
+	}
+
+	unsigned count = 0;
+	for (const size_t *hint = sizeClassHints; *hint != 0 && count < FolioReserveMaximumClasses; ++hint) {
+		// Round to 16 bytes so every carved block is aligned like malloc() memory
+		size_t blockLength = (folioInternalProvider_BlockLength(provider, *hint) + 15) & ~(size_t) 15;
+		bool duplicate = false;
+		for (unsigned i = 0; i < count; ++i) {
+			duplicate |= blockLengths[i] == blockLength;
+		}
+
+		if (!duplicate && !_isLargeObject(pool, blockLength)) {
+			unsigned i = count++;
+			while (i > 0 && blockLengths[i - 1] > blockLength) {
+				blockLengths[i] = blockLengths[i - 1];
+				i--;
+			}
+			blockLengths[i] = blockLength;
+		}
+	}
+	return count;
+}
+
+size_t
+folioInternalProvider_ReserveBlocks(FolioMemoryProvider *provider, size_t bytes, const size_t *sizeClassHints, unsigned flags)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	if (pool->blockAllocator != NULL || atomic_load(&pool->reserve) != NULL) {
+		return 0;
+	}
+
+	size_t poolSize = (size_t) atomic_load(&pool->poolSize);
+	if (bytes > poolSize) {
+		bytes = poolSize;
+	}
+
+	size_t blockLengths[FolioReserveMaximumClasses];
+	unsigned classCount = _reserveBlockLengths(provider, pool, sizeClassHints, blockLengths);
+	if (classCount == 0) {
+		return 0;
+	}
+
+	size_t share = bytes / classCount;
+	size_t blockCounts[FolioReserveMaximumClasses];
+	size_t length = 0;
+	for (unsigned i = 0; i < classCount; ++i) {
+		blockCounts[i] = share / blockLengths[i];
+		length += blockCounts[i] * blockLengths[i];
+	}
+	if (length == 0) {
+		return 0;
+	}
+
+	int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+	if (flags & FolioReserveFlags_Populate) {
+		mapFlags |= MAP_POPULATE;
+		flags &= ~FolioReserveFlags_Populate;
+	}
+#endif
+
+	size_t mappingLength = _mappedLength(length);
+	uint8_t *mapping = mmap(NULL, mappingLength, PROT_READ | PROT_WRITE, mapFlags, -1, 0);
+	if (mapping == MAP_FAILED) {
+		return 0;
+	}
+
+	FolioReserve *reserve = calloc(1, sizeof(FolioReserve));
+	trapOutOfMemoryIf(reserve == NULL, "Could not allocate the reserve");
+
+	reserve->mapping = mapping;
+	reserve->mappingLength = mappingLength;
+	reserve->locked = folioInternalProvider_Prefault(mapping, mappingLength, flags);
+
+	uint8_t *next = mapping;
+	for (unsigned i = 0; i < classCount; ++i) {
+		FolioReserveClass *class = &reserve->classes[i];
+		atomic_flag_clear(&class->lock);
+		class->blockLength = blockLengths[i];
+		class->blocks = blockCounts[i];
+		class->start = next;
+
+		// Link the blocks in address order, so allocations walk the memory forwards
+		void **tail = &class->freeList;
+		for (size_t b = 0; b < blockCounts[i]; ++b) {
+			*tail = next;
+			tail = (void **) next;
+			next += blockLengths[i];
+		}
+		*tail = NULL;
+		class->end = next;
+	}
+	reserve->classCount = classCount;
+
+	FolioReserve *expected = NULL;
+	if (!atomic_compare_exchange_strong(&pool->reserve, &expected, reserve)) {
+		// Another thread reserved first
+		munmap(mapping, mappingLength);
+		free(reserve);
+		mappingLength = 0;
+	}
+
+	return mappingLength;
+}
+
+void
+folioInternalProvider_SetValidationLevel(FolioMemoryProvider *provider, FolioValidationLevel level, unsigned sampleInterval)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+	trapIllegalValueIf(level > FolioValidationLevel_FinalRelease, "Invalid validation level %d", level);
+
+	atomic_store(&pool->sampleInterval, sampleInterval);
+	atomic_store(&pool->validationLevel, level);
+}
+
+FolioValidationLevel
+folioInternalProvider_GetValidationLevel(const FolioMemoryProvider *provider)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	return atomic_load(&pool->validationLevel);
+}
+
+size_t
+folioInternalProvider_SoftLimitCount(const FolioMemoryProvider *provider)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+
+	return (size_t) atomic_load(&pool->softLimitCount);
 }
 
 size_t
@@ -576,10 +2137,17 @@ folioInternalProvider_AllocationSize(const FolioMemoryProvider *provider)
 	FolioPool *pool = folioPool_GetFromProvider(provider);
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
-	folioLock_FlagLock(&pool->allocationLock);
-	size_t size = pool->currentAllocation;
-	folioLock_FlagUnlock(&pool->allocationLock);
-	return size;
+	return (size_t) atomic_load(&pool->currentAllocation);
+}
+
+size_t
+folioInternalProvider_ClassAllocationSize(const FolioMemoryProvider *provider, unsigned priority)
+{
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
+	trapIllegalValueIf(priority >= FolioPriorityClasses, "priority %u must be less than %d", priority, FolioPriorityClasses);
+
+	return (size_t) atomic_load_explicit(&pool->priorityClasses[priority].current, memory_order_relaxed);
 }
 
 void
@@ -589,7 +2157,7 @@ folioInternalProvider_Lock(FolioMemoryProvider *provider, void *memory)
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
 	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
-	_validateInternal(pool, header);
+	_validateForLevel(pool, header);
 
 	folioHeader_Lock(header);
 }
@@ -601,7 +2169,7 @@ folioInternalProvider_Unlock(FolioMemoryProvider *provider, void *memory)
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
 	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
-	_validateInternal(pool, header);
+	_validateForLevel(pool, header);
 
 	folioHeader_Unlock(header);
 }
@@ -612,25 +2180,9 @@ folioInternalProvider_Report(const FolioMemoryProvider *provider, FILE *stream)
 	FolioPool *pool = folioPool_GetFromProvider(provider);
 	trapUnexpectedStateIf( !_verifyInternalProvider(pool), "provider pointer is not a FolioPool");
 
-	bool locked = atomic_flag_test_and_set(&pool->allocationLock);
-	if (!locked) {
-		atomic_flag_clear(&pool->allocationLock);
-	}
-
-	fprintf(stream, "Pool (%p) : hdrMagic 0x%08x provStateLen %u provHdrLen %u hdrAlgnLen %u hdrGrdLen %u "
-			" trlAlgnLen %u GrdByte 0x%02x IsLocked %d poolSize %zu alloc'd %d refCount %d\n",
-			(void *) pool,
-			pool->headerMagic,
-			pool->providerStateLength,
-			pool->providerHeaderLength,
-			pool->headerAlignedLength,
-			pool->headerGuardLength,
-			pool->trailerAlignedLength,
-			pool->guardPattern,
-			locked,
-			pool->poolSize,
-			pool->currentAllocation,
-			atomic_load(&pool->referenceCount));
+	char *poolString = folioPool_ToString(pool);
+	fprintf(stream, "%s", poolString);
+	free(poolString);
 }
 
 void
@@ -24,60 +24,21 @@
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <LongBow/runtime.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 #include <Folio/folio.h>
 #include <Folio/private/folio_Lock.h>
 
-struct folio_lock {
-	atomic_int referenceCount;
-	atomic_flag spinLock;
-	pthread_t lockingThreadId;
-};
-
-FolioLock *
-folioLock_Create(void)
-{
-	FolioLock *lock = calloc(1, sizeof(FolioLock));
-	if (lock) {
-		atomic_flag_clear(&lock->spinLock);
-		lock->referenceCount = ATOMIC_VAR_INIT(1);
-
-		// note that this thread does not really hold the lock, but
-		// we need to initialize it with something and as it is an
-		// opaque value this is all we have.
-		lock->lockingThreadId = pthread_self();
-	}
-
-	return lock;
-}
-
-FolioLock *
-folioLock_Acquire(const FolioLock *lock)
-{
-	assertNotNull(lock, "lock must be non-null");
-	FolioLock *copy = (FolioLock *) lock;
-	int prior = atomic_fetch_add(&copy->referenceCount, 1);
-	trapUnexpectedStateIf(prior == 0, "Acquire on memory with zero reference count");
-	return copy;
-}
-
-void
-folioLock_Release(FolioLock **lockPtr)
-{
-	assertNotNull(lockPtr, "lockPtr must be non-null");
-	assertNotNull(*lockPtr, "lockPtr must dereference to non-null");
-	FolioLock *lock = *lockPtr;
-	int prior = atomic_fetch_sub(&lock->referenceCount, 1);
-	trapUnexpectedStateIf(prior < 1, "Releasing memory with a refcount %d < 1", prior)
-	if (prior == 1) {
-		free(lock);
-	}
-	*lockPtr = NULL;
-}
-
 void
 folioLock_FlagLock(atomic_flag *flag)
 {
@@ -87,33 +48,43 @@ folioLock_FlagLock(atomic_flag *flag)
 	do {
 		prior = atomic_flag_test_and_set(flag);
 	} while (prior);
-
 }
+
 void
 folioLock_FlagUnlock(atomic_flag *flag)
 {
 	atomic_flag_clear(flag);
 }
 
+// Without a futex, the longest sleep before checking the word again
+#define _pollNanos 100000
+
 void
-folioLock_Lock(FolioLock *lock)
+folioLock_FutexWait(atomic_uint *word, unsigned expected, uint64_t timeoutNanos)
 {
-	assertNotNull(lock, "lock must be non-null");
-
-	folioLock_FlagLock(&lock->spinLock);
+#ifdef __linux__
+	// Long waits are cut to an hour, the caller waits again
+	if (timeoutNanos > 3600ULL * 1000000000ULL) {
+		timeoutNanos = 3600ULL * 1000000000ULL;
+	}
 
-	lock->lockingThreadId = pthread_self();
+	struct timespec timeout = { .tv_sec = (time_t) (timeoutNanos / 1000000000ULL), .tv_nsec = (long) (timeoutNanos % 1000000000ULL) };
+	syscall(SYS_futex, (void *) word, FUTEX_WAIT_PRIVATE, expected, &timeout, NULL, 0);
+#else
+	if (atomic_load(word) == expected) {
+		struct timespec timeout = { .tv_sec = 0, .tv_nsec = (long) (timeoutNanos < _pollNanos ? timeoutNanos : _pollNanos) };
+		nanosleep(&timeout, NULL);
+	}
+#endif
 }
 
 void
-folioLock_Unlock(FolioLock *lock)
+folioLock_FutexWake(atomic_uint *word, unsigned count)
 {
-	if (pthread_equal(pthread_self(), lock->lockingThreadId)) {
-		folioLock_FlagUnlock(&lock->spinLock);
-	} else {
-		trapCannotObtainLock("Caller thread id not equal to locker thread id");
-	}
+#ifdef __linux__
+	syscall(SYS_futex, (void *) word, FUTEX_WAKE_PRIVATE, (int) count, NULL, NULL, 0);
+#else
+	(void) word;
+	(void) count;
+#endif
 }
-
-
-
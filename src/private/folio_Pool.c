@@ -31,19 +31,116 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <Folio/private/folio_Pool.h>
+#include <Folio/private/folio_Lock.h>
+
+// Slot 0 is never used, it is the id of a pool that has not registered
+static _Atomic(FolioMemoryProvider *) _registry[FolioMaximumPools];
+static atomic_uint _registryHint;
+
+/*
+ * Takes a free slot of the registry for the provider
+ */
+static uint32_t
+_register(FolioMemoryProvider *provider)
+{
+	unsigned start = atomic_fetch_add_explicit(&_registryHint, 1, memory_order_relaxed);
+	for (unsigned i = 0; i < FolioMaximumPools - 1; ++i) {
+		uint32_t id = 1 + (start + i) % (FolioMaximumPools - 1);
+		FolioMemoryProvider *expected = NULL;
+		if (atomic_compare_exchange_strong(&_registry[id], &expected, provider)) {
+			return id;
+		}
+	}
+	trapOutOfMemory("More than %d pools", FolioMaximumPools - 1);
+}
+
+FolioOwner
+folioPool_Owner(FolioPool *pool, FolioMemoryProvider *provider)
+{
+	uint32_t id = atomic_load_explicit(&pool->poolId, memory_order_relaxed);
+	if (id == 0) {
+		uint32_t newId = _register(provider);
+
+		// on failure, id is the id another thread registered
+		if (atomic_compare_exchange_strong(&pool->poolId, &id, newId)) {
+			id = newId;
+		} else {
+			atomic_store(&_registry[newId], NULL);
+		}
+	}
+
+	return (FolioOwner) { .poolId = id, .magic = pool->headerMagic };
+}
+
+void
+folioPool_Unregister(FolioPool *pool)
+{
+	uint32_t id = atomic_exchange(&pool->poolId, 0);
+	if (id != 0) {
+		atomic_store(&_registry[id], NULL);
+	}
+}
+
+FolioMemoryProvider *
+folioPool_GetOwner(const void *memory)
+{
+	trapIllegalValueIf(memory == NULL, "memory must be non-null");
+
+	const FolioOwner *owner = (const FolioOwner *) memory - 1;
+	FolioMemoryProvider *provider = NULL;
+	if (owner->poolId < FolioMaximumPools) {
+		provider = atomic_load_explicit(&_registry[owner->poolId], memory_order_acquire);
+	}
+
+	trapUnexpectedStateIf(provider == NULL || ((FolioPool *) provider->poolState)->headerMagic != owner->magic,
+			"Memory %p: invalid owner (memory underrun or not folio memory)", memory);
+	return provider;
+}
+
+/*
+ * The bytes a child pool holding `bytes` charges its parent, rounded up to whole chunks
+ */
+static uint64_t
+_parentCharge(const FolioPool *pool, uint64_t bytes)
+{
+	uint64_t chunks = bytes / pool->parentChunk + (bytes % pool->parentChunk != 0 ? 1 : 0);
+	return chunks > UINT64_MAX / pool->parentChunk ? UINT64_MAX : chunks * pool->parentChunk;
+}
+
+/*
+ * Appends a line for each child of the pool, each followed by its own children indented
+ */
+static char *
+_appendChildren(char *str, FolioPool *pool, unsigned depth)
+{
+	folioLock_FlagLock(&pool->childLock);
+	for (FolioPool *child = pool->firstChild; child != NULL; child = child->nextSibling) {
+		uint64_t current = atomic_load(&child->currentAllocation);
+
+		char *withChild = NULL;
+		asprintf(&withChild, "%s%*schild pool %p: %" PRIu64 " of %" PRIu64 " bytes, charged %" PRIu64 " (chunk %" PRIu64 ")\n",
+				str, 4 + 2 * depth, "", (void *) child, current, (uint64_t) atomic_load(&child->poolSize),
+				_parentCharge(child, current), child->parentChunk);
+		free(str);
+		str = _appendChildren(withChild, child, depth + 1);
+	}
+	folioLock_FlagUnlock(&pool->childLock);
+
+	return str;
+}
 
 char *
 folioPool_ToString(const FolioPool *pool)
 {
 	char *str = NULL;
 
-	bool locked = atomic_flag_test_and_set(&((FolioPool *)pool)->allocationLock);
-	if (!locked) {
-		atomic_flag_clear(&((FolioPool *)pool)->allocationLock);
-	}
-
 	asprintf(&str, "Pool (%p) : hdrMagic 0x%08x provStateLen %u provHdrLen %u hdrAlgnLen %u hdrGrdLen %u "
-			" trlAlgnLen %u GrdByte 0x%02x IsLocked %d poolSize %zu alloc'd %d refCount %d\n",
+			" trlAlgnLen %u GrdByte 0x%02x poolSize %" PRIu64 " softLimit %" PRIu64 " (crossed %" PRIu64 ")"
+			" alloc'd %" PRIu64 " refCount %d"
+			" largeObjects %" PRIu64 " (%" PRIu64 " bytes mapped, %" PRIu64 " total, threshold %zu)"
+			" scavenged %" PRIu64 " bytes in %" PRIu64 " calls (retain %zu, decay %u%%)"
+			" reclaimers %u reclaims %" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " ns total, %" PRIu64 " ns max, %" PRIu64 " skipped)"
+			" waiters %u (max %u) waits %" PRIu64 " (%" PRIu64 " ns total, %" PRIu64 " timeouts)\n",
 			(void *) pool,
 			pool->headerMagic,
 			pool->providerStateLength,
@@ -52,10 +149,352 @@ folioPool_ToString(const FolioPool *pool)
 			pool->headerGuardLength,
 			pool->trailerAlignedLength,
 			pool->guardPattern,
-			locked,
-			pool->poolSize,
-			pool->currentAllocation,
-			atomic_load(&((FolioPool *)pool)->referenceCount));
+			(uint64_t) atomic_load(&((FolioPool *)pool)->poolSize),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->softLimit),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->softLimitCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->currentAllocation),
+			atomic_load(&((FolioPool *)pool)->referenceCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->largeObjectCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->largeObjectBytes),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->largeObjectTotal),
+			atomic_load(&((FolioPool *)pool)->largeObjectThreshold),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->scavengedBytes),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->scavengeCount),
+			atomic_load(&((FolioPool *)pool)->scavengeRetain),
+			atomic_load(&((FolioPool *)pool)->scavengeDecayPercent),
+			atomic_load(&((FolioPool *)pool)->reclaimerCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->reclaimCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->reclaimedBytes),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->reclaimNanos),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->reclaimMaxNanos),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->reclaimSkipped),
+			atomic_load(&((FolioPool *)pool)->waiters),
+			atomic_load(&((FolioPool *)pool)->maxWaiters),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->waitCount),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->waitNanos),
+			(uint64_t) atomic_load(&((FolioPool *)pool)->waitTimeouts));
 
-	return str;
+	for (unsigned i = 0; i < FolioPriorityClasses; ++i) {
+		FolioPriorityClass *class = &((FolioPool *)pool)->priorityClasses[i];
+		uint64_t cap = atomic_load(&class->cap);
+		uint64_t current = atomic_load(&class->current);
+		uint64_t denials = atomic_load(&class->denials);
+		uint64_t reserve = atomic_load(&class->reserve);
+
+		if (current > 0 || denials > 0 || reserve > 0 || cap != UINT64_MAX) {
+			char *withClass = NULL;
+			if (cap != UINT64_MAX) {
+				asprintf(&withClass, "%s    priority %u: %" PRIu64 " bytes (reserve %" PRIu64 ", cap %" PRIu64 ") denials %" PRIu64 "\n",
+						str, i, current, reserve, cap, denials);
+			} else {
+				asprintf(&withClass, "%s    priority %u: %" PRIu64 " bytes (reserve %" PRIu64 ", no cap) denials %" PRIu64 "\n",
+						str, i, current, reserve, denials);
+			}
+			free(str);
+			str = withClass;
+		}
+	}
+
+	if (atomic_load(&((FolioPool *)pool)->waitCount) > 0) {
+		char *withWaits = NULL;
+		asprintf(&withWaits, "%s    wait histogram (<1 usec, then 4x per bucket):", str);
+		free(str);
+		str = withWaits;
+
+		for (unsigned i = 0; i < FolioWaitHistogramBuckets; ++i) {
+			asprintf(&withWaits, "%s %" PRIu64, str, (uint64_t) atomic_load(&((FolioPool *)pool)->waitHistogram[i]));
+			free(str);
+			str = withWaits;
+		}
+
+		asprintf(&withWaits, "%s\n", str);
+		free(str);
+		str = withWaits;
+	}
+
+	FolioReserve *reserve = atomic_load(&((FolioPool *)pool)->reserve);
+	if (reserve != NULL) {
+		size_t blocks = 0;
+		size_t blocksInUse = 0;
+		size_t bytesInUse = 0;
+		for (unsigned i = 0; i < reserve->classCount; ++i) {
+			FolioReserveClass *class = &reserve->classes[i];
+			folioLock_FlagLock(&class->lock);
+			blocks += class->blocks;
+			blocksInUse += class->blocksInUse;
+			bytesInUse += class->blocksInUse * class->blockLength;
+			folioLock_FlagUnlock(&class->lock);
+		}
+
+		char *withReserve = NULL;
+		asprintf(&withReserve, "%s    reserved %zu bytes%s, %zu bytes used (%zu of %zu blocks)\n",
+				str, reserve->mappingLength, reserve->locked ? " locked" : "", bytesInUse, blocksInUse, blocks);
+		free(str);
+		str = withReserve;
+	}
+
+	if (pool->parent != NULL) {
+		char *withParent = NULL;
+		asprintf(&withParent, "%s    child of pool %p, charged %" PRIu64 " bytes (chunk %" PRIu64 ")\n",
+				str, (void *) pool->parent, _parentCharge(pool, atomic_load(&((FolioPool *)pool)->currentAllocation)),
+				pool->parentChunk);
+		free(str);
+		str = withParent;
+	}
+
+	return _appendChildren(str, (FolioPool *) pool, 0);
+}
+
+static uint64_t
+_addSaturated(uint64_t a, uint64_t b)
+{
+	return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+/*
+ * Counts length bytes in the class, if the class stays under its cap and every class,
+ * counted as the larger of its bytes and its reserve, still fits in the pool.
+ */
+static bool
+_reserveLimitedClass(FolioPool *pool, unsigned priority, size_t length)
+{
+	bool reserved = false;
+
+	folioLock_FlagLock(&pool->priorityLock);
+	FolioPriorityClass *class = &pool->priorityClasses[priority];
+	uint64_t current = atomic_load_explicit(&class->current, memory_order_relaxed);
+	uint64_t cap = atomic_load_explicit(&class->cap, memory_order_relaxed);
+
+	if (current <= cap && length <= cap - current) {
+		uint64_t committed = 0;
+		for (unsigned i = 0; i < FolioPriorityClasses; ++i) {
+			uint64_t bytes = atomic_load_explicit(&pool->priorityClasses[i].current, memory_order_relaxed);
+			if (i == priority) {
+				bytes += length;
+			}
+			uint64_t reserve = atomic_load_explicit(&pool->priorityClasses[i].reserve, memory_order_relaxed);
+			committed = _addSaturated(committed, bytes > reserve ? bytes : reserve);
+		}
+
+		if (committed <= atomic_load_explicit(&pool->poolSize, memory_order_relaxed)) {
+			atomic_fetch_add_explicit(&class->current, length, memory_order_relaxed);
+			reserved = true;
+		}
+	}
+	folioLock_FlagUnlock(&pool->priorityLock);
+
+	return reserved;
+}
+
+bool
+folioPool_Reserve(FolioPool *pool, unsigned priority, size_t length, bool *crossedSoftLimit)
+{
+	trapIllegalValueIf(priority >= FolioPriorityClasses, "priority %u must be less than %d", priority, FolioPriorityClasses);
+
+	*crossedSoftLimit = false;
+
+	FolioPriorityClass *class = &pool->priorityClasses[priority];
+	if (atomic_load_explicit(&pool->priorityLimited, memory_order_relaxed)) {
+		if (!_reserveLimitedClass(pool, priority, length)) {
+			atomic_fetch_add_explicit(&class->denials, 1, memory_order_relaxed);
+			return false;
+		}
+	} else {
+		atomic_fetch_add_explicit(&class->current, length, memory_order_relaxed);
+	}
+
+	bool reserved = false;
+	bool retry = true;
+	uint64_t current = atomic_load_explicit(&pool->currentAllocation, memory_order_relaxed);
+
+	// The limits may change while we spin, that is fine.  Each attempt checks
+	// against the values it read.
+	while (retry) {
+		uint64_t hardLimit = atomic_load_explicit(&pool->poolSize, memory_order_relaxed);
+		if (current <= hardLimit && length <= hardLimit - current) {
+			// A child first charges its parent for any chunks this reservation starts.
+			// Each successful swap from current adds exactly its own chunks, so the parent
+			// always holds the child's currentAllocation rounded up to a chunk.
+			uint64_t charge = 0;
+			if (pool->parent != NULL) {
+				charge = _parentCharge(pool, current + length) - _parentCharge(pool, current);
+				bool parentCrossed;
+				if (charge > 0 && !folioPool_Reserve(pool->parent, FolioPriority_Normal, charge, &parentCrossed)) {
+					break;
+				}
+			}
+
+			// on failure, current is updated to the latest value
+			reserved = atomic_compare_exchange_weak_explicit(&pool->currentAllocation, &current, current + length,
+									memory_order_relaxed, memory_order_relaxed);
+			retry = !reserved;
+			if (!reserved && charge > 0) {
+				folioPool_Unreserve(pool->parent, FolioPriority_Normal, charge);
+			}
+		} else {
+			retry = false;
+		}
+	}
+
+	if (reserved) {
+		uint64_t softLimit = atomic_load_explicit(&pool->softLimit, memory_order_relaxed);
+		if (current <= softLimit && current + length > softLimit) {
+			atomic_fetch_add_explicit(&pool->softLimitCount, 1, memory_order_relaxed);
+			*crossedSoftLimit = true;
+		}
+	} else {
+		atomic_fetch_sub_explicit(&class->current, length, memory_order_relaxed);
+		atomic_fetch_add_explicit(&class->denials, 1, memory_order_relaxed);
+	}
+
+	return reserved;
+}
+
+bool
+folioPool_CanEverReserve(const FolioPool *pool, unsigned priority, size_t length)
+{
+	trapIllegalValueIf(priority >= FolioPriorityClasses, "priority %u must be less than %d", priority, FolioPriorityClasses);
+
+	uint64_t bytes = length;
+	for (;;) {
+		if (bytes > atomic_load_explicit(&pool->poolSize, memory_order_relaxed)
+				|| bytes > atomic_load_explicit(&pool->priorityClasses[priority].cap, memory_order_relaxed)) {
+			return false;
+		}
+		if (pool->parent == NULL) {
+			return true;
+		}
+
+		// A child charges its parent whole chunks, in the parent's Normal class
+		bytes = _parentCharge(pool, bytes);
+		priority = FolioPriority_Normal;
+		pool = pool->parent;
+	}
+}
+
+/*
+ * Wakes the first waiter of each descendant pool.  Its reservation may have failed
+ * in this pool, whose release it would otherwise never hear about.
+ */
+static void
+_wakeDescendantWaiters(FolioPool *pool)
+{
+	folioLock_FlagLock(&pool->childLock);
+	for (FolioPool *child = pool->firstChild; child != NULL; child = child->nextSibling) {
+		if (atomic_load(&child->waiters) > 0) {
+			folioLock_FlagLock(&child->waitLock);
+			if (child->waitHead != NULL) {
+				folioPool_WakeWaiter(child->waitHead);
+			}
+			folioLock_FlagUnlock(&child->waitLock);
+		}
+		if (atomic_load(&child->descendantWaiters) > 0) {
+			_wakeDescendantWaiters(child);
+		}
+	}
+	folioLock_FlagUnlock(&pool->childLock);
+}
+
+void
+folioPool_Unreserve(FolioPool *pool, unsigned priority, size_t length)
+{
+	uint64_t priorClass = atomic_fetch_sub_explicit(&pool->priorityClasses[priority].current, length, memory_order_relaxed);
+	trapIllegalValueIf(priorClass < length, "priority %u allocation less than length", priority);
+
+	// Sequentially consistent, so either a thread that starts waiting sees this memory,
+	// or the caller sees the waiter and wakes it.  Free on x86, a locked instruction anyway.
+	uint64_t prior = atomic_fetch_sub_explicit(&pool->currentAllocation, length, memory_order_seq_cst);
+	trapIllegalValueIf(prior < length, "current allocation less than length");
+
+	if (pool->parent != NULL) {
+		uint64_t refund = _parentCharge(pool, prior) - _parentCharge(pool, prior - length);
+		if (refund > 0) {
+			folioPool_Unreserve(pool->parent, FolioPriority_Normal, refund);
+		}
+	}
+
+	if (atomic_load(&pool->waiters) > 0) {
+		folioLock_FlagLock(&pool->waitLock);
+		if (pool->waitHead != NULL) {
+			folioPool_WakeWaiter(pool->waitHead);
+		}
+		folioLock_FlagUnlock(&pool->waitLock);
+	}
+
+	if (atomic_load(&pool->descendantWaiters) > 0) {
+		_wakeDescendantWaiters(pool);
+	}
+}
+
+void
+folioPool_WakeWaiter(FolioWaiter *waiter)
+{
+	atomic_store(&waiter->wakeup, 1);
+	folioLock_FutexWake(&waiter->wakeup, 1);
+}
+
+void
+folioPool_CountDescendantWaiter(FolioPool *pool, int delta)
+{
+	for (FolioPool *ancestor = pool->parent; ancestor != NULL; ancestor = ancestor->parent) {
+		atomic_fetch_add(&ancestor->descendantWaiters, (unsigned) delta);
+	}
+}
+
+void
+folioPool_Attach(FolioPool *pool, FolioPool *parent, uint64_t chunk)
+{
+	trapIllegalValueIf(pool->parent != NULL, "pool %p already has a parent", (void *) pool);
+	trapIllegalValueIf(atomic_load(&pool->currentAllocation) > 0, "pool %p has memory reserved", (void *) pool);
+	trapIllegalValueIf(chunk == 0, "chunk must be positive");
+
+	pool->parentChunk = chunk;
+	pool->parent = parent;
+
+	folioLock_FlagLock(&parent->childLock);
+	pool->nextSibling = parent->firstChild;
+	parent->firstChild = pool;
+	folioLock_FlagUnlock(&parent->childLock);
+}
+
+void
+folioPool_Detach(FolioPool *pool)
+{
+	FolioPool *parent = pool->parent;
+
+	folioLock_FlagLock(&parent->childLock);
+	FolioPool **link = &parent->firstChild;
+	while (*link != pool) {
+		link = &(*link)->nextSibling;
+	}
+	*link = pool->nextSibling;
+	folioLock_FlagUnlock(&parent->childLock);
+
+	// The pool may be released with memory outstanding
+	uint64_t charged = _parentCharge(pool, atomic_load(&pool->currentAllocation));
+	if (charged > 0) {
+		folioPool_Unreserve(parent, FolioPriority_Normal, charged);
+	}
+
+	pool->parent = NULL;
+	pool->nextSibling = NULL;
+}
+
+void
+folioPool_SetPriorityClass(FolioPool *pool, unsigned priority, uint64_t reserveBytes, uint64_t capBytes)
+{
+	trapIllegalValueIf(priority >= FolioPriorityClasses, "priority %u must be less than %d", priority, FolioPriorityClasses);
+
+	folioLock_FlagLock(&pool->priorityLock);
+	atomic_store(&pool->priorityClasses[priority].reserve, reserveBytes);
+	atomic_store(&pool->priorityClasses[priority].cap, capBytes);
+
+	bool limited = false;
+	for (unsigned i = 0; i < FolioPriorityClasses; ++i) {
+		if (atomic_load(&pool->priorityClasses[i].reserve) > 0 || atomic_load(&pool->priorityClasses[i].cap) != UINT64_MAX) {
+			limited = true;
+		}
+	}
+	atomic_store(&pool->priorityLimited, limited);
+	folioLock_FlagUnlock(&pool->priorityLock);
 }
@@ -0,0 +1,200 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LongBow/runtime.h>
+#include <pthread.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <Folio/private/folio_Stats.h>
+
+// The next shard to hand to a thread
+static atomic_uint _nextShard = ATOMIC_VAR_INIT(0);
+
+// The shard of the current thread, or -1 before its first use
+static __thread int _threadShard = -1;
+
+static FolioStatsShard *
+_getShard(FolioStats *stats)
+{
+	if (_threadShard < 0) {
+		_threadShard = (int) (atomic_fetch_add_explicit(&_nextShard, 1, memory_order_relaxed) % FolioStatsShardCount);
+	}
+
+	FolioStatsShard *shard = &stats->shards[_threadShard];
+
+	// Record who uses the shard.  This is a load and compare once the shard is claimed.
+	uintptr_t self = (uintptr_t) pthread_self();
+	uintptr_t owner = atomic_load_explicit(&shard->owner, memory_order_relaxed);
+	if (owner != self) {
+		if (owner != 0 || !atomic_compare_exchange_strong(&shard->owner, &owner, self)) {
+			if (!atomic_load_explicit(&shard->shared, memory_order_relaxed)) {
+				atomic_store_explicit(&shard->shared, true, memory_order_relaxed);
+			}
+		}
+	}
+
+	return shard;
+}
+
+void
+folioStats_Initialize(FolioStats *stats)
+{
+	assertNotNull(stats, "stats must be non-null");
+	memset(stats, 0, sizeof(FolioStats));
+}
+
+void
+folioStats_Allocate(FolioStats *stats, bool success)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	if (success) {
+		atomic_fetch_add_explicit(&shard->outstandingAllocs, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&shard->outstandingAcquires, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&shard->allocations, 1, memory_order_relaxed);
+	} else {
+		atomic_fetch_add_explicit(&shard->outOfMemoryCount, 1, memory_order_relaxed);
+	}
+}
+
+void
+folioStats_AllocateBatch(FolioStats *stats, size_t allocated, size_t failed)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	if (allocated > 0) {
+		atomic_fetch_add_explicit(&shard->outstandingAllocs, (int64_t) allocated, memory_order_relaxed);
+		atomic_fetch_add_explicit(&shard->outstandingAcquires, (int64_t) allocated, memory_order_relaxed);
+		atomic_fetch_add_explicit(&shard->allocations, allocated, memory_order_relaxed);
+	}
+	if (failed > 0) {
+		atomic_fetch_add_explicit(&shard->outOfMemoryCount, failed, memory_order_relaxed);
+	}
+}
+
+void
+folioStats_Acquire(FolioStats *stats)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	atomic_fetch_add_explicit(&shard->outstandingAcquires, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->acquires, 1, memory_order_relaxed);
+}
+
+void
+folioStats_AcquireN(FolioStats *stats, size_t n)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	atomic_fetch_add_explicit(&shard->outstandingAcquires, (int64_t) n, memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->acquires, n, memory_order_relaxed);
+}
+
+void
+folioStats_Release(FolioStats *stats, bool finalRelease)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	atomic_fetch_sub_explicit(&shard->outstandingAcquires, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->releases, 1, memory_order_relaxed);
+	if (finalRelease) {
+		atomic_fetch_sub_explicit(&shard->outstandingAllocs, 1, memory_order_relaxed);
+	}
+}
+
+void
+folioStats_ReleaseBatch(FolioStats *stats, size_t releases, size_t finalReleases)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	atomic_fetch_sub_explicit(&shard->outstandingAcquires, (int64_t) releases, memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->releases, releases, memory_order_relaxed);
+	if (finalReleases > 0) {
+		atomic_fetch_sub_explicit(&shard->outstandingAllocs, (int64_t) finalReleases, memory_order_relaxed);
+	}
+}
+
+void
+folioStats_Discard(FolioStats *stats, size_t allocs, size_t acquires)
+{
+	FolioStatsShard *shard = _getShard(stats);
+	atomic_fetch_sub_explicit(&shard->outstandingAllocs, (int64_t) allocs, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&shard->outstandingAcquires, (int64_t) acquires, memory_order_relaxed);
+}
+
+void
+folioStats_Sum(const FolioStats *stats, FolioStatsSnapshot *sum)
+{
+	assertNotNull(stats, "stats must be non-null");
+	assertNotNull(sum, "sum must be non-null");
+
+	int64_t outstandingAllocs = 0;
+	int64_t outstandingAcquires = 0;
+	memset(sum, 0, sizeof(FolioStatsSnapshot));
+
+	for (int i = 0; i < FolioStatsShardCount; ++i) {
+		FolioStatsShard *shard = (FolioStatsShard *) &stats->shards[i];
+		outstandingAllocs += atomic_load_explicit(&shard->outstandingAllocs, memory_order_relaxed);
+		outstandingAcquires += atomic_load_explicit(&shard->outstandingAcquires, memory_order_relaxed);
+		sum->allocations += atomic_load_explicit(&shard->allocations, memory_order_relaxed);
+		sum->acquires += atomic_load_explicit(&shard->acquires, memory_order_relaxed);
+		sum->releases += atomic_load_explicit(&shard->releases, memory_order_relaxed);
+		sum->outOfMemoryCount += atomic_load_explicit(&shard->outOfMemoryCount, memory_order_relaxed);
+	}
+
+	sum->outstandingAllocs = (size_t) outstandingAllocs;
+	sum->outstandingAcquires = (size_t) outstandingAcquires;
+}
+
+size_t
+folioStats_OutstandingAcquires(const FolioStats *stats)
+{
+	assertNotNull(stats, "stats must be non-null");
+
+	int64_t outstandingAcquires = 0;
+	for (int i = 0; i < FolioStatsShardCount; ++i) {
+		FolioStatsShard *shard = (FolioStatsShard *) &stats->shards[i];
+		outstandingAcquires += atomic_load_explicit(&shard->outstandingAcquires, memory_order_relaxed);
+	}
+	return (size_t) outstandingAcquires;
+}
+
+void
+folioStats_ReportThreads(const FolioStats *stats, FILE *stream)
+{
+	assertNotNull(stats, "stats must be non-null");
+
+	for (int i = 0; i < FolioStatsShardCount; ++i) {
+		FolioStatsShard *shard = (FolioStatsShard *) &stats->shards[i];
+		uintptr_t owner = atomic_load_explicit(&shard->owner, memory_order_relaxed);
+		if (owner != 0) {
+			fprintf(stream, "   shard %2d thread %#" PRIxPTR "%s: allocs %" PRIu64 " acquires %" PRIu64
+					" releases %" PRIu64 " outOfMemory %" PRIu64 "\n",
+					i,
+					owner,
+					atomic_load_explicit(&shard->shared, memory_order_relaxed) ? " (shared)" : "",
+					(uint64_t) atomic_load_explicit(&shard->allocations, memory_order_relaxed),
+					(uint64_t) atomic_load_explicit(&shard->acquires, memory_order_relaxed),
+					(uint64_t) atomic_load_explicit(&shard->releases, memory_order_relaxed),
+					(uint64_t) atomic_load_explicit(&shard->outOfMemoryCount, memory_order_relaxed));
+		}
+	}
+}
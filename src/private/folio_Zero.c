@@ -0,0 +1,100 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <Folio/private/folio_Zero.h>
+
+#ifdef __SSE2__
+/*
+ * Streams zeros over the cache line aligned middle of the memory.  The stores
+ * are weakly ordered, so fence before anyone else may see the memory.
+ */
+static void
+_clearNonTemporal(void *memory, size_t length)
+{
+	uint8_t *p = memory;
+	uint8_t *end = p + length;
+
+	uint8_t *lineStart = (uint8_t *) (((uintptr_t) p + 63) & ~(uintptr_t) 63);
+	uint8_t *lineEnd = (uint8_t *) ((uintptr_t) end & ~(uintptr_t) 63);
+
+	if (lineEnd <= lineStart) {
+		memset(p, 0, length);
+		return;
+	}
+
+	memset(p, 0, lineStart - p);
+
+	const __m128i zero = _mm_setzero_si128();
+	for (uint8_t *q = lineStart; q < lineEnd; q += 64) {
+		_mm_stream_si128((__m128i *) q, zero);
+		_mm_stream_si128((__m128i *) (q + 16), zero);
+		_mm_stream_si128((__m128i *) (q + 32), zero);
+		_mm_stream_si128((__m128i *) (q + 48), zero);
+	}
+	_mm_sfence();
+
+	memset(lineEnd, 0, end - lineEnd);
+}
+#endif
+
+// 0 until the first call computes it.  Threads that race to compute it store the same value.
+static atomic_size_t _threshold = ATOMIC_VAR_INIT(0);
+
+size_t
+folioZero_NonTemporalThreshold(void)
+{
+	size_t threshold = atomic_load_explicit(&_threshold, memory_order_relaxed);
+	if (threshold == 0) {
+		long cacheSize = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+		cacheSize = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+		threshold = cacheSize > 0 ? (size_t) cacheSize / 4 * 3 : FolioZeroDefaultNonTemporalThreshold;
+		atomic_store_explicit(&_threshold, threshold, memory_order_relaxed);
+	}
+	return threshold;
+}
+
+void
+folioZero_Clear(void *memory, size_t length)
+{
+#ifdef __SSE2__
+	if (length >= folioZero_NonTemporalThreshold()) {
+		_clearNonTemporal(memory, length);
+		return;
+	}
+#endif
+	memset(memory, 0, length);
+}
@@ -50,7 +50,6 @@ LONGBOW_TEST_FIXTURE(Global)
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_CompareMagic);
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_DecrementReferenceCount);
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_ExecuteFinalizer);
-    LONGBOW_RUN_TEST_CASE(Global, folioHeader_Finalize);
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_GetFinalizer);
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_GetHeaderGuardAddress);
     LONGBOW_RUN_TEST_CASE(Global, folioHeader_GetMemoryHeader);
@@ -101,11 +100,6 @@ LONGBOW_TEST_CASE(Global, folioHeader_ExecuteFinalizer)
 
 }
 
-LONGBOW_TEST_CASE(Global, folioHeader_Finalize)
-{
-
-}
-
 LONGBOW_TEST_CASE(Global, folioHeader_GetFinalizer)
 {
 
@@ -158,7 +152,14 @@ LONGBOW_TEST_CASE(Global, folioHeader_Invalidate)
 
 LONGBOW_TEST_CASE(Global, folioHeader_Lock)
 {
+	FolioHeader header;
+	folioHeader_Initialize(&header, 123, 500, 1, 0, NULL, 0, 0);
 
+	folioHeader_Lock(&header);
+	bool wasLocked = atomic_flag_test_and_set(&header.xspinLock);
+	assertTrue(wasLocked, "Header spin lock should be set");
+	assertTrue(pthread_equal(header.xlockingThreadId, pthread_self()), "Locker should be this thread");
+	folioHeader_Unlock(&header);
 }
 
 LONGBOW_TEST_CASE(Global, folioHeader_ProviderDataLength)
@@ -183,7 +184,14 @@ LONGBOW_TEST_CASE(Global, folioHeader_ToString)
 
 LONGBOW_TEST_CASE(Global, folioHeader_Unlock)
 {
+	FolioHeader header;
+	folioHeader_Initialize(&header, 123, 500, 1, 0, NULL, 0, 0);
+
+	folioHeader_Lock(&header);
+	folioHeader_Unlock(&header);
 
+	bool wasLocked = atomic_flag_test_and_set(&header.xspinLock);
+	assertFalse(wasLocked, "Header spin lock should be clear after unlock");
 }
 
 /*****************************************************/
@@ -29,6 +29,7 @@
 
 #include <LongBow/unit-test.h>
 #include <Folio/folio.h>
+#include <pthread.h>
 
 /* **************************************** */
 typedef struct mockup_stats {
@@ -40,6 +41,70 @@ static const FolioMemoryProvider MockupProviderTemplate;
 
 static const size_t mockup_memory = 256;
 
+static unsigned _softLimitCalls;
+static size_t _softLimitAllocatedBytes;
+
+static void
+_softLimitCallback(FolioMemoryProvider *provider __attribute__((unused)), size_t allocatedBytes,
+		size_t softLimit __attribute__((unused)))
+{
+	_softLimitCalls++;
+	_softLimitAllocatedBytes = allocatedBytes;
+}
+
+typedef struct reclaimer_context {
+	unsigned id;
+	void *memory;
+	size_t length;
+} ReclaimerContext;
+
+static unsigned _reclaimOrder[16];
+static unsigned _reclaimCalls;
+
+static size_t
+_reclaimer(FolioMemoryProvider *provider, size_t targetBytes __attribute__((unused)), void *context)
+{
+	ReclaimerContext *reclaimer = context;
+	_reclaimOrder[_reclaimCalls++] = reclaimer->id;
+
+	size_t length = 0;
+	if (reclaimer->memory) {
+		folioInternalProvider_ReleaseMemory(provider, &reclaimer->memory);
+		length = reclaimer->length;
+	}
+	return length;
+}
+
+typedef struct waiter_context {
+	FolioMemoryProvider *provider;
+	size_t length;
+	bool keep;
+	void *memory;
+	unsigned sequence;
+} WaiterContext;
+
+static atomic_uint _waitSequence;
+
+static void *
+_waiterThread(void *arg)
+{
+	WaiterContext *waiter = arg;
+	waiter->memory = folioInternalProvider_AllocateWait(waiter->provider, waiter->length, NULL, FolioWaitForever);
+	waiter->sequence = atomic_fetch_add(&_waitSequence, 1);
+	if (!waiter->keep) {
+		folioInternalProvider_ReleaseMemory(waiter->provider, &waiter->memory);
+	}
+	return NULL;
+}
+
+static void
+_waitForWaiters(FolioPool *pool, unsigned waiters)
+{
+	while (atomic_load(&pool->waiters) < waiters) {
+		usleep(100);
+	}
+}
+
 /* **************************************** */
 
 LONGBOW_TEST_RUNNER(folio_InternalProvider)
@@ -61,9 +126,19 @@ LONGBOW_TEST_RUNNER_TEARDOWN(folio_InternalProvider)
 LONGBOW_TEST_FIXTURE(Global)
 {
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Acquire);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AcquireUnchecked);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AcquireN);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AcquireProvider);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Allocate);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateAligned);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateAligned_Small);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateAligned_Reallocate);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateBatch);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateBatch_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateWait);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateWait_Fifo);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocateWait_Timeout);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_AllocationSize);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Create_NoState);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Create_WithState);
@@ -72,12 +147,33 @@ LONGBOW_TEST_FIXTURE(Global)
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_GetProviderHeaderLength);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_GetProviderState);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_GetProviderStateLength);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_LargeObject);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_LargeObject_Reallocate);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Length);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Lock);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Reallocate);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Reallocate_Shared);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Reallocate_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_Full);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_RateLimit);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_SoftLimit);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReleaseMemory);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReleaseBatch);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReleaseMemoryN);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReleaseProvider);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReserveBlocks);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ReserveBlocks_Reallocate);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Report);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_ScavengeLimit);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Scavenge);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Scavenge_Reserve);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetAvailableMemory);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetPriorityClass);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetPriorityClass_Reallocate);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetSoftLimit);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetValidationLevel_MagicOnly);
+    LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_SetValidationLevel_FinalRelease);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Unlock);
     LONGBOW_RUN_TEST_CASE(Global, folioInternalProvider_Validate);
 }
@@ -104,6 +200,54 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_Acquire)
 
 }
 
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AcquireUnchecked)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory = folioInternalProvider_Allocate(provider, 64, NULL);
+	void *copy = folioInternalProvider_AcquireUnchecked(provider, memory);
+	assertTrue(copy == memory, "Wrong pointer, expected %p got %p", memory, copy);
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, folioPool_GetFromProvider(provider));
+	int refcount = folioHeader_ReferenceCount(header);
+	assertTrue(refcount == 2, "Expected reference count 2, got %d", refcount);
+
+	bool finalRelease = folioInternalProvider_ReleaseMemoryUnchecked(provider, &copy);
+	assertFalse(finalRelease, "First release should not be final");
+	assertNull(copy, "Release did not null the pointer");
+
+	finalRelease = folioInternalProvider_ReleaseMemoryUnchecked(provider, &memory);
+	assertTrue(finalRelease, "Second release should be final");
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 0, "Expected 0 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AcquireN)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory = folioInternalProvider_Allocate(provider, 64, NULL);
+	void *copy = folioInternalProvider_AcquireN(provider, memory, 5);
+	assertTrue(copy == memory, "Wrong pointer, expected %p got %p", memory, copy);
+
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, folioPool_GetFromProvider(provider));
+	int refcount = folioHeader_ReferenceCount(header);
+	assertTrue(refcount == 6, "Expected reference count 6, got %d", refcount);
+
+	for (int i = 0; i < 6; i++) {
+		void *reference = memory;
+		folioInternalProvider_ReleaseMemory(provider, &reference);
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 0, "Expected 0 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_AcquireProvider)
 {
 
@@ -116,7 +260,241 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_Allocate)
 
 LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateAndZero)
 {
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	folioInternalProvider_SetLargeObjectThreshold(provider, 4096);
+
+	// A calloc() block and a mapped block
+	const size_t lengths[] = { 100, 10000 };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		uint8_t *memory = folioInternalProvider_AllocateAndZero(provider, lengths[i], NULL);
+		assertNotNull(memory, "Allocate %zu failed", lengths[i]);
+		for (size_t j = 0; j < lengths[i]; j++) {
+			assertTrue(memory[j] == 0, "Length %zu byte %zu not zero", lengths[i], j);
+		}
+		folioInternalProvider_Validate(provider, memory);
+		folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	}
 
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateAligned)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	const size_t alignments[] = { 16, 32, 64, 4096 };
+	for (size_t i = 0; i < sizeof(alignments) / sizeof(size_t); i++) {
+		void *memory = folioInternalProvider_AllocateAligned(provider, 100, alignments[i], NULL);
+		assertNotNull(memory, "Allocate aligned to %zu failed", alignments[i]);
+		assertTrue(((uintptr_t) memory & (alignments[i] - 1)) == 0, "Memory %p not aligned to %zu", memory, alignments[i]);
+
+		// The header is still at the fixed offset
+		FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+		assertTrue(1U << folioHeader_GetAlignmentShift(header) == alignments[i], "Wrong alignment shift %u",
+				folioHeader_GetAlignmentShift(header));
+
+		memset(memory, 0x5A, 100);
+		folioInternalProvider_Validate(provider, memory);
+		assertTrue(folioInternalProvider_Length(provider, memory) == 100, "Wrong length");
+
+		size_t current = folioInternalProvider_AllocationSize(provider);
+		assertTrue(current == 100, "Expected 100 bytes allocated, got %zu", current);
+
+		bool finalRelease = folioInternalProvider_ReleaseMemory(provider, &memory);
+		assertTrue(finalRelease, "Release should be final");
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 0, "Expected 0 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateAligned_Small)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	// Every allocation already has this alignment, so there is no padding
+	void *memory = folioInternalProvider_AllocateAligned(provider, 100, sizeof(void *), NULL);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, folioPool_GetFromProvider(provider));
+	assertTrue(folioHeader_GetAlignmentShift(header) == 0, "Expected no alignment shift, got %u",
+			folioHeader_GetAlignmentShift(header));
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateAligned_Reallocate)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	uint8_t *memory = folioInternalProvider_AllocateAligned(provider, 64, 256, NULL);
+	memset(memory, 0x5A, 64);
+
+	const size_t lengths[] = { 200, 20 };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		void *result = folioInternalProvider_Reallocate(provider, (void **) &memory, lengths[i]);
+		assertNotNull(result, "Reallocate to %zu failed", lengths[i]);
+		assertTrue(((uintptr_t) memory & 255) == 0, "Memory %p lost its alignment", (void *) memory);
+		assertTrue(memory[0] == 0x5A && memory[19] == 0x5A, "Lost the contents at length %zu", lengths[i]);
+		folioInternalProvider_Validate(provider, memory);
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 20, "Expected 20 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateBatch)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory[4];
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, 4, 10, NULL, memory);
+	assertTrue(allocated == 4, "Expected 4 allocations, got %zu", allocated);
+
+	for (int i = 0; i < 4; i++) {
+		assertNotNull(memory[i], "Memory %d is null", i);
+		memset(memory[i], 0x5A, 10);
+		folioInternalProvider_Validate(provider, memory[i]);
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 40, "Expected 40 bytes allocated, got %zu", current);
+
+	for (int i = 0; i < 4; i++) {
+		folioInternalProvider_ReleaseMemory(provider, &memory[i]);
+	}
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateBatch_OutOfMemory)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	// The whole batch must fit
+	void *memory[4] = { (void *) 1, (void *) 1, (void *) 1, (void *) 1 };
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, 4, mockup_memory / 2, NULL, memory);
+	assertTrue(allocated == 0, "Expected 0 allocations, got %zu", allocated);
+
+	for (int i = 0; i < 4; i++) {
+		assertNull(memory[i], "Memory %d is not null", i);
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 0, "Expected 0 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateWait)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	// Room in the pool, so it does not wait
+	void *memory = folioInternalProvider_AllocateWait(provider, mockup_memory, NULL, FolioWaitForever);
+	assertNotNull(memory, "Should allocate without waiting");
+	uint64_t count = atomic_load(&pool->waitCount);
+	assertTrue(count == 0, "Expected no waits, got %" PRIu64, count);
+
+	WaiterContext waiter = { .provider = provider, .length = 100, .keep = true };
+	pthread_t thread;
+	pthread_create(&thread, NULL, _waiterThread, &waiter);
+	_waitForWaiters(pool, 1);
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	pthread_join(thread, NULL);
+
+	assertNotNull(waiter.memory, "The waiter should get memory after the release");
+	count = atomic_load(&pool->waitCount);
+	assertTrue(count == 1, "Expected 1 wait, got %" PRIu64, count);
+	unsigned waiters = atomic_load(&pool->waiters);
+	assertTrue(waiters == 0, "Expected no waiters, got %u", waiters);
+
+	folioInternalProvider_ReleaseMemory(provider, &waiter.memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateWait_Fifo)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	void *first = folioInternalProvider_Allocate(provider, mockup_memory / 2, NULL);
+	void *second = folioInternalProvider_Allocate(provider, mockup_memory / 2, NULL);
+
+	atomic_store(&_waitSequence, 0);
+	WaiterContext a = { .provider = provider, .length = 200 };
+	WaiterContext b = { .provider = provider, .length = 100 };
+	pthread_t threadA, threadB;
+	pthread_create(&threadA, NULL, _waiterThread, &a);
+	_waitForWaiters(pool, 1);
+	pthread_create(&threadB, NULL, _waiterThread, &b);
+	_waitForWaiters(pool, 2);
+
+	// b would fit now, but it is behind a
+	folioInternalProvider_ReleaseMemory(provider, &first);
+	usleep(20000);
+	unsigned waiters = atomic_load(&pool->waiters);
+	assertTrue(waiters == 2, "Expected b to wait behind a, got %u waiters", waiters);
+
+	folioInternalProvider_ReleaseMemory(provider, &second);
+	pthread_join(threadA, NULL);
+	pthread_join(threadB, NULL);
+
+	assertTrue(a.sequence == 0 && b.sequence == 1, "Expected a then b, got a %u b %u", a.sequence, b.sequence);
+
+	unsigned maxWaiters = atomic_load(&pool->maxWaiters);
+	assertTrue(maxWaiters == 2, "Expected at most 2 waiters, got %u", maxWaiters);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocateWait_Timeout)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	// Can never fit, so it does not wait
+	void *memory = folioInternalProvider_AllocateWait(provider, mockup_memory + 1, NULL, FolioWaitForever);
+	assertNull(memory, "Should not allocate more than the pool");
+
+	memory = folioInternalProvider_Allocate(provider, mockup_memory, NULL);
+
+	void *fail = folioInternalProvider_AllocateWait(provider, 1, NULL, 0);
+	assertNull(fail, "Should not wait with a 0 timeout");
+	uint64_t count = atomic_load(&pool->waitCount);
+	assertTrue(count == 0, "Expected no waits, got %" PRIu64, count);
+
+	uint64_t start = _nowNanos();
+	fail = folioInternalProvider_AllocateWait(provider, 1, NULL, 10);
+	uint64_t elapsed = _nowNanos() - start;
+	assertNull(fail, "Should time out");
+	assertTrue(elapsed >= 10000000, "Expected at least 10 msec, got %" PRIu64 " ns", elapsed);
+
+	uint64_t timeouts = atomic_load(&pool->waitTimeouts);
+	assertTrue(timeouts == 1, "Expected 1 timeout, got %" PRIu64, timeouts);
+
+	uint64_t total = 0;
+	for (unsigned i = 0; i < FolioWaitHistogramBuckets; ++i) {
+		total += atomic_load(&pool->waitHistogram[i]);
+	}
+	assertTrue(total == 1, "Expected 1 wait in the histogram, got %" PRIu64, total);
+	assertTrue(_waitBucket(999) == 0, "Expected bucket 0 under 1 usec, got %u", _waitBucket(999));
+	assertTrue(_waitBucket(10000000) == 7, "Expected bucket 7 for 10 msec, got %u", _waitBucket(10000000));
+	assertTrue(_waitBucket(UINT64_MAX) == FolioWaitHistogramBuckets - 1, "Expected the last bucket");
+
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, "waits 1 (") != NULL && strstr(str, "1 timeouts") != NULL, "Pool string should show the wait: %s", str);
+	assertTrue(strstr(str, "wait histogram") != NULL, "Pool string should show the histogram: %s", str);
+	free(str);
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
 }
 
 LONGBOW_TEST_CASE(Global, folioInternalProvider_AllocationSize)
@@ -142,7 +520,7 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_Create_NoState)
 			expectedHeaderGuardLength, pool->headerGuardLength);
 
 	// with non-zero headerLength we need to account for the guard
-	size_t expectedHeaderAlignedLength = sizeof(FolioHeader) + headerLength + expectedHeaderGuardLength;
+	size_t expectedHeaderAlignedLength = sizeof(FolioHeader) + headerLength + expectedHeaderGuardLength + sizeof(FolioOwner);
 	assertTrue(pool->headerAlignedLength == expectedHeaderAlignedLength,
 			"wrong headerAlignedLength expected %zu got %u",
 			expectedHeaderAlignedLength,
@@ -175,7 +553,7 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_Create_WithState)
 			expectedHeaderGuardLength, pool->headerGuardLength);
 
 
-	size_t expectedHeaderAlignedLength = sizeof(FolioHeader) + headerLength + expectedHeaderGuardLength;
+	size_t expectedHeaderAlignedLength = sizeof(FolioHeader) + headerLength + expectedHeaderGuardLength + sizeof(FolioOwner);
 	assertTrue(pool->headerAlignedLength == expectedHeaderAlignedLength,
 			"wrong headerAlignedLength expected %zu got %u",
 			expectedHeaderAlignedLength,
@@ -216,6 +594,73 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_GetProviderStateLength)
 
 }
 
+LONGBOW_TEST_CASE(Global, folioInternalProvider_LargeObject)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	folioInternalProvider_SetLargeObjectThreshold(provider, 4096);
+
+	void *small = folioInternalProvider_Allocate(provider, 100, NULL);
+	FolioHeader *header = folioHeader_GetMemoryHeader(small, pool);
+	assertFalse(folioHeader_IsLargeObject(header), "100 bytes should not be a large object");
+
+	uint8_t *large = folioInternalProvider_Allocate(provider, 10000, NULL);
+	header = folioHeader_GetMemoryHeader(large, pool);
+	assertTrue(folioHeader_IsLargeObject(header), "10000 bytes should be a large object");
+	memset(large, 0x5A, 10000);
+	folioInternalProvider_Validate(provider, large);
+
+	uint8_t *aligned = folioInternalProvider_AllocateAligned(provider, 10000, 4096, NULL);
+	assertTrue(((uintptr_t) aligned & 4095) == 0, "Memory %p not aligned", (void *) aligned);
+	header = folioHeader_GetMemoryHeader(aligned, pool);
+	assertTrue(folioHeader_IsLargeObject(header), "Aligned 10000 bytes should be a large object");
+
+	uint64_t count = atomic_load(&pool->largeObjectCount);
+	assertTrue(count == 2, "Expected 2 large objects, got %" PRIu64, count);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &aligned);
+	folioInternalProvider_ReleaseMemory(provider, (void **) &large);
+
+	count = atomic_load(&pool->largeObjectCount);
+	uint64_t bytes = atomic_load(&pool->largeObjectBytes);
+	uint64_t total = atomic_load(&pool->largeObjectTotal);
+	assertTrue(count == 0, "Expected 0 large objects after release, got %" PRIu64, count);
+	assertTrue(bytes == 0, "Expected 0 mapped bytes after release, got %" PRIu64, bytes);
+	assertTrue(total == 2, "Expected 2 large objects total, got %" PRIu64, total);
+
+	folioInternalProvider_ReleaseMemory(provider, &small);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_LargeObject_Reallocate)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	folioInternalProvider_SetLargeObjectThreshold(provider, 4096);
+
+	uint8_t *memory = folioInternalProvider_Allocate(provider, 100, NULL);
+	memset(memory, 0x5A, 100);
+
+	// Crosses the threshold up, grows in place with mremap, then crosses back down
+	const size_t lengths[] = { 10000, 1024 * 1024, 20000, 50 };
+	const bool expected[] = { true, true, true, false };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		void *result = folioInternalProvider_Reallocate(provider, (void **) &memory, lengths[i]);
+		assertNotNull(result, "Reallocate to %zu failed", lengths[i]);
+		assertTrue(memory[0] == 0x5A && memory[49] == 0x5A, "Lost the contents at length %zu", lengths[i]);
+
+		FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+		assertTrue(folioHeader_IsLargeObject(header) == expected[i], "Wrong large object flag at length %zu", lengths[i]);
+		folioInternalProvider_Validate(provider, memory);
+	}
+
+	uint64_t count = atomic_load(&pool->largeObjectCount);
+	assertTrue(count == 0, "Expected 0 large objects, got %" PRIu64, count);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_Length)
 {
 
@@ -226,24 +671,611 @@ LONGBOW_TEST_CASE(Global, folioInternalProvider_Lock)
 
 }
 
+LONGBOW_TEST_CASE(Global, folioInternalProvider_Reallocate)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	uint8_t *memory = folioInternalProvider_Allocate(provider, 9, NULL);
+	memset(memory, 0x5A, 9);
+
+	// 9 and 15 bytes have the same aligned length, so it grows in to the trailer guard slack
+	uint8_t *saved = memory;
+	void *result = folioInternalProvider_Reallocate(provider, (void **) &memory, 15);
+	assertTrue(result == saved && memory == saved, "Expected in place growth at %p, got %p", (void *) saved, result);
+	assertTrue(folioInternalProvider_Length(provider, memory) == 15, "Wrong length");
+	folioInternalProvider_Validate(provider, memory);
+
+	// Beyond the slack
+	result = folioInternalProvider_Reallocate(provider, (void **) &memory, 200);
+	assertNotNull(result, "Reallocate failed");
+	assertTrue(result == memory, "Did not update the memory pointer");
+	folioInternalProvider_Validate(provider, memory);
+	for (int i = 0; i < 9; i++) {
+		assertTrue(memory[i] == 0x5A, "Lost the contents at byte %d", i);
+	}
+	memset(memory, 0xA5, 200);
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 200, "Expected 200 bytes allocated, got %zu", current);
+
+	result = folioInternalProvider_Reallocate(provider, (void **) &memory, 3);
+	assertNotNull(result, "Reallocate failed");
+	folioInternalProvider_Validate(provider, memory);
+
+	current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 3, "Expected 3 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_Reallocate_Shared)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory = folioInternalProvider_Allocate(provider, 16, NULL);
+	void *copy = folioInternalProvider_Acquire(provider, memory);
+
+	void *saved = memory;
+	void *result = folioInternalProvider_Reallocate(provider, &memory, 100);
+	assertNull(result, "Should not reallocate memory with 2 references");
+	assertTrue(memory == saved, "The memory pointer changed");
+	assertTrue(folioInternalProvider_Length(provider, memory) == 16, "The length changed");
+
+	folioInternalProvider_ReleaseMemory(provider, &copy);
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_Reallocate_OutOfMemory)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory = folioInternalProvider_Allocate(provider, 16, NULL);
+	void *result = folioInternalProvider_Reallocate(provider, &memory, mockup_memory + 1);
+	assertNull(result, "Should not reallocate beyond the pool size");
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 16, "Expected 16 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	folioInternalProvider_SetReclaimInterval(provider, 0);
+
+	ReclaimerContext a = { .id = 1, .length = 100 };
+	ReclaimerContext b = { .id = 2, .length = 100 };
+	a.memory = folioInternalProvider_Allocate(provider, a.length, NULL);
+	b.memory = folioInternalProvider_Allocate(provider, b.length, NULL);
+
+	assertTrue(folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &a, 5), "Should register");
+	assertTrue(folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &b, 1), "Should register");
+
+	// Out of memory, so b (the lower priority number) gives back enough and a is not called
+	_reclaimCalls = 0;
+	void *memory = folioInternalProvider_Allocate(provider, 100, NULL);
+	assertNotNull(memory, "Should allocate after reclaiming");
+	assertTrue(_reclaimCalls == 1 && _reclaimOrder[0] == 2, "Expected only reclaimer 2, got %u calls", _reclaimCalls);
+	assertNull(b.memory, "Reclaimer 2 should have released its memory");
+
+	// Not enough to reclaim, so both are called and the allocation still fails
+	_reclaimCalls = 0;
+	void *fail = folioInternalProvider_Allocate(provider, 200, NULL);
+	assertNull(fail, "Should not allocate beyond the pool after reclaiming");
+	assertTrue(_reclaimCalls == 2 && _reclaimOrder[0] == 2 && _reclaimOrder[1] == 1,
+			"Expected reclaimers 2 then 1, got %u calls", _reclaimCalls);
+
+	uint64_t count = atomic_load(&pool->reclaimCount);
+	assertTrue(count == 2, "Expected 2 reclaims, got %" PRIu64, count);
+	uint64_t bytes = atomic_load(&pool->reclaimedBytes);
+	assertTrue(bytes == 200, "Expected 200 reclaimed bytes, got %" PRIu64, bytes);
+
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, "reclaimers 2 reclaims 2 (200 bytes") != NULL, "Pool string should show the reclaims: %s", str);
+	free(str);
+
+	assertTrue(folioInternalProvider_UnregisterReclaimer(provider, _reclaimer, &a), "Should unregister");
+	assertFalse(folioInternalProvider_UnregisterReclaimer(provider, _reclaimer, &a), "Should not unregister twice");
+	assertTrue(folioInternalProvider_UnregisterReclaimer(provider, _reclaimer, &b), "Should unregister");
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_Full)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	ReclaimerContext contexts[FolioMaximumReclaimers + 1];
+	for (unsigned i = 0; i < FolioMaximumReclaimers; ++i) {
+		contexts[i] = (ReclaimerContext) { .id = i };
+		assertTrue(folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &contexts[i], 0), "Should register %u", i);
+	}
+
+	assertFalse(folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &contexts[FolioMaximumReclaimers], 0),
+			"Should not register beyond %d", FolioMaximumReclaimers);
+
+	// Equal priorities run in registration order
+	folioInternalProvider_SetReclaimInterval(provider, 0);
+	_reclaimCalls = 0;
+	void *fail = folioInternalProvider_Allocate(provider, mockup_memory + 1, NULL);
+	assertNull(fail, "Should not allocate beyond the pool");
+	assertTrue(_reclaimCalls == FolioMaximumReclaimers, "Expected %d calls, got %u", FolioMaximumReclaimers, _reclaimCalls);
+	for (unsigned i = 0; i < FolioMaximumReclaimers; ++i) {
+		assertTrue(_reclaimOrder[i] == i, "Expected reclaimer %u at %u, got %u", i, i, _reclaimOrder[i]);
+	}
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_RateLimit)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	folioInternalProvider_SetReclaimInterval(provider, 60000);
+
+	ReclaimerContext a = { .id = 1 };
+	folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &a, 0);
+
+	_reclaimCalls = 0;
+	void *fail = folioInternalProvider_Allocate(provider, mockup_memory + 1, NULL);
+	assertNull(fail, "Should not allocate beyond the pool");
+	fail = folioInternalProvider_Allocate(provider, mockup_memory + 1, NULL);
+	assertNull(fail, "Should not allocate beyond the pool");
+
+	assertTrue(_reclaimCalls == 1, "Expected the second reclaim to be skipped, got %u calls", _reclaimCalls);
+	uint64_t skipped = atomic_load(&pool->reclaimSkipped);
+	assertTrue(skipped == 1, "Expected 1 skipped reclaim, got %" PRIu64, skipped);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_RegisterReclaimer_SoftLimit)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	folioInternalProvider_SetReclaimInterval(provider, 0);
+	folioInternalProvider_SetSoftLimit(provider, 100, NULL);
+
+	ReclaimerContext a = { .id = 1, .length = 60 };
+	a.memory = folioInternalProvider_Allocate(provider, a.length, NULL);
+	folioInternalProvider_RegisterReclaimer(provider, _reclaimer, &a, 0);
+
+	// Crossing the soft limit reclaims but does not fail
+	_reclaimCalls = 0;
+	void *memory = folioInternalProvider_Allocate(provider, 60, NULL);
+	assertNotNull(memory, "Soft limit should not fail the allocation");
+	assertTrue(_reclaimCalls == 1, "Expected 1 reclaim, got %u", _reclaimCalls);
+	assertNull(a.memory, "Reclaimer should have released its memory");
+
+	size_t allocated = folioPool_GetFromProvider(provider)->currentAllocation;
+	assertTrue(allocated == 60, "Expected 60 bytes allocated, got %zu", allocated);
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_ReleaseMemory)
 {
 
 }
 
+static unsigned _batchFinalized = 0;
+
+static void
+_batchFinalizer(void *memory __attribute__((unused)))
+{
+	_batchFinalized++;
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_ReleaseBatch)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory[3];
+	folioInternalProvider_AllocateBatch(provider, 3, 16, _batchFinalizer, memory);
+
+	// The second one has another reference, so it is not a final release
+	void *copy = folioInternalProvider_Acquire(provider, memory[1]);
+
+	_batchFinalized = 0;
+	bool finalRelease[3];
+	size_t finalReleases = folioInternalProvider_ReleaseBatch(provider, memory, 3, finalRelease);
+	assertTrue(finalReleases == 2, "Expected 2 final releases, got %zu", finalReleases);
+	assertTrue(finalRelease[0] && !finalRelease[1] && finalRelease[2], "Wrong final releases");
+	assertTrue(_batchFinalized == 2, "Expected 2 finalizer calls, got %u", _batchFinalized);
+
+	for (int i = 0; i < 3; i++) {
+		assertNull(memory[i], "Memory %d was not nulled", i);
+	}
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 16, "Expected 16 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseMemory(provider, &copy);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_ReleaseMemoryN)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	void *memory = folioInternalProvider_Allocate(provider, 16, _batchFinalizer);
+	folioInternalProvider_AcquireN(provider, memory, 7);
+
+	_batchFinalized = 0;
+	void *reference = memory;
+	bool finalRelease = folioInternalProvider_ReleaseMemoryN(provider, &reference, 5);
+	assertFalse(finalRelease, "Should not be the final release with 3 references left");
+	assertNull(reference, "Release did not null the pointer");
+
+	reference = memory;
+	finalRelease = folioInternalProvider_ReleaseMemoryN(provider, &reference, 3);
+	assertTrue(finalRelease, "Should be the final release");
+	assertTrue(_batchFinalized == 1, "Expected 1 finalizer call, got %u", _batchFinalized);
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 0, "Expected 0 bytes allocated, got %zu", current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_ReleaseProvider)
 {
 
 }
 
+LONGBOW_TEST_CASE(Global, folioInternalProvider_ReserveBlocks)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	const size_t hints[] = { 1000, 100, 100, 0 };
+	size_t reserved = folioInternalProvider_ReserveBlocks(provider, 64 * 1024, hints, FolioReserveFlags_Populate);
+	assertTrue(reserved >= 60 * 1024, "Expected about 64 KB reserved, got %zu", reserved);
+
+	FolioReserve *reserve = atomic_load(&pool->reserve);
+	assertTrue(reserve->classCount == 2, "Expected the duplicate hint dropped, got %u classes", reserve->classCount);
+	assertTrue(reserve->classes[0].blockLength < reserve->classes[1].blockLength, "Classes not sorted");
+
+	size_t again = folioInternalProvider_ReserveBlocks(provider, 64 * 1024, hints, FolioReserveFlags_None);
+	assertTrue(again == 0, "A second reserve should return 0, got %zu", again);
+
+	// Dirty a reserved block, then make sure a zeroed allocation reusing it is zero
+	uint8_t *memory = folioInternalProvider_Allocate(provider, 100, NULL);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+	assertNotNull(_reserveClassForBlock(reserve, header), "Expected a reserved block");
+	assertTrue(reserve->classes[0].blocksInUse == 1, "Expected 1 block in use, got %zu", reserve->classes[0].blocksInUse);
+	memset(memory, 0xA5, 100);
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	assertTrue(reserve->classes[0].blocksInUse == 0, "Expected 0 blocks in use, got %zu", reserve->classes[0].blocksInUse);
+
+	memory = folioInternalProvider_AllocateAndZero(provider, 90, NULL);
+	for (size_t i = 0; i < 90; i++) {
+		assertTrue(memory[i] == 0, "Byte %zu not zero", i);
+	}
+
+	// Too small to use a reserved block without wasting it
+	void *small = folioInternalProvider_Allocate(provider, 8, NULL);
+	assertNull(_reserveClassForBlock(reserve, folioHeader_GetMemoryHeader(small, pool)), "8 bytes should not use a reserved block");
+
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, "reserved") != NULL, "Pool string should show the reserve: %s", str);
+	free(str);
+
+	folioInternalProvider_ReleaseMemory(provider, &small);
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_ReserveBlocks_Reallocate)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	const size_t hints[] = { 100, 0 };
+	folioInternalProvider_ReserveBlocks(provider, 16 * 1024, hints, FolioReserveFlags_None);
+	FolioReserve *reserve = atomic_load(&pool->reserve);
+
+	uint8_t *memory = folioInternalProvider_Allocate(provider, 60, NULL);
+	memset(memory, 0x5A, 60);
+	void *block = folioHeader_GetMemoryHeader(memory, pool);
+
+	// Still fits the reserved block, so it stays in place
+	folioInternalProvider_Reallocate(provider, (void **) &memory, 100);
+	assertTrue(folioHeader_GetMemoryHeader(memory, pool) == block, "Expected the block to stay in place");
+
+	// Outgrows it, so it moves to malloc() and the reserved block is free again
+	folioInternalProvider_Reallocate(provider, (void **) &memory, 1000);
+	assertNull(_reserveClassForBlock(reserve, folioHeader_GetMemoryHeader(memory, pool)), "Expected a malloc() block");
+	assertTrue(reserve->classes[0].blocksInUse == 0, "Expected 0 blocks in use, got %zu", reserve->classes[0].blocksInUse);
+	assertTrue(memory[0] == 0x5A && memory[59] == 0x5A, "Lost the contents");
+	folioInternalProvider_Validate(provider, memory);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_Report)
 {
 
 }
 
+LONGBOW_TEST_CASE(Global, folioInternalProvider_ScavengeLimit)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	// The default gives back everything, up to the budget
+	size_t limit = folioInternalProvider_ScavengeLimit(provider, 1000, SIZE_MAX);
+	assertTrue(limit == 1000, "Expected 1000, got %zu", limit);
+	limit = folioInternalProvider_ScavengeLimit(provider, 1000, 10);
+	assertTrue(limit == 10, "Expected 10, got %zu", limit);
+
+	folioInternalProvider_SetScavengePolicy(provider, 200, 25);
+	limit = folioInternalProvider_ScavengeLimit(provider, 1000, SIZE_MAX);
+	assertTrue(limit == 200, "Expected 25%% of 800, got %zu", limit);
+	limit = folioInternalProvider_ScavengeLimit(provider, 150, SIZE_MAX);
+	assertTrue(limit == 0, "Expected nothing below the retention, got %zu", limit);
+	limit = folioInternalProvider_ScavengeLimit(provider, 201, SIZE_MAX);
+	assertTrue(limit == 1, "Expected at least 1 byte above the retention, got %zu", limit);
+
+	limit = folioInternalProvider_ScavengeLimit(provider, SIZE_MAX, SIZE_MAX);
+	assertTrue(limit > SIZE_MAX / 5 && limit < SIZE_MAX / 3, "Overflow, got %zu", limit);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_Scavenge)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	void *memory = folioInternalProvider_Allocate(provider, 100, NULL);
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+
+	size_t scavenged = folioInternalProvider_Scavenge(provider, SIZE_MAX);
+	assertTrue(scavenged == 0, "malloc() pools cannot count, got %zu", scavenged);
+
+	uint64_t count = atomic_load(&pool->scavengeCount);
+	assertTrue(count == 1, "Expected 1 scavenge, got %" PRIu64, count);
+
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, "scavenged 0 bytes in 1 calls") != NULL, "Pool string should show the scavenge: %s", str);
+	free(str);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_Scavenge_Reserve)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	const size_t hints[] = { 3 * 4096, 0 };
+	folioInternalProvider_ReserveBlocks(provider, 64 * 1024, hints, FolioReserveFlags_None);
+	FolioReserve *reserve = atomic_load(&pool->reserve);
+	assertTrue(reserve->classCount == 1, "Expected 1 class, got %u", reserve->classCount);
+
+	uint8_t *memory = folioInternalProvider_Allocate(provider, 3 * 4096, NULL);
+	memset(memory, 0xA5, 3 * 4096);
+
+	// Less than one block's pages gives back nothing
+	size_t scavenged = folioInternalProvider_Scavenge(provider, 100);
+	assertTrue(scavenged == 0, "A 100 byte budget should not give back a block, got %zu", scavenged);
+
+	// Every idle block has at least 2 whole pages after its link word
+	size_t idleBlocks = reserve->classes[0].blocks - 1;
+	scavenged = folioInternalProvider_Scavenge(provider, SIZE_MAX);
+	assertTrue(scavenged >= idleBlocks * 2 * 4096, "Expected at least %zu bytes, got %zu", idleBlocks * 2 * 4096, scavenged);
+	assertNull(reserve->classes[0].freeList, "Every idle block should be scavenged");
+
+	// The same blocks do not count twice
+	size_t again = folioInternalProvider_Scavenge(provider, SIZE_MAX);
+	assertTrue(again == 0, "A second scavenge should give back nothing, got %zu", again);
+
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "scavenged %zu bytes in 3 calls", scavenged);
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, buffer) != NULL, "Pool string should show '%s': %s", buffer, str);
+	free(str);
+
+	// A scavenged block is used again, and a zeroed allocation from it is zero
+	uint8_t *zeroed = folioInternalProvider_AllocateAndZero(provider, 3 * 4096, NULL);
+	assertNotNull(_reserveClassForBlock(reserve, folioHeader_GetMemoryHeader(zeroed, pool)), "Expected a reserved block");
+	for (size_t i = 0; i < 3 * 4096; i++) {
+		assertTrue(zeroed[i] == 0, "Byte %zu not zero", i);
+	}
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &zeroed);
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
 LONGBOW_TEST_CASE(Global, folioInternalProvider_SetAvailableMemory)
 {
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	folioInternalProvider_SetAvailableMemory(provider, 100);
+	void *memory = folioInternalProvider_Allocate(provider, 101, NULL);
+	assertNull(memory, "Should not allocate beyond the hard limit");
+
+	memory = folioInternalProvider_Allocate(provider, 100, NULL);
+	assertNotNull(memory, "Should allocate up to the hard limit");
+
+	// Lowering the limit below the current allocation fails the next allocation only
+	folioInternalProvider_SetAvailableMemory(provider, 50);
+	void *another = folioInternalProvider_Allocate(provider, 1, NULL);
+	assertNull(another, "Should not allocate above the lowered hard limit");
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_SetPriorityClass)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	folioInternalProvider_SetPriorityClass(provider, FolioPriority_Critical, 100, SIZE_MAX);
+	folioInternalProvider_SetPriorityClass(provider, FolioPriority_Bulk, 0, 50);
+
+	folioInternalProvider_SetThreadPriority(FolioPriority_Bulk);
+	void *fail = folioInternalProvider_Allocate(provider, 51, NULL);
+	assertNull(fail, "Bulk should not allocate above its cap");
+	void *bulk = folioInternalProvider_Allocate(provider, 50, NULL);
+	assertNotNull(bulk, "Bulk should allocate up to its cap");
+
+	// The pool less the critical reserve and the bulk bytes
+	folioInternalProvider_SetThreadPriority(FolioPriority_Normal);
+	void *normal = folioInternalProvider_Allocate(provider, mockup_memory - 100 - 50, NULL);
+	assertNotNull(normal, "Normal should allocate up to the critical reserve");
+	fail = folioInternalProvider_Allocate(provider, 1, NULL);
+	assertNull(fail, "Normal should not allocate in to the critical reserve");
+
+	folioInternalProvider_SetThreadPriority(FolioPriority_Critical);
+	void *critical[2];
+	size_t allocated = folioInternalProvider_AllocateBatch(provider, 2, 50, NULL, critical);
+	assertTrue(allocated == 2, "Critical should allocate its reserve, got %zu", allocated);
+	fail = folioInternalProvider_Allocate(provider, 1, NULL);
+	assertNull(fail, "Critical should not allocate beyond the pool");
+	folioInternalProvider_SetThreadPriority(FolioPriority_Normal);
+
+	uint64_t denials = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].denials);
+	assertTrue(denials == 1, "Expected 1 bulk denial, got %" PRIu64, denials);
+	denials = atomic_load(&pool->priorityClasses[FolioPriority_Normal].denials);
+	assertTrue(denials == 1, "Expected 1 normal denial, got %" PRIu64, denials);
+
+	char *str = folioPool_ToString(pool);
+	assertTrue(strstr(str, "priority 0: 100 bytes (reserve 100, no cap) denials 1") != NULL, "Pool string should show critical: %s", str);
+	assertTrue(strstr(str, "priority 3: 50 bytes (reserve 0, cap 50) denials 1") != NULL, "Pool string should show bulk: %s", str);
+	free(str);
+
+	// Each class gets back its own bytes
+	void *mixed[3] = { normal, critical[0], bulk };
+	folioInternalProvider_ReleaseBatch(provider, mixed, 3, NULL);
+	uint64_t current = atomic_load(&pool->priorityClasses[FolioPriority_Critical].current);
+	assertTrue(current == 50, "Expected 50 critical bytes, got %" PRIu64, current);
+	current = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].current);
+	assertTrue(current == 0, "Expected 0 bulk bytes, got %" PRIu64, current);
+
+	folioInternalProvider_ReleaseMemory(provider, &critical[1]);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_SetPriorityClass_Reallocate)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	folioInternalProvider_SetPriorityClass(provider, FolioPriority_Bulk, 0, 100);
+	FolioPriority prior = folioInternalProvider_SetThreadPriority(FolioPriority_Bulk);
+	void *memory = folioInternalProvider_Allocate(provider, 60, NULL);
+	folioInternalProvider_SetThreadPriority(prior);
+
+	// The block stays in its class, whatever the class of the thread
+	void *result = folioInternalProvider_Reallocate(provider, &memory, 101);
+	assertNull(result, "Should not grow above the cap");
+	result = folioInternalProvider_Reallocate(provider, &memory, 100);
+	assertNotNull(result, "Should grow up to the cap");
+
+	uint64_t current = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].current);
+	assertTrue(current == 100, "Expected 100 bulk bytes, got %" PRIu64, current);
+
+	// Lifting the limits goes back to counting only
+	folioInternalProvider_SetPriorityClass(provider, FolioPriority_Bulk, 0, SIZE_MAX);
+	assertFalse(atomic_load(&pool->priorityLimited), "Expected no limits");
+
+	folioInternalProvider_ReleaseMemory(provider, &memory);
+	current = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].current);
+	assertTrue(current == 0, "Expected 0 bulk bytes, got %" PRIu64, current);
+
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_SetSoftLimit)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+
+	_softLimitCalls = 0;
+	folioInternalProvider_SetSoftLimit(provider, 100, _softLimitCallback);
+
+	void *a = folioInternalProvider_Allocate(provider, 100, NULL);
+	assertTrue(_softLimitCalls == 0, "Reaching the soft limit should not call back, got %u", _softLimitCalls);
+
+	// Soft limit allows the allocation
+	void *b = folioInternalProvider_Allocate(provider, 10, NULL);
+	assertNotNull(b, "Soft limit should not fail the allocation");
+	assertTrue(_softLimitCalls == 1, "Expected 1 callback, got %u", _softLimitCalls);
+	assertTrue(_softLimitAllocatedBytes == 110, "Expected 110 bytes, got %zu", _softLimitAllocatedBytes);
+
+	// Already above the soft limit, so no new crossing
+	void *c = folioInternalProvider_Allocate(provider, 10, NULL);
+	assertTrue(_softLimitCalls == 1, "Expected 1 callback, got %u", _softLimitCalls);
+
+	folioInternalProvider_ReleaseMemory(provider, &b);
+	folioInternalProvider_ReleaseMemory(provider, &c);
+	b = folioInternalProvider_Allocate(provider, 10, NULL);
+	assertTrue(_softLimitCalls == 2, "Expected 2 callbacks, got %u", _softLimitCalls);
+
+	size_t count = folioInternalProvider_SoftLimitCount(provider);
+	assertTrue(count == 2, "Expected soft limit count 2, got %zu", count);
+
+	folioInternalProvider_ReleaseMemory(provider, &a);
+	folioInternalProvider_ReleaseMemory(provider, &b);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_SetValidationLevel_MagicOnly)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	folioInternalProvider_SetValidationLevel(provider, FolioValidationLevel_MagicOnly, 0);
+
+	FolioValidationLevel level = folioInternalProvider_GetValidationLevel(provider);
+	assertTrue(level == FolioValidationLevel_MagicOnly, "Wrong level, expected %d got %d", FolioValidationLevel_MagicOnly, level);
+
+	const size_t length = 64;
+	uint8_t *memory = folioInternalProvider_Allocate(provider, length, NULL);
+
+	// Overrun by one byte.  Magic-only does not look at the trailer.
+	uint8_t saved = memory[length];
+	memory[length] = ~saved;
 
+	void *copy = folioInternalProvider_Acquire(provider, memory);
+	size_t test = folioInternalProvider_Length(provider, memory);
+	assertTrue(test == length, "Wrong length, expected %zu got %zu", length, test);
+	folioInternalProvider_ReleaseMemory(provider, &copy);
+
+	memory[length] = saved;
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Global, folioInternalProvider_SetValidationLevel_FinalRelease)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	folioInternalProvider_SetValidationLevel(provider, FolioValidationLevel_FinalRelease, 0);
+
+	const size_t length = 64;
+	uint8_t *memory = folioInternalProvider_Allocate(provider, length, NULL);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, folioPool_GetFromProvider(provider));
+
+	// A broken header magic is not noticed on ordinary operations
+	uint32_t saved;
+	memcpy(&saved, header, sizeof(saved));
+	memset(header, 0, sizeof(saved));
+
+	void *copy = folioInternalProvider_Acquire(provider, memory);
+	folioInternalProvider_Lock(provider, memory);
+	folioInternalProvider_Unlock(provider, memory);
+
+	memcpy(header, &saved, sizeof(saved));
+	folioInternalProvider_ReleaseMemory(provider, &copy);
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
 }
 
 LONGBOW_TEST_CASE(Global, folioInternalProvider_Unlock)
@@ -267,6 +1299,7 @@ LONGBOW_TEST_FIXTURE(Local)
     LONGBOW_RUN_TEST_CASE(Local, _fillGuard);
     LONGBOW_RUN_TEST_CASE(Local, _getRandomMagic);
     LONGBOW_RUN_TEST_CASE(Local, _increaseCurrentAllocation);
+    LONGBOW_RUN_TEST_CASE(Local, _validateForLevel_Sampled);
     LONGBOW_RUN_TEST_CASE(Local, _validateInternal);
     LONGBOW_RUN_TEST_CASE(Local, _verifyGuard);
     LONGBOW_RUN_TEST_CASE(Local, _verifyHeader);
@@ -303,7 +1336,17 @@ LONGBOW_TEST_CASE(Local, _computeTotalLength)
 
 LONGBOW_TEST_CASE(Local, _decreaseCurrentAllocation)
 {
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, SIZE_MAX, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	const size_t length = (size_t) 5 << 30;
+	_increaseCurrentAllocation(provider, pool, FolioPriority_Normal, length);
+	_decreaseCurrentAllocation(pool, FolioPriority_Normal, length - 1);
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == 1, "Expected 1 byte, got %zu", current);
 
+	_decreaseCurrentAllocation(pool, FolioPriority_Normal, 1);
+	folioInternalProvider_ReleaseProvider(&provider);
 }
 
 LONGBOW_TEST_CASE(Local, _fillGuard)
@@ -318,7 +1361,52 @@ LONGBOW_TEST_CASE(Local, _getRandomMagic)
 
 LONGBOW_TEST_CASE(Local, _increaseCurrentAllocation)
 {
+	// Tens of GiB, beyond 32-bit accounting
+	const size_t poolSize = (size_t) 40 << 30;
+	const size_t length = (size_t) 3 << 30;
 
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, poolSize, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	size_t count = 0;
+	while (_increaseCurrentAllocation(provider, pool, FolioPriority_Normal, length)) {
+		count++;
+	}
+
+	assertTrue(count == poolSize / length, "Expected %zu reservations, got %zu", poolSize / length, count);
+
+	size_t current = folioInternalProvider_AllocationSize(provider);
+	assertTrue(current == count * length, "Expected %zu bytes, got %zu", count * length, current);
+
+	_decreaseCurrentAllocation(pool, FolioPriority_Normal, current);
+	folioInternalProvider_ReleaseProvider(&provider);
+}
+
+LONGBOW_TEST_CASE(Local, _validateForLevel_Sampled)
+{
+	FolioMemoryProvider *provider = folioInternalProvider_Create(&MockupProviderTemplate, mockup_memory, 0, 0);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+	folioInternalProvider_SetValidationLevel(provider, FolioValidationLevel_Sampled, 4);
+
+	const size_t length = 64;
+	uint8_t *memory = folioInternalProvider_Allocate(provider, length, NULL);
+	FolioHeader *header = folioHeader_GetMemoryHeader(memory, pool);
+
+	// The first 3 of every 4 only check the magic, so do not see the overrun
+	uint8_t saved = memory[length];
+	memory[length] = ~saved;
+
+	_sampleCounter = 0;
+	for (int i = 0; i < 3; i++) {
+		_validateForLevel(pool, header);
+	}
+	assertTrue(_sampleCounter == 3, "Expected 3 samples, got %u", _sampleCounter);
+
+	memory[length] = saved;
+	_validateForLevel(pool, header);
+
+	folioInternalProvider_ReleaseMemory(provider, (void **) &memory);
+	folioInternalProvider_ReleaseProvider(&provider);
 }
 
 LONGBOW_TEST_CASE(Local, _validateInternal)
@@ -0,0 +1,228 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include "../src/private/folio_Stats.c"
+
+#include <LongBow/unit-test.h>
+#include <Folio/folio.h>
+
+LONGBOW_TEST_RUNNER(folio_Stats)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Global);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_Stats)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_Stats)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Global)
+{
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_Allocate);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_AllocateBatch);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_Acquire);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_AcquireN);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_Release_OtherThread);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_ReleaseBatch);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_Discard);
+    LONGBOW_RUN_TEST_CASE(Global, folioStats_ReportThreads);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(Global)
+{
+	FolioStats *stats = malloc(sizeof(FolioStats));
+	folioStats_Initialize(stats);
+	longBowTestCase_SetClipBoardData(testCase, stats);
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Global)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+	free(stats);
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_Allocate)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_Allocate(stats, true);
+	folioStats_Allocate(stats, true);
+	folioStats_Allocate(stats, false);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 2, "Expected 2 allocs, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 2, "Expected 2 acquires, got %zu", sum.outstandingAcquires);
+	assertTrue(sum.allocations == 2, "Expected 2 allocations, got %zu", sum.allocations);
+	assertTrue(sum.outOfMemoryCount == 1, "Expected 1 out of memory, got %zu", sum.outOfMemoryCount);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_AllocateBatch)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_AllocateBatch(stats, 5, 3);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 5, "Expected 5 allocs, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 5, "Expected 5 acquires, got %zu", sum.outstandingAcquires);
+	assertTrue(sum.allocations == 5, "Expected 5 allocations, got %zu", sum.allocations);
+	assertTrue(sum.outOfMemoryCount == 3, "Expected 3 out of memory, got %zu", sum.outOfMemoryCount);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_Acquire)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_Allocate(stats, true);
+	folioStats_Acquire(stats);
+	assertTrue(folioStats_OutstandingAcquires(stats) == 2, "Expected 2 acquires, got %zu",
+			folioStats_OutstandingAcquires(stats));
+
+	folioStats_Release(stats, false);
+	folioStats_Release(stats, true);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 0, "Expected 0 allocs, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 0, "Expected 0 acquires, got %zu", sum.outstandingAcquires);
+	assertTrue(sum.releases == 2, "Expected 2 releases, got %zu", sum.releases);
+}
+
+static void *
+_allocateThread(void *arg)
+{
+	FolioStats *stats = arg;
+	for (int i = 0; i < 10; ++i) {
+		folioStats_Allocate(stats, true);
+	}
+	return NULL;
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_AcquireN)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_Allocate(stats, true);
+	folioStats_AcquireN(stats, 8);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAcquires == 9, "Expected 9 acquires, got %zu", sum.outstandingAcquires);
+	assertTrue(sum.acquires == 8, "Expected 8 acquires, got %zu", sum.acquires);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_Release_OtherThread)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, _allocateThread, stats);
+	pthread_join(thread, NULL);
+
+	// The other thread has its own shard, so ours goes negative
+	for (int i = 0; i < 10; ++i) {
+		folioStats_Release(stats, true);
+	}
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 0, "Expected 0 allocs, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 0, "Expected 0 acquires, got %zu", sum.outstandingAcquires);
+
+	FolioStatsShard *mine = &stats->shards[_threadShard];
+	int64_t outstanding = atomic_load(&mine->outstandingAllocs);
+	assertTrue(outstanding == -10, "Expected -10 in this thread's shard, got %" PRId64, outstanding);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_ReleaseBatch)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_AllocateBatch(stats, 4, 0);
+	folioStats_Acquire(stats);
+	folioStats_ReleaseBatch(stats, 4, 3);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 1, "Expected 1 alloc, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 1, "Expected 1 acquire, got %zu", sum.outstandingAcquires);
+	assertTrue(sum.releases == 4, "Expected 4 releases, got %zu", sum.releases);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_Discard)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_Allocate(stats, true);
+	folioStats_Allocate(stats, true);
+	folioStats_Acquire(stats);
+	folioStats_Discard(stats, 2, 3);
+
+	FolioStatsSnapshot sum;
+	folioStats_Sum(stats, &sum);
+	assertTrue(sum.outstandingAllocs == 0, "Expected 0 allocs, got %zu", sum.outstandingAllocs);
+	assertTrue(sum.outstandingAcquires == 0, "Expected 0 acquires, got %zu", sum.outstandingAcquires);
+}
+
+LONGBOW_TEST_CASE(Global, folioStats_ReportThreads)
+{
+	FolioStats *stats = longBowTestCase_GetClipBoardData(testCase);
+
+	folioStats_Allocate(stats, true);
+	folioStats_Release(stats, true);
+
+	char *buffer = NULL;
+	size_t length = 0;
+	FILE *stream = open_memstream(&buffer, &length);
+	folioStats_ReportThreads(stats, stream);
+	fclose(stream);
+
+	char expected[64];
+	snprintf(expected, sizeof(expected), "thread %#" PRIxPTR, (uintptr_t) pthread_self());
+	assertNotNull(strstr(buffer, expected), "Report missing '%s': %s", expected, buffer);
+	free(buffer);
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_Stats);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
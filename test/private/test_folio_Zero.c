@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include "../src/private/folio_Zero.c"
+
+#include <LongBow/unit-test.h>
+#include <stdlib.h>
+
+LONGBOW_TEST_RUNNER(folio_Zero)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Global);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_Zero)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_Zero)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Global)
+{
+    LONGBOW_RUN_TEST_CASE(Global, folioZero_Clear_Small);
+    LONGBOW_RUN_TEST_CASE(Global, folioZero_NonTemporalThreshold);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(Global)
+{
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Global)
+{
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+typedef void (ClearFunction)(void *memory, size_t length);
+
+/*
+ * Clears [offset, offset + length) of a 0xFF filled buffer and checks that
+ * exactly those bytes are zero.
+ */
+static void
+_assertClear(ClearFunction *clear, size_t offset, size_t length)
+{
+	size_t bufferLength = offset + length + 128;
+	uint8_t *buffer = malloc(bufferLength);
+	memset(buffer, 0xFF, bufferLength);
+
+	clear(buffer + offset, length);
+
+	for (size_t i = 0; i < bufferLength; ++i) {
+		uint8_t expected = (i >= offset && i < offset + length) ? 0 : 0xFF;
+		assertTrue(buffer[i] == expected, "offset %zu length %zu: byte %zu is %u", offset, length, i, buffer[i]);
+	}
+
+	free(buffer);
+}
+
+LONGBOW_TEST_CASE(Global, folioZero_Clear_Small)
+{
+	_assertClear(folioZero_Clear, 0, 0);
+	_assertClear(folioZero_Clear, 3, 1);
+	_assertClear(folioZero_Clear, 7, 4096);
+}
+
+LONGBOW_TEST_CASE(Global, folioZero_NonTemporalThreshold)
+{
+	size_t threshold = folioZero_NonTemporalThreshold();
+	assertTrue(threshold > 0, "Threshold must be positive");
+
+#ifdef __SSE2__
+	// Unaligned start and end, so both memset() edges are used
+	_assertClear(_clearNonTemporal, 5, 100000 + 37);
+	_assertClear(_clearNonTemporal, 64, 128);
+	_assertClear(_clearNonTemporal, 1, 10);
+#endif
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_Zero);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
@@ -0,0 +1,453 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include <LongBow/unit-test.h>
+
+#include "../src/folio_ArenaProvider.c"
+
+#include <Folio/folio.h>
+
+LONGBOW_TEST_RUNNER(folio_ArenaProvider)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Local);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_ArenaProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_ArenaProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Local)
+{
+    LONGBOW_RUN_TEST_CASE(Local, _allocate);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_Large);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAligned);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate_AtTop);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate_Move);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Local, _acquire);
+    LONGBOW_RUN_TEST_CASE(Local, _report);
+    LONGBOW_RUN_TEST_CASE(Local, _length);
+
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Reset);
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Reset_FinalizerOrder);
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Reset_AfterRelease);
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Reset_FinalizerReleases);
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Reset_ManyAllocations);
+    LONGBOW_RUN_TEST_CASE(Local, folioArenaProvider_Release);
+    LONGBOW_RUN_TEST_CASE(Local, _scavenge);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(Local)
+{
+	FolioMemoryProvider *arenaProvider = folioArenaProvider_Create(SIZE_MAX);
+	longBowTestCase_SetClipBoardData(testCase, arenaProvider);
+
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Local)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	int status = LONGBOW_STATUS_SUCCEEDED;
+
+	if (arenaProvider != NULL) {
+		if (!folioMemoryProvider_TestRefCount(arenaProvider, 0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
+			_report(arenaProvider, stdout);
+			status = LONGBOW_STATUS_MEMORYLEAK;
+		}
+
+		_releaseProvider(&arenaProvider);
+	}
+
+	return status;
+}
+
+// Records the order finalizers run in
+static void *_finalized[16];
+static unsigned _finalizedCount;
+
+static void
+_recordFinalizer(void *memory)
+{
+	if (_finalizedCount < sizeof(_finalized) / sizeof(_finalized[0])) {
+		_finalized[_finalizedCount] = memory;
+	}
+	_finalizedCount++;
+}
+
+// A node that releases the allocation it points to when finalized
+typedef struct node {
+	FolioMemoryProvider *provider;
+	void *other;
+} Node;
+
+static void
+_nodeFinalizer(void *memory)
+{
+	Node *node = memory;
+	if (node->other != NULL) {
+		_release(node->provider, &node->other);
+	}
+	_recordFinalizer(memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t allocSize = 9;
+	void *memory = _allocate(arenaProvider, allocSize, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+
+	size_t acquireCount = _acquireCount(arenaProvider);
+	assertTrue(acquireCount == 1, "Expected 1 allocation, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(arenaProvider);
+	assertTrue(allocationSize == allocSize, "Expected %zu bytes, got %zu", allocSize, allocationSize);
+
+	assertTrue(((uintptr_t) memory & (_alignment_width - 1)) == 0, "Memory %p not aligned", memory);
+
+	_validate(arenaProvider, memory);
+	_release(arenaProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_Large)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	// Bigger than a chunk, so it gets its own
+	const size_t allocSize = 4 * ChunkLength;
+	void *memory = _allocate(arenaProvider, allocSize, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+	memset(memory, 0xA5, allocSize);
+
+	void *small = _allocate(arenaProvider, 16, NULL);
+	assertNotNull(small, "Did not return memory pointer");
+
+	_validate(arenaProvider, memory);
+	_release(arenaProvider, &memory);
+	_release(arenaProvider, &small);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAligned)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+	void *memory = _allocateAligned(arenaProvider, 100, 64, _recordFinalizer);
+	assertNotNull(memory, "Did not return memory pointer");
+	assertTrue(((uintptr_t) memory & 63) == 0, "Memory %p not aligned to 64", memory);
+	_validate(arenaProvider, memory);
+
+	// The reset finds it in the log like any other allocation
+	folioArenaProvider_Reset(arenaProvider);
+	assertTrue(_finalizedCount == 1, "Expected 1 finalizer call, got %u", _finalizedCount);
+	assertTrue(_finalized[0] == memory, "Finalized %p, expected %p", _finalized[0], memory);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate_AtTop)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	// The first allocation is below the one that grows
+	void *first = _allocate(arenaProvider, 16, NULL);
+
+	void *memory = _allocate(arenaProvider, 64, NULL);
+	void *saved = memory;
+
+	// The last block bumped grows in place
+	void *result = _reallocate(arenaProvider, &memory, 1024);
+	assertTrue(result == saved, "Expected in place growth at %p, got %p", saved, result);
+	memset(memory, 0x5A, 1024);
+
+	_validate(arenaProvider, memory);
+	_release(arenaProvider, &memory);
+	_release(arenaProvider, &first);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate_Move)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+	uint8_t *memory = _allocate(arenaProvider, 64, _recordFinalizer);
+	memset(memory, 0x5A, 64);
+	// The reset cleans this one up
+	_allocate(arenaProvider, 64, NULL);
+
+	// Not the top block, so it moves
+	void *saved = memory;
+	void *result = _reallocate(arenaProvider, (void **) &memory, 1024);
+	assertNotNull(result, "Reallocate failed");
+	assertTrue(result != saved, "Expected the block to move");
+	assertTrue(memory[63] == 0x5A, "Lost the contents");
+	_validate(arenaProvider, memory);
+
+	// The reset finalizes the new block once, and not the old one
+	folioArenaProvider_Reset(arenaProvider);
+	assertTrue(_finalizedCount == 1, "Expected 1 finalizer call, got %u", _finalizedCount);
+	assertTrue(_finalized[0] == memory, "Finalized %p, expected %p", _finalized[0], (void *) memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_OutOfMemory)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_setAvailableMemory(arenaProvider, 10);
+	void *memory = _allocate(arenaProvider, 11, NULL);
+	assertNull(memory, "Should not have allocated beyond the pool size");
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(arenaProvider);
+	FolioStatsSnapshot stats;
+	folioStats_Sum(&state->stats, &stats);
+	assertTrue(stats.outOfMemoryCount == 1, "Expected 1 out of memory, got %zu", stats.outOfMemoryCount);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAndZero)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t allocSize = 64;
+	uint8_t *memory = _allocateAndZero(arenaProvider, allocSize, NULL);
+	for (size_t i = 0; i < allocSize; ++i) {
+		assertTrue(memory[i] == 0, "Byte %zu not zero: %02X", i, memory[i]);
+	}
+
+	_release(arenaProvider, (void **) &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _acquire)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(arenaProvider, 32, NULL);
+	void *copy = _acquire(arenaProvider, memory);
+
+	size_t acquireCount = _acquireCount(arenaProvider);
+	assertTrue(acquireCount == 2, "Expected 2 acquires, got %zu", acquireCount);
+
+	_release(arenaProvider, &copy);
+	_release(arenaProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _report)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(arenaProvider, 32, NULL);
+	_report(arenaProvider, stdout);
+	_release(arenaProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _length)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t allocSize = 77;
+	void *memory = _allocate(arenaProvider, allocSize, NULL);
+	size_t length = _length(arenaProvider, memory);
+	assertTrue(length == allocSize, "Expected %zu, got %zu", allocSize, length);
+	_release(arenaProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _scavenge)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(arenaProvider);
+
+	void *memory = _allocate(arenaProvider, 100, NULL);
+
+	// Not empty, so nothing to give back
+	size_t scavenged = _scavenge(arenaProvider, SIZE_MAX);
+	assertTrue(scavenged == 0, "Expected 0 bytes from a live arena, got %zu", scavenged);
+
+	_release(arenaProvider, &memory);
+	folioArenaProvider_Reset(arenaProvider);
+	assertTrue(state->chunkCount == 1, "Expected the reset to keep 1 chunk, got %zu", state->chunkCount);
+
+	// The kept chunk only goes as a whole, so a budget smaller than it gives back nothing
+	scavenged = _scavenge(arenaProvider, 1);
+	assertTrue(scavenged == 0, "Expected 0 bytes from a 1 byte budget, got %zu", scavenged);
+	assertTrue(state->chunkCount == 1, "Expected the chunk kept, got %zu", state->chunkCount);
+
+	scavenged = _scavenge(arenaProvider, SIZE_MAX);
+	assertTrue(scavenged == ChunkLength, "Expected %zu bytes, got %zu", ChunkLength, scavenged);
+	assertTrue(state->chunkCount == 0, "Expected no chunks, got %zu", state->chunkCount);
+
+	// Still usable
+	memory = _allocate(arenaProvider, 100, NULL);
+	assertNotNull(memory, "Allocate after scavenge failed");
+	_release(arenaProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Reset)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *a = _allocate(arenaProvider, 100, NULL);
+	void *b = _allocate(arenaProvider, 200, NULL);
+	_acquire(arenaProvider, b);
+
+	// Without finalizers the reset has nothing to walk
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(arenaProvider);
+	assertNull(state->log, "Allocations without a finalizer should not be logged");
+
+	folioArenaProvider_Reset(arenaProvider);
+
+	size_t acquireCount = _acquireCount(arenaProvider);
+	assertTrue(acquireCount == 0, "Expected 0 acquires after reset, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(arenaProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes after reset, got %zu", allocationSize);
+
+	assertTrue(state->chunkCount == 1, "Expected one chunk kept for reuse, got %zu", state->chunkCount);
+	assertTrue(state->resetCount == 1, "Expected 1 reset, got %zu", state->resetCount);
+
+	// The kept chunk is used again
+	void *c = _allocate(arenaProvider, 100, NULL);
+	assertTrue(c == a, "Expected the first allocation after reset at %p, got %p", a, c);
+	_release(arenaProvider, &c);
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Reset_FinalizerOrder)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+
+	void *memory[4];
+	for (int i = 0; i < 4; ++i) {
+		memory[i] = _allocate(arenaProvider, 16, _recordFinalizer);
+	}
+
+	folioArenaProvider_Reset(arenaProvider);
+
+	assertTrue(_finalizedCount == 4, "Expected 4 finalizers, got %u", _finalizedCount);
+	for (int i = 0; i < 4; ++i) {
+		assertTrue(_finalized[i] == memory[3 - i], "Finalizer %d ran on %p expected %p", i, _finalized[i], memory[3 - i]);
+	}
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Reset_AfterRelease)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+
+	void *a = _allocate(arenaProvider, 16, _recordFinalizer);
+	void *b = _allocate(arenaProvider, 16, _recordFinalizer);
+	void *expected = b;
+	_release(arenaProvider, &b);
+	assertTrue(_finalizedCount == 1, "Expected release to finalize, got %u", _finalizedCount);
+
+	folioArenaProvider_Reset(arenaProvider);
+
+	// b must not be finalized again
+	assertTrue(_finalizedCount == 2, "Expected 2 finalizers, got %u", _finalizedCount);
+	assertTrue(_finalized[0] == expected, "Wrong first finalizer %p expected %p", _finalized[0], expected);
+	assertTrue(_finalized[1] == a, "Wrong second finalizer %p expected %p", _finalized[1], a);
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Reset_FinalizerReleases)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+
+	// old holds a reference to young and young holds a reference to old
+	Node *old = _allocate(arenaProvider, sizeof(Node), _nodeFinalizer);
+	Node *young = _allocate(arenaProvider, sizeof(Node), _nodeFinalizer);
+	old->provider = arenaProvider;
+	old->other = _acquire(arenaProvider, young);
+	young->provider = arenaProvider;
+	young->other = _acquire(arenaProvider, old);
+
+	folioArenaProvider_Reset(arenaProvider);
+
+	assertTrue(_finalizedCount == 2, "Expected 2 finalizers, got %u", _finalizedCount);
+
+	size_t acquireCount = _acquireCount(arenaProvider);
+	assertTrue(acquireCount == 0, "Expected 0 acquires after reset, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(arenaProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes after reset, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Reset_ManyAllocations)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+
+	// Several log pages and several chunks
+	const unsigned count = 3 * LogEntries;
+	for (unsigned i = 0; i < count; ++i) {
+		void *memory = _allocate(arenaProvider, 200, _recordFinalizer);
+		assertNotNull(memory, "Allocation %u failed", i);
+	}
+
+	ArenaState *state = (ArenaState *) folioInternalProvider_GetProviderState(arenaProvider);
+	assertTrue(state->chunkCount > 1, "Expected more than one chunk, got %zu", state->chunkCount);
+
+	folioArenaProvider_Reset(arenaProvider);
+	assertTrue(_finalizedCount == count, "Expected %u finalizers, got %u", count, _finalizedCount);
+	assertTrue(state->chunkCount == 1, "Expected one chunk kept for reuse, got %zu", state->chunkCount);
+}
+
+LONGBOW_TEST_CASE(Local, folioArenaProvider_Release)
+{
+	FolioMemoryProvider *arenaProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizedCount = 0;
+	_allocate(arenaProvider, 16, _recordFinalizer);
+
+	bool finalRelease = folioArenaProvider_Release(&arenaProvider);
+	assertTrue(finalRelease, "Expected the final release");
+	assertNull(arenaProvider, "Release should null the provider");
+	assertTrue(_finalizedCount == 1, "Expected 1 finalizer, got %u", _finalizedCount);
+
+	longBowTestCase_SetClipBoardData(testCase, NULL);
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_ArenaProvider);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
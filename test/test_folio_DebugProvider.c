@@ -35,8 +35,10 @@ LONGBOW_TEST_FIXTURE(Local)
     LONGBOW_RUN_TEST_CASE(Local, _allocate);
     LONGBOW_RUN_TEST_CASE(Local, _allocate_ZeroLength);
     LONGBOW_RUN_TEST_CASE(Local, _allocate_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate);
 
     LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateBatch);
     LONGBOW_RUN_TEST_CASE(Local, _acquire);
     LONGBOW_RUN_TEST_CASE(Local, _report);
     LONGBOW_RUN_TEST_CASE(Local, _length);
@@ -91,6 +93,93 @@ LONGBOW_TEST_CASE(Local, _allocate)
 	_release(debugProvider, &memory);
 }
 
+static void
+_countEntry(const void *memory __attribute__((unused)), void *closure)
+{
+	(*(size_t *) closure)++;
+}
+
+static size_t
+_listLength(DebugState *state)
+{
+	size_t length = 0;
+	folioInternalList_ForEach(state->allocationList, _countEntry, &length);
+	return length;
+}
+
+typedef struct find_entry {
+	const void *memory;
+	size_t found;
+} FindEntry;
+
+static void
+_findEntry(const void *memory, void *closure)
+{
+	FindEntry *find = closure;
+	if (memory == find->memory) {
+		find->found++;
+	}
+}
+
+static size_t
+_listCount(DebugState *state, const void *memory)
+{
+	FindEntry find = { .memory = memory, .found = 0 };
+	folioInternalList_ForEach(state->allocationList, _findEntry, &find);
+	return find.found;
+}
+
+LONGBOW_TEST_CASE(Local, _allocateBatch)
+{
+	FolioMemoryProvider *debugProvider = longBowTestCase_GetClipBoardData(testCase);
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(debugProvider);
+
+	// More than one release chunk
+	void *memory[100];
+	size_t allocated = _allocateBatch(debugProvider, 100, 32, NULL, memory);
+	assertTrue(allocated == 100, "Expected 100 allocations, got %zu", allocated);
+
+	size_t listLength = _listLength(state);
+	assertTrue(listLength == 100, "Expected 100 entries in the allocation list, got %zu", listLength);
+
+	void *copy = _acquire(debugProvider, memory[70]);
+	_releaseBatch(debugProvider, memory, allocated);
+
+	listLength = _listLength(state);
+	assertTrue(listLength == 1, "Expected 1 entry in the allocation list, got %zu", listLength);
+
+	size_t acquireCount = _acquireCount(debugProvider);
+	assertTrue(acquireCount == 1, "Expected 1 reference, got %zu", acquireCount);
+
+	_release(debugProvider, &copy);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate)
+{
+	FolioMemoryProvider *debugProvider = longBowTestCase_GetClipBoardData(testCase);
+	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(debugProvider);
+
+	void *memory = _allocate(debugProvider, 16, NULL);
+	void *old = memory;
+	size_t listLength = _listLength(state);
+
+	void *result = _reallocate(debugProvider, &memory, 64 * 1024);
+	assertNotNull(result, "Reallocate failed");
+
+	// The allocation list must follow the memory if it moved
+	DebugHeader *debug = (DebugHeader *) folioInternalProvider_GetProviderHeader(debugProvider, memory);
+	assertTrue(debug->allocListHandle != NULL, "No allocation list entry");
+	assertTrue(_listLength(state) == listLength, "Expected %zu entries in the allocation list, got %zu",
+			listLength, _listLength(state));
+	assertTrue(_listCount(state, memory) == 1, "The allocation list does not hold the new memory %p", memory);
+	if (memory != old) {
+		assertTrue(_listCount(state, old) == 0, "The allocation list still holds the old memory %p", old);
+	}
+
+	_validate(debugProvider, memory);
+	_release(debugProvider, &memory);
+}
+
 LONGBOW_TEST_CASE(Local, _allocate_ZeroLength)
 {
 	FolioMemoryProvider *debugProvider = longBowTestCase_GetClipBoardData(testCase);
@@ -238,8 +327,7 @@ LONGBOW_TEST_FIXTURE_TEARDOWN(CorruptMemory)
 
 	DebugState *state = (DebugState *) folioInternalProvider_GetProviderState(_data.provider);
 
-	state->stats.outstandingAllocs--;
-	state->stats.outstandingAcquires--;
+	folioStats_Release(&state->stats, true);
 	pool->currentAllocation -= _data.length;
 
 	if (!folio_TestRefCount(0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
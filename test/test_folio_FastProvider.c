@@ -0,0 +1,395 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include <LongBow/unit-test.h>
+
+#include "../src/folio_FastProvider.c"
+
+#include <Folio/folio.h>
+#include <inttypes.h>
+
+LONGBOW_TEST_RUNNER(folio_FastProvider)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Local);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_FastProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_FastProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Local)
+{
+    LONGBOW_RUN_TEST_CASE(Local, _allocate);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_ZeroLength);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_TooLarge);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAligned);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateBatch);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate);
+    LONGBOW_RUN_TEST_CASE(Local, _priority);
+    LONGBOW_RUN_TEST_CASE(Local, _acquire);
+    LONGBOW_RUN_TEST_CASE(Local, _acquireN);
+    LONGBOW_RUN_TEST_CASE(Local, _release_Finalizer);
+    LONGBOW_RUN_TEST_CASE(Local, _lock);
+    LONGBOW_RUN_TEST_CASE(Local, _report);
+    LONGBOW_RUN_TEST_CASE(Local, _length);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(Local)
+{
+	FolioMemoryProvider *fastProvider = folioFastProvider_Create(SIZE_MAX);
+	longBowTestCase_SetClipBoardData(testCase, fastProvider);
+
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Local)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	int status = LONGBOW_STATUS_SUCCEEDED;
+
+	if (!folioMemoryProvider_TestRefCount(fastProvider, 0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
+		_report(fastProvider, stdout);
+		status = LONGBOW_STATUS_MEMORYLEAK;
+	}
+
+	_releaseProvider(&fastProvider);
+
+	return status;
+}
+
+LONGBOW_TEST_CASE(Local, _allocate)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	assertTrue(sizeof(FastHeader) == 32, "Expected a 32 byte header, got %zu", sizeof(FastHeader));
+
+	const size_t allocSize = 9;
+	void *memory = _allocate(fastProvider, allocSize, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+	assertTrue(((uintptr_t) memory & (MallocAlignment - 1)) == 0, "Memory %p does not have malloc() alignment", memory);
+
+	size_t acquireCount = _acquireCount(fastProvider);
+	assertTrue(acquireCount == 1, "Expected 1 allocation, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == allocSize, "Expected %zu bytes, got %zu", allocSize, allocationSize);
+
+	assertTrue(((uintptr_t) memory & (_alignment_width - 1)) == 0, "Memory %p not aligned", memory);
+
+	_validate(fastProvider, memory);
+	_release(fastProvider, &memory);
+	assertNull(memory, "Release did not null the pointer");
+
+	allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_ZeroLength)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(fastProvider, 0, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+	_release(fastProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_OutOfMemory)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+	_setAvailableMemory(fastProvider, 64);
+
+	void * memory = _allocate(fastProvider, 128, NULL);
+	assertNull(memory, "memory should have been NULL due to out of memory");
+
+	FolioStatsSnapshot copy;
+	folioStats_Sum(_getStats(fastProvider), &copy);
+	assertTrue(copy.outOfMemoryCount == 1, "Expected 1 out of memory, got %zu", copy.outOfMemoryCount);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateBatch)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+	_setAvailableMemory(fastProvider, 250);
+
+	// The whole batch does not fit, so none of it is allocated
+	void *out[4];
+	size_t allocated = _allocateBatch(fastProvider, 4, 100, NULL, out);
+	assertTrue(allocated == 0, "Expected 0 allocations, got %zu", allocated);
+	for (size_t i = 0; i < 4; i++) {
+		assertNull(out[i], "out[%zu] should be NULL", i);
+	}
+	assertTrue(_allocationSize(fastProvider) == 0, "The failed batch should give back its reservation");
+
+	allocated = _allocateBatch(fastProvider, 4, 50, NULL, out);
+	assertTrue(allocated == 4, "Expected 4 allocations, got %zu", allocated);
+	assertTrue(_allocationSize(fastProvider) == 200, "Expected 200 bytes, got %zu", _allocationSize(fastProvider));
+
+	_releaseBatch(fastProvider, out, allocated);
+	assertTrue(_allocationSize(fastProvider) == 0, "Expected 0 bytes, got %zu", _allocationSize(fastProvider));
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_TooLarge)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	// The header only has 32 bits for the length
+	void * memory = _allocate(fastProvider, (size_t) UINT32_MAX + 1, NULL);
+	assertNull(memory, "memory should have been NULL, the length does not fit the header");
+
+	size_t allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAndZero)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	uint8_t truth[length];
+	memset(truth, 0, length);
+
+	void *memory = _allocateAndZero(fastProvider, length, NULL);
+	int result = memcmp(truth, memory, length);
+	assertTrue(result == 0, "Memory was not set to zero");
+	_release(fastProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAligned)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t alignments[] = { 8, 16, 32, 4096 };
+	for (size_t i = 0; i < sizeof(alignments) / sizeof(size_t); i++) {
+		char *memory = _allocateAligned(fastProvider, 6, alignments[i], NULL);
+		assertNotNull(memory, "Did not return memory pointer");
+		assertTrue(((uintptr_t) memory & (alignments[i] - 1)) == 0, "Memory %p not aligned to %zu", (void *) memory, alignments[i]);
+		strcpy(memory, "hello");
+
+		// Keeps the alignment when it moves
+		void *result = _reallocate(fastProvider, (void **) &memory, 10000);
+		assertNotNull(result, "Reallocate failed");
+		assertTrue(((uintptr_t) memory & (alignments[i] - 1)) == 0, "Memory %p lost its alignment", (void *) memory);
+		assertTrue(strcmp(memory, "hello") == 0, "Lost the contents, got '%s'", memory);
+
+		_validate(fastProvider, memory);
+		_release(fastProvider, (void **) &memory);
+	}
+
+	size_t allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	char *memory = _allocate(fastProvider, 6, NULL);
+	strcpy(memory, "hello");
+
+	void *copy = _acquire(fastProvider, memory);
+	void *result = _reallocate(fastProvider, (void **) &memory, 4096);
+	assertNull(result, "Should not reallocate memory with 2 references");
+	_release(fastProvider, &copy);
+
+	result = _reallocate(fastProvider, (void **) &memory, 4096);
+	assertNotNull(result, "Reallocate failed");
+	assertTrue(strcmp(memory, "hello") == 0, "Lost the contents, got '%s'", memory);
+	assertTrue(_length(fastProvider, memory) == 4096, "Wrong length");
+
+	size_t allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == 4096, "Expected 4096 bytes, got %zu", allocationSize);
+
+	_release(fastProvider, (void **) &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _priority)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+	FolioPool *pool = folioPool_GetFromProvider(fastProvider);
+
+	folioMemoryProvider_SetPriorityClass(fastProvider, FolioPriority_Bulk, 0, 100);
+	FolioPriority prior = folioMemoryProvider_SetThreadPriority(FolioPriority_Bulk);
+	assertTrue(prior == FolioPriority_Normal, "Expected the thread to start in Normal, got %d", prior);
+
+	void *memory = _allocate(fastProvider, 64, NULL);
+	assertNotNull(memory, "Should allocate under the cap");
+	void *fail = _allocate(fastProvider, 64, NULL);
+	assertNull(fail, "Should not allocate above the cap");
+
+	// The block keeps its class, whatever the thread's class is now
+	folioMemoryProvider_SetThreadPriority(FolioPriority_Normal);
+	void *result = _reallocate(fastProvider, &memory, 101);
+	assertNull(result, "Should not reallocate above the cap");
+
+	void *aligned = folioMemoryProvider_AllocateWithPriority(fastProvider, 32, NULL, FolioPriority_Bulk);
+	assertNotNull(aligned, "Should allocate under the cap");
+
+	uint64_t bulk = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].current);
+	assertTrue(bulk == 96, "Expected 96 bulk bytes, got %" PRIu64, bulk);
+	uint64_t denials = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].denials);
+	assertTrue(denials == 2, "Expected 2 denials, got %" PRIu64, denials);
+
+	_release(fastProvider, &memory);
+	_release(fastProvider, &aligned);
+
+	bulk = atomic_load(&pool->priorityClasses[FolioPriority_Bulk].current);
+	assertTrue(bulk == 0, "Expected 0 bulk bytes, got %" PRIu64, bulk);
+
+	folioMemoryProvider_SetPriorityClass(fastProvider, FolioPriority_Bulk, 0, SIZE_MAX);
+}
+
+LONGBOW_TEST_CASE(Local, _acquire)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	void *memory = _allocate(fastProvider, length, NULL);
+	void *mem2 = _acquire(fastProvider, memory);
+
+	size_t acquireCount = _acquireCount(fastProvider);
+	assertTrue(acquireCount == 2, "Expected 2 allocation, got %zu", acquireCount);
+
+	_release(fastProvider, &memory);
+
+	acquireCount = _acquireCount(fastProvider);
+	assertTrue(acquireCount == 1, "Expected 1 allocation, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(fastProvider);
+	assertTrue(allocationSize == length, "Expected %zu bytes, got %zu", length, allocationSize);
+
+	_release(fastProvider, &mem2);
+}
+
+static unsigned _finalizerCalls;
+
+static void
+_finalizer(void *memory)
+{
+	assertTrue(*(uint32_t *) memory == 0xDEADBEEF, "Finalizer got the wrong memory");
+	_finalizerCalls++;
+}
+
+LONGBOW_TEST_CASE(Local, _acquireN)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizerCalls = 0;
+	uint32_t *memory = _allocate(fastProvider, 128, _finalizer);
+	*memory = 0xDEADBEEF;
+	_acquireN(fastProvider, memory, 9);
+
+	size_t acquireCount = _acquireCount(fastProvider);
+	assertTrue(acquireCount == 10, "Expected 10 references, got %zu", acquireCount);
+
+	void *copy = memory;
+	_releaseN(fastProvider, &copy, 4);
+	assertTrue(_finalizerCalls == 0, "Finalizer ran with references left");
+
+	_releaseN(fastProvider, (void **) &memory, 6);
+	assertTrue(_finalizerCalls == 1, "Expected 1 finalizer call, got %u", _finalizerCalls);
+
+	acquireCount = _acquireCount(fastProvider);
+	assertTrue(acquireCount == 0, "Expected 0 references, got %zu", acquireCount);
+}
+
+LONGBOW_TEST_CASE(Local, _release_Finalizer)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalizerCalls = 0;
+	uint32_t *memory = _allocate(fastProvider, sizeof(uint32_t), _finalizer);
+	*memory = 0xDEADBEEF;
+
+	void *mem2 = _acquire(fastProvider, memory);
+	_release(fastProvider, &mem2);
+	assertTrue(_finalizerCalls == 0, "Finalizer called before the final release");
+
+	_release(fastProvider, (void **) &memory);
+	assertTrue(_finalizerCalls == 1, "Expected 1 finalizer call, got %u", _finalizerCalls);
+}
+
+LONGBOW_TEST_CASE(Local, _lock)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(fastProvider, 64, NULL);
+	FastHeader *header = _getHeader(memory);
+
+	_lock(fastProvider, memory);
+	assertTrue(atomic_load(&header->state) & LockBit, "Lock bit not set");
+
+	// The lock bit does not disturb the reference count
+	void *mem2 = _acquire(fastProvider, memory);
+	_release(fastProvider, &mem2);
+	assertTrue((atomic_load(&header->state) & ReferenceMask) == 1, "Wrong reference count");
+
+	_unlock(fastProvider, memory);
+	assertFalse(atomic_load(&header->state) & LockBit, "Lock bit still set");
+
+	_release(fastProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _report)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(fastProvider, 128, NULL);
+	_display(fastProvider, memory, stdout);
+	_report(fastProvider, stdout);
+	_release(fastProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _length)
+{
+	FolioMemoryProvider *fastProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	void *memory = _allocate(fastProvider, length, NULL);
+	size_t test = _length(fastProvider, memory);
+	assertTrue(length == test, "Wrong length, expected %zu got %zu", length, test);
+	_release(fastProvider, &memory);
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_FastProvider);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
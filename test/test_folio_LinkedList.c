@@ -48,6 +48,8 @@ LONGBOW_TEST_FIXTURE(Global)
 {
     LONGBOW_RUN_TEST_CASE(Global, folioLinkedList_Create);
     LONGBOW_RUN_TEST_CASE(Global, folioLinkedList_Append);
+    LONGBOW_RUN_TEST_CASE(Global, folioLinkedList_Remove_MovesReference);
+    LONGBOW_RUN_TEST_CASE(Global, folioLinkedList_Release_NotEmpty);
 }
 
 LONGBOW_TEST_FIXTURE_SETUP(Global)
@@ -104,6 +106,40 @@ LONGBOW_TEST_CASE(Global, folioLinkedList_Append)
 	folioLinkedList_Release(&list);
 }
 
+LONGBOW_TEST_CASE(Global, folioLinkedList_Remove_MovesReference)
+{
+	FolioLinkedList *list = folioLinkedList_Create();
+	Integer *integer = folio_Allocate(sizeof(Integer));
+
+	// The list and the integer, plus the list's reference to the integer and its entry
+	folioLinkedList_Append(list, integer);
+	size_t references = folio_OustandingReferences();
+	assertTrue(references == 4, "Expected 4 references, got %zu", references);
+
+	// The entry is gone and its reference to the integer now belongs to the caller
+	Integer *test = folioLinkedList_Remove(list);
+	assertTrue(test == integer, "Wrong element, expected %p actual %p", (void *) integer, (void *) test);
+	references = folio_OustandingReferences();
+	assertTrue(references == 3, "Expected 3 references, got %zu", references);
+
+	folio_Release((void **) &test);
+	folio_Release((void **) &integer);
+	folioLinkedList_Release(&list);
+}
+
+LONGBOW_TEST_CASE(Global, folioLinkedList_Release_NotEmpty)
+{
+	FolioLinkedList *list = folioLinkedList_Create();
+	Integer *integer = folio_Allocate(sizeof(Integer));
+
+	folioLinkedList_Append(list, integer);
+	folioLinkedList_Append(list, integer);
+
+	// The list finalizer releases the entries' references
+	folioLinkedList_Release(&list);
+	folio_Release((void **) &integer);
+}
+
 /*****************************************************/
 
 
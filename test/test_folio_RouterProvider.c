@@ -0,0 +1,343 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include <LongBow/unit-test.h>
+
+#include "../src/folio_RouterProvider.c"
+
+#include <Folio/folio.h>
+#include <Folio/folio_StdProvider.h>
+
+LONGBOW_TEST_RUNNER(folio_RouterProvider)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Local);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_RouterProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_RouterProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Local)
+{
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_Routes);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_Fallback);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_PoolSize);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateBatch_DoesNotFit);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAligned);
+    LONGBOW_RUN_TEST_CASE(Local, _acquire);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate);
+    LONGBOW_RUN_TEST_CASE(Local, _releaseBatch);
+    LONGBOW_RUN_TEST_CASE(Local, _finalizer);
+    LONGBOW_RUN_TEST_CASE(Local, _createChild);
+    LONGBOW_RUN_TEST_CASE(Local, _report);
+}
+
+typedef struct test_data {
+	FolioMemoryProvider *small;
+	FolioMemoryProvider *large;
+	FolioMemoryProvider *router;
+} TestData;
+
+#define SmallRoute 256
+
+LONGBOW_TEST_FIXTURE_SETUP(Local)
+{
+	TestData *data = malloc(sizeof(TestData));
+	data->small = folioStdProvider_Create(SIZE_MAX);
+	data->large = folioStdProvider_Create(SIZE_MAX);
+	data->router = folioRouterProvider_Create(SIZE_MAX, data->large, NULL);
+	folioRouterProvider_AddRoute(data->router, SmallRoute, data->small, data->large);
+
+	longBowTestCase_SetClipBoardData(testCase, data);
+
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Local)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	int status = LONGBOW_STATUS_SUCCEEDED;
+
+	FolioMemoryProvider *providers[] = { data->router, data->small, data->large };
+	for (unsigned i = 0; i < 3; ++i) {
+		if (!folioMemoryProvider_TestRefCount(providers[i], 0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
+			folioMemoryProvider_Report(providers[i], stdout);
+			status = LONGBOW_STATUS_MEMORYLEAK;
+		}
+	}
+
+	assertFalse(folioMemoryProvider_ReleaseProvider(&data->small), "The router should hold a reference to small");
+	assertFalse(folioMemoryProvider_ReleaseProvider(&data->large), "The router should hold a reference to large");
+	assertTrue(folioMemoryProvider_ReleaseProvider(&data->router), "The router should be freed");
+	free(data);
+
+	return status;
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_Routes)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	void *small = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	void *edge = folioMemoryProvider_Allocate(data->router, SmallRoute, NULL);
+	void *large = folioMemoryProvider_Allocate(data->router, 1000, NULL);
+
+	size_t expected = 100 + SmallRoute + 2 * PrefixLength;
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == expected, "Wrong small bytes, expected %zu got %zu",
+			expected, folioMemoryProvider_AllocatedBytes(data->small));
+	expected = 1000 + PrefixLength;
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == expected, "Wrong large bytes, expected %zu got %zu",
+			expected, folioMemoryProvider_AllocatedBytes(data->large));
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 100 + SmallRoute + 1000, "Wrong router bytes, got %zu",
+			folioMemoryProvider_AllocatedBytes(data->router));
+
+	assertTrue(folioMemoryProvider_Length(data->router, small) == 100, "Wrong length %zu",
+			folioMemoryProvider_Length(data->router, small));
+	memset(large, 0xAA, 1000);
+	folioMemoryProvider_Validate(data->router, large);
+
+	folioMemoryProvider_Release(data->router, &small);
+	folioMemoryProvider_Release(data->router, &edge);
+	folioMemoryProvider_Release(data->router, &large);
+	assertNull(small, "Release should set the pointer to NULL");
+
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 0, "Small should be empty");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == 0, "Large should be empty");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 0, "Router should be empty");
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_Fallback)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	folioMemoryProvider_SetAvailableMemory(data->small, 100 + PrefixLength);
+
+	void *first = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	void *second = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	assertNotNull(second, "The fallback should take the allocation");
+
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == 100 + PrefixLength, "The second allocation should be in large, got %zu",
+			folioMemoryProvider_AllocatedBytes(data->large));
+
+	RouterState *state = (RouterState *) folioInternalProvider_GetProviderState(data->router);
+	assertTrue(atomic_load(&state->routes[0].fallbacks) == 1, "Wrong fallback count %" PRIu64,
+			(uint64_t) atomic_load(&state->routes[0].fallbacks));
+
+	// Each goes back to its own provider
+	folioMemoryProvider_Release(data->router, &second);
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == 0, "Large should be empty");
+	folioMemoryProvider_Release(data->router, &first);
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 0, "Small should be empty");
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_PoolSize)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	folioMemoryProvider_SetAvailableMemory(data->router, 1500);
+
+	void *first = folioMemoryProvider_Allocate(data->router, 1000, NULL);
+	void *second = folioMemoryProvider_Allocate(data->router, 1000, NULL);
+	assertNull(second, "The router pool should be full");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == 1000 + PrefixLength, "The failed allocation should not reach large");
+
+	folioMemoryProvider_Release(data->router, &first);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateBatch_DoesNotFit)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	folioMemoryProvider_SetAvailableMemory(data->router, 2500);
+
+	// The whole batch does not fit, so none of it is allocated
+	void *out[4];
+	memset(out, 0xA5, sizeof(out));
+	size_t allocated = folioMemoryProvider_AllocateBatch(data->router, 4, 1000, NULL, out);
+	assertTrue(allocated == 0, "Expected 0 allocations, got %zu", allocated);
+	for (size_t i = allocated; i < 4; i++) {
+		assertNull(out[i], "out[%zu] should be NULL", i);
+	}
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 0, "The failed batch should give back its reservation");
+
+	allocated = folioMemoryProvider_AllocateBatch(data->router, 4, 500, NULL, out);
+	assertTrue(allocated == 4, "Expected 4 allocations, got %zu", allocated);
+	for (size_t i = 0; i < 4; i++) {
+		assertTrue(folioMemoryProvider_Length(data->router, out[i]) == 500, "Wrong length of out[%zu]", i);
+	}
+
+	folioMemoryProvider_ReleaseBatch(data->router, out, allocated);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAligned)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	size_t alignments[] = { 8, 32, 64, 4096 };
+	for (unsigned i = 0; i < sizeof(alignments) / sizeof(alignments[0]); ++i) {
+		uint8_t *memory = folioMemoryProvider_AllocateAligned(data->router, 100, alignments[i], NULL);
+		assertTrue(((uintptr_t) memory & (alignments[i] - 1)) == 0, "Memory %p not aligned to %zu", (void *) memory, alignments[i]);
+		assertTrue(folioMemoryProvider_Length(data->router, memory) == 100, "Wrong length");
+
+		memset(memory, 0x55, 100);
+		folioMemoryProvider_Validate(data->router, memory);
+		folioMemoryProvider_Release(data->router, (void **) &memory);
+	}
+
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 0, "Small should be empty");
+}
+
+LONGBOW_TEST_CASE(Local, _acquire)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	void *copy = folioMemoryProvider_Acquire(data->router, memory);
+	void *copies = folioMemoryProvider_AcquireN(data->router, memory, 3);
+	assertTrue(folioMemoryProvider_OustandingReferences(data->router) == 5, "Wrong references %zu",
+			folioMemoryProvider_OustandingReferences(data->router));
+
+	folioMemoryProvider_Lock(data->router, memory);
+	folioMemoryProvider_Unlock(data->router, memory);
+
+	folioMemoryProvider_ReleaseN(data->router, &copies, 3);
+	folioMemoryProvider_Release(data->router, &copy);
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 100, "Memory should still be allocated");
+
+	folioMemoryProvider_Release(data->router, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	uint8_t *memory = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	memset(memory, 0x33, 100);
+
+	// Stays with small, past the route
+	assertNotNull(folioMemoryProvider_Reallocate(data->router, (void **) &memory, 1000), "Reallocate failed");
+	assertTrue(memory[99] == 0x33, "Contents not kept");
+	assertTrue(folioMemoryProvider_Length(data->router, memory) == 1000, "Wrong length");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 1000, "Wrong router bytes %zu",
+			folioMemoryProvider_AllocatedBytes(data->router));
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 1000 + PrefixLength, "Wrong small bytes %zu",
+			folioMemoryProvider_AllocatedBytes(data->small));
+
+	assertNotNull(folioMemoryProvider_Reallocate(data->router, (void **) &memory, 10), "Reallocate failed");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 10, "Wrong router bytes %zu",
+			folioMemoryProvider_AllocatedBytes(data->router));
+
+	folioMemoryProvider_Release(data->router, (void **) &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _releaseBatch)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	size_t lengths[] = { 10, 20, 1000, 2000, 30, 3000 };
+	void *memory[6];
+	for (unsigned i = 0; i < 6; ++i) {
+		memory[i] = folioMemoryProvider_Allocate(data->router, lengths[i], NULL);
+	}
+
+	folioMemoryProvider_ReleaseBatch(data->router, memory, 6);
+
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 0, "Small should be empty");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->large) == 0, "Large should be empty");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 0, "Router should be empty");
+}
+
+static void *_finalized;
+
+static void
+_recordFinalizer(void *memory)
+{
+	_finalized = memory;
+}
+
+LONGBOW_TEST_CASE(Local, _finalizer)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	_finalized = NULL;
+	void *memory = folioMemoryProvider_Allocate(data->router, 1000, _recordFinalizer);
+	void *expected = memory;
+	void *copy = folioMemoryProvider_Acquire(data->router, memory);
+
+	folioMemoryProvider_Release(data->router, &memory);
+	assertNull(_finalized, "Finalizer should not run before the last release");
+
+	folioMemoryProvider_Release(data->router, &copy);
+	assertTrue(_finalized == expected, "Finalizer got %p expected %p", _finalized, expected);
+}
+
+LONGBOW_TEST_CASE(Local, _createChild)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	FolioMemoryProvider *child = folioMemoryProvider_CreateChild(data->router, 1000);
+
+	void *memory = folioMemoryProvider_Allocate(child, 100, NULL);
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->small) == 100 + PrefixLength, "The child should use the routes");
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) > 0, "The child should charge the router");
+
+	void *tooLarge = folioMemoryProvider_Allocate(child, 1000, NULL);
+	assertNull(tooLarge, "The child limit should hold");
+
+	folioMemoryProvider_Release(child, &memory);
+	assertTrue(folioMemoryProvider_AllocatedBytes(data->router) == 0, "The child should give back its charge");
+
+	folioMemoryProvider_ReleaseProvider(&child);
+}
+
+LONGBOW_TEST_CASE(Local, _report)
+{
+	TestData *data = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = folioMemoryProvider_Allocate(data->router, 100, NULL);
+	folioMemoryProvider_Display(data->router, memory, stdout);
+	folioMemoryProvider_Report(data->router, stdout);
+	folioMemoryProvider_Release(data->router, &memory);
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_RouterProvider);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
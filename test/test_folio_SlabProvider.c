@@ -0,0 +1,649 @@
+/*
+   Copyright (c) 2017, Palo Alto Research Center
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+   FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+   OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The source file being tested
+#include <LongBow/unit-test.h>
+
+#include "../src/folio_SlabProvider.c"
+
+#include <Folio/folio.h>
+
+LONGBOW_TEST_RUNNER(folio_SlabProvider)
+{
+    LONGBOW_RUN_TEST_FIXTURE(Local);
+    LONGBOW_RUN_TEST_FIXTURE(CorruptMemory);
+}
+
+LONGBOW_TEST_RUNNER_SETUP(folio_SlabProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_RUNNER_TEARDOWN(folio_SlabProvider)
+{
+    return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE(Local)
+{
+    LONGBOW_RUN_TEST_CASE(Local, _sizeClassIndex);
+    LONGBOW_RUN_TEST_CASE(Local, _statsAlignment);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_ZeroLength);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_OutOfMemory);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_ReuseBlock);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_ManySlabs);
+    LONGBOW_RUN_TEST_CASE(Local, _allocate_Large);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAligned);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate_SameClass);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate_OtherClass);
+    LONGBOW_RUN_TEST_CASE(Local, _threadCache_Flush);
+    LONGBOW_RUN_TEST_CASE(Local, _threadCache_DrainOnExit);
+    LONGBOW_RUN_TEST_CASE(Local, _threadCache_ManyProviders);
+    LONGBOW_RUN_TEST_CASE(Local, _reserve);
+    LONGBOW_RUN_TEST_CASE(Local, _scavenge);
+    LONGBOW_RUN_TEST_CASE(Local, _scavenge_Retain);
+
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero_Fresh);
+    LONGBOW_RUN_TEST_CASE(Local, _acquire);
+    LONGBOW_RUN_TEST_CASE(Local, _report);
+    LONGBOW_RUN_TEST_CASE(Local, _length);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(Local)
+{
+	FolioMemoryProvider *slabProvider = folioSlabProvider_Create(SIZE_MAX);
+	longBowTestCase_SetClipBoardData(testCase, slabProvider);
+
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(Local)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	int status = LONGBOW_STATUS_SUCCEEDED;
+
+	if (!folioMemoryProvider_TestRefCount(slabProvider, 0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
+		_report(slabProvider, stdout);
+		status = LONGBOW_STATUS_MEMORYLEAK;
+	}
+
+	_releaseProvider(&slabProvider);
+
+	return status;
+}
+
+LONGBOW_TEST_CASE(Local, _sizeClassIndex)
+{
+	for (size_t length = 1; length <= MaximumClassLength; ++length) {
+		unsigned index = _sizeClassIndex(length);
+		assertTrue(index < SizeClassCount, "Length %zu has class %u beyond %u", length, index, SizeClassCount);
+
+		size_t classLength = _sizeClassLength(index);
+		assertTrue(classLength >= length, "Length %zu in class %u of only %zu bytes", length, index, classLength);
+
+		if (index > 0) {
+			size_t smaller = _sizeClassLength(index - 1);
+			assertTrue(smaller < length, "Length %zu should be in class %u (%zu bytes)", length, index - 1, smaller);
+		}
+	}
+
+	assertTrue(_sizeClassLength(SizeClassCount - 1) == MaximumClassLength, "Wrong maximum class length %zu",
+			_sizeClassLength(SizeClassCount - 1));
+}
+
+LONGBOW_TEST_CASE(Local, _statsAlignment)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	// Each stats shard must have its own cache line
+	assertTrue(((uintptr_t) &state->stats % 64) == 0, "Stats at %p are not 64 byte aligned", (void *) &state->stats);
+	assertTrue(((uintptr_t) &state->stats.shards[1] % 64) == 0, "Shard 1 at %p is not 64 byte aligned",
+			(void *) &state->stats.shards[1]);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t allocSize = 9;
+	void *memory = _allocate(slabProvider, allocSize, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+
+	size_t acquireCount = _acquireCount(slabProvider);
+	assertTrue(acquireCount == 1, "Expected 1 allocation, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == allocSize, "Expected %zu bytes, got %zu", allocSize, allocationSize);
+
+	assertTrue(((uintptr_t) memory & (_alignment_width - 1)) == 0, "Memory %p not aligned", memory);
+
+	_validate(slabProvider, memory);
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_ZeroLength)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t allocSize = 0;
+	void *memory = _allocate(slabProvider, allocSize, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == allocSize, "Expected %zu bytes, got %zu", allocSize, allocationSize);
+
+	_validate(slabProvider, memory);
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_OutOfMemory)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	_setAvailableMemory(slabProvider, 64);
+
+	void * memory = _allocate(slabProvider, 128, NULL);
+	assertNull(memory, "memory should have been NULL due to out of memory");
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_ReuseBlock)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *first = _allocate(slabProvider, 100, NULL);
+	void *saved = first;
+	_release(slabProvider, &first);
+
+	// A second allocation in the same size class should come off the free list
+	void *second = _allocate(slabProvider, 104, NULL);
+	assertTrue(second == saved, "Expected the freed block %p, got %p", saved, second);
+
+	_validate(slabProvider, second);
+	_release(slabProvider, &second);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_ManySlabs)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	// More blocks than fit in one slab
+	const size_t length = 4000;
+	const size_t count = 2 * SlabLength / length;
+	void *memory[count];
+
+	for (size_t i = 0; i < count; ++i) {
+		memory[i] = _allocate(slabProvider, length, NULL);
+		assertNotNull(memory[i], "Allocation %zu failed", i);
+		memset(memory[i], (int) i, length);
+	}
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+	assertTrue(state->slabCount >= 2, "Expected at least 2 slabs, got %zu", state->slabCount);
+
+	for (size_t i = 0; i < count; ++i) {
+		_validate(slabProvider, memory[i]);
+		_release(slabProvider, &memory[i]);
+	}
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _allocate_Large)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	const size_t length = 2 * MaximumClassLength;
+	void *memory = _allocate(slabProvider, length, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+	assertTrue(atomic_load(&state->largeAllocs) == 1, "Expected 1 large alloc, got %zu", atomic_load(&state->largeAllocs));
+
+	memset(memory, 0x5A, length);
+	_validate(slabProvider, memory);
+	_release(slabProvider, &memory);
+
+	assertTrue(atomic_load(&state->largeAllocs) == 0, "Expected 0 large allocs, got %zu", atomic_load(&state->largeAllocs));
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAligned)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	// One from a size class and one large block
+	const size_t lengths[] = { 100, 2 * MaximumClassLength };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		void *memory = _allocateAligned(slabProvider, lengths[i], 4096, NULL);
+		assertNotNull(memory, "Did not return memory pointer");
+		assertTrue(((uintptr_t) memory & 4095) == 0, "Memory %p not aligned to 4096", memory);
+		memset(memory, 0xA5, lengths[i]);
+
+		_validate(slabProvider, memory);
+		_release(slabProvider, &memory);
+	}
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate_SameClass)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	FolioPool *pool = folioPool_GetFromProvider(slabProvider);
+
+	// Find how far the block can grow in its size class
+	const size_t length = 100;
+	size_t overhead = pool->headerAlignedLength + pool->trailerAlignedLength;
+	size_t classLength = _sizeClassLength(_sizeClassIndex(folioInternalProvider_BlockLength(slabProvider, length)));
+	size_t newLength = (classLength - overhead) & ~(_alignment_width - 1);
+
+	void *memory = _allocate(slabProvider, length, NULL);
+	void *saved = memory;
+	void *result = _reallocate(slabProvider, &memory, newLength);
+	assertTrue(result == saved, "Expected in place growth at %p, got %p", saved, result);
+	memset(memory, 0x5A, newLength);
+
+	_validate(slabProvider, memory);
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate_OtherClass)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	uint8_t *memory = _allocate(slabProvider, 100, NULL);
+	memset(memory, 0x5A, 100);
+
+	// To a bigger class, then to a large malloc() block, then back
+	const size_t lengths[] = { 1000, 2 * MaximumClassLength, 4 * MaximumClassLength, 50 };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		void *result = _reallocate(slabProvider, (void **) &memory, lengths[i]);
+		assertNotNull(result, "Reallocate to %zu failed", lengths[i]);
+		_validate(slabProvider, memory);
+		assertTrue(memory[0] == 0x5A && memory[49] == 0x5A, "Lost the contents at length %zu", lengths[i]);
+	}
+
+	assertTrue(atomic_load(&state->largeAllocs) == 0, "Expected 0 large allocs, got %zu", atomic_load(&state->largeAllocs));
+	_release(slabProvider, (void **) &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _threadCache_Flush)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	const size_t length = 100;
+	const size_t count = 3 * CacheMaximumBlocks;
+	void *memory[count];
+
+	for (size_t i = 0; i < count; ++i) {
+		memory[i] = _allocate(slabProvider, length, NULL);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		_release(slabProvider, &memory[i]);
+	}
+
+	// The thread cache must have given the extra blocks back to the size class
+	ThreadCache *cache = _getThreadCache(state);
+	for (unsigned i = 0; i < SizeClassCount; ++i) {
+		assertTrue(cache->magazines[i].count <= _cacheLimit(i), "Class %u cached %u blocks, limit %u",
+				i, cache->magazines[i].count, _cacheLimit(i));
+
+		assertTrue(state->classes[i].blocksInUse == cache->magazines[i].count,
+				"Class %u has %zu blocks in use, but %u cached and none allocated",
+				i, state->classes[i].blocksInUse, cache->magazines[i].count);
+	}
+}
+
+static void *
+_threadCacheWorker(void *arg)
+{
+	FolioMemoryProvider *slabProvider = arg;
+
+	const size_t count = 10;
+	void *memory[count];
+
+	for (size_t i = 0; i < count; ++i) {
+		memory[i] = _allocate(slabProvider, 100, NULL);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		_release(slabProvider, &memory[i]);
+	}
+
+	return NULL;
+}
+
+LONGBOW_TEST_CASE(Local, _threadCache_DrainOnExit)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, _threadCacheWorker, slabProvider);
+	pthread_join(thread, NULL);
+
+	assertNull(state->caches, "The thread cache was not destroyed on thread exit");
+
+	for (unsigned i = 0; i < SizeClassCount; ++i) {
+		assertTrue(state->classes[i].blocksInUse == 0, "Class %u has %zu blocks still in use",
+				i, state->classes[i].blocksInUse);
+	}
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _threadCache_ManyProviders)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	void *memory = _allocate(slabProvider, 100, NULL);
+
+	// More live providers with thread caches than there are pthread keys
+	const size_t count = PTHREAD_KEYS_MAX + 16;
+	FolioMemoryProvider **providers = calloc(count, sizeof(FolioMemoryProvider *));
+	for (size_t i = 0; i < count; ++i) {
+		providers[i] = folioSlabProvider_Create(SIZE_MAX);
+		void *block = folioMemoryProvider_Allocate(providers[i], 100, NULL);
+		folioMemoryProvider_Release(providers[i], &block);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		assertTrue(folioMemoryProvider_ReleaseProvider(&providers[i]), "Provider %zu should be freed", i);
+	}
+	free(providers);
+
+	// The caches of the freed providers go away as the thread looks for the first one's
+	assertTrue(_findThreadCache(folioInternalProvider_GetProviderState(slabProvider)) != NULL, "Lost the thread cache");
+	assertTrue(_threadCaches->threadNext == NULL, "The caches of freed providers are still on the thread's list");
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _reserve)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	const size_t hints[] = { 100, 1000, 0 };
+	size_t reserved = _reserve(slabProvider, 4 * SlabLength, hints, FolioReserveFlags_Populate);
+	assertTrue(reserved == 4 * SlabLength, "Expected 4 slabs reserved, got %zu bytes", reserved);
+	assertTrue(state->slabCount == 4, "Expected 4 slabs, got %zu", state->slabCount);
+
+	// Comes off the reserved free list, so no new slab
+	void *memory = _allocate(slabProvider, 100, NULL);
+	assertTrue(state->slabCount == 4, "Expected 4 slabs, got %zu", state->slabCount);
+
+	unsigned index = _sizeClassIndex(folioInternalProvider_BlockLength(slabProvider, 100));
+	SlabHeader *slab = (SlabHeader *) ((uintptr_t) memory & ~(uintptr_t) (SlabLength - 1));
+	assertTrue(slab->sizeClass == index, "Expected size class %u, got %u", index, slab->sizeClass);
+
+	_release(slabProvider, &memory);
+}
+
+/*
+ * Fills and frees 4 slabs worth of 4000 byte blocks
+ */
+static void
+_fillAndFree(FolioMemoryProvider *slabProvider)
+{
+	const size_t length = 4000;
+	const size_t count = 4 * SlabLength / length;
+	void *memory[count];
+
+	for (size_t i = 0; i < count; ++i) {
+		memory[i] = _allocate(slabProvider, length, NULL);
+		assertNotNull(memory[i], "Allocate %zu failed", i);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		_release(slabProvider, &memory[i]);
+	}
+}
+
+LONGBOW_TEST_CASE(Local, _scavenge)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	const size_t hints[] = { 100, 0 };
+	_reserve(slabProvider, SlabLength, hints, FolioReserveFlags_None);
+
+	_fillAndFree(slabProvider);
+	size_t slabs = state->slabCount;
+
+	// A budget under one slab gives back nothing
+	size_t scavenged = _scavenge(slabProvider, SlabLength - 1);
+	assertTrue(scavenged == 0, "Expected 0 bytes, got %zu", scavenged);
+
+	scavenged = _scavenge(slabProvider, SlabLength);
+	assertTrue(scavenged == SlabLength, "Expected 1 slab, got %zu bytes", scavenged);
+
+	// Everything but the reserved slab and the slab being carved
+	scavenged += _scavenge(slabProvider, SIZE_MAX);
+	assertTrue(state->slabCount == 2, "Expected 2 slabs left of %zu, got %zu", slabs, state->slabCount);
+	assertTrue(scavenged == (slabs - 2) * SlabLength, "Expected %zu bytes, got %zu", (slabs - 2) * SlabLength, scavenged);
+
+	// The free lists still work
+	_fillAndFree(slabProvider);
+}
+
+LONGBOW_TEST_CASE(Local, _scavenge_Retain)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	_fillAndFree(slabProvider);
+	size_t idleSlabs = state->slabCount - 1;
+
+	folioMemoryProvider_SetScavengePolicy(slabProvider, idleSlabs * SlabLength, 100);
+	size_t scavenged = _scavenge(slabProvider, SIZE_MAX);
+	assertTrue(scavenged == 0, "Expected the retained slabs kept, got %zu bytes", scavenged);
+
+	// Half of the idle slabs above one slab
+	folioMemoryProvider_SetScavengePolicy(slabProvider, SlabLength, 50);
+	scavenged = _scavenge(slabProvider, SIZE_MAX);
+	size_t expected = (idleSlabs - 1) / 2 * SlabLength;
+	assertTrue(scavenged == expected, "Expected %zu bytes, got %zu", expected, scavenged);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAndZero)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	uint8_t truth[length];
+	memset(truth, 0, length);
+
+	// Dirty a block so the zeroed allocation reuses it
+	void *dirty = _allocate(slabProvider, length, NULL);
+	memset(dirty, 0xA5, length);
+	_release(slabProvider, &dirty);
+
+	void *memory = _allocateAndZero(slabProvider, length, NULL);
+	int result = memcmp(truth, memory, length);
+	assertTrue(result == 0, "Memory was not set to zero");
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAndZero_Fresh)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(slabProvider);
+
+	const size_t lengths[] = { 200, 2 * MaximumClassLength };
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(size_t); i++) {
+		uint8_t *memory = _allocateAndZero(slabProvider, lengths[i], NULL);
+		for (size_t j = 0; j < lengths[i]; j++) {
+			assertTrue(memory[j] == 0, "Length %zu byte %zu not zero", lengths[i], j);
+		}
+
+		if (lengths[i] <= MaximumClassLength) {
+			// Every block of a new slab is fresh, and stays so until a block is released to the magazine
+			unsigned index = _sizeClassIndex(folioInternalProvider_BlockLength(slabProvider, lengths[i]));
+			ThreadMagazine *magazine = &_getThreadCache(state)->magazines[index];
+			assertTrue(magazine->fresh == magazine->count, "Expected %u fresh blocks, got %u", magazine->count, magazine->fresh);
+
+			_release(slabProvider, (void **) &memory);
+			assertTrue(magazine->fresh == 0, "The release should end the fresh blocks, got %u", magazine->fresh);
+		} else {
+			_release(slabProvider, (void **) &memory);
+		}
+	}
+}
+
+LONGBOW_TEST_CASE(Local, _acquire)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	void *memory = _allocate(slabProvider, length, NULL);
+	void *mem2 = _acquire(slabProvider, memory);
+	_validate(slabProvider, memory);
+	_validate(slabProvider, mem2);
+
+	size_t acquireCount = _acquireCount(slabProvider);
+	assertTrue(acquireCount == 2, "Expected 2 allocation, got %zu", acquireCount);
+
+	_release(slabProvider, &memory);
+
+	acquireCount = _acquireCount(slabProvider);
+	assertTrue(acquireCount == 1, "Expected 1 allocation, got %zu", acquireCount);
+
+	size_t allocationSize = _allocationSize(slabProvider);
+	assertTrue(allocationSize == length, "Expected %zu bytes, got %zu", length, allocationSize);
+
+	_release(slabProvider, &mem2);
+}
+
+LONGBOW_TEST_CASE(Local, _report)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	void *memory = _allocate(slabProvider, 128, NULL);
+	void *mem2 = _allocate(slabProvider, 1000, NULL);
+
+	_report(slabProvider, stdout);
+
+	_release(slabProvider, &mem2);
+	_release(slabProvider, &memory);
+}
+
+LONGBOW_TEST_CASE(Local, _length)
+{
+	FolioMemoryProvider *slabProvider = longBowTestCase_GetClipBoardData(testCase);
+
+	const size_t length = 128;
+	void *memory = _allocate(slabProvider, length, NULL);
+	size_t test = _length(slabProvider, memory);
+	assertTrue(length == test, "Wrong length, expected %zu got %zu", length, test);
+	_release(slabProvider, &memory);
+}
+
+/*****************************************************/
+
+typedef struct corrupt_data {
+	FolioMemoryProvider *provider;
+	void *memory;
+	size_t length;
+} CorruptData;
+
+static CorruptData _data;
+
+LONGBOW_TEST_FIXTURE(CorruptMemory)
+{
+    LONGBOW_RUN_TEST_CASE(CorruptMemory, overrun);
+    LONGBOW_RUN_TEST_CASE(CorruptMemory, underrun);
+}
+
+LONGBOW_TEST_FIXTURE_SETUP(CorruptMemory)
+{
+	_data.provider = folioSlabProvider_Create(SIZE_MAX);
+	_data.length = 64;
+	_data.memory = _allocate(_data.provider, _data.length, NULL);
+
+	return LONGBOW_STATUS_SUCCEEDED;
+}
+
+LONGBOW_TEST_FIXTURE_TEARDOWN(CorruptMemory)
+{
+	int status = LONGBOW_STATUS_SUCCEEDED;
+
+	// Because we intentionally corrupt the memory, we cannot use
+	// normal release.  The slabs go away with the provider.
+
+	SlabState *state = (SlabState *) folioInternalProvider_GetProviderState(_data.provider);
+	folioStats_Release(&state->stats, true);
+
+	if (!folioMemoryProvider_TestRefCount(_data.provider, 0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
+		_report(_data.provider, stdout);
+		status = LONGBOW_STATUS_MEMORYLEAK;
+	}
+
+	_releaseProvider(&_data.provider);
+
+	return status;
+}
+
+LONGBOW_TEST_CASE_EXPECTS(CorruptMemory, overrun, .event = &LongBowTrapUnexpectedStateEvent)
+{
+	size_t length = _length(_data.provider, _data.memory);
+
+	memset(_data.memory, 0xFF, length + 1);
+	_validate(_data.provider, _data.memory);
+
+	// if we get there it failed
+	printf("*** The memory should have overrun\n");
+	folioInternalProvider_Display(_data.provider, _data.memory, stdout);
+}
+
+LONGBOW_TEST_CASE_EXPECTS(CorruptMemory, underrun, .event = &LongBowTrapUnexpectedStateEvent)
+{
+	// wipe out part of magic2, but be sure to not corrupt the length
+	void *p2 = _data.memory - 1;
+
+	memset(p2, 0xFF, 1);
+	_validate(_data.provider, _data.memory);
+
+	// if we get there it failed
+	printf("*** The memory should have underrun\n");
+	folioInternalProvider_Display(_data.provider, _data.memory, stdout);
+}
+
+/*****************************************************/
+
+int
+main(int argc, char *argv[argc])
+{
+    LongBowRunner *testRunner = LONGBOW_TEST_RUNNER_CREATE(folio_SlabProvider);
+    int exitStatus = LONGBOW_TEST_MAIN(argc, argv, testRunner, NULL);
+    longBowTestRunner_Destroy(&testRunner);
+    exit(exitStatus);
+}
@@ -35,6 +35,9 @@
 #include "../src/folio_StdProvider.c"
 
 #include <Folio/folio.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
 
 LONGBOW_TEST_RUNNER(folio_StdProvider)
 {
@@ -65,9 +68,25 @@ LONGBOW_TEST_FIXTURE(Local)
     LONGBOW_RUN_TEST_CASE(Local, _allocate_OutOfMemory);
 
     LONGBOW_RUN_TEST_CASE(Local, _allocateAndZero);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateAligned);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateBatch);
     LONGBOW_RUN_TEST_CASE(Local, _acquire);
+    LONGBOW_RUN_TEST_CASE(Local, _acquireUnchecked);
+    LONGBOW_RUN_TEST_CASE(Local, _acquireN);
+    LONGBOW_RUN_TEST_CASE(Local, folio_Steal);
+    LONGBOW_RUN_TEST_CASE(Local, _reallocate);
     LONGBOW_RUN_TEST_CASE(Local, _report);
     LONGBOW_RUN_TEST_CASE(Local, _length);
+    LONGBOW_RUN_TEST_CASE(Local, _createChild);
+    LONGBOW_RUN_TEST_CASE(Local, _createChild_Tree);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateWait_NeverFits);
+    LONGBOW_RUN_TEST_CASE(Local, _allocateWait_SiblingRelease);
+    LONGBOW_RUN_TEST_CASE(Local, _getOwner);
+    LONGBOW_RUN_TEST_CASE(Local, folio_PushThreadProvider);
+    LONGBOW_RUN_TEST_CASE(Local, folio_PushThreadProvider_ThreadExit);
+    LONGBOW_RUN_TEST_CASE(Local, folio_SetProvider_Concurrent);
+    LONGBOW_RUN_TEST_CASE(Local, folio_SetProvider_LiveBlocks);
+    LONGBOW_RUN_TEST_CASE(Local, folio_SetProvider_WhileWaiting);
 }
 
 LONGBOW_TEST_FIXTURE_SETUP(Local)
@@ -183,6 +202,115 @@ LONGBOW_TEST_CASE(Local, _acquire)
 	folio_Release(&mem2);
 }
 
+LONGBOW_TEST_CASE(Local, _acquireUnchecked)
+{
+	const size_t length = 128;
+	void *memory = folio_Allocate(length);
+	void *mem2 = folio_AcquireUnchecked(memory);
+
+	size_t acquireCount = folio_OustandingReferences();
+	assertTrue(acquireCount == 2, "Expected 2 allocation, got %zu", acquireCount);
+
+	folio_ReleaseUnchecked(&mem2);
+	assertNull(mem2, "Release did not null the pointer");
+	folio_ReleaseUnchecked(&memory);
+
+	size_t allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateAligned)
+{
+	void *memory = folio_AllocateAligned(1000, 64, NULL);
+	assertNotNull(memory, "Did not return memory pointer");
+	assertTrue(((uintptr_t) memory & 63) == 0, "Memory %p not aligned to 64", memory);
+	memset(memory, 0xA5, 1000);
+	folio_Validate(memory);
+
+	void *mem2 = folio_Acquire(memory);
+	folio_Release(&mem2);
+	folio_Release(&memory);
+
+	size_t allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateBatch)
+{
+	void *memory[64];
+	size_t allocated = folio_AllocateBatch(64, 1500, NULL, memory);
+	assertTrue(allocated == 64, "Expected 64 allocations, got %zu", allocated);
+
+	size_t acquireCount = folio_OustandingReferences();
+	assertTrue(acquireCount == 64, "Expected 64 references, got %zu", acquireCount);
+
+	size_t allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 64 * 1500, "Expected %d bytes, got %zu", 64 * 1500, allocationSize);
+
+	folio_ReleaseBatch(memory, allocated);
+	assertNull(memory[63], "Release did not null the pointer");
+
+	allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, _acquireN)
+{
+	void *memory = folio_Allocate(128);
+	folio_AcquireN(memory, 4);
+
+	size_t acquireCount = folio_OustandingReferences();
+	assertTrue(acquireCount == 5, "Expected 5 references, got %zu", acquireCount);
+
+	// Consumers release one at a time or several at once
+	void *copy = memory;
+	folio_Release(&copy);
+	copy = memory;
+	folio_ReleaseN(&copy, 3);
+	assertNull(copy, "Release did not null the pointer");
+
+	acquireCount = folio_OustandingReferences();
+	assertTrue(acquireCount == 1, "Expected 1 reference, got %zu", acquireCount);
+
+	folio_ReleaseN(&memory, 1);
+
+	size_t allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 0, "Expected 0 bytes, got %zu", allocationSize);
+}
+
+LONGBOW_TEST_CASE(Local, folio_Steal)
+{
+	void *slot = folio_Allocate(16);
+	void *saved = slot;
+
+	void *memory = folio_Steal(&slot);
+	assertTrue(memory == saved, "Wrong pointer, expected %p got %p", saved, memory);
+	assertNull(slot, "Steal did not null the slot");
+
+	size_t acquireCount = folio_OustandingReferences();
+	assertTrue(acquireCount == 1, "Expected 1 reference, got %zu", acquireCount);
+
+	assertNull(folio_Steal(&slot), "Stealing from an empty slot should return NULL");
+
+	folio_Release(&memory);
+}
+
+LONGBOW_TEST_CASE(Local, _reallocate)
+{
+	char *memory = folio_Allocate(6);
+	strcpy(memory, "hello");
+
+	void *result = folio_Reallocate((void **) &memory, 4096);
+	assertNotNull(result, "Reallocate failed");
+	assertTrue(strcmp(memory, "hello") == 0, "Lost the contents, got '%s'", memory);
+	folio_Validate(memory);
+
+	size_t allocationSize = folio_AllocatedBytes();
+	assertTrue(allocationSize == 4096, "Expected 4096 bytes, got %zu", allocationSize);
+
+	folio_Release((void **) &memory);
+}
+
 LONGBOW_TEST_CASE(Local, _report)
 {
 	const size_t length = 128;
@@ -204,12 +332,355 @@ LONGBOW_TEST_CASE(Local, _length)
 	folio_Release(&memory);
 }
 
+LONGBOW_TEST_CASE(Local, _createChild)
+{
+	FolioMemoryProvider *parent = folioStdProvider_Create(1000);
+
+	// Limits of 600 charge the parent in chunks of 75 bytes
+	FolioMemoryProvider *a = folioMemoryProvider_CreateChild(parent, 600);
+	FolioMemoryProvider *b = folioMemoryProvider_CreateChild(parent, 600);
+
+	void *a1 = folioMemoryProvider_Allocate(a, 100, NULL);
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 150, "Wrong parent bytes, expected 150 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	// Fits in the chunk already charged
+	void *a2 = folioMemoryProvider_Allocate(a, 10, NULL);
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 150, "Wrong parent bytes, expected 150 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	void *b1 = folioMemoryProvider_Allocate(b, 500, NULL);
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 675, "Wrong parent bytes, expected 675 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	// Within the limit of a, but not of the parent
+	void *a3 = folioMemoryProvider_Allocate(a, 400, NULL);
+	assertNull(a3, "Allocation beyond the parent limit should fail");
+	assertTrue(folioMemoryProvider_AllocatedBytes(a) == 110, "Wrong child bytes, expected 110 got %zu",
+			folioMemoryProvider_AllocatedBytes(a));
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 675, "Wrong parent bytes, expected 675 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	// Beyond the limit of b
+	void *b2 = folioMemoryProvider_Allocate(b, 101, NULL);
+	assertNull(b2, "Allocation beyond the child limit should fail");
+
+	folioMemoryProvider_Release(a, &a1);
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 600, "Wrong parent bytes, expected 600 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	folioMemoryProvider_Release(b, &b1);
+	folioMemoryProvider_Release(a, &a2);
+	assertTrue(folioMemoryProvider_AllocatedBytes(parent) == 0, "Wrong parent bytes, expected 0 got %zu",
+			folioMemoryProvider_AllocatedBytes(parent));
+
+	// The children hold references to the parent
+	assertFalse(folioMemoryProvider_ReleaseProvider(&parent), "Parent should not be freed while it has children");
+	folioMemoryProvider_ReleaseProvider(&a);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&b), "Last child should free the parent");
+}
+
+LONGBOW_TEST_CASE(Local, _createChild_Tree)
+{
+	FolioMemoryProvider *root = folioStdProvider_Create(SIZE_MAX);
+	FolioMemoryProvider *child = folioMemoryProvider_CreateChild(root, 8000);
+	FolioMemoryProvider *grandchild = folioMemoryProvider_CreateChild(child, 800);
+
+	// The grandchild charges 100 byte chunks to the child, which charges 1000 byte chunks to the root
+	void *memory = folioMemoryProvider_Allocate(grandchild, 150, NULL);
+	assertTrue(folioMemoryProvider_AllocatedBytes(child) == 200, "Wrong child bytes, expected 200 got %zu",
+			folioMemoryProvider_AllocatedBytes(child));
+	assertTrue(folioMemoryProvider_AllocatedBytes(root) == 1000, "Wrong root bytes, expected 1000 got %zu",
+			folioMemoryProvider_AllocatedBytes(root));
+
+	char *report = folioPool_ToString(folioPool_GetFromProvider(root));
+	char *childLine = strstr(report, "child pool");
+	assertNotNull(childLine, "Report should show the child: %s", report);
+	assertNotNull(strstr(childLine, "150 of 800 bytes, charged 200"), "Report should show the grandchild: %s", report);
+	free(report);
+
+	folioMemoryProvider_Release(grandchild, &memory);
+	assertTrue(folioMemoryProvider_AllocatedBytes(root) == 0, "Wrong root bytes, expected 0 got %zu",
+			folioMemoryProvider_AllocatedBytes(root));
+
+	folioMemoryProvider_ReleaseProvider(&grandchild);
+	folioMemoryProvider_ReleaseProvider(&child);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&root), "Root should be freed");
+}
+
+static uint64_t
+_elapsedNanos(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) (now.tv_sec - start->tv_sec) * 1000000000ULL + (uint64_t) now.tv_nsec - (uint64_t) start->tv_nsec;
+}
+
+LONGBOW_TEST_CASE(Local, _allocateWait_NeverFits)
+{
+	FolioMemoryProvider *parent = folioStdProvider_Create(1000);
+	FolioMemoryProvider *child = folioMemoryProvider_CreateChild(parent, 2000);
+	folioMemoryProvider_SetPriorityClass(parent, FolioPriority_Normal, 0, 300);
+
+	// Each could never fit, so none of them waits out the timeout
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	void *memory = folioMemoryProvider_AllocateWait(parent, 400, NULL, 10000);
+	assertNull(memory, "Should not allocate beyond the class cap");
+
+	memory = folioMemoryProvider_AllocateWait(child, 1500, NULL, 10000);
+	assertNull(memory, "Should not allocate beyond the parent's pool");
+
+	// The child charges the parent whole chunks of 250 bytes
+	memory = folioMemoryProvider_AllocateWait(child, 260, NULL, 10000);
+	assertNull(memory, "Should not allocate beyond the parent's class cap");
+
+	uint64_t elapsed = _elapsedNanos(&start);
+	assertTrue(elapsed < 1000000000, "Expected no waits, took %" PRIu64 " ns", elapsed);
+
+	// Within every limit it still succeeds
+	memory = folioMemoryProvider_AllocateWait(child, 50, NULL, 10000);
+	assertNotNull(memory, "Should allocate within the limits");
+	folioMemoryProvider_Release(child, &memory);
+
+	folioMemoryProvider_ReleaseProvider(&parent);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&child), "Child should free the parent");
+}
+
+static void *
+_allocateWaitChild(void *arg)
+{
+	FolioMemoryProvider *child = arg;
+	return folioMemoryProvider_AllocateWait(child, 500, NULL, 10000);
+}
+
+LONGBOW_TEST_CASE(Local, _allocateWait_SiblingRelease)
+{
+	FolioMemoryProvider *parent = folioStdProvider_Create(1000);
+	FolioMemoryProvider *a = folioMemoryProvider_CreateChild(parent, 1000);
+	FolioMemoryProvider *b = folioMemoryProvider_CreateChild(parent, 1000);
+	FolioPool *pool = folioPool_GetFromProvider(a);
+
+	// a has room of its own, but the parent does not
+	void *full = folioMemoryProvider_Allocate(b, 900, NULL);
+	assertNotNull(full, "Should allocate from b");
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, _allocateWaitChild, a);
+	while (atomic_load(&pool->waiters) == 0) {
+		sched_yield();
+	}
+
+	// The release refunds the parent, which must wake the waiter in a
+	folioMemoryProvider_Release(b, &full);
+	void *memory = NULL;
+	pthread_join(thread, &memory);
+
+	uint64_t elapsed = _elapsedNanos(&start);
+	assertNotNull(memory, "The waiter should allocate once b releases");
+	assertTrue(elapsed < 5000000000ULL, "Expected a prompt wake up, took %" PRIu64 " ns", elapsed);
+
+	folioMemoryProvider_Release(a, &memory);
+	folioMemoryProvider_ReleaseProvider(&parent);
+	folioMemoryProvider_ReleaseProvider(&a);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&b), "Last child should free the parent");
+}
+
+static void *
+_getThreadProvider(void *unused __attribute__((unused)))
+{
+	return folio_GetProvider();
+}
+
+LONGBOW_TEST_CASE(Local, folio_PushThreadProvider)
+{
+	FolioMemoryProvider *global = folio_GetProvider();
+	FolioMemoryProvider *outer = folioStdProvider_Create(SIZE_MAX);
+	FolioMemoryProvider *inner = folioStdProvider_Create(SIZE_MAX);
+
+	folio_PushThreadProvider(outer);
+	void *a = folio_Allocate(16);
+	folio_PushThreadProvider(inner);
+	void *b = folio_AllocateAndZero(16, NULL);
+
+	// The counters follow the pushed provider
+	assertTrue(folio_AllocatedBytes() == 16, "Expected 16 bytes in the scope, got %zu", folio_AllocatedBytes());
+	assertTrue(folio_TestRefCount(1, stdout, "Expected 1 reference in the scope\n"), "Wrong scope references");
+
+	// Another thread still uses the global provider
+	pthread_t thread;
+	void *other = NULL;
+	pthread_create(&thread, NULL, _getThreadProvider, NULL);
+	pthread_join(thread, &other);
+	assertTrue(other == global, "Other thread should use the global provider");
+
+	folio_PopThreadProvider();
+	assertTrue(folio_GetProvider() == outer, "Pop should return to the outer provider");
+	folio_PopThreadProvider();
+	assertTrue(folio_GetProvider() == global, "Pop should return to the global provider");
+
+	assertTrue(folioMemoryProvider_GetOwner(a) == outer, "a should come from the outer provider");
+	assertTrue(folioMemoryProvider_GetOwner(b) == inner, "b should come from the inner provider");
+
+	// Released after the pops, through their owners
+	folio_Release(&a);
+	folio_Release(&b);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&inner), "Inner provider should be freed");
+	assertTrue(folioMemoryProvider_ReleaseProvider(&outer), "Outer provider should be freed");
+}
+
+static atomic_bool _swapping;
+
+static void *
+_allocateWhileSwapping(void *unused __attribute__((unused)))
+{
+	unsigned count = 0;
+	while (atomic_load(&_swapping) || count < 1000) {
+		void *memory = folio_Allocate(32);
+		folio_Length(memory);
+		folio_Release(&memory);
+		count++;
+	}
+	return NULL;
+}
+
+static void *
+_exitWithPushedProvider(void *provider)
+{
+	folio_PushThreadProvider(provider);
+	folio_PushThreadProvider(provider);
+	void *memory = folio_Allocate(16);
+	return memory;
+}
+
+LONGBOW_TEST_CASE(Local, folio_PushThreadProvider_ThreadExit)
+{
+	FolioMemoryProvider *provider = folioStdProvider_Create(SIZE_MAX);
+
+	pthread_t thread;
+	void *memory = NULL;
+	pthread_create(&thread, NULL, _exitWithPushedProvider, provider);
+	pthread_join(thread, &memory);
+
+	// The exit popped both pushes, so only the memory and this reference are left
+	assertTrue(folioMemoryProvider_GetOwner(memory) == provider, "Memory should come from the pushed provider");
+	folio_Release(&memory);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&provider), "The thread should not hold a reference after it exits");
+}
+
+LONGBOW_TEST_CASE(Local, folio_SetProvider_Concurrent)
+{
+	FolioMemoryProvider *global = folio_GetProvider();
+	FolioMemoryProvider *providers[2] = { folioStdProvider_Create(SIZE_MAX), folioStdProvider_Create(SIZE_MAX) };
+
+	atomic_store(&_swapping, true);
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++) {
+		pthread_create(&threads[i], NULL, _allocateWhileSwapping, NULL);
+	}
+
+	// Each swap must wait for allocations on the prior provider before releasing it
+	for (int i = 0; i < 200; i++) {
+		folio_SetProvider(providers[i % 2]);
+	}
+	folio_SetProvider(global);
+
+	atomic_store(&_swapping, false);
+	for (int i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		assertTrue(folioMemoryProvider_AllocatedBytes(providers[i]) == 0, "Provider %d has %zu bytes allocated",
+				i, folioMemoryProvider_AllocatedBytes(providers[i]));
+		assertTrue(folioMemoryProvider_ReleaseProvider(&providers[i]), "Provider %d should be freed", i);
+	}
+}
+
+LONGBOW_TEST_CASE(Local, folio_SetProvider_LiveBlocks)
+{
+	FolioMemoryProvider *global = folio_GetProvider();
+	FolioMemoryProvider *provider = folioStdProvider_Create(SIZE_MAX);
+
+	folio_SetProvider(provider);
+	void *memory = folio_Allocate(64);
+	void *batch[] = { folio_Allocate(32), folio_Allocate(32) };
+	assertFalse(folioMemoryProvider_ReleaseProvider(&provider), "The global provider should still hold a reference");
+
+	// The swap drops the last reference, the blocks keep the pool
+	folio_SetProvider(global);
+
+	assertTrue(folio_Length(memory) == 64, "Wrong length, expected 64 got %zu", folio_Length(memory));
+	folio_ReleaseBatch(batch, 2);
+	folio_Release(&memory);
+}
+
+static void *
+_allocateWaitForever(void *unused __attribute__((unused)))
+{
+	return folio_AllocateWait(32, NULL, FolioWaitForever);
+}
+
+LONGBOW_TEST_CASE(Local, folio_SetProvider_WhileWaiting)
+{
+	FolioMemoryProvider *global = folio_GetProvider();
+	FolioMemoryProvider *provider = folioStdProvider_Create(64);
+	FolioPool *pool = folioPool_GetFromProvider(provider);
+
+	folio_SetProvider(provider);
+	void *full = folio_Allocate(64);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, _allocateWaitForever, NULL);
+	while (atomic_load(&pool->waiters) == 0) {
+		sched_yield();
+	}
+
+	// Must not wait for the sleeping allocation
+	folio_SetProvider(global);
+
+	folio_Release(&full);
+	void *memory = NULL;
+	pthread_join(thread, &memory);
+
+	assertTrue(folioMemoryProvider_GetOwner(memory) == provider, "Memory should come from the provider the wait started with");
+	folio_Release(&memory);
+	assertTrue(folioMemoryProvider_ReleaseProvider(&provider), "The wait should not keep a reference");
+}
+
+LONGBOW_TEST_CASE(Local, _getOwner)
+{
+	FolioMemoryProvider *provider = folioStdProvider_Create(SIZE_MAX);
+	void *memory = folioMemoryProvider_Allocate(provider, 64, NULL);
+	void *global = folio_Allocate(64);
+
+	assertTrue(folioMemoryProvider_GetOwner(memory) == provider, "Wrong owner for provider memory");
+	assertTrue(folioMemoryProvider_GetOwner(global) == folio_GetProvider(), "Wrong owner for global memory");
+
+	// The folio_* calls go to the owner, not the global provider
+	void *copy = folio_Acquire(memory);
+	assertTrue(folio_Length(copy) == 64, "Wrong length, expected 64 got %zu", folio_Length(copy));
+	assertTrue(folioMemoryProvider_OustandingReferences(provider) == 2, "Wrong provider references, expected 2 got %zu",
+			folioMemoryProvider_OustandingReferences(provider));
+
+	void *batch[] = { copy, global, memory };
+	folio_ReleaseBatch(batch, 3);
+	assertTrue(folioMemoryProvider_AllocatedBytes(provider) == 0, "Wrong provider bytes, expected 0 got %zu",
+			folioMemoryProvider_AllocatedBytes(provider));
+
+	assertTrue(folioMemoryProvider_ReleaseProvider(&provider), "Provider should be freed");
+}
+
 /*****************************************************/
 
 LONGBOW_TEST_FIXTURE(CorruptMemory)
 {
     LONGBOW_RUN_TEST_CASE(CorruptMemory, overrun);
     LONGBOW_RUN_TEST_CASE(CorruptMemory, underrun);
+    LONGBOW_RUN_TEST_CASE(CorruptMemory, overrun_FinalRelease);
 }
 
 static const int _corruptLength = 64;
@@ -237,9 +708,8 @@ LONGBOW_TEST_FIXTURE_TEARDOWN(CorruptMemory)
 	size_t requestLength = folioHeader_GetRequestedLength(h);
 	free(h);
 
-	_Stats *stats = (_Stats *) folioInternalProvider_GetProviderState(&FolioStdProvider);
-	stats->outstandingAllocs--;
-	stats->outstandingAcquires--;
+	FolioStats *stats = (FolioStats *) folioInternalProvider_GetProviderState(&FolioStdProvider);
+	folioStats_Release(stats, true);
 	pool->currentAllocation -= requestLength;
 
 	if (!folio_TestRefCount(0, stdout, "Memory leak in %s\n", longBowTestCase_GetFullName(testCase))) {
@@ -248,6 +718,7 @@ LONGBOW_TEST_FIXTURE_TEARDOWN(CorruptMemory)
 	}
 
 	folio_SetAvailableMemory(SIZE_MAX);
+	folio_SetValidationLevel(FolioValidationLevel_Full, 0);
 
 	return status;
 }
@@ -278,6 +749,21 @@ LONGBOW_TEST_CASE_EXPECTS(CorruptMemory, underrun, .event = &LongBowTrapUnexpect
 	fflush(stdout);
 }
 
+LONGBOW_TEST_CASE_EXPECTS(CorruptMemory, overrun_FinalRelease, .event = &LongBowTrapUnexpectedStateEvent)
+{
+	uint8_t *p = longBowTestCase_GetClipBoardData(testCase);
+	folio_SetValidationLevel(FolioValidationLevel_FinalRelease, 0);
+
+	p[_corruptLength] = ~p[_corruptLength];
+
+	// Not checked until the final release
+	void *p2 = folio_Acquire(p);
+	folio_Release(&p2);
+
+	void *p3 = p;
+	folio_Release(&p3);
+}
+
 /*****************************************************/
 
 int